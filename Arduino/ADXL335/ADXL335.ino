@@ -1,3 +1,10 @@
+#include <ESPFrame.h>
+
+// Set to true to send binary frames (read on the host with BinarySerialStream)
+// instead of tab-separated text (read with ASCIISerialStream).
+const bool kUseBinaryFrames = false;
+ESPFrame frame(Serial);
+
 int vinpin = A0;
 int voutpin = A1;
 int gndpin = A2;
@@ -16,6 +23,14 @@ void setup() {
 }
 
 void loop() {
+  if (kUseBinaryFrames) {
+    frame.add((int16_t) analogRead(xpin));
+    frame.add((int16_t) analogRead(ypin));
+    frame.add((int16_t) analogRead(zpin));
+    frame.send();
+    return;
+  }
+
   Serial.print(analogRead(xpin)); Serial.print("\t");
   Serial.print(analogRead(ypin)); Serial.print("\t");
   Serial.print(analogRead(zpin)); Serial.println();
@@ -1,4 +1,10 @@
 #include "CurieImu.h"
+#include <ESPFrame.h>
+
+// Set to true to send binary frames (read on the host with BinarySerialStream)
+// instead of tab-separated text (read with ASCIISerialStream).
+const bool kUseBinaryFrames = false;
+ESPFrame frame(Serial);
 
 int16_t ax, ay, az;
 int16_t gx, gy, gz;
@@ -16,6 +22,14 @@ void setup() {
 
 void loop() {
   CurieImu.getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+
+  if (kUseBinaryFrames) {
+    frame.add(ax); frame.add(ay); frame.add(az);
+    frame.add(gx); frame.add(gy); frame.add(gz);
+    frame.send();
+    return;
+  }
+
   Serial.print(ax);
   Serial.print("\t");
   Serial.print(ay);
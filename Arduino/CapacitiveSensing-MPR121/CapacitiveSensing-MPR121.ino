@@ -1,5 +1,11 @@
 #include <Wire.h>
 #include "Adafruit_MPR121.h"
+#include <ESPFrame.h>
+
+// Set to true to send binary frames (read on the host with BinarySerialStream)
+// instead of tab-separated text (read with ASCIISerialStream).
+const bool kUseBinaryFrames = false;
+ESPFrame frame(Serial);
 
 Adafruit_MPR121 cap = Adafruit_MPR121();
 
@@ -13,6 +19,13 @@ void setup() {
 }
 
 void loop() {
+  if (kUseBinaryFrames) {
+    for (int i = 0; i < 12; i++) frame.add(cap.filteredData(i));
+    frame.send();
+    delay(10);
+    return;
+  }
+
   for (int i = 0; i < 12; i++) {
     Serial.print(cap.filteredData(i)); Serial.print("\t");
     //Serial.print(cap.baselineData(i)); Serial.print("\t");
@@ -1,8 +1,14 @@
 #include <Wire.h>
 #include "Adafruit_TCS34725.h"
+#include <ESPFrame.h>
 
 Adafruit_TCS34725 tcs = Adafruit_TCS34725(TCS34725_INTEGRATIONTIME_50MS, TCS34725_GAIN_4X);
 
+// Set to true to send binary frames (read on the host with BinarySerialStream)
+// instead of tab-separated text (read with ASCIISerialStream).
+const bool kUseBinaryFrames = false;
+ESPFrame frame(Serial);
+
 void setup() {
   Serial.begin(9600);
 
@@ -22,7 +28,13 @@ void loop() {
   tcs.getRawData(&red, &green, &blue, &clear);
 
   tcs.setInterrupt(true);  // turn off LED
-  
+
+  if (kUseBinaryFrames) {
+    frame.add(red); frame.add(green); frame.add(blue);
+    frame.send();
+    return;
+  }
+
   Serial.print(red); Serial.print("\t");
   Serial.print(green); Serial.print("\t");
   Serial.print(blue); // Serial.print("\t");
@@ -1,100 +1,132 @@
-char *model = "GRT_PIPELINE_FILE_V3.0\n\
-PipelineMode: CLASSIFICATION_MODE\n\
-NumPreprocessingModules: 1\n\
-NumFeatureExtractionModules: 1\n\
-NumPostprocessingModules: 0\n\
-Trained: 1\n\
-Info: \n\
-PreProcessingModuleDatatypes:	MovingAverageFilter\n\
-FeatureExtractionModuleDatatypes:	TimeDomainFeatures\n\
-ClassificationModuleDatatype:	ANBC\n\
-PostProcessingModuleDatatypes:\n\
-PreProcessingModule_1\n\
-GRT_MOVING_AVERAGE_FILTER_FILE_V1.0\n\
-NumInputDimensions: 1\n\
-NumOutputDimensions: 1\n\
-FilterSize: 5\n\
-FeatureExtractionModule_1\n\
-GRT_TIME_DOMAIN_FEATURES_FILE_V1.0\n\
-Trained: 0\n\
-UseScaling: 0\n\
-NumInputDimensions: 1\n\
-NumOutputDimensions: 2\n\
-NumTrainingIterationsToConverge: 3239951500\n\
-MinNumEpochs: 0\n\
-MaxNumEpochs: 100\n\
-ValidationSetSize: 20\n\
-LearningRate: 0.1\n\
-MinChange: 1e-05\n\
-UseValidationSet: 0\n\
-RandomiseTrainingOrder: 1\n\
-Initialized: 1\n\
-BufferLength: 10\n\
-NumFrames: 1\n\
-OffsetInput: 0\n\
-UseMean: 1\n\
-UseStdDev: 1\n\
-UseEuclideanNorm: 0\n\
-UseRMS: 0\n\
-GRT_ANBC_MODEL_FILE_V2.0\n\
-Trained: 1\n\
-UseScaling: 0\n\
-NumInputDimensions: 2\n\
-NumOutputDimensions: 0\n\
-NumTrainingIterationsToConverge: 0\n\
-MinNumEpochs: 0\n\
-MaxNumEpochs: 100\n\
-ValidationSetSize: 20\n\
-LearningRate: 0.1\n\
-MinChange: 1e-05\n\
-UseValidationSet: 0\n\
-RandomiseTrainingOrder: 1\n\
-UseNullRejection: 0\n\
-ClassifierMode: 0\n\
-NullRejectionCoeff: 10\n\
-NumClasses: 3\n\
-NullRejectionThresholds:  0 0 0\n\
-ClassLabels:  1 2 3\n\
-*************_MODEL_*************\n\
-Model_ID: 1\n\
-N: 2\n\
-ClassLabel: 1\n\
-Threshold: -53.2888\n\
-Gamma: 10\n\
-TrainingMu: 4.91754\n\
-TrainingSigma: 5.82063\n\
-Mu:\n\
-	0.601282	0.00441438\n\
-Sigma:\n\
-	0.0195889	0.0247883\n\
-Weights:\n\
-	1	1\n\
-*************_MODEL_*************\n\
-Model_ID: 2\n\
-N: 2\n\
-ClassLabel: 2\n\
-Threshold: -28.2796\n\
-Gamma: 10\n\
-TrainingMu: 1.96227\n\
-TrainingSigma: 3.02419\n\
-Mu:\n\
-	-0.0480029	0.0210273\n\
-Sigma:\n\
-	0.130697	0.0642641\n\
-Weights:\n\
-	1	1\n\
-*************_MODEL_*************\n\
-Model_ID: 3\n\
-N: 2\n\
-ClassLabel: 3\n\
-Threshold: -29.9383\n\
-Gamma: 10\n\
-TrainingMu: 2.74099\n\
-TrainingSigma: 3.26793\n\
-Mu:\n\
-	-0.561578	0.0149926\n\
-Sigma:\n\
-	0.0887719	0.0438518\n\
-Weights:\n\
-	1	1\n\
-";
+// Generated from a trained GRT pipeline by the ESP exporter (pipeline_export.h);
+// do not edit.
+//
+// MovingAverageFilter(5) -> TimeDomainFeatures(10, 1) -> ANBC
+// 1 input dimensions, 3 classes, 68 bytes of State, float arithmetic.
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#ifndef ESP_READ_FLOAT
+#define ESP_READ_FLOAT(x) pgm_read_float(&(x))
+#define ESP_READ_BYTE(x) pgm_read_byte(&(x))
+#define ESP_READ_WORD(x) pgm_read_word(&(x))
+#define ESP_READ_DWORD(x) pgm_read_dword(&(x))
+#endif
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef ESP_READ_FLOAT
+#define ESP_READ_FLOAT(x) (x)
+#define ESP_READ_BYTE(x) (x)
+#define ESP_READ_WORD(x) (x)
+#define ESP_READ_DWORD(x) (x)
+#endif
+#endif
+
+namespace model {
+
+constexpr uint16_t kNumInputDimensions = 1;
+constexpr uint16_t kNumClasses = 3;
+
+const uint16_t kClassLabels[kNumClasses] PROGMEM = {
+    1, 2, 3
+};
+const float kOffsets[kNumClasses] PROGMEM = {
+    5.79229879f, 2.94175076f, 3.71074748f
+};
+const float kMeans[3][2] PROGMEM = {
+    { 0.601282001f, 0.00441438006f },
+    { -0.0480028987f, 0.0210273005f },
+    { -0.561577976f, 0.0149926003f }
+};
+const float kPrecisions[3][2] PROGMEM = {
+    { 1303.01648f, 813.722839f },
+    { 29.2710819f, 121.069054f },
+    { 63.4481506f, 260.013062f }
+};
+
+// The filters' sample history; zero-initialize it to start empty.
+struct State {
+    float buffer1[5][1];
+    uint16_t next1;
+    uint16_t count1;
+    float buffer2[10][1];
+    uint16_t next2;
+    uint16_t count2;
+};
+
+// `input` holds kNumInputDimensions values. Returns the predicted class
+// label, or 0 for none.
+inline uint16_t predict(State* state, const float* input) {
+    const float* x0 = input;
+    // MovingAverageFilter(5): the mean of the last 5 inputs.
+    float x1[1];
+    for (uint16_t j = 0; j < 1; j++) {
+        state->buffer1[state->next1][j] = x0[j];
+    }
+    if (++state->next1 == 5) { state->next1 = 0; }
+    if (state->count1 < 5) { state->count1++; }
+    for (uint16_t j = 0; j < 1; j++) {
+        float sum = 0;
+        for (uint16_t i = 0; i < state->count1; i++) { sum += state->buffer1[i][j]; }
+        x1[j] = sum / state->count1;
+    }
+
+    // TimeDomainFeatures(10, 1): per input and frame of 10 samples, mean std-dev.
+    float x2[2];
+    for (uint16_t j = 0; j < 1; j++) {
+        state->buffer2[state->next2][j] = x1[j];
+    }
+    if (++state->next2 == 10) { state->next2 = 0; }
+    if (state->count2 < 10) { state->count2++; }
+    {
+        const uint16_t first = state->count2 < 10 ? 0 : state->next2;
+        uint16_t f = 0;
+        for (uint16_t j = 0; j < 1; j++) {
+            for (uint16_t frame = 0; frame < 1; frame++) {
+                float sum = 0;
+                float sum_squares = 0;
+                for (uint16_t i = frame * 10; i < (frame + 1) * 10; i++) {
+                    uint16_t slot = first + i;
+                    if (slot >= 10) { slot -= 10; }
+                    const float v = state->buffer2[slot][j];
+                    sum += v; sum_squares += v * v;
+                }
+                const float mean = sum / 10;
+                x2[f++] = mean;
+                float deviation = 0;
+                for (uint16_t i = frame * 10; i < (frame + 1) * 10; i++) {
+                    uint16_t slot = first + i;
+                    if (slot >= 10) { slot -= 10; }
+                    const float v = state->buffer2[slot][j];
+                    deviation += (v - mean) * (v - mean);
+                }
+                x2[f++] = sqrtf(deviation / 9);
+            }
+        }
+    }
+
+    // ANBC: the class with the highest Gaussian log-likelihood.
+    uint16_t best = 0;
+    float best_log_likelihood = -INFINITY;
+    for (uint16_t k = 0; k < kNumClasses; k++) {
+        float log_likelihood = ESP_READ_FLOAT(kOffsets[k]);
+        for (uint16_t j = 0; j < 2; j++) {
+            const float diff = x2[j] - ESP_READ_FLOAT(kMeans[k][j]);
+            log_likelihood -= ESP_READ_FLOAT(kPrecisions[k][j]) * diff * diff;
+        }
+        if (log_likelihood > best_log_likelihood) {
+            best = k;
+            best_log_likelihood = log_likelihood;
+        }
+    }
+    if (!(best_log_likelihood >= -745.13f)) { return 0; }
+    return ESP_READ_WORD(kClassLabels[best]);
+}
+
+}  // namespace model
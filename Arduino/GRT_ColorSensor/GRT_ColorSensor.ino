@@ -1,24 +1,13 @@
 //#include <Adafruit_TCS34725.h>
 
-#undef min
-#undef max
+// model.h is generated by esp-export (Xcode/SmartSensors/headless) from the
+// trained pipeline: MovingAverageFilter(5) and ANBC.
+#include "model.h"
 
-#include <GRT.h>
-#include "pipeline.h"
-
-using namespace GRT;
-
-istringstream iss(pipelineText);
-GestureRecognitionPipeline pipeline;
+model::State state = model::State();
 
 //Adafruit_TCS34725 tcs = Adafruit_TCS34725(TCS34725_INTEGRATIONTIME_50MS, TCS34725_GAIN_4X);
 
-//void setupPipeline(GestureRecognitionPipeline& pipeline) {
-//    pipeline.addPreProcessingModule(MovingAverageFilter(5, 1));
-//    pipeline.addFeatureExtractionModule(TimeDomainFeatures(10, 1, 1, false, true, true, false, false));
-//    pipeline.setClassifier(ANBC());
-//}
-
 void setup() {
   Serial.begin(115200);
   Serial.print("Starting");
@@ -27,32 +16,6 @@ void setup() {
   }
   Serial.println();
 
-  pipeline.load(iss);
-  Serial.println("Loaded pipeline.");
-  
-  vector<ANBC_Model> models = ((ANBC *)pipeline.getClassifier())->getModels();
-  for (int i = 0; i < models.size(); i++) {
-    Serial.print("N: "); Serial.print(models[i].N); Serial.println();
-    Serial.print("classLabel: "); Serial.print(models[i].classLabel); Serial.println();
-    Serial.print("trainingMu: "); Serial.print(models[i].trainingMu); Serial.println();
-    Serial.print("trainingSigma: "); Serial.print(models[i].trainingSigma); Serial.println();
-    Serial.print("mu: ");
-    for (int j = 0; j < models[i].mu.size(); j++) {
-      Serial.print(models[i].mu[j]); Serial.print(" ");
-    }
-    Serial.println();
-    Serial.print("sigma: ");
-    for (int j = 0; j < models[i].sigma.size(); j++) {
-      Serial.print(models[i].sigma[j]); Serial.print(" ");
-    }
-    Serial.println();
-    Serial.print("weights: ");
-    for (int j = 0; j < models[i].weights.size(); j++) {
-      Serial.print(models[i].weights[j]); Serial.print(" ");
-    }
-    Serial.println();
-  }
-
 //  if (!tcs.begin()) {
 //    Serial.println("No TCS34725 found ... check your connections");
 //    while (1); // halt!
@@ -76,12 +39,8 @@ void loop() {
   // Serial.print(clear);
   Serial.println();
     
-  vector<double> sample(3);
+  float sample[model::kNumInputDimensions];
   sample[0] = red; sample[1] = green; sample[2] = blue;
-  if (!pipeline.predict(sample)) {
-    Serial.println("Error in predict.");
-  } else {
-    Serial.println(pipeline.getPredictedClassLabel());
-  }
+  Serial.println(model::predict(&state, sample));
   delay(10);
 }
@@ -1,89 +0,0 @@
-char *classifierText = "GRT_ANBC_MODEL_FILE_V2.0"
-"Trained: 1"
-"UseScaling: 0"
-"NumInputDimensions: 3"
-"NumOutputDimensions: 0"
-"NumTrainingIterationsToConverge: 0"
-"MinNumEpochs: 0"
-"MaxNumEpochs: 100"
-"ValidationSetSize: 20"
-"LearningRate: 0.1"
-"MinChange: 1e-05"
-"UseValidationSet: 0"
-"RandomiseTrainingOrder: 1"
-"UseNullRejection: 0"
-"ClassifierMode: 0"
-"NullRejectionCoeff: 10"
-"NumClasses: 5"
-"NullRejectionThresholds:  0 0 0 0 0"
-"ClassLabels:  1 2 3 4 5"
-"*************_MODEL_*************"
-"Model_ID: 1"
-"N: 3"
-"ClassLabel: 1"
-"Threshold: -15.8721"
-"Gamma: 10"
-"TrainingMu: 7.73699"
-"TrainingSigma: 2.36091"
-"Mu:"
-"	0.544878	0.577175	0.60697"
-"Sigma:"
-"	0.0280816	0.0103227	0.0259348"
-"Weights:"
-"	1	1	1"
-"*************_MODEL_*************"
-"Model_ID: 2"
-"N: 3"
-"ClassLabel: 2"
-"Threshold: -32.0517"
-"Gamma: 10"
-"TrainingMu: 8.89881"
-"TrainingSigma: 4.09505"
-"Mu:"
-"	0.663789	0.583366	0.467014"
-"Sigma:"
-"	0.018802	0.0106666	0.0211707"
-"Weights:"
-"	1	1	1"
-"*************_MODEL_*************"
-"Model_ID: 3"
-"N: 3"
-"ClassLabel: 3"
-"Threshold: -60.0068"
-"Gamma: 10"
-"TrainingMu: 8.65218"
-"TrainingSigma: 6.8659"
-"Mu:"
-"	0.827589	0.4129	0.378976"
-"Sigma:"
-"	0.0180186	0.0188622	0.0121089"
-"Weights:"
-"	1	1	1"
-"*************_MODEL_*************"
-"Model_ID: 4"
-"N: 3"
-"ClassLabel: 4"
-"Threshold: -63.1854"
-"Gamma: 10"
-"TrainingMu: 8.18183"
-"TrainingSigma: 7.13672"
-"Mu:"
-"	0.652215	0.567472	0.501332"
-"Sigma:"
-"	0.0204737	0.0186158	0.0157328"
-"Weights:"
-"	1	1	1"
-"*************_MODEL_*************"
-"Model_ID: 5"
-"N: 3"
-"ClassLabel: 5"
-"Threshold: -15.2109"
-"Gamma: 10"
-"TrainingMu: 10.1427"
-"TrainingSigma: 2.53536"
-"Mu:"
-"	0.566964	0.618156	0.544262"
-"Sigma:"
-"	0.0134325	0.0112531	0.0109163"
-"Weights:"
-"	1	1	1";
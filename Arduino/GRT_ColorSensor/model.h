@@ -0,0 +1,99 @@
+// Generated from a trained GRT pipeline by the ESP exporter (pipeline_export.h);
+// do not edit.
+//
+// MovingAverageFilter(5) -> ANBC
+// 3 input dimensions, 5 classes, 64 bytes of State, float arithmetic.
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#ifndef ESP_READ_FLOAT
+#define ESP_READ_FLOAT(x) pgm_read_float(&(x))
+#define ESP_READ_BYTE(x) pgm_read_byte(&(x))
+#define ESP_READ_WORD(x) pgm_read_word(&(x))
+#define ESP_READ_DWORD(x) pgm_read_dword(&(x))
+#endif
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef ESP_READ_FLOAT
+#define ESP_READ_FLOAT(x) (x)
+#define ESP_READ_BYTE(x) (x)
+#define ESP_READ_WORD(x) (x)
+#define ESP_READ_DWORD(x) (x)
+#endif
+#endif
+
+namespace model {
+
+constexpr uint16_t kNumInputDimensions = 3;
+constexpr uint16_t kNumClasses = 5;
+
+const uint16_t kClassLabels[kNumClasses] PROGMEM = {
+    1, 2, 3, 4, 5
+};
+const float kOffsets[kNumClasses] PROGMEM = {
+    9.04140472f, 9.61275101f, 9.64394474f, 9.26755047f, 10.5578728f
+};
+const float kMeans[5][3] PROGMEM = {
+    { 0.544878006f, 0.577175021f, 0.606970012f },
+    { 0.663788974f, 0.583365977f, 0.467014015f },
+    { 0.827588975f, 0.412900001f, 0.378975987f },
+    { 0.652215004f, 0.567471981f, 0.501331985f },
+    { 0.566963971f, 0.618156016f, 0.544261992f }
+};
+const float kPrecisions[5][3] PROGMEM = {
+    { 634.054077f, 4692.27441f, 743.368591f },
+    { 1414.36633f, 4394.58643f, 1115.57703f },
+    { 1540.02551f, 1405.35266f, 3410.04907f },
+    { 1192.82666f, 1442.80151f, 2020.03064f },
+    { 2771.12622f, 3948.44092f, 4195.84131f }
+};
+
+// The filters' sample history; zero-initialize it to start empty.
+struct State {
+    float buffer1[5][3];
+    uint16_t next1;
+    uint16_t count1;
+};
+
+// `input` holds kNumInputDimensions values. Returns the predicted class
+// label, or 0 for none.
+inline uint16_t predict(State* state, const float* input) {
+    const float* x0 = input;
+    // MovingAverageFilter(5): the mean of the last 5 inputs.
+    float x1[3];
+    for (uint16_t j = 0; j < 3; j++) {
+        state->buffer1[state->next1][j] = x0[j];
+    }
+    if (++state->next1 == 5) { state->next1 = 0; }
+    if (state->count1 < 5) { state->count1++; }
+    for (uint16_t j = 0; j < 3; j++) {
+        float sum = 0;
+        for (uint16_t i = 0; i < state->count1; i++) { sum += state->buffer1[i][j]; }
+        x1[j] = sum / state->count1;
+    }
+
+    // ANBC: the class with the highest Gaussian log-likelihood.
+    uint16_t best = 0;
+    float best_log_likelihood = -INFINITY;
+    for (uint16_t k = 0; k < kNumClasses; k++) {
+        float log_likelihood = ESP_READ_FLOAT(kOffsets[k]);
+        for (uint16_t j = 0; j < 3; j++) {
+            const float diff = x1[j] - ESP_READ_FLOAT(kMeans[k][j]);
+            log_likelihood -= ESP_READ_FLOAT(kPrecisions[k][j]) * diff * diff;
+        }
+        if (log_likelihood > best_log_likelihood) {
+            best = k;
+            best_log_likelihood = log_likelihood;
+        }
+    }
+    if (!(best_log_likelihood >= -745.13f)) { return 0; }
+    return ESP_READ_WORD(kClassLabels[best]);
+}
+
+}  // namespace model
@@ -0,0 +1,20 @@
+// Streams three analog inputs to the host as binary frames. On the host, use
+//
+//   BinarySerialStream stream(0, 115200, 3);
+//
+// instead of ASCIISerialStream.
+
+#include <ESPFrame.h>
+
+ESPFrame frame(Serial);
+
+void setup() {
+  Serial.begin(115200);
+}
+
+void loop() {
+  frame.add((int16_t) analogRead(A0));
+  frame.add((int16_t) analogRead(A1));
+  frame.add((int16_t) analogRead(A2));
+  frame.send();
+}
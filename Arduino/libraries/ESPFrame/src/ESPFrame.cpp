@@ -0,0 +1,95 @@
+#include "ESPFrame.h"
+
+#include <string.h>
+
+ESPFrame::ESPFrame(Print &out)
+  : _out(out), _sequence(0), _type(0), _count(0), _length(3) {
+}
+
+bool ESPFrame::append(uint8_t type, const void *value, uint8_t size) {
+  if (_count >= ESPFRAME_MAX_VALUES) return false;
+  if (_count > 0 && type != _type) return false;
+
+  _type = type;
+  // All Arduino targets are little-endian, so the in-memory representation is
+  // already the wire representation.
+  memcpy(&_raw[_length], value, size);
+  _length += size;
+  _count++;
+  return true;
+}
+
+bool ESPFrame::add(int16_t value) {
+  return append(ESPFRAME_INT16, &value, sizeof(value));
+}
+
+bool ESPFrame::add(uint16_t value) {
+  return append(ESPFRAME_UINT16, &value, sizeof(value));
+}
+
+bool ESPFrame::add(float value) {
+  return append(ESPFRAME_FLOAT, &value, sizeof(value));
+}
+
+size_t ESPFrame::send() {
+  if (_count == 0) return 0;
+
+  _raw[0] = _sequence++;
+  _raw[1] = _type;
+  _raw[2] = _count;
+  uint16_t crc = crc16(_raw, _length);
+  _raw[_length++] = crc & 0xFF;
+  _raw[_length++] = crc >> 8;
+
+  // COBS: replace every zero with the distance to the next zero.
+  uint8_t encoded[ESPFRAME_MAX_ENCODED_SIZE];
+  uint8_t code_index = 0;
+  uint8_t code = 1;
+  uint8_t n = 1;
+  for (uint8_t i = 0; i < _length; i++) {
+    if (_raw[i] == 0) {
+      encoded[code_index] = code;
+      code_index = n++;
+      code = 1;
+    } else {
+      encoded[n++] = _raw[i];
+      if (++code == 0xFF) {
+        encoded[code_index] = code;
+        code_index = n++;
+        code = 1;
+      }
+    }
+  }
+  encoded[code_index] = code;
+  encoded[n++] = 0;
+
+  _count = 0;
+  _length = 3;
+  return _out.write(encoded, n);
+}
+
+size_t ESPFrame::sendInt16(const int16_t *values, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) add(values[i]);
+  return send();
+}
+
+size_t ESPFrame::sendUInt16(const uint16_t *values, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) add(values[i]);
+  return send();
+}
+
+size_t ESPFrame::sendFloat(const float *values, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) add(values[i]);
+  return send();
+}
+
+uint16_t ESPFrame::crc16(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= (uint16_t) *data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,77 @@
+/*
+ * ESPFrame sends sensor samples to the Smart Sensors host application in a
+ * compact binary format, read on the host by BinarySerialStream.
+ *
+ *   ESPFrame frame(Serial);
+ *   frame.add(ax); frame.add(ay); frame.add(az);   // int16_t values
+ *   frame.send();
+ *
+ * Compared to printing tab-separated text this roughly thirds the number of
+ * bytes per sample, and corrupted frames are detected and dropped by the host
+ * instead of being mis-parsed.
+ *
+ * Wire format (all multi-byte fields little-endian):
+ *
+ *   uint8  sequence    incremented for every frame, lets the host count losses
+ *   uint8  type        ESPFRAME_INT16, ESPFRAME_UINT16 or ESPFRAME_FLOAT
+ *   uint8  count       number of values (at most ESPFRAME_MAX_VALUES)
+ *   ...    values      count * 2 (int16/uint16) or count * 4 (float) bytes
+ *   uint16 crc         CRC-16/CCITT-FALSE over all of the above
+ *
+ * The frame is COBS-encoded, so it contains no zero bytes, and terminated by a
+ * single 0x00 delimiter.
+ */
+#ifndef ESPFRAME_H
+#define ESPFRAME_H
+
+#if (ARDUINO >= 100)
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define ESPFRAME_INT16   0
+#define ESPFRAME_UINT16  1
+#define ESPFRAME_FLOAT   2
+
+#define ESPFRAME_MAX_VALUES 32
+
+// sequence + type + count + largest payload + crc
+#define ESPFRAME_MAX_RAW_SIZE (3 + ESPFRAME_MAX_VALUES * 4 + 2)
+// COBS adds one byte per 254 bytes (plus one), then the delimiter.
+#define ESPFRAME_MAX_ENCODED_SIZE (ESPFRAME_MAX_RAW_SIZE + ESPFRAME_MAX_RAW_SIZE / 254 + 2)
+
+class ESPFrame {
+ public:
+  ESPFrame(Print &out);
+
+  // Append a value to the current frame. All values in a frame must have the
+  // same type; returns false (and ignores the value) if the type differs from
+  // the first value added or the frame is full.
+  bool add(int16_t value);
+  bool add(uint16_t value);
+  bool add(float value);
+
+  // Encode and write the current frame, then start a new one. Returns the
+  // number of bytes written.
+  size_t send();
+
+  // Convenience: send a whole array as one frame.
+  size_t sendInt16(const int16_t *values, uint8_t count);
+  size_t sendUInt16(const uint16_t *values, uint8_t count);
+  size_t sendFloat(const float *values, uint8_t count);
+
+  static uint16_t crc16(const uint8_t *data, size_t length);
+
+ private:
+  bool append(uint8_t type, const void *value, uint8_t size);
+
+  Print &_out;
+  uint8_t _sequence;
+  uint8_t _type;
+  uint8_t _count;
+  uint8_t _length;
+  uint8_t _raw[ESPFRAME_MAX_RAW_SIZE];
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * anbc-bench compares FastANBC's prediction kernel with GRT's ANBC on
+ * synthetic data: for 3-, 12- and 64-dimensional inputs, it trains both on
+ * the same Gaussian clusters, predicts the same random inputs with each, and
+ * reports the time per prediction and how often the labels agree:
+ *
+ *   anbc-bench                  # 8 classes
+ *   anbc-bench --classes 32 --scaling
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "fast_anbc.h"
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: anbc-bench [options]\n"
+        "  -c, --classes N       number of classes (default 8)\n"
+        "  -n, --predictions N   predictions per dimension count (default\n"
+        "                        100000)\n"
+        "  -s, --scaling         scale the input to the training ranges\n"
+        "  -h, --help            show this message\n";
+
+const uint32_t kDimensions[] = { 3, 12, 64 };
+const uint32_t kSamplesPerClass = 50;
+
+struct Run {
+    std::vector<GRT::UINT> labels;
+    std::vector<double> log_likelihoods;
+    int64_t elapsed_ns;
+};
+
+template <class Classifier>
+Run predictAll(Classifier& classifier,
+               const std::vector<GRT::VectorDouble>& inputs) {
+    Run run = { std::vector<GRT::UINT>(), std::vector<double>(), 0 };
+    run.labels.reserve(inputs.size());
+    int64_t start_ns = getMonotonicTimeNs();
+    for (const GRT::VectorDouble& input : inputs) {
+        classifier.predict(input);
+        run.labels.push_back(classifier.getPredictedClassLabel());
+    }
+    run.elapsed_ns = getMonotonicTimeNs() - start_ns;
+    // Once more for the log-likelihoods, outside the timed loop.
+    for (const GRT::VectorDouble& input : inputs) {
+        classifier.predict(input);
+        GRT::VectorDouble distances = classifier.getClassDistances();
+        run.log_likelihoods.insert(run.log_likelihoods.end(),
+                                   distances.begin(), distances.end());
+    }
+    return run;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_classes = 8;
+    uint32_t num_predictions = 100000;
+    bool use_scaling = false;
+
+    const struct option kOptions[] = {
+        { "classes", required_argument, nullptr, 'c' },
+        { "predictions", required_argument, nullptr, 'n' },
+        { "scaling", no_argument, nullptr, 's' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "c:n:sh", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'c': num_classes = atoi(optarg); break;
+            case 'n': num_predictions = atoi(optarg); break;
+            case 's': use_scaling = true; break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_classes == 0 || num_predictions == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    std::cout << "FastANBC kernel: " << FastANBC::getKernelName() << ", "
+              << num_classes << " classes\n";
+    std::mt19937 random(1);
+    for (uint32_t num_dimensions : kDimensions) {
+        // Every class is a cluster around its own random center.
+        std::uniform_real_distribution<double> center(-1, 1);
+        std::normal_distribution<double> spread(0, 0.2);
+        GRT::ClassificationData training_data;
+        training_data.setNumDimensions(num_dimensions);
+        std::vector<GRT::VectorDouble> centers(num_classes);
+        for (uint32_t k = 0; k < num_classes; k++) {
+            for (uint32_t j = 0; j < num_dimensions; j++) {
+                centers[k].push_back(center(random));
+            }
+            for (uint32_t i = 0; i < kSamplesPerClass; i++) {
+                GRT::VectorDouble sample(centers[k]);
+                for (double& x : sample) { x += spread(random); }
+                training_data.addSample(k + 1, sample);
+            }
+        }
+        // Inputs near the clusters, and some between them.
+        std::vector<GRT::VectorDouble> inputs(num_predictions);
+        for (uint32_t i = 0; i < num_predictions; i++) {
+            inputs[i] = centers[i % num_classes];
+            for (double& x : inputs[i]) { x += 2 * spread(random); }
+        }
+
+        GRT::ANBC anbc(use_scaling, true);
+        FastANBC fast(use_scaling, true);
+        if (!anbc.train(training_data) || !fast.train(training_data)) {
+            ofLog(OF_LOG_ERROR) << "Failed to train on " << num_dimensions
+                                << " dimensions";
+            return 1;
+        }
+        Run grt = predictAll(anbc, inputs);
+        Run ours = predictAll(fast, inputs);
+
+        uint32_t num_agreeing = 0;
+        for (uint32_t i = 0; i < num_predictions; i++) {
+            if (grt.labels[i] == ours.labels[i]) { num_agreeing++; }
+        }
+        double max_error = 0;
+        for (uint32_t i = 0; i < grt.log_likelihoods.size(); i++) {
+            double expected = grt.log_likelihoods[i];
+            if (std::isinf(expected)) { continue; }
+            max_error = std::max(max_error,
+                                 std::fabs(ours.log_likelihoods[i] - expected) /
+                                 std::max(1.0, std::fabs(expected)));
+        }
+        std::cout << num_dimensions << " dimensions: "
+                  << formatDuration(double(grt.elapsed_ns) / num_predictions)
+                  << " -> "
+                  << formatDuration(double(ours.elapsed_ns) / num_predictions)
+                  << " per prediction ("
+                  << double(grt.elapsed_ns) / std::max<int64_t>(1, ours.elapsed_ns)
+                  << "x), labels agree on " << num_agreeing << "/"
+                  << num_predictions << ", log-likelihood error < "
+                  << max_error << "\n";
+    }
+    return 0;
+}
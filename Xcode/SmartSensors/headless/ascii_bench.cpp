@@ -0,0 +1,181 @@
+/*
+ * ascii-bench compares ASCIILineParser (ascii_parser.h) with the way
+ * ASCIISerialStream used to parse lines: one byte at a time into a string,
+ * then an istringstream, a vector and a MatrixDouble per line. Both read the
+ * same generated input in serial-sized chunks, once with 3 decimal columns
+ * (like the accelerometer sketches print) and once with 12 integer columns
+ * (like the MPR121 sketch), and report lines per second:
+ *
+ *   ascii-bench                         # 200000 lines of each
+ *   ascii-bench --lines 1000000 --chunk 64
+ *
+ * Exits with status 1 if the two parse different values.
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "ascii_parser.h"
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: ascii-bench [options]\n"
+        "  -n, --lines N         lines per input (default 200000)\n"
+        "  -c, --chunk BYTES     bytes per read (default 256, as the old\n"
+        "                        reading loop)\n"
+        "  -h, --help            show this message\n";
+
+// Lines as the Arduino sketches print them.
+std::string generateInput(uint32_t num_lines, uint32_t num_columns,
+                          bool is_integer) {
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> reading(0, 1023);
+    std::normal_distribution<double> acceleration(0, 4);
+    std::string input;
+    char value[32];
+    for (uint32_t i = 0; i < num_lines; i++) {
+        for (uint32_t j = 0; j < num_columns; j++) {
+            if (is_integer) {
+                snprintf(value, sizeof(value), "%d", reading(random));
+            } else {
+                snprintf(value, sizeof(value), "%.2f", acceleration(random));
+            }
+            input += value;
+            input += j + 1 < num_columns ? '\t' : '\n';
+        }
+    }
+    return input;
+}
+
+// The old ASCIISerialStream::readSerial() loop, minus the serial port.
+// Returns the time taken and appends every value parsed to `values`.
+int64_t parseWithStringStream(const std::string& input, size_t chunk_size,
+                              std::vector<double>* values) {
+    int64_t start_ns = getMonotonicTimeNs();
+    string s;
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+        size_t size = std::min(chunk_size, input.size() - offset);
+        const char* buffer = input.data() + offset;
+        for (size_t i = 0; i < size; i++) {
+            s += buffer[i];
+            if (buffer[i] != '\n') { continue; }
+
+            istringstream iss(s);
+            vector<double> data;
+            double d;
+            while (iss >> d) data.push_back(d);
+            if (data.size() > 0) {
+                GRT::MatrixDouble matrix;
+                matrix.push_back(data);
+                values->insert(values->end(), matrix[0],
+                               matrix[0] + matrix.getNumCols());
+            }
+            s.clear();
+        }
+    }
+    return getMonotonicTimeNs() - start_ns;
+}
+
+// The current loop: chunks go straight into the parser's buffer and every
+// line of a chunk into one batch.
+int64_t parseWithLineParser(const std::string& input, size_t chunk_size,
+                            uint32_t num_columns, std::vector<double>* values) {
+    int64_t start_ns = getMonotonicTimeNs();
+    ASCIILineParser parser(num_columns);
+    GRT::MatrixDouble batch;
+    size_t offset = 0;
+    while (offset < input.size()) {
+        size_t capacity;
+        char* dest = parser.prepare(&capacity);
+        size_t size = std::min(std::min(chunk_size, capacity),
+                               input.size() - offset);
+        memcpy(dest, input.data() + offset, size);
+        parser.commit(size);
+        offset += size;
+
+        uint32_t num_rows = parser.parse();
+        if (num_rows == 0) { continue; }
+        if (batch.getNumRows() != num_rows ||
+            batch.getNumCols() != num_columns) {
+            batch.resize(num_rows, num_columns);
+        }
+        for (uint32_t i = 0; i < num_rows; i++) {
+            std::copy(parser.getRow(i), parser.getRow(i) + num_columns,
+                      batch[i]);
+        }
+        for (uint32_t i = 0; i < num_rows; i++) {
+            values->insert(values->end(), batch[i], batch[i] + num_columns);
+        }
+    }
+    return getMonotonicTimeNs() - start_ns;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_lines = 200000;
+    size_t chunk_size = 256;
+
+    const struct option kOptions[] = {
+        { "lines", required_argument, nullptr, 'n' },
+        { "chunk", required_argument, nullptr, 'c' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "n:c:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'n': num_lines = atoi(optarg); break;
+            case 'c': chunk_size = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_lines == 0 || chunk_size == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    bool ok = true;
+    for (uint32_t num_columns : { 3, 12 }) {
+        const bool is_integer = num_columns == 12;
+        std::string input = generateInput(num_lines, num_columns, is_integer);
+        std::vector<double> old_values;
+        std::vector<double> new_values;
+        old_values.reserve(num_lines * num_columns);
+        new_values.reserve(num_lines * num_columns);
+        int64_t old_ns = parseWithStringStream(input, chunk_size, &old_values);
+        int64_t new_ns = parseWithLineParser(input, chunk_size, num_columns,
+                                             &new_values);
+        bool same = old_values == new_values &&
+                    new_values.size() == size_t(num_lines) * num_columns;
+
+        double old_lines_per_s = num_lines * 1e9 / std::max<int64_t>(1, old_ns);
+        double new_lines_per_s = num_lines * 1e9 / std::max<int64_t>(1, new_ns);
+        std::cout << num_lines << " lines of " << num_columns
+                  << (is_integer ? " integers" : " decimals") << ": "
+                  << "istringstream " << static_cast<uint64_t>(old_lines_per_s)
+                  << " lines/s (" << formatDuration(old_ns) << "), "
+                  << "ASCIILineParser "
+                  << static_cast<uint64_t>(new_lines_per_s) << " lines/s ("
+                  << formatDuration(new_ns) << ", "
+                  << new_lines_per_s / old_lines_per_s << "x)"
+                  << (same ? "" : "; DIFFERENT values") << "\n";
+        ok = same && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * ascii-check feeds ASCIILineParser (ascii_parser.h) a line longer than its
+ * maximum line length followed by valid lines, in chunks of several sizes,
+ * and checks that the long line is dropped as one malformed line, up to its
+ * newline, and that exactly the valid lines come out as rows:
+ *
+ *   make ascii-check && ./ascii-check
+ *
+ * Exits with status 1 if any check fails, listing the ones that did.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ascii_parser.h"
+
+namespace {
+
+const uint32_t kNumDimensions = 3;
+const size_t kMaxLineLength = 1024;
+
+int num_failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << "\n";
+        num_failures++;
+    }
+}
+
+// Feeds `input` to `parser` in chunks of at most `chunk_size` bytes and
+// returns the values of every row parsed.
+std::vector<double> feed(ASCIILineParser& parser, const std::string& input,
+                         size_t chunk_size) {
+    std::vector<double> values;
+    size_t offset = 0;
+    while (offset < input.size()) {
+        size_t capacity;
+        char* dest = parser.prepare(&capacity);
+        size_t size = std::min(std::min(chunk_size, capacity),
+                               input.size() - offset);
+        memcpy(dest, input.data() + offset, size);
+        parser.commit(size);
+        offset += size;
+
+        uint32_t num_rows = parser.parse();
+        for (uint32_t i = 0; i < num_rows; i++) {
+            values.insert(values.end(), parser.getRow(i),
+                          parser.getRow(i) + kNumDimensions);
+        }
+    }
+    return values;
+}
+
+// An over-long line of numbers between `before` and `after`, fed in chunks
+// of `chunk_size`, must leave exactly the rows of `expected`.
+void checkLongLine(const std::string& before, size_t long_line_length,
+                   const std::string& after, size_t chunk_size,
+                   const std::vector<double>& expected) {
+    std::string long_line;
+    while (long_line.size() < long_line_length) { long_line += "1 "; }
+    std::string input = before + long_line + "\n" + after;
+
+    ASCIILineParser parser(kNumDimensions, 4096, kMaxLineLength);
+    std::vector<double> values = feed(parser, input, chunk_size);
+    std::string what = "a " + std::to_string(long_line.size()) +
+                       "-byte line in " + std::to_string(chunk_size) +
+                       "-byte chunks";
+    check(values == expected, what + ": only the valid rows are parsed");
+    check(parser.getNumMalformedLines() == 1,
+          what + ": counted as one malformed line, not " +
+          std::to_string(parser.getNumMalformedLines()));
+}
+
+}  // namespace
+
+int main() {
+    for (size_t chunk_size : { 1, 7, 64, 1000, 4096 }) {
+        for (size_t long_line_length : { kMaxLineLength + 1,
+                                         3 * kMaxLineLength,
+                                         5 * kMaxLineLength }) {
+            checkLongLine("", long_line_length, "1 2 3\n", chunk_size,
+                          { 1, 2, 3 });
+            checkLongLine("4 5 6\n", long_line_length, "1 2 3\n7 8 9\n",
+                          chunk_size, { 4, 5, 6, 1, 2, 3, 7, 8, 9 });
+        }
+    }
+
+    std::cout << (num_failures == 0 ? "All checks passed\n" : "");
+    return num_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * dtw-bench measures how much PrunedDTW's lower bounds save over aligning
+ * every template in full, on recorded sessions. It trains a PrunedDTW and
+ * GRT's DTW (with the same null rejection and band, as the examples used it)
+ * on the training data, replays every session through GRT's DTW and through
+ * PrunedDTW with and without pruning, sample by sample, and checks that
+ * PrunedDTW predicts the same label for every sample either way. It also
+ * counts the samples where GRT's DTW predicts a different label:
+ *
+ *   dtw-bench -t data/training_data.grt data/sessions/session-20161016-120000.esps
+ *
+ * Sessions hold the samples as the pipeline saw them (normalized, and
+ * calibrated if the app has a calibrator), so they can be replayed straight
+ * into the classifier. With --threads, it also trains and replays a copy
+ * that splits the work over a ThreadPool, and checks its labels too. Exits
+ * with status 1 if any of PrunedDTW's labels differ; labels that differ from
+ * GRT's DTW are only counted.
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "of_shim.h"
+#include "profiler.h"
+#include "pruned_dtw.h"
+#include "session_file.h"
+#include "thread_pool.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: dtw-bench -t FILE [options] SESSION...\n"
+        "  -t, --training-data FILE  training data saved by the app\n"
+        "  -n, --null-rejection C    null rejection coefficient (default 0.4,\n"
+        "                            as in user_accelerometer_gestures.h)\n"
+        "  -r, --radius R            Sakoe-Chiba band radius, as a fraction\n"
+        "                            of the series length (default 0.2)\n"
+        "  -s, --scaling             scale the input to the training ranges\n"
+        "  -j, --threads N           also train and predict on a pool of N\n"
+        "                            threads (0: one per core)\n"
+        "  -h, --help                show this message\n";
+
+struct Replay {
+    std::vector<GRT::UINT> labels;
+    int64_t elapsed_ns;
+};
+
+Replay replay(GRT::Classifier& classifier, const SessionReader& session) {
+    Replay result = { std::vector<GRT::UINT>(), 0 };
+    result.labels.reserve(session.getNumSamples());
+    GRT::VectorDouble sample(session.getNumDimensions());
+    classifier.reset();
+    int64_t start_ns = getMonotonicTimeNs();
+    for (uint64_t i = 0; i < session.getNumSamples(); i++) {
+        const double* data = session.getSample(i);
+        sample.assign(data, data + session.getNumDimensions());
+        classifier.predict_(sample);
+        result.labels.push_back(classifier.getPredictedClassLabel());
+    }
+    result.elapsed_ns = getMonotonicTimeNs() - start_ns;
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string training_data_path;
+    double null_rejection_coeff = 0.4;
+    double radius = 0.2;
+    bool use_scaling = false;
+    int num_threads = -1;
+
+    const struct option kOptions[] = {
+        { "training-data", required_argument, nullptr, 't' },
+        { "null-rejection", required_argument, nullptr, 'n' },
+        { "radius", required_argument, nullptr, 'r' },
+        { "scaling", no_argument, nullptr, 's' },
+        { "threads", required_argument, nullptr, 'j' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "t:n:r:sj:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 't': training_data_path = optarg; break;
+            case 'n': null_rejection_coeff = atof(optarg); break;
+            case 'r': radius = atof(optarg); break;
+            case 's': use_scaling = true; break;
+            case 'j': num_threads = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (training_data_path.empty() || optind == argc) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    GRT::TimeSeriesClassificationData training_data;
+    if (!training_data.load(training_data_path)) {
+        ofLog(OF_LOG_ERROR) << "Failed to load " << training_data_path;
+        return 1;
+    }
+    PrunedDTW pruned(use_scaling, true, null_rejection_coeff, radius);
+    int64_t start_ns = getMonotonicTimeNs();
+    if (!pruned.train(training_data)) {
+        ofLog(OF_LOG_ERROR) << "Failed to train on " << training_data_path;
+        return 1;
+    }
+    std::cout << "Trained " << pruned.getNumClasses() << " templates on "
+              << training_data.getNumSamples() << " samples in "
+              << formatDuration(getMonotonicTimeNs() - start_ns)
+              << "; window of " << pruned.getWindowLength() << " samples\n";
+    PrunedDTW full(pruned);
+    full.setUsePruning(false);
+
+    GRT::DTW grt(use_scaling, true, null_rejection_coeff,
+                 GRT::DTW::TEMPLATE_THRESHOLDS, true, radius);
+    start_ns = getMonotonicTimeNs();
+    if (!grt.train(training_data)) {
+        ofLog(OF_LOG_ERROR) << "Failed to train GRT's DTW on "
+                            << training_data_path;
+        return 1;
+    }
+    std::cout << "Trained GRT's DTW in "
+              << formatDuration(getMonotonicTimeNs() - start_ns) << "\n";
+
+    std::unique_ptr<ThreadPool> pool;
+    PrunedDTW parallel(use_scaling, true, null_rejection_coeff, radius);
+    if (num_threads >= 0) {
+        pool.reset(new ThreadPool(num_threads));
+        parallel.setThreadPool(pool.get());
+        start_ns = getMonotonicTimeNs();
+        if (!parallel.train(training_data)) {
+            ofLog(OF_LOG_ERROR) << "Failed to train on " << pool->getNumThreads()
+                                << " threads";
+            return 1;
+        }
+        std::cout << "Trained on " << pool->getNumThreads() << " threads in "
+                  << formatDuration(getMonotonicTimeNs() - start_ns) << "\n";
+    }
+
+    uint64_t num_samples = 0;
+    uint64_t num_mismatches = 0;
+    uint64_t num_grt_mismatches = 0;
+    int64_t pruned_ns = 0;
+    int64_t full_ns = 0;
+    int64_t parallel_ns = 0;
+    int64_t grt_ns = 0;
+    for (int i = optind; i < argc; i++) {
+        SessionReader session;
+        if (!session.open(argv[i])) {
+            ofLog(OF_LOG_ERROR) << argv[i] << ": " << session.getLastError();
+            return 1;
+        }
+        if (session.getNumDimensions() != training_data.getNumDimensions()) {
+            ofLog(OF_LOG_ERROR) << argv[i] << " has "
+                                << session.getNumDimensions()
+                                << " dimensions, the training data "
+                                << training_data.getNumDimensions();
+            return 1;
+        }
+        Replay with_pruning = replay(pruned, session);
+        Replay without_pruning = replay(full, session);
+        Replay on_pool = { with_pruning.labels, 0 };
+        if (pool != nullptr) { on_pool = replay(parallel, session); }
+        Replay with_grt = replay(grt, session);
+
+        uint64_t mismatches = 0;
+        uint64_t grt_mismatches = 0;
+        for (uint64_t j = 0; j < with_pruning.labels.size(); j++) {
+            if (with_pruning.labels[j] != without_pruning.labels[j] ||
+                with_pruning.labels[j] != on_pool.labels[j]) {
+                mismatches++;
+            }
+            if (with_pruning.labels[j] != with_grt.labels[j]) {
+                grt_mismatches++;
+            }
+        }
+        uint64_t n = std::max<uint64_t>(1, session.getNumSamples());
+        std::cout << argv[i] << ": " << session.getNumSamples()
+                  << " samples, GRT's DTW "
+                  << formatDuration(double(with_grt.elapsed_ns) / n) << ", "
+                  << formatDuration(double(without_pruning.elapsed_ns) / n)
+                  << " -> "
+                  << formatDuration(double(with_pruning.elapsed_ns) / n)
+                  << " per sample";
+        if (pool != nullptr) {
+            std::cout << ", " << formatDuration(double(on_pool.elapsed_ns) / n)
+                      << " on the pool";
+        }
+        std::cout << ", " << mismatches << " labels differ ("
+                  << grt_mismatches << " from GRT's)\n";
+        num_samples += session.getNumSamples();
+        num_mismatches += mismatches;
+        num_grt_mismatches += grt_mismatches;
+        grt_ns += with_grt.elapsed_ns;
+        pruned_ns += with_pruning.elapsed_ns;
+        full_ns += without_pruning.elapsed_ns;
+        parallel_ns += on_pool.elapsed_ns;
+    }
+
+    const PrunedDTW::PruningStats& stats = pruned.getPruningStats();
+    uint64_t num_templates = stats.num_kim_pruned + stats.num_keogh_pruned +
+                             stats.num_abandoned + stats.num_aligned;
+    double n = std::max<uint64_t>(1, num_samples);
+    std::cout << "Total: " << num_samples << " samples, GRT's DTW "
+              << formatDuration(grt_ns / n) << " ("
+              << double(grt_ns) / std::max<int64_t>(1, pruned_ns)
+              << "x slower than pruned), "
+              << formatDuration(full_ns / n) << " -> "
+              << formatDuration(pruned_ns / n) << " per sample ("
+              << double(full_ns) / std::max<int64_t>(1, pruned_ns) << "x)";
+    if (pool != nullptr) {
+        std::cout << ", " << formatDuration(parallel_ns / n) << " on the pool";
+    }
+    std::cout << "\n"
+              << "Templates considered: " << num_templates
+              << ", pruned by LB_Kim: " << stats.num_kim_pruned
+              << ", by LB_Keogh: " << stats.num_keogh_pruned
+              << ", abandoned: " << stats.num_abandoned
+              << ", aligned in full: " << stats.num_aligned << "\n"
+              << "Labels that differ from GRT's DTW: " << num_grt_mismatches
+              << " (" << 100.0 * num_grt_mismatches / n << "%)\n";
+    if (num_mismatches > 0) {
+        std::cout << num_mismatches << " labels differ\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * esp-export turns a trained pipeline saved by the app (pipeline.grt) into a
+ * C++ header for an Arduino sketch (see src/pipeline_export.h):
+ *
+ *   esp-export -o ../../../Arduino/GRT_ColorSensor/model.h data/pipeline.grt
+ *
+ * With --fixed-point, the code computes in integers, with scales calibrated
+ * on the training data the pipeline was trained on:
+ *
+ *   esp-export --fixed-point data/TrainingData.grt -o model.h data/pipeline.grt
+ *
+ * The app also writes model.h and model_fixed_point.h next to pipeline.grt
+ * when it saves a pipeline that can be exported. `make export-check`
+ * compiles the generated code on the host and compares its predictions with
+ * GRT's on recorded sessions; `make fixed-point-report` compares the
+ * fixed-point code's accuracy with GRT's on the training data.
+ */
+#include <getopt.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "of_shim.h"
+#include "pipeline_export.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: esp-export [options] PIPELINE\n"
+        "  -n, --name NAME       namespace of the generated code (default\n"
+        "                        model)\n"
+        "  -o, --output FILE     write the header to FILE instead of stdout\n"
+        "  -q, --fixed-point TRAINING_DATA\n"
+        "                        generate fixed-point code, calibrated on\n"
+        "                        TRAINING_DATA (saved by the app)\n"
+        "  -h, --help            show this message\n";
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string name = "model";
+    std::string output_path;
+    std::string training_data_path;
+
+    const struct option kOptions[] = {
+        { "name", required_argument, nullptr, 'n' },
+        { "output", required_argument, nullptr, 'o' },
+        { "fixed-point", required_argument, nullptr, 'q' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "n:o:q:h", kOptions, nullptr)) !=
+           -1) {
+        switch (option) {
+            case 'n': name = optarg; break;
+            case 'o': output_path = optarg; break;
+            case 'q': training_data_path = optarg; break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (optind + 1 != argc || name.empty()) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    GRT::GestureRecognitionPipeline trained;
+    if (!trained.load(argv[optind])) {
+        ofLog(OF_LOG_ERROR) << "Failed to load " << argv[optind];
+        return 1;
+    }
+    ExportedPipeline pipeline;
+    std::string error;
+    if (!readExportedPipeline(trained, &pipeline, &error)) {
+        ofLog(OF_LOG_ERROR) << argv[optind] << ": " << error;
+        return 1;
+    }
+    FixedPointScales scales;
+    if (!training_data_path.empty()) {
+        GRT::TimeSeriesClassificationData training_data;
+        if (!training_data.load(training_data_path)) {
+            ofLog(OF_LOG_ERROR) << "Failed to load " << training_data_path;
+            return 1;
+        }
+        if (!calibrateFixedPoint(pipeline, training_data, &scales, &error)) {
+            ofLog(OF_LOG_ERROR) << training_data_path << ": " << error;
+            return 1;
+        }
+    }
+    std::ofstream output_file;
+    if (!output_path.empty()) { output_file.open(output_path); }
+    std::ostream& output = output_path.empty()
+            ? std::cout
+            : static_cast<std::ostream&>(output_file);
+    if (training_data_path.empty()) {
+        writePipelineHeader(pipeline, name, output);
+    } else {
+        writeFixedPointHeader(pipeline, scales, name, output);
+    }
+    if (!output.flush()) {
+        ofLog(OF_LOG_ERROR) << "Failed to write "
+                            << (output_path.empty() ? "stdout" : output_path);
+        return 1;
+    }
+    return 0;
+}
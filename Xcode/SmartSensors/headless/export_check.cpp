@@ -0,0 +1,114 @@
+/*
+ * export-check compares the code esp-export generates with GRT: it replays
+ * recorded sessions through the trained pipeline and through the generated
+ * predict(), compiled for the host, and checks that both give the same label
+ * for every sample. It is built against the header generated for the
+ * pipeline, so it runs through make:
+ *
+ *   make export-check PIPELINE=data/pipeline.grt \
+ *           SESSIONS=data/sessions/session-20161016-120000.esps
+ *
+ * Sessions hold the samples as the pipeline saw them (normalized, and
+ * calibrated if the app has a calibrator). The generated code computes in
+ * float, so a label can legitimately differ where two classes are within
+ * rounding of each other; the samples that differ are listed. Exits with
+ * status 1 if any label differs.
+ */
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "exported_pipeline.h"
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+#include "session_file.h"
+
+namespace {
+
+const uint32_t kMaxMismatchesListed = 10;
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: export-check PIPELINE SESSION...\n";
+        return 2;
+    }
+    GRT::GestureRecognitionPipeline pipeline;
+    if (!pipeline.load(argv[1])) {
+        ofLog(OF_LOG_ERROR) << "Failed to load " << argv[1];
+        return 1;
+    }
+
+    uint64_t num_samples = 0;
+    uint64_t num_mismatches = 0;
+    int64_t grt_ns = 0;
+    int64_t exported_ns = 0;
+    for (int i = 2; i < argc; i++) {
+        SessionReader session;
+        if (!session.open(argv[i])) {
+            ofLog(OF_LOG_ERROR) << argv[i] << ": " << session.getLastError();
+            return 1;
+        }
+        const uint32_t num_dimensions = session.getNumDimensions();
+        if (num_dimensions != exported::kNumInputDimensions) {
+            ofLog(OF_LOG_ERROR) << argv[i] << " has " << num_dimensions
+                                << " dimensions, the pipeline "
+                                << exported::kNumInputDimensions;
+            return 1;
+        }
+
+        std::vector<GRT::UINT> grt_labels;
+        grt_labels.reserve(session.getNumSamples());
+        GRT::VectorDouble sample(num_dimensions);
+        pipeline.reset();
+        int64_t start_ns = getMonotonicTimeNs();
+        for (uint64_t j = 0; j < session.getNumSamples(); j++) {
+            const double* data = session.getSample(j);
+            sample.assign(data, data + num_dimensions);
+            pipeline.predict(sample);
+            grt_labels.push_back(pipeline.getPredictedClassLabel());
+        }
+        int64_t session_grt_ns = getMonotonicTimeNs() - start_ns;
+
+        std::vector<uint16_t> exported_labels;
+        exported_labels.reserve(session.getNumSamples());
+        std::vector<float> input(num_dimensions);
+        exported::State state = exported::State();
+        start_ns = getMonotonicTimeNs();
+        for (uint64_t j = 0; j < session.getNumSamples(); j++) {
+            const double* data = session.getSample(j);
+            std::copy(data, data + num_dimensions, input.begin());
+            exported_labels.push_back(exported::predict(&state, input.data()));
+        }
+        int64_t session_exported_ns = getMonotonicTimeNs() - start_ns;
+
+        uint64_t mismatches = 0;
+        for (uint64_t j = 0; j < grt_labels.size(); j++) {
+            if (grt_labels[j] == exported_labels[j]) { continue; }
+            if (mismatches++ < kMaxMismatchesListed) {
+                std::cout << argv[i] << ": sample " << j << ": GRT "
+                          << grt_labels[j] << ", exported "
+                          << exported_labels[j] << "\n";
+            }
+        }
+        double n = std::max<uint64_t>(1, session.getNumSamples());
+        std::cout << argv[i] << ": " << session.getNumSamples()
+                  << " samples, GRT " << formatDuration(session_grt_ns / n)
+                  << ", exported " << formatDuration(session_exported_ns / n)
+                  << " per sample, " << mismatches << " labels differ\n";
+        num_samples += session.getNumSamples();
+        num_mismatches += mismatches;
+        grt_ns += session_grt_ns;
+        exported_ns += session_exported_ns;
+    }
+    std::cout << "Total: " << num_samples << " samples, " << num_mismatches
+              << " labels differ; GRT "
+              << formatDuration(grt_ns / std::max<double>(1, num_samples))
+              << ", exported "
+              << formatDuration(exported_ns / std::max<double>(1, num_samples))
+              << " per sample\n";
+    return num_mismatches > 0 ? 1 : 0;
+}
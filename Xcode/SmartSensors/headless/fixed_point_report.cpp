@@ -0,0 +1,172 @@
+/*
+ * fixed-point-report measures what the fixed-point code esp-export generates
+ * loses against GRT and the float code: it replays the training data, sample
+ * by sample from empty buffers and row by row like the live pipeline,
+ * through the trained pipeline, the float code and the fixed-point code
+ * (compiled for the host), and reports for each how often its label is the
+ * sample's class, per row and by majority vote over each sample's rows, how
+ * often the generated code agrees with GRT, and the time per row. It is
+ * built against the headers generated for the pipeline, so it runs through
+ * make:
+ *
+ *   make fixed-point-report PIPELINE=data/pipeline.grt \
+ *           TRAINING_DATA=data/TrainingData.grt
+ *
+ * The fixed-point code is calibrated on the same training data, so this is
+ * the accuracy it has on data within the calibrated range; inputs beyond
+ * twice that range saturate.
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "exported_pipeline.h"
+#include "fixed_point_pipeline.h"
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+
+namespace {
+
+struct Result {
+    std::string name;
+    uint64_t num_correct_rows = 0;
+    uint64_t num_correct_samples = 0;
+    uint64_t num_rows_agreeing = 0;
+    int64_t elapsed_ns = 0;
+    // The labels of the current sample's rows.
+    std::vector<GRT::UINT> labels;
+};
+
+// The most common label other than 0, as the parameter sweep votes.
+GRT::UINT vote(const std::vector<GRT::UINT>& labels) {
+    std::map<GRT::UINT, uint32_t> votes;
+    for (GRT::UINT label : labels) {
+        if (label != 0) { votes[label]++; }
+    }
+    GRT::UINT predicted_label = 0;
+    uint32_t max_votes = 0;
+    for (const auto& v : votes) {
+        if (v.second > max_votes) {
+            predicted_label = v.first;
+            max_votes = v.second;
+        }
+    }
+    return predicted_label;
+}
+
+std::string formatPercentage(uint64_t count, uint64_t total) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2)
+         << 100.0 * count / std::max<uint64_t>(1, total) << "%";
+    return text.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: fixed-point-report PIPELINE TRAINING_DATA\n";
+        return 2;
+    }
+    GRT::GestureRecognitionPipeline pipeline;
+    if (!pipeline.load(argv[1])) {
+        ofLog(OF_LOG_ERROR) << "Failed to load " << argv[1];
+        return 1;
+    }
+    GRT::TimeSeriesClassificationData training_data;
+    if (!training_data.load(argv[2])) {
+        ofLog(OF_LOG_ERROR) << "Failed to load " << argv[2];
+        return 1;
+    }
+    const uint32_t num_dimensions = training_data.getNumDimensions();
+    if (num_dimensions != exported::kNumInputDimensions ||
+        num_dimensions != fixed_point::kNumInputDimensions) {
+        ofLog(OF_LOG_ERROR) << argv[2] << " has " << num_dimensions
+                            << " dimensions, the pipeline "
+                            << exported::kNumInputDimensions;
+        return 1;
+    }
+
+    Result grt, exported_float, exported_fixed_point;
+    grt.name = "GRT";
+    exported_float.name = "float";
+    exported_fixed_point.name = "fixed point";
+    Result* const results[] = { &grt, &exported_float, &exported_fixed_point };
+    uint64_t num_rows = 0;
+    std::vector<GRT::VectorDouble> rows;
+    std::vector<float> input(num_dimensions);
+    for (GRT::UINT i = 0; i < training_data.getNumSamples(); i++) {
+        const GRT::MatrixDouble& data = training_data[i].getData();
+        const GRT::UINT class_label = training_data[i].getClassLabel();
+        rows.resize(data.getNumRows());
+        for (GRT::UINT row = 0; row < rows.size(); row++) {
+            rows[row] = data.getRowVector(row);
+        }
+        grt.labels.clear();
+        exported_float.labels.clear();
+        exported_fixed_point.labels.clear();
+
+        pipeline.reset();
+        int64_t start_ns = getMonotonicTimeNs();
+        for (const GRT::VectorDouble& row : rows) {
+            pipeline.predict(row);
+            grt.labels.push_back(pipeline.getPredictedClassLabel());
+        }
+        grt.elapsed_ns += getMonotonicTimeNs() - start_ns;
+
+        exported::State float_state = exported::State();
+        start_ns = getMonotonicTimeNs();
+        for (const GRT::VectorDouble& row : rows) {
+            std::copy(row.begin(), row.end(), input.begin());
+            exported_float.labels.push_back(
+                    exported::predict(&float_state, input.data()));
+        }
+        exported_float.elapsed_ns += getMonotonicTimeNs() - start_ns;
+
+        fixed_point::State fixed_point_state = fixed_point::State();
+        start_ns = getMonotonicTimeNs();
+        for (const GRT::VectorDouble& row : rows) {
+            std::copy(row.begin(), row.end(), input.begin());
+            exported_fixed_point.labels.push_back(
+                    fixed_point::predict(&fixed_point_state, input.data()));
+        }
+        exported_fixed_point.elapsed_ns += getMonotonicTimeNs() - start_ns;
+
+        for (Result* result : results) {
+            for (uint32_t row = 0; row < rows.size(); row++) {
+                result->num_correct_rows += result->labels[row] == class_label;
+                result->num_rows_agreeing +=
+                        result->labels[row] == grt.labels[row];
+            }
+            result->num_correct_samples += vote(result->labels) == class_label;
+        }
+        num_rows += rows.size();
+    }
+
+    const uint64_t num_samples = training_data.getNumSamples();
+    std::cout << num_samples << " training samples, " << num_rows
+              << " rows\n";
+    for (const Result* result : results) {
+        std::cout << std::left << std::setw(13) << result->name + ":"
+                  << formatPercentage(result->num_correct_rows, num_rows)
+                  << " of rows and "
+                  << formatPercentage(result->num_correct_samples, num_samples)
+                  << " of samples correct";
+        if (result != &grt) {
+            std::cout << ", agrees with GRT on "
+                      << formatPercentage(result->num_rows_agreeing, num_rows)
+                      << " of rows";
+        }
+        std::cout << ", "
+                  << formatDuration(result->elapsed_ns /
+                                    std::max<double>(1, num_rows))
+                  << " per row\n";
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * frame-bench times what the app's training tab does with the training data
+ * on every frame, and on every click that moves between samples, for
+ * training sets of growing size. Neither should depend on how many
+ * recordings there are. For comparison, it also times the click as the app
+ * used to handle it, copying every class out of GRT's training data:
+ *
+ *   frame-bench                         # up to 100000 recordings
+ *   frame-bench --recordings 500000 --rows 50
+ *
+ * Both run the app's own code (training_browser.h); only the drawing, which
+ * needs a window, is left out. Exits with status 1 if the two ways of handling a click show
+ * different samples.
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+#include "training_browser.h"
+#include "training_set.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: frame-bench [options]\n"
+        "  -n, --recordings N    recordings in the largest set (default\n"
+        "                        100000); also times sets of N/100 and N/10\n"
+        "  -r, --rows N          mean rows per recording (default 100)\n"
+        "  -d, --dimensions N    dimensions (default 3)\n"
+        "  -h, --help            show this message\n";
+
+// As in the app.
+const uint32_t kNumMaxLabels = 9;
+const uint32_t kNumFrames = 10000;
+const uint32_t kNumClicks = 20;
+
+struct Timings {
+    int64_t frame_ns;
+    int64_t click_ns;
+    int64_t grt_click_ns;
+    bool same_samples;
+};
+
+// What drawTrainingInfo() computes for every label, with the first sample
+// of each plotted.
+uint64_t drawFrame(const TrainingSet& set) {
+    uint64_t total = 0;
+    for (uint32_t label = 1; label <= kNumMaxLabels; label++) {
+        TrainingSampleCaption caption = getTrainingSampleCaption(set, label, 0);
+        total += caption.num_samples + caption.text.size();
+    }
+    return total;
+}
+
+Timings run(uint32_t num_recordings, uint32_t num_rows,
+            uint32_t num_dimensions) {
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint32_t> length(num_rows / 2,
+                                                   num_rows * 3 / 2);
+    std::normal_distribution<double> value(0, 1);
+    TrainingSet set;
+    set.setNumDimensions(num_dimensions);
+    GRT::TimeSeriesClassificationData data;
+    data.setNumDimensions(num_dimensions);
+    for (uint32_t i = 0; i < num_recordings; i++) {
+        GRT::MatrixDouble recording(length(random), num_dimensions);
+        for (uint32_t row = 0; row < recording.getNumRows(); row++) {
+            for (uint32_t d = 0; d < num_dimensions; d++) {
+                recording[row][d] = value(random);
+            }
+        }
+        set.append(i % kNumMaxLabels + 1, recording);
+        data.addSample(i % kNumMaxLabels + 1, recording);
+    }
+
+    Timings timings;
+    uint64_t total = 0;
+    int64_t start_ns = getMonotonicTimeNs();
+    for (uint32_t frame = 0; frame < kNumFrames; frame++) {
+        total += drawFrame(set);
+    }
+    timings.frame_ns = (getMonotonicTimeNs() - start_ns) / kNumFrames;
+
+    // Each click is on the "->" of one label, as mouseReleased() handles it,
+    // with every label starting at its first sample.
+    std::vector<int> indices(kNumMaxLabels, 0);
+    std::vector<GRT::MatrixDouble> shown(kNumClicks);
+    start_ns = getMonotonicTimeNs();
+    for (uint32_t click = 0; click < kNumClicks; click++) {
+        const uint32_t clicked = click % kNumMaxLabels + 1;
+        stepTrainingSample(set, clicked, 1, &indices[clicked - 1],
+                           &shown[click]);
+    }
+    timings.click_ns = (getMonotonicTimeNs() - start_ns) / kNumClicks;
+
+    // The app used to copy every label's samples out of GRT's training data
+    // on a click, then plot the next one of the clicked label.
+    std::vector<GRT::MatrixDouble> grt_shown;
+    start_ns = getMonotonicTimeNs();
+    for (uint32_t click = 0; click < kNumClicks; click++) {
+        const uint32_t clicked = click % kNumMaxLabels + 1;
+        for (uint32_t label = 1; label <= kNumMaxLabels; label++) {
+            GRT::TimeSeriesClassificationData class_data =
+                    data.getClassData(label);
+            if (label == clicked) {
+                grt_shown.push_back(
+                        class_data[click / kNumMaxLabels + 1].getData());
+            }
+        }
+    }
+    timings.grt_click_ns = (getMonotonicTimeNs() - start_ns) / kNumClicks;
+
+    timings.same_samples = total > 0;
+    for (uint32_t i = 0; i < kNumClicks; i++) {
+        if (shown[i].getNumRows() != grt_shown[i].getNumRows()) {
+            timings.same_samples = false;
+            continue;
+        }
+        for (uint32_t row = 0; row < shown[i].getNumRows(); row++) {
+            for (uint32_t d = 0; d < num_dimensions; d++) {
+                if (shown[i][row][d] != grt_shown[i][row][d]) {
+                    timings.same_samples = false;
+                }
+            }
+        }
+    }
+    return timings;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_recordings = 100000;
+    uint32_t num_rows = 100;
+    uint32_t num_dimensions = 3;
+
+    const struct option kOptions[] = {
+        { "recordings", required_argument, nullptr, 'n' },
+        { "rows", required_argument, nullptr, 'r' },
+        { "dimensions", required_argument, nullptr, 'd' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "n:r:d:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'n': num_recordings = atoi(optarg); break;
+            case 'r': num_rows = atoi(optarg); break;
+            case 'd': num_dimensions = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_recordings < 100 * kNumMaxLabels || num_rows < 2 ||
+        num_dimensions == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    bool ok = true;
+    for (uint32_t size : { num_recordings / 100, num_recordings / 10,
+                           num_recordings }) {
+        Timings timings = run(size, num_rows, num_dimensions);
+        std::cout << size << " recordings: frame "
+                  << formatDuration(timings.frame_ns) << ", click "
+                  << formatDuration(timings.click_ns)
+                  << " (copying GRT's classes: "
+                  << formatDuration(timings.grt_click_ns) << ")"
+                  << (timings.same_samples ? "" : "; DIFFERENT samples")
+                  << "\n";
+        ok = timings.same_samples && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/*
+ * knn-bench compares KDTreeKNN with GRT's brute-force KNN on synthetic data:
+ * for training sets of 1000, 10000 and 100000 samples, it trains both on the
+ * same Gaussian clusters, predicts the same random inputs with each, and
+ * reports the time per prediction, how many training samples KDTreeKNN
+ * measured the distance to, and how often the labels agree, for an exact
+ * search and an approximate one:
+ *
+ *   knn-bench                   # 3 dimensions (e.g. a color sensor)
+ *   knn-bench --dimensions 6 --epsilon 1
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "kd_tree_knn.h"
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: knn-bench [options]\n"
+        "  -d, --dimensions N    input dimensions (default 3)\n"
+        "  -c, --classes N       number of classes (default 8)\n"
+        "  -k N                  neighbours (default 10)\n"
+        "  -e, --epsilon E       approximation of the second KD-tree run\n"
+        "                        (default 0.5)\n"
+        "  -n, --predictions N   predictions per training set size (default\n"
+        "                        1000)\n"
+        "  -h, --help            show this message\n";
+
+const uint32_t kNumSamples[] = { 1000, 10000, 100000 };
+
+struct Run {
+    std::vector<GRT::UINT> labels;
+    int64_t elapsed_ns;
+};
+
+template <class Classifier>
+Run predictAll(Classifier& classifier,
+               const std::vector<GRT::VectorDouble>& inputs) {
+    Run run = { std::vector<GRT::UINT>(), 0 };
+    run.labels.reserve(inputs.size());
+    int64_t start_ns = getMonotonicTimeNs();
+    for (const GRT::VectorDouble& input : inputs) {
+        classifier.predict(input);
+        run.labels.push_back(classifier.getPredictedClassLabel());
+    }
+    run.elapsed_ns = getMonotonicTimeNs() - start_ns;
+    return run;
+}
+
+uint32_t countAgreeing(const Run& a, const Run& b) {
+    uint32_t num_agreeing = 0;
+    for (uint32_t i = 0; i < a.labels.size(); i++) {
+        if (a.labels[i] == b.labels[i]) { num_agreeing++; }
+    }
+    return num_agreeing;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_dimensions = 3;
+    uint32_t num_classes = 8;
+    uint32_t k = 10;
+    double epsilon = 0.5;
+    uint32_t num_predictions = 1000;
+
+    const struct option kOptions[] = {
+        { "dimensions", required_argument, nullptr, 'd' },
+        { "classes", required_argument, nullptr, 'c' },
+        { "epsilon", required_argument, nullptr, 'e' },
+        { "predictions", required_argument, nullptr, 'n' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "d:c:k:e:n:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'd': num_dimensions = atoi(optarg); break;
+            case 'c': num_classes = atoi(optarg); break;
+            case 'k': k = atoi(optarg); break;
+            case 'e': epsilon = atof(optarg); break;
+            case 'n': num_predictions = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_dimensions == 0 || num_classes == 0 || k == 0 || epsilon < 0 ||
+        num_predictions == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    std::cout << num_dimensions << " dimensions, " << num_classes
+              << " classes, K = " << k << "\n";
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> center(-1, 1);
+    std::normal_distribution<double> spread(0, 0.3);
+    std::vector<GRT::VectorDouble> centers(num_classes);
+    for (GRT::VectorDouble& c : centers) {
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            c.push_back(center(random));
+        }
+    }
+    std::vector<GRT::VectorDouble> inputs(num_predictions);
+    for (uint32_t i = 0; i < num_predictions; i++) {
+        inputs[i] = centers[i % num_classes];
+        for (double& x : inputs[i]) { x += spread(random); }
+    }
+
+    for (uint32_t num_samples : kNumSamples) {
+        GRT::ClassificationData training_data;
+        training_data.setNumDimensions(num_dimensions);
+        for (uint32_t i = 0; i < num_samples; i++) {
+            GRT::VectorDouble sample(centers[i % num_classes]);
+            for (double& x : sample) { x += spread(random); }
+            training_data.addSample(i % num_classes + 1, sample);
+        }
+
+        GRT::KNN knn(k);
+        KDTreeKNN exact(k);
+        KDTreeKNN approximate(k);
+        approximate.setEpsilon(epsilon);
+        if (!knn.train(training_data) || !exact.train(training_data) ||
+            !approximate.train(training_data)) {
+            ofLog(OF_LOG_ERROR) << "Failed to train on " << num_samples
+                                << " samples";
+            return 1;
+        }
+        Run grt = predictAll(knn, inputs);
+        Run ours = predictAll(exact, inputs);
+        uint64_t exact_distances = 0;
+        for (const GRT::VectorDouble& input : inputs) {
+            exact.predict(input);
+            exact_distances += exact.getNumDistancesComputed();
+        }
+        Run approximate_run = predictAll(approximate, inputs);
+        uint64_t approximate_distances = 0;
+        for (const GRT::VectorDouble& input : inputs) {
+            approximate.predict(input);
+            approximate_distances += approximate.getNumDistancesComputed();
+        }
+
+        std::cout << num_samples << " samples: KNN "
+                  << formatDuration(double(grt.elapsed_ns) / num_predictions)
+                  << ", exact "
+                  << formatDuration(double(ours.elapsed_ns) / num_predictions)
+                  << " (" << double(grt.elapsed_ns) /
+                             std::max<int64_t>(1, ours.elapsed_ns)
+                  << "x, " << exact_distances / num_predictions
+                  << " distances, labels agree on " << countAgreeing(grt, ours)
+                  << "/" << num_predictions << "), epsilon " << epsilon << " "
+                  << formatDuration(double(approximate_run.elapsed_ns) /
+                                    num_predictions)
+                  << " (" << double(grt.elapsed_ns) /
+                             std::max<int64_t>(1, approximate_run.elapsed_ns)
+                  << "x, " << approximate_distances / num_predictions
+                  << " distances, labels agree on "
+                  << countAgreeing(grt, approximate_run) << "/"
+                  << num_predictions << ")\n";
+    }
+    return 0;
+}
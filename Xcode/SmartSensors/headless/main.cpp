@@ -0,0 +1,544 @@
+/*
+ * esp-headless runs a user's sensor application (the setup() in one of the
+ * src/user_*.h headers) on an InferenceEngine, without openFrameworks: no
+ * window, no plots and no training UI. The pipeline is either one trained and
+ * saved with the app, or trained at start-up from saved training data.
+ *
+ * With --sessions, it instead hosts many independent sessions on one thread
+ * pool (see SessionManager), one per line of the sessions file:
+ *
+ *   # name  stream                 pipeline        [ostream]
+ *   left    ascii:0:115200:3       gestures.grt    tcp:localhost:5204
+ *   right   binary:1:115200:3      gestures.grt
+ *   replay  replay:run.esps:2:loop other.grt
+ *
+ * Streams are ascii:<port>:<baud>:<dimensions>,
+ * binary:<port>:<baud>:<dimensions> or replay:<path>[:<speed>[:loop]]; the
+ * optional TCP ostream sends "<name> <label>\n" for every predicted label.
+ * Sessions naming the same pipeline file share one loaded copy. The user's
+ * setup() is not run, so sessions have no calibrator.
+ *
+ * With --sweep, it does not run at all: it searches the user's tuneables for
+ * the best settings instead (see ParameterSweep), training and
+ * cross-validating the user's pipeline on --training-data at every point and
+ * printing a leaderboard:
+ *
+ *   esp-headless -t data.grt --sweep grid:5 --min-accuracy 0.9 \
+ *           --sample-rate 50
+ *
+ * While running, it periodically prints throughput and end-to-end latency,
+ * and dumps the full latency profile when it exits (on SIGINT/SIGTERM, after
+ * --duration, or when every ReplayStream reaches the end of its session).
+ */
+#include <getopt.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "inference_engine.h"
+#include "parameter_sweep.h"
+#include "pipeline_file.h"
+#include "profiler.h"
+#include "runtime.h"
+#include "sample_clock.h"
+#include "session_manager.h"
+#include "tracer.h"
+#include "training_set.h"
+
+#ifndef ESP_USER_HEADER
+#define ESP_USER_HEADER "user.h"
+#endif
+#include ESP_USER_HEADER
+
+namespace {
+
+const char kUsage[] =
+        "Usage: esp-headless [options]\n"
+        "  -p, --pipeline FILE       trained pipeline saved by the app, as\n"
+        "                            GRT text or a model file (*.espm)\n"
+        "                            (default: pipeline.grt)\n"
+        "  -t, --training-data FILE  train the user's pipeline on FILE instead\n"
+        "                            (GRT text or a training set, *.espt)\n"
+        "  -c, --cpu N               pin the inference thread to CPU N (Linux)\n"
+        "  -d, --duration SECONDS    stop after this long\n"
+        "  -s, --stats SECONDS       print statistics this often (default 5,\n"
+        "                            0 to disable)\n"
+        "  -o, --profile FILE        write the latency profile to FILE instead\n"
+        "                            of stdout\n"
+        "  -x, --trace FILE          record a Chrome trace to FILE\n"
+        "  -D, --data-path DIR       data directory for ofToDataPath()\n"
+        "                            (default: data/)\n"
+        "  -S, --sessions FILE       run the sessions listed in FILE instead\n"
+        "                            of the user's setup()\n"
+        "  -j, --threads N           thread pool size for --sessions and\n"
+        "                            --sweep (default: one per core)\n"
+        "  -W, --sweep SPEC          sweep the tuneables over grid:STEPS or\n"
+        "                            random:POINTS[:SEED] instead of running;\n"
+        "                            needs --training-data\n"
+        "  -k, --folds K             cross-validation folds for --sweep\n"
+        "                            (default 5)\n"
+        "  -a, --min-accuracy A      rank the fastest points reaching A (0-1)\n"
+        "                            first (default: rank by accuracy)\n"
+        "  -r, --sample-rate HZ      rate --training-data was recorded at, for\n"
+        "                            time-based stages in --sweep (default 100)\n";
+
+std::atomic<bool> should_stop(false);
+
+void onSignal(int) {
+    should_stop = true;
+}
+
+// Collects what the user's setup() hands over. Tuneable parameters keep the
+// values setup() gives them.
+class HeadlessRuntime : public Runtime {
+  public:
+    void useStream(IStream& stream) { stream_ = &stream; }
+    void useCalibrator(Calibrator& calibrator) { calibrator_ = &calibrator; }
+    void usePipeline(GRT::GestureRecognitionPipeline& pipeline) {
+        pipeline_ = &pipeline;
+    }
+    void useOStream(OStream& stream) { ostream_ = &stream; }
+    void registerTuneable(Tuneable* tuneable) {
+        tuneables_.push_back(tuneable);
+    }
+    void reloadPipelineModules() {}
+
+    IStream* stream_ = nullptr;
+    Calibrator* calibrator_ = nullptr;
+    GRT::GestureRecognitionPipeline* pipeline_ = nullptr;
+    OStream* ostream_ = nullptr;
+    std::vector<Tuneable*> tuneables_;
+};
+
+void printStats(const InferenceEngine& engine, double elapsed_s) {
+    LatencyHistogram* e2e =
+            getProfiler().getHistogram("e2e/arrival to prediction");
+    uint64_t processed = engine.getNumProcessed();
+    std::cout << elapsed_s << "s: " << processed << " samples ("
+              << static_cast<uint64_t>(processed / std::max(elapsed_s, 1e-3))
+              << "/s), " << engine.getNumQueued() << " queued, "
+              << engine.getNumDropped() << " dropped; arrival to prediction p50 "
+              << formatDuration(e2e->getPercentile(50)) << ", p99 "
+              << formatDuration(e2e->getPercentile(99)) << ", max "
+              << formatDuration(e2e->getMax()) << std::endl;
+}
+
+std::vector<std::string> split(const std::string& s, char separator) {
+    std::vector<std::string> parts;
+    std::istringstream in(s);
+    std::string part;
+    while (std::getline(in, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+std::unique_ptr<IStream> createStream(const std::string& spec) {
+    std::vector<std::string> parts = split(spec, ':');
+    std::unique_ptr<IStream> stream;
+    if (parts.size() == 4 && (parts[0] == "ascii" || parts[0] == "binary")) {
+        uint32_t port = atoi(parts[1].c_str());
+        uint32_t baud = atoi(parts[2].c_str());
+        uint32_t num_dimensions = atoi(parts[3].c_str());
+        if (parts[0] == "ascii") {
+            stream.reset(new ASCIISerialStream(port, baud, num_dimensions));
+        } else {
+            stream.reset(new BinarySerialStream(port, baud, num_dimensions));
+        }
+    } else if (parts.size() >= 2 && parts.size() <= 4 && parts[0] == "replay") {
+        double speed = parts.size() > 2 ? atof(parts[2].c_str()) : 1.0;
+        bool loop = parts.size() > 3 && parts[3] == "loop";
+        stream.reset(new ReplayStream(parts[1], speed, loop));
+    }
+    return stream;
+}
+
+// Maps every class label of `pipeline` to "<name> <label>\n".
+std::unique_ptr<OStream> createOStream(
+        const std::string& spec, const std::string& name,
+        const GRT::GestureRecognitionPipeline& pipeline) {
+    std::vector<std::string> parts = split(spec, ':');
+    if (parts.size() != 3 || parts[0] != "tcp") { return nullptr; }
+    std::map<uint32_t, string> mapping;
+    for (GRT::UINT label : pipeline.getClassLabels()) {
+        mapping[label] = name + " " + std::to_string(label) + "\n";
+    }
+    std::unique_ptr<OStream> ostream(
+            new TcpOStream(parts[1], atoi(parts[2].c_str()), mapping));
+    ostream->setStreamSize(10000000);
+    return ostream;
+}
+
+bool hasExtension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(),
+                        extension) == 0;
+}
+
+// A model file (*.espm) or GRT text, by extension.
+bool loadPipeline(const std::string& path,
+                  GRT::GestureRecognitionPipeline* pipeline) {
+    if (!hasExtension(path, ".espm")) { return pipeline->load(path); }
+    std::string error;
+    if (!loadPipelineFile(path, pipeline, &error)) {
+        ofLog(OF_LOG_ERROR) << error;
+        return false;
+    }
+    return true;
+}
+
+// A training set file (*.espt) or GRT text, by extension.
+bool loadTrainingData(const std::string& path,
+                      GRT::TimeSeriesClassificationData* data) {
+    if (!hasExtension(path, ".espt")) { return data->load(path); }
+    TrainingSet training_set;
+    if (!training_set.load(path)) {
+        ofLog(OF_LOG_ERROR) << training_set.getLastError();
+        return false;
+    }
+    *data = training_set.toTimeSeriesData();
+    return true;
+}
+
+bool loadSessions(const std::string& path, SessionManager& sessions) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        ofLog(OF_LOG_ERROR) << "Failed to open " << path;
+        return false;
+    }
+    std::map<std::string, std::shared_ptr<GRT::GestureRecognitionPipeline>>
+            pipelines;
+    std::string line;
+    for (uint32_t line_num = 1; std::getline(in, line); line_num++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name, stream_spec, pipeline_path, ostream_spec;
+        if (!(fields >> name)) { continue; }
+        if (!(fields >> stream_spec >> pipeline_path)) {
+            ofLog(OF_LOG_ERROR) << path << ":" << line_num
+                                << ": expected a stream and a pipeline";
+            return false;
+        }
+        fields >> ostream_spec;
+
+        std::unique_ptr<IStream> stream = createStream(stream_spec);
+        if (stream == nullptr) {
+            ofLog(OF_LOG_ERROR) << path << ":" << line_num
+                                << ": bad stream " << stream_spec;
+            return false;
+        }
+
+        std::shared_ptr<GRT::GestureRecognitionPipeline>& pipeline =
+                pipelines[pipeline_path];
+        if (pipeline == nullptr) {
+            pipeline = std::make_shared<GRT::GestureRecognitionPipeline>();
+            if (!loadPipeline(pipeline_path, pipeline.get()) ||
+                !pipeline->getTrained()) {
+                ofLog(OF_LOG_ERROR) << path << ":" << line_num
+                                    << ": failed to load a trained pipeline"
+                                    << " from " << pipeline_path;
+                return false;
+            }
+        }
+
+        std::unique_ptr<OStream> ostream;
+        if (!ostream_spec.empty()) {
+            ostream = createOStream(ostream_spec, name, *pipeline);
+            if (ostream == nullptr) {
+                ofLog(OF_LOG_ERROR) << path << ":" << line_num
+                                    << ": bad ostream " << ostream_spec;
+                return false;
+            }
+        }
+        sessions.addSession(name, std::move(stream), pipeline,
+                            std::move(ostream));
+    }
+    if (sessions.getNumSessions() == 0) {
+        ofLog(OF_LOG_ERROR) << path << " lists no sessions";
+        return false;
+    }
+    return true;
+}
+
+bool isFinished(SessionManager& sessions) {
+    for (uint32_t i = 0; i < sessions.getNumSessions(); i++) {
+        ReplayStream* replay = dynamic_cast<ReplayStream*>(&sessions.getStream(i));
+        if (replay == nullptr || !replay->isFinished() ||
+            sessions.getEngine(i).getNumQueued() > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int runSessions(const std::string& path, uint32_t num_threads,
+                double duration_s, double stats_interval_s) {
+    SessionManager sessions(num_threads);
+    if (!loadSessions(path, sessions)) { return 1; }
+    ofLog() << "Running " << sessions.getNumSessions() << " sessions on "
+            << sessions.getThreadPool().getNumThreads() << " threads";
+    sessions.startAll();
+
+    int64_t start_ns = getMonotonicTimeNs();
+    int64_t next_stats_ns = start_ns + stats_interval_s * 1e9;
+    while (!should_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        int64_t now_ns = getMonotonicTimeNs();
+        double elapsed_s = (now_ns - start_ns) / 1e9;
+        if (duration_s > 0 && elapsed_s >= duration_s) { break; }
+        if (isFinished(sessions)) { break; }
+        if (stats_interval_s > 0 && now_ns >= next_stats_ns) {
+            std::cout << elapsed_s << "s:" << std::endl;
+            sessions.dumpStats(std::cout);
+            next_stats_ns += stats_interval_s * 1e9;
+        }
+    }
+    sessions.stopAll();
+    std::cout << (getMonotonicTimeNs() - start_ns) / 1e9 << "s:" << std::endl;
+    sessions.dumpStats(std::cout);
+    return 0;
+}
+
+int runSweep(HeadlessRuntime& runtime, const std::string& spec,
+             const std::string& training_data_path, uint32_t num_folds,
+             double min_accuracy, double sample_rate_hz,
+             uint32_t num_threads) {
+    if (sample_rate_hz <= 0) {
+        ofLog(OF_LOG_ERROR) << "bad sample rate " << sample_rate_hz;
+        return 2;
+    }
+    GRT::TimeSeriesClassificationData training_data;
+    if (training_data_path.empty() ||
+        !loadTrainingData(training_data_path, &training_data)) {
+        ofLog(OF_LOG_ERROR) << "--sweep needs training data (--training-data)";
+        return 1;
+    }
+    if (runtime.tuneables_.empty()) {
+        ofLog(OF_LOG_ERROR) << "setup() registers no tuneables to sweep";
+        return 1;
+    }
+
+    GRT::GestureRecognitionPipeline& pipeline = *runtime.pipeline_;
+    ParameterSweep sweep(runtime.tuneables_, [&pipeline]() {
+        pipeline.clearAll();
+        ::setup();
+        return pipeline;
+    });
+    std::vector<std::string> parts = split(spec, ':');
+    if (parts.size() == 2 && parts[0] == "grid") {
+        sweep.addGrid(atoi(parts[1].c_str()));
+    } else if ((parts.size() == 2 || parts.size() == 3) &&
+               parts[0] == "random") {
+        uint32_t seed = parts.size() > 2 ? atoi(parts[2].c_str())
+                                         : std::random_device()();
+        sweep.addRandom(atoi(parts[1].c_str()), seed);
+    } else {
+        ofLog(OF_LOG_ERROR) << "bad sweep " << spec;
+        return 2;
+    }
+
+    ThreadPool pool(num_threads);
+    ofLog() << "Sweeping " << sweep.getNumPoints() << " points with "
+            << num_folds << "-fold cross-validation on "
+            << pool.getNumThreads() << " threads";
+    uint64_t start_ms = ofGetElapsedTimeMillis();
+    std::vector<ParameterSweep::Result> results =
+            sweep.run(training_data, num_folds, 1e9 / sample_rate_hz, pool);
+    if (results.empty()) { return 1; }
+    ofLog() << "Swept in " << ofGetElapsedTimeMillis() - start_ms << " ms";
+
+    ParameterSweep::rank(results, min_accuracy);
+    sweep.printLeaderboard(results, std::cout);
+    return 0;
+}
+
+int writeProfile(const std::string& profile_path) {
+    if (profile_path.empty()) {
+        getProfiler().dump(std::cout);
+        return 0;
+    }
+    std::ofstream out(profile_path.c_str());
+    getProfiler().dump(out);
+    if (!out) {
+        ofLog(OF_LOG_ERROR) << "Failed to write " << profile_path;
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    string pipeline_path = "pipeline.grt";
+    string training_data_path;
+    int cpu = -1;
+    double duration_s = 0;
+    double stats_interval_s = 5;
+    string profile_path;
+    string trace_path;
+    string sessions_path;
+    uint32_t num_threads = 0;
+    string sweep_spec;
+    uint32_t num_folds = 5;
+    // Above any accuracy, so that the leaderboard is ranked by accuracy.
+    double min_accuracy = 2;
+    double sample_rate_hz = 100;
+
+    const struct option kOptions[] = {
+        { "pipeline", required_argument, nullptr, 'p' },
+        { "training-data", required_argument, nullptr, 't' },
+        { "cpu", required_argument, nullptr, 'c' },
+        { "duration", required_argument, nullptr, 'd' },
+        { "stats", required_argument, nullptr, 's' },
+        { "profile", required_argument, nullptr, 'o' },
+        { "trace", required_argument, nullptr, 'x' },
+        { "data-path", required_argument, nullptr, 'D' },
+        { "sessions", required_argument, nullptr, 'S' },
+        { "threads", required_argument, nullptr, 'j' },
+        { "sweep", required_argument, nullptr, 'W' },
+        { "folds", required_argument, nullptr, 'k' },
+        { "min-accuracy", required_argument, nullptr, 'a' },
+        { "sample-rate", required_argument, nullptr, 'r' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "p:t:c:d:s:o:x:D:S:j:W:k:a:r:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'p': pipeline_path = optarg; break;
+            case 't': training_data_path = optarg; break;
+            case 'c': cpu = atoi(optarg); break;
+            case 'd': duration_s = atof(optarg); break;
+            case 's': stats_interval_s = atof(optarg); break;
+            case 'o': profile_path = optarg; break;
+            case 'x': trace_path = optarg; break;
+            case 'D': ofSetDataPathRoot(optarg); break;
+            case 'S': sessions_path = optarg; break;
+            case 'j': num_threads = atoi(optarg); break;
+            case 'W': sweep_spec = optarg; break;
+            case 'k': num_folds = atoi(optarg); break;
+            case 'a': min_accuracy = atof(optarg); break;
+            case 'r': sample_rate_hz = atof(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (!sessions_path.empty()) {
+        if (!trace_path.empty()) { getTracer().start(); }
+        int status = runSessions(sessions_path, num_threads, duration_s,
+                                 stats_interval_s);
+        if (!trace_path.empty() && !getTracer().stop(trace_path)) {
+            ofLog(OF_LOG_ERROR) << getTracer().getLastError();
+        }
+        return status != 0 ? status : writeProfile(profile_path);
+    }
+
+    HeadlessRuntime runtime;
+    setRuntime(&runtime);
+    // setup() is a user-defined function.
+    ::setup();
+
+    if (runtime.stream_ == nullptr || runtime.pipeline_ == nullptr) {
+        ofLog(OF_LOG_ERROR) << "setup() must call useStream() and usePipeline()";
+        return 1;
+    }
+    if (!sweep_spec.empty()) {
+        return runSweep(runtime, sweep_spec, training_data_path, num_folds,
+                        min_accuracy, sample_rate_hz, num_threads);
+    }
+    // Calibration data can only be collected in the app.
+    if (runtime.calibrator_ != nullptr && !runtime.calibrator_->isCalibrated()) {
+        ofLog(OF_LOG_ERROR) << "The calibrator needs calibration data, which "
+                            << "cannot be collected headless";
+        return 1;
+    }
+
+    std::shared_ptr<GRT::GestureRecognitionPipeline> pipeline;
+    if (!training_data_path.empty()) {
+        GRT::TimeSeriesClassificationData training_data;
+        if (!loadTrainingData(training_data_path, &training_data)) {
+            ofLog(OF_LOG_ERROR) << "Failed to load " << training_data_path;
+            return 1;
+        }
+        pipeline = std::make_shared<GRT::GestureRecognitionPipeline>(
+                *runtime.pipeline_);
+        uint64_t start_ms = ofGetElapsedTimeMillis();
+        if (!pipeline->train(training_data)) {
+            ofLog(OF_LOG_ERROR) << "Failed to train the pipeline";
+            return 1;
+        }
+        ofLog() << "Trained on " << training_data.getNumSamples()
+                << " samples in " << ofGetElapsedTimeMillis() - start_ms
+                << " ms";
+    } else {
+        pipeline = std::make_shared<GRT::GestureRecognitionPipeline>();
+        if (!loadPipeline(pipeline_path, pipeline.get())) {
+            ofLog(OF_LOG_ERROR) << "Failed to load " << pipeline_path;
+            return 1;
+        }
+    }
+    if (!pipeline->getTrained()) {
+        ofLog(OF_LOG_ERROR) << "The pipeline is not trained";
+        return 1;
+    }
+
+    if (runtime.ostream_ != nullptr) {
+        runtime.ostream_->setStreamSize(10000000);
+        if (!runtime.ostream_->start()) {
+            ofLog(OF_LOG_ERROR) << "failed to connect to ostream";
+        }
+    }
+
+    if (!trace_path.empty()) { getTracer().start(); }
+
+    InferenceEngine engine;
+    engine.setCalibrator(runtime.calibrator_);
+    engine.setOStream(runtime.ostream_);
+    engine.setPipeline(pipeline);
+    engine.start(runtime.stream_);
+    if (cpu >= 0 && !engine.pinToCpu(cpu)) {
+        ofLog(OF_LOG_WARNING) << "Could not pin the inference thread to CPU "
+                              << cpu;
+    }
+
+    ReplayStream* replay = dynamic_cast<ReplayStream*>(runtime.stream_);
+    int64_t start_ns = getMonotonicTimeNs();
+    int64_t next_stats_ns = start_ns + stats_interval_s * 1e9;
+    while (!should_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        int64_t now_ns = getMonotonicTimeNs();
+        double elapsed_s = (now_ns - start_ns) / 1e9;
+        if (duration_s > 0 && elapsed_s >= duration_s) { break; }
+        if (replay != nullptr && replay->isFinished() &&
+            engine.getNumQueued() == 0) {
+            break;
+        }
+        if (stats_interval_s > 0 && now_ns >= next_stats_ns) {
+            printStats(engine, elapsed_s);
+            next_stats_ns += stats_interval_s * 1e9;
+        }
+    }
+    engine.stop();
+    printStats(engine, (getMonotonicTimeNs() - start_ns) / 1e9);
+
+    if (!trace_path.empty() && !getTracer().stop(trace_path)) {
+        ofLog(OF_LOG_ERROR) << getTracer().getLastError();
+    }
+
+    return writeProfile(profile_path);
+}
@@ -0,0 +1,245 @@
+/*
+ * model-bench checks that pipelines saved as model files (pipeline_file.h)
+ * load back exactly as they were saved, and compares how long they take to
+ * load with GRT's text. For each pipeline, it saves it both ways and loads
+ * each back a few times, then checks that the pipeline loaded from the model
+ * file saves the same GRT text as the original and predicts the same labels
+ * for a stream of random inputs:
+ *
+ *   model-bench                    # large synthetic PrunedDTW and KDTreeKNN
+ *   model-bench pipeline.grt       # and pipelines saved by the app
+ *
+ * The synthetic models are a PrunedDTW with --templates templates of
+ * --length samples, and a KDTreeKNN with --samples training samples. Exits
+ * with status 1 if any check fails.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kd_tree_knn.h"
+#include "of_shim.h"
+#include "pipeline_file.h"
+#include "profiler.h"
+#include "pruned_dtw.h"
+#include "sample_clock.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: model-bench [options] [PIPELINE...]\n"
+        "  -t, --templates N     PrunedDTW templates (default 64)\n"
+        "  -l, --length N        samples per template (default 400)\n"
+        "  -s, --samples N       KDTreeKNN training samples (default 100000)\n"
+        "  -d, --dimensions N    input dimensions (default 3)\n"
+        "  -r, --repeats N       loads to time, keeping the fastest\n"
+        "                        (default 5)\n"
+        "  -h, --help            show this message\n";
+
+const char kTextPath[] = "model-bench.grt";
+const char kModelPath[] = "model-bench.espm";
+const uint32_t kNumPredictions = 500;
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+uint64_t getFileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+std::string formatSize(uint64_t bytes) {
+    std::ostringstream out;
+    out.precision(3);
+    if (bytes >= 1 << 20) {
+        out << double(bytes) / (1 << 20) << " MB";
+    } else {
+        out << double(bytes) / (1 << 10) << " KB";
+    }
+    return out.str();
+}
+
+std::vector<GRT::UINT> predictAll(GRT::GestureRecognitionPipeline& pipeline,
+                                  uint32_t num_dimensions) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::vector<GRT::UINT> labels;
+    GRT::VectorDouble input(num_dimensions);
+    pipeline.reset();
+    for (uint32_t i = 0; i < kNumPredictions; i++) {
+        for (double& x : input) { x = value(random); }
+        pipeline.predict(input);
+        labels.push_back(pipeline.getPredictedClassLabel());
+    }
+    return labels;
+}
+
+// Saves `pipeline` both ways, times loading each, and checks the round trip.
+bool check(const std::string& name, GRT::GestureRecognitionPipeline& pipeline,
+           uint32_t num_repeats) {
+    std::string error;
+    if (!pipeline.save(kTextPath) ||
+        !savePipelineFile(pipeline, kModelPath, &error)) {
+        ofLog(OF_LOG_ERROR) << name << ": failed to save: " << error;
+        return false;
+    }
+
+    int64_t text_ns = 0;
+    int64_t model_ns = 0;
+    GRT::GestureRecognitionPipeline loaded;
+    for (uint32_t i = 0; i < num_repeats; i++) {
+        GRT::GestureRecognitionPipeline from_text;
+        int64_t start_ns = getMonotonicTimeNs();
+        bool ok = from_text.load(kTextPath);
+        int64_t elapsed_ns = getMonotonicTimeNs() - start_ns;
+        if (!ok) {
+            ofLog(OF_LOG_ERROR) << name << ": failed to load the text";
+            return false;
+        }
+        text_ns = i == 0 ? elapsed_ns : std::min(text_ns, elapsed_ns);
+
+        GRT::GestureRecognitionPipeline from_model;
+        start_ns = getMonotonicTimeNs();
+        ok = loadPipelineFile(kModelPath, &from_model, &error);
+        elapsed_ns = getMonotonicTimeNs() - start_ns;
+        if (!ok) {
+            ofLog(OF_LOG_ERROR) << name << ": " << error;
+            return false;
+        }
+        model_ns = i == 0 ? elapsed_ns : std::min(model_ns, elapsed_ns);
+        if (i + 1 == num_repeats) { loaded = from_model; }
+    }
+
+    std::string text = readFile(kTextPath);
+    uint64_t text_size = getFileSize(kTextPath);
+    uint64_t model_size = getFileSize(kModelPath);
+    bool same_text = loaded.save(kTextPath) && readFile(kTextPath) == text;
+    const uint32_t num_dimensions = pipeline.getInputVectorDimensionsSize();
+    std::vector<GRT::UINT> expected = predictAll(pipeline, num_dimensions);
+    std::vector<GRT::UINT> actual = predictAll(loaded, num_dimensions);
+    uint32_t num_agreeing = 0;
+    for (uint32_t i = 0; i < kNumPredictions; i++) {
+        if (expected[i] == actual[i]) { num_agreeing++; }
+    }
+    remove(kTextPath);
+    remove(kModelPath);
+
+    std::cout << name << ": text " << formatSize(text_size) << " in "
+              << formatDuration(text_ns) << ", model file "
+              << formatSize(model_size) << " in " << formatDuration(model_ns)
+              << " (" << double(text_ns) / std::max<int64_t>(1, model_ns)
+              << "x); saves " << (same_text ? "the same" : "DIFFERENT")
+              << " text, labels agree on " << num_agreeing << "/"
+              << kNumPredictions << "\n";
+    return same_text && num_agreeing == kNumPredictions;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_templates = 64;
+    uint32_t template_length = 400;
+    uint32_t num_samples = 100000;
+    uint32_t num_dimensions = 3;
+    uint32_t num_repeats = 5;
+
+    const struct option kOptions[] = {
+        { "templates", required_argument, nullptr, 't' },
+        { "length", required_argument, nullptr, 'l' },
+        { "samples", required_argument, nullptr, 's' },
+        { "dimensions", required_argument, nullptr, 'd' },
+        { "repeats", required_argument, nullptr, 'r' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "t:l:s:d:r:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 't': num_templates = atoi(optarg); break;
+            case 'l': template_length = atoi(optarg); break;
+            case 's': num_samples = atoi(optarg); break;
+            case 'd': num_dimensions = atoi(optarg); break;
+            case 'r': num_repeats = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_templates == 0 || template_length < 2 || num_samples == 0 ||
+        num_dimensions == 0 || num_repeats == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    bool ok = true;
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0, 0.05);
+
+    // Two noisy recordings of a different curve per class, so that every
+    // class keeps one template.
+    GRT::TimeSeriesClassificationData series;
+    series.setNumDimensions(num_dimensions);
+    for (uint32_t c = 0; c < num_templates; c++) {
+        for (uint32_t repeat = 0; repeat < 2; repeat++) {
+            GRT::MatrixDouble sample(template_length, num_dimensions);
+            for (uint32_t i = 0; i < template_length; i++) {
+                double t = double(i) / (template_length - 1);
+                for (uint32_t d = 0; d < num_dimensions; d++) {
+                    sample[i][d] =
+                            std::sin((c + 1) * (d + 1) * t) + noise(random);
+                }
+            }
+            series.addSample(c + 1, sample);
+        }
+    }
+    PrunedDTW dtw(false, true, 3.0);
+    if (!dtw.train(series)) {
+        ofLog(OF_LOG_ERROR) << "Failed to train PrunedDTW";
+        return 1;
+    }
+    GRT::GestureRecognitionPipeline dtw_pipeline;
+    dtw_pipeline.setClassifier(dtw);
+    ok = check("PrunedDTW", dtw_pipeline, num_repeats) && ok;
+
+    GRT::ClassificationData samples;
+    samples.setNumDimensions(num_dimensions);
+    std::uniform_real_distribution<double> value(-1, 1);
+    for (uint32_t i = 0; i < num_samples; i++) {
+        GRT::VectorDouble sample(num_dimensions);
+        for (double& x : sample) { x = value(random); }
+        samples.addSample(1 + (sample[0] > 0) + 2 * (sample[1] > 0), sample);
+    }
+    KDTreeKNN knn(10, true, true, 10.0);
+    if (!knn.train(samples)) {
+        ofLog(OF_LOG_ERROR) << "Failed to train KDTreeKNN";
+        return 1;
+    }
+    GRT::GestureRecognitionPipeline knn_pipeline;
+    knn_pipeline.setClassifier(knn);
+    ok = check("KDTreeKNN", knn_pipeline, num_repeats) && ok;
+
+    for (int i = optind; i < argc; i++) {
+        GRT::GestureRecognitionPipeline pipeline;
+        if (!pipeline.load(argv[i])) {
+            ofLog(OF_LOG_ERROR) << "Failed to load " << argv[i];
+            ok = false;
+            continue;
+        }
+        ok = check(argv[i], pipeline, num_repeats) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*
+ * ring-check exercises RingBuffer (ring_buffer.h) from one thread: pushing,
+ * popping and clearing around the wrap-around point and with the ring full,
+ * checking after each step that front() returns exactly what was pushed and
+ * not yet consumed:
+ *
+ *   make ring-check && ./ring-check
+ *
+ * Exits with status 1 if any check fails, listing the ones that did.
+ */
+#include <cstdint>
+#include <iostream>
+
+#include "ring_buffer.h"
+
+namespace {
+
+const size_t kCapacity = 8;
+
+int num_failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << "\n";
+        num_failures++;
+    }
+}
+
+// Consumes everything queued and checks that it is `first`, `first + 1`, ...
+// `first + n - 1`. Gives up after more elements than the ring can hold, so
+// that a ring which never runs empty fails rather than hangs.
+void checkDrain(RingBuffer<uint64_t>& ring, uint64_t first, size_t n,
+                const char* what) {
+    bool in_order = true;
+    size_t num_drained = 0;
+    for (uint64_t* value = ring.front();
+         value != nullptr && num_drained <= ring.capacity();
+         ring.pop(), value = ring.front()) {
+        in_order = in_order && *value == first + num_drained;
+        num_drained++;
+    }
+    check(in_order && num_drained == n, what);
+}
+
+}  // namespace
+
+int main() {
+    RingBuffer<uint64_t> ring(kCapacity);
+    check(ring.front() == nullptr, "a new ring is empty");
+
+    // Push and clear before anything was consumed: front() must not hand out
+    // the discarded slots, which the consumer has not looked at yet.
+    for (uint64_t i = 0; i < 3; i++) { ring.push(i); }
+    ring.clear();
+    check(ring.front() == nullptr, "empty after clear()");
+    check(ring.size() == 0, "size() is 0 after clear()");
+
+    // Same, after front() has cached the producer's position.
+    for (uint64_t i = 0; i < 3; i++) { ring.push(i); }
+    check(ring.front() != nullptr && *ring.front() == 0,
+          "front() is the oldest element");
+    ring.clear();
+    check(ring.front() == nullptr, "empty after front() and clear()");
+    ring.push(100);
+    check(ring.front() != nullptr && *ring.front() == 100,
+          "front() is the first element pushed after clear()");
+    checkDrain(ring, 100, 1, "drains only what was pushed after clear()");
+
+    // Fill the ring across the wrap-around point; one more is dropped.
+    for (uint64_t i = 0; i < kCapacity; i++) {
+        check(ring.push(i), "push() into a ring with room");
+    }
+    check(!ring.push(kCapacity), "push() into a full ring is dropped");
+    check(ring.getNumDropped() == 1 && ring.getNumOverruns() == 1,
+          "the drop is counted");
+    checkDrain(ring, 0, kCapacity, "drains a full ring in order");
+
+    // Clearing a full ring frees every slot.
+    for (uint64_t i = 0; i < kCapacity; i++) { ring.push(i); }
+    ring.clear();
+    check(ring.front() == nullptr, "empty after clearing a full ring");
+    for (uint64_t i = 0; i < kCapacity; i++) {
+        check(ring.push(i + 10), "push() after clearing a full ring");
+    }
+    checkDrain(ring, 10, kCapacity, "drains a refilled ring in order");
+    check(ring.front() == nullptr, "empty after draining");
+
+    std::cout << (num_failures == 0 ? "All checks passed\n" : "");
+    return num_failures == 0 ? 0 : 1;
+}
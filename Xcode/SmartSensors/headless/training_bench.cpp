@@ -0,0 +1,255 @@
+/*
+ * training-bench compares loading training data from a TrainingSet file
+ * (training_set.h) with loading GRT's text, on synthetic recordings, and
+ * checks that the file gives back exactly the recordings it was saved with,
+ * including after samples are appended, trimmed, relabelled and erased and
+ * it is saved again in place. It also times those edits, which should not
+ * depend on how many recordings there are:
+ *
+ *   training-bench                      # 20000 recordings of 3 dimensions
+ *   training-bench --recordings 50000 --rows 200
+ *
+ * Exits with status 1 if any check fails.
+ */
+#include <getopt.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+#include "training_set.h"
+
+namespace {
+
+const char kUsage[] =
+        "Usage: training-bench [options]\n"
+        "  -n, --recordings N    recordings (default 20000)\n"
+        "  -r, --rows N          mean rows per recording (default 100)\n"
+        "  -d, --dimensions N    dimensions (default 3)\n"
+        "  -c, --classes N       class labels (default 9)\n"
+        "  -h, --help            show this message\n";
+
+const char kTextPath[] = "training-bench.grt";
+const char kSetPath[] = "training-bench.espt";
+// Recordings appended before saving in place.
+const uint32_t kNumEdits = 10;
+// Recordings of class 1 trimmed, relabelled and erased (each).
+const uint32_t kNumClassEdits = 100;
+
+uint64_t getFileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// Whether `set` holds exactly `data`'s recordings, in order.
+bool isSame(const TrainingSet& set, GRT::TimeSeriesClassificationData& data) {
+    if (set.getNumSamples() != data.getNumSamples()) { return false; }
+    std::vector<uint32_t> ids = set.getSampleIds();
+    for (uint32_t i = 0; i < ids.size(); i++) {
+        const GRT::MatrixDouble& matrix = data[i].getData();
+        const uint32_t id = ids[i];
+        if (set.getClassLabel(id) != data[i].getClassLabel() ||
+            set.getNumRows(id) != matrix.getNumRows()) {
+            return false;
+        }
+        for (uint32_t d = 0; d < set.getNumDimensions(); d++) {
+            const double* column = set.getColumn(id, d);
+            for (uint32_t row = 0; row < set.getNumRows(id); row++) {
+                if (column[row] != matrix[row][d]) { return false; }
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    uint32_t num_recordings = 20000;
+    uint32_t num_rows = 100;
+    uint32_t num_dimensions = 3;
+    uint32_t num_classes = 9;
+
+    const struct option kOptions[] = {
+        { "recordings", required_argument, nullptr, 'n' },
+        { "rows", required_argument, nullptr, 'r' },
+        { "dimensions", required_argument, nullptr, 'd' },
+        { "classes", required_argument, nullptr, 'c' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "n:r:d:c:h", kOptions,
+                                 nullptr)) != -1) {
+        switch (option) {
+            case 'n': num_recordings = atoi(optarg); break;
+            case 'r': num_rows = atoi(optarg); break;
+            case 'd': num_dimensions = atoi(optarg); break;
+            case 'c': num_classes = atoi(optarg); break;
+            case 'h': std::cout << kUsage; return 0;
+            default: std::cerr << kUsage; return 2;
+        }
+    }
+    if (num_recordings < 3 * kNumClassEdits * num_classes || num_rows < 6 ||
+        num_dimensions == 0 || num_classes == 0) {
+        std::cerr << kUsage;
+        return 2;
+    }
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint32_t> length(num_rows / 2,
+                                                   num_rows * 3 / 2);
+    std::normal_distribution<double> value(0, 1);
+    GRT::TimeSeriesClassificationData data;
+    data.setNumDimensions(num_dimensions);
+    for (uint32_t i = 0; i < num_recordings + kNumEdits; i++) {
+        GRT::MatrixDouble recording(length(random), num_dimensions);
+        for (uint32_t row = 0; row < recording.getNumRows(); row++) {
+            for (uint32_t d = 0; d < num_dimensions; d++) {
+                recording[row][d] = value(random);
+            }
+        }
+        data.addSample(i % num_classes + 1, recording);
+    }
+    // The last kNumEdits recordings are appended later.
+    GRT::TimeSeriesClassificationData initial;
+    initial.setNumDimensions(num_dimensions);
+    for (uint32_t i = 0; i < num_recordings; i++) {
+        initial.addSample(data[i].getClassLabel(), data[i].getData());
+    }
+
+    TrainingSet set;
+    set.assign(initial);
+    int64_t start_ns = getMonotonicTimeNs();
+    bool ok = initial.save(kTextPath);
+    int64_t text_save_ns = getMonotonicTimeNs() - start_ns;
+    start_ns = getMonotonicTimeNs();
+    ok = set.save(kSetPath) && ok;
+    int64_t set_save_ns = getMonotonicTimeNs() - start_ns;
+    if (!ok) {
+        ofLog(OF_LOG_ERROR) << "Failed to save: " << set.getLastError();
+        return 1;
+    }
+
+    GRT::TimeSeriesClassificationData text;
+    start_ns = getMonotonicTimeNs();
+    ok = text.load(kTextPath);
+    int64_t text_load_ns = getMonotonicTimeNs() - start_ns;
+    TrainingSet loaded;
+    start_ns = getMonotonicTimeNs();
+    ok = loaded.load(kSetPath) && ok;
+    int64_t set_load_ns = getMonotonicTimeNs() - start_ns;
+    if (!ok) {
+        ofLog(OF_LOG_ERROR) << "Failed to load: " << loaded.getLastError();
+        return 1;
+    }
+    bool same = isSame(loaded, initial);
+
+    // Reads every value once, as training does.
+    start_ns = getMonotonicTimeNs();
+    double sum = 0;
+    for (uint32_t id : loaded.getSampleIds()) {
+        for (uint32_t d = 0; d < num_dimensions; d++) {
+            const double* column = loaded.getColumn(id, d);
+            for (uint32_t row = 0; row < loaded.getNumRows(id); row++) {
+                sum += column[row];
+            }
+        }
+    }
+    int64_t scan_ns = getMonotonicTimeNs() - start_ns;
+
+    // Edit class 1 as the app does: trim a row off both ends of some of its
+    // recordings, move others to the next class and erase others, keeping
+    // the expected result in GRT's data alongside.
+    const std::vector<uint32_t> ids = loaded.getClassSampleIds(1);
+    const uint32_t other_label = num_classes > 1 ? 2 : 1;
+    std::vector<GRT::MatrixDouble> expected_rows(num_recordings);
+    std::vector<uint32_t> expected_labels(num_recordings);
+    std::vector<bool> is_erased(num_recordings, false);
+    for (uint32_t i = 0; i < num_recordings; i++) {
+        expected_rows[i] = initial[i].getData();
+        expected_labels[i] = initial[i].getClassLabel();
+    }
+    start_ns = getMonotonicTimeNs();
+    for (uint32_t k = 0; k < kNumClassEdits; k++) {
+        ok = loaded.trim(ids[k], 1, loaded.getNumRows(ids[k]) - 2) && ok;
+    }
+    int64_t trim_ns = getMonotonicTimeNs() - start_ns;
+    start_ns = getMonotonicTimeNs();
+    for (uint32_t k = kNumClassEdits; k < 2 * kNumClassEdits; k++) {
+        loaded.setClassLabel(ids[k], other_label);
+    }
+    int64_t relabel_ns = getMonotonicTimeNs() - start_ns;
+    start_ns = getMonotonicTimeNs();
+    for (uint32_t k = 2 * kNumClassEdits; k < 3 * kNumClassEdits; k++) {
+        loaded.erase(ids[k]);
+    }
+    int64_t erase_ns = getMonotonicTimeNs() - start_ns;
+    // Loading numbers the samples in order, so IDs are indices into
+    // `initial`.
+    for (uint32_t k = 0; k < kNumClassEdits; k++) {
+        GRT::MatrixDouble trimmed;
+        GRT::MatrixDouble& rows = expected_rows[ids[k]];
+        for (uint32_t row = 1; row + 1 < rows.getNumRows(); row++) {
+            trimmed.push_back(rows.getRowVector(row));
+        }
+        rows = trimmed;
+        expected_labels[ids[kNumClassEdits + k]] = other_label;
+        is_erased[ids[2 * kNumClassEdits + k]] = true;
+    }
+    GRT::TimeSeriesClassificationData edited;
+    edited.setNumDimensions(num_dimensions);
+    for (uint32_t i = 0; i < num_recordings; i++) {
+        if (!is_erased[i]) {
+            edited.addSample(expected_labels[i], expected_rows[i]);
+        }
+    }
+
+    // Append the rest and save in place.
+    for (uint32_t i = num_recordings; i < num_recordings + kNumEdits; i++) {
+        loaded.append(data[i].getClassLabel(), data[i].getData());
+        edited.addSample(data[i].getClassLabel(), data[i].getData());
+    }
+    uint64_t size_before = getFileSize(kSetPath);
+    start_ns = getMonotonicTimeNs();
+    ok = loaded.save(kSetPath) && ok;
+    int64_t append_ns = getMonotonicTimeNs() - start_ns;
+    TrainingSet reloaded;
+    ok = ok && reloaded.load(kSetPath);
+    bool same_after_edits = ok && isSame(loaded, edited) &&
+                            isSame(reloaded, edited) &&
+                            loaded.getNumClassSamples(1) ==
+                                    reloaded.getNumClassSamples(1);
+
+    std::cout << num_recordings << " recordings of " << num_dimensions
+              << " dimensions (checksum " << sum << ")\n"
+              << "GRT text: " << getFileSize(kTextPath) << " bytes, saved in "
+              << formatDuration(text_save_ns) << ", loaded in "
+              << formatDuration(text_load_ns) << "\n"
+              << "Training set: " << size_before << " bytes, saved in "
+              << formatDuration(set_save_ns) << ", loaded in "
+              << formatDuration(set_load_ns) << " ("
+              << double(text_load_ns) / std::max<int64_t>(1, set_load_ns)
+              << "x), every value read in " << formatDuration(scan_ns)
+              << "; loads back " << (same ? "the same" : "DIFFERENT")
+              << " recordings\n"
+              << "Editing " << ids.size() << " recordings of class 1: trim "
+              << formatDuration(trim_ns / kNumClassEdits) << ", relabel "
+              << formatDuration(relabel_ns / kNumClassEdits) << ", erase "
+              << formatDuration(erase_ns / kNumClassEdits) << " each\n"
+              << "Appending " << kNumEdits << " after the edits: saved in "
+              << "place in " << formatDuration(append_ns) << ", "
+              << getFileSize(kSetPath) << " bytes; loads back "
+              << (same_after_edits ? "the same" : "DIFFERENT")
+              << " recordings\n";
+    remove(kTextPath);
+    remove(kSetPath);
+    return same && same_after_edits ? 0 : 1;
+}
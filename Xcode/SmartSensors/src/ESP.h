@@ -2,7 +2,12 @@
 
 #include "GRT/GRT.h"
 #include "calibrator.h"
+#include "clocked_timeout_filter.h"
+#include "fast_anbc.h"
 #include "istream.h"
+#include "kd_tree_knn.h"
 #include "ostream.h"
+#include "pruned_dtw.h"
+#include "tuneable.h"
 
 using namespace GRT;
@@ -0,0 +1,180 @@
+#include "ascii_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Powers of ten that are exactly representable as doubles.
+const double kExactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+const int kMaxExactPowerOfTen = 22;
+
+// Mantissas below 2^53 convert to double exactly.
+const uint64_t kMaxExactMantissa = 1ULL << 53;
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == ','; }
+
+}  // namespace
+
+ASCIILineParser::ASCIILineParser(uint32_t num_dimensions, size_t chunk_size,
+                                 size_t max_line_length)
+        : num_dimensions_(num_dimensions),
+          chunk_size_(chunk_size),
+          max_line_length_(max_line_length),
+          buffer_(chunk_size + max_line_length),
+          size_(0),
+          // The shortest possible line is "0\n"; size for a buffer full of them.
+          rows_(((chunk_size + max_line_length) / 2 + 1) * num_dimensions),
+          num_rows_(0),
+          discarding_(false),
+          num_malformed_lines_(0) {
+}
+
+char* ASCIILineParser::prepare(size_t* capacity) {
+    if (size_ > max_line_length_) {
+        // A partial line longer than any sane sample: drop it, and the rest
+        // of it up to the next newline.
+        num_malformed_lines_++;
+        size_ = 0;
+        discarding_ = true;
+    }
+    *capacity = chunk_size_;
+    return &buffer_[size_];
+}
+
+void ASCIILineParser::commit(size_t size) {
+    size_ += size;
+}
+
+uint32_t ASCIILineParser::parse() {
+    num_rows_ = 0;
+
+    const char* begin = buffer_.data();
+    const char* end = begin + size_;
+    const char* line = begin;
+    if (discarding_) {
+        const char* newline = static_cast<const char*>(
+            memchr(line, '\n', end - line));
+        if (newline == nullptr) {
+            size_ = 0;
+            return 0;
+        }
+        discarding_ = false;
+        line = newline + 1;
+    }
+    for (;;) {
+        const char* newline = static_cast<const char*>(
+            memchr(line, '\n', end - line));
+        if (newline == nullptr) { break; }
+
+        if (newline != line) {
+            if (parseLine(line, newline, &rows_[num_rows_ * num_dimensions_])) {
+                num_rows_++;
+            } else {
+                num_malformed_lines_++;
+            }
+        }
+        line = newline + 1;
+    }
+
+    // Carry the partial line over to the front of the buffer.
+    size_ = end - line;
+    if (size_ > 0 && line != begin) {
+        memmove(buffer_.data(), line, size_);
+    }
+    return num_rows_;
+}
+
+bool ASCIILineParser::parseLine(const char* begin, const char* end, double* row) {
+    const char* p = begin;
+    uint32_t n = 0;
+    double value;
+    while (parseDouble(p, end, &value)) {
+        if (n == num_dimensions_) { return false; }
+        row[n++] = value;
+    }
+    while (p < end && isBlank(*p)) { p++; }
+    return n == num_dimensions_ && p == end;
+}
+
+bool ASCIILineParser::parseDouble(const char*& p, const char* end, double* value) {
+    while (p < end && isBlank(*p)) { p++; }
+    const char* start = p;
+    const char* q = p;
+
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        q++;
+    }
+
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; q < end && isDigit(*q); q++) {
+        any_digit = true;
+        if (num_digits < 19) {
+            mantissa = mantissa * 10 + (*q - '0');
+            if (mantissa != 0) { num_digits++; }
+        } else {
+            exponent++;
+        }
+    }
+    if (q < end && *q == '.') {
+        q++;
+        for (; q < end && isDigit(*q); q++) {
+            any_digit = true;
+            if (num_digits < 19) {
+                mantissa = mantissa * 10 + (*q - '0');
+                if (mantissa != 0) { num_digits++; }
+                exponent--;
+            }
+        }
+    }
+    if (!any_digit) { return false; }
+
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        const char* e = q + 1;
+        bool negative_exponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negative_exponent = (*e == '-');
+            e++;
+        }
+        if (e < end && isDigit(*e)) {
+            int explicit_exponent = 0;
+            for (; e < end && isDigit(*e); e++) {
+                if (explicit_exponent < 10000) {
+                    explicit_exponent = explicit_exponent * 10 + (*e - '0');
+                }
+            }
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            q = e;
+        }
+    }
+
+    // Fast path: an exact mantissa scaled by an exact power of ten is correctly
+    // rounded. This covers everything Serial.print() produces.
+    if (mantissa < kMaxExactMantissa &&
+        exponent >= -kMaxExactPowerOfTen && exponent <= kMaxExactPowerOfTen) {
+        double d = static_cast<double>(mantissa);
+        d = exponent < 0 ? d / kExactPowersOfTen[-exponent]
+                         : d * kExactPowersOfTen[exponent];
+        *value = negative ? -d : d;
+    } else {
+        // Rare: defer to strtod on a NUL-terminated copy.
+        char copy[64];
+        size_t length = q - start;
+        if (length >= sizeof(copy)) { return false; }
+        memcpy(copy, start, length);
+        copy[length] = '\0';
+        *value = strtod(copy, nullptr);
+    }
+
+    p = q;
+    return true;
+}
@@ -0,0 +1,76 @@
+/*
+ * ASCIILineParser turns a stream of whitespace-separated numbers, one sample
+ * per line (as printed by our Arduino sketches), into rows of doubles without
+ * allocating per line.
+ *
+ * ASCIILineParser parser(3);
+ * while (...) {
+ *     size_t capacity;
+ *     char* dest = parser.prepare(&capacity);
+ *     parser.commit(read(fd, dest, capacity));
+ *     for (uint32_t i = 0; i < parser.parse(); i++) use(parser.getRow(i));
+ * }
+ *
+ * Bytes are read straight into the parser's buffer, lines are split in place
+ * and numbers are converted into pre-allocated row storage. A trailing partial
+ * line is kept for the next chunk.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ASCIILineParser {
+  public:
+    // `max_line_length` bounds the size of a partial line that is carried over
+    // between chunks; longer lines are discarded as malformed, up to and
+    // including their newline.
+    explicit ASCIILineParser(uint32_t num_dimensions,
+                             size_t chunk_size = 4096,
+                             size_t max_line_length = 1024);
+
+    // Returns where the next chunk of bytes should be written and, in
+    // `capacity`, how many bytes may be written there.
+    char* prepare(size_t* capacity);
+
+    // Marks `size` bytes written at prepare() as valid.
+    void commit(size_t size);
+
+    // Parses all complete lines received so far and returns how many rows were
+    // produced. Rows stay valid until the next call to prepare().
+    uint32_t parse();
+
+    uint32_t getNumDimensions() const { return num_dimensions_; }
+    uint32_t getNumRows() const { return num_rows_; }
+    const double* getRow(uint32_t i) const { return &rows_[i * num_dimensions_]; }
+    double* getRow(uint32_t i) { return &rows_[i * num_dimensions_]; }
+
+    // Lines that did not contain exactly getNumDimensions() numbers, or that
+    // exceeded the maximum line length.
+    uint64_t getNumMalformedLines() const { return num_malformed_lines_; }
+
+    // Parses one number starting at `p` (leading spaces/tabs are skipped) and
+    // advances `p` past it. Returns false if no number starts at `p`. Exposed
+    // for reuse by other text protocols.
+    static bool parseDouble(const char*& p, const char* end, double* value);
+
+  private:
+    bool parseLine(const char* begin, const char* end, double* row);
+
+    const uint32_t num_dimensions_;
+    const size_t chunk_size_;
+    const size_t max_line_length_;
+
+    // buffer_[0, size_) holds unparsed bytes; parsing starts at the beginning.
+    std::vector<char> buffer_;
+    size_t size_;
+
+    std::vector<double> rows_;
+    uint32_t num_rows_;
+
+    // Whether the rest of an over-long line is still to be skipped.
+    bool discarding_;
+
+    uint64_t num_malformed_lines_;
+};
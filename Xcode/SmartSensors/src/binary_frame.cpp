@@ -0,0 +1,117 @@
+#include "binary_frame.h"
+
+#include <cstring>
+
+namespace {
+
+inline uint16_t readUInt16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline float readFloat(const uint8_t* p) {
+    uint32_t bits = static_cast<uint32_t>(p[0]) |
+            (static_cast<uint32_t>(p[1]) << 8) |
+            (static_cast<uint32_t>(p[2]) << 16) |
+            (static_cast<uint32_t>(p[3]) << 24);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+}  // namespace
+
+const uint32_t BinaryFrameDecoder::kMaxValues;
+const size_t BinaryFrameDecoder::kMaxRawSize;
+const size_t BinaryFrameDecoder::kMaxEncodedSize;
+
+BinaryFrameDecoder::BinaryFrameDecoder(uint32_t num_dimensions)
+        : num_dimensions_(num_dimensions),
+          decoded_(kMaxEncodedSize),
+          overflowed_(false),
+          values_(num_dimensions),
+          has_sequence_(false),
+          last_sequence_(0),
+          num_frames_(0),
+          num_corrupt_frames_(0),
+          num_lost_frames_(0) {
+    encoded_.reserve(kMaxEncodedSize);
+}
+
+void BinaryFrameDecoder::countCorrupt() {
+    num_corrupt_frames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BinaryFrameDecoder::finishFrame() {
+    if (encoded_.empty()) { return false; }  // back-to-back delimiters
+
+    bool overflowed = overflowed_;
+    overflowed_ = false;
+    int size = overflowed ? -1 : cobsDecode(encoded_.data(), encoded_.size(),
+                                            decoded_.data());
+    encoded_.clear();
+
+    if (size < 5) {
+        countCorrupt();
+        return false;
+    }
+
+    const uint8_t* frame = decoded_.data();
+    if (crc16(frame, size - 2) != readUInt16(frame + size - 2)) {
+        countCorrupt();
+        return false;
+    }
+
+    uint8_t sequence = frame[0];
+    uint8_t type = frame[1];
+    uint8_t count = frame[2];
+    uint32_t value_size = (type == FLOAT) ? 4 : 2;
+    if (type > FLOAT || count != num_dimensions_ ||
+        static_cast<uint32_t>(size) != 3 + count * value_size + 2) {
+        countCorrupt();
+        return false;
+    }
+
+    // The CRC passed, so the sequence number is trustworthy.
+    if (has_sequence_) {
+        uint8_t expected = last_sequence_ + 1;
+        num_lost_frames_.fetch_add(static_cast<uint8_t>(sequence - expected),
+                                   std::memory_order_relaxed);
+    }
+    has_sequence_ = true;
+    last_sequence_ = sequence;
+
+    const uint8_t* p = frame + 3;
+    for (uint32_t i = 0; i < count; i++, p += value_size) {
+        switch (type) {
+            case INT16: values_[i] = static_cast<int16_t>(readUInt16(p)); break;
+            case UINT16: values_[i] = readUInt16(p); break;
+            case FLOAT: values_[i] = readFloat(p); break;
+        }
+    }
+    num_frames_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+uint16_t BinaryFrameDecoder::crc16(const uint8_t* data, size_t size) {
+    uint16_t crc = 0xFFFF;
+    while (size--) {
+        crc ^= static_cast<uint16_t>(*data++) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+int BinaryFrameDecoder::cobsDecode(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t read = 0;
+    size_t written = 0;
+    while (read < size) {
+        uint8_t code = in[read++];
+        if (code == 0 || read + code - 1 > size) { return -1; }
+        for (uint8_t i = 1; i < code; i++) { out[written++] = in[read++]; }
+        // A zero follows every block except 0xFF blocks and the last block.
+        if (code != 0xFF && read < size) { out[written++] = 0; }
+    }
+    return static_cast<int>(written);
+}
@@ -0,0 +1,81 @@
+/*
+ * BinaryFrameDecoder decodes the framed binary protocol emitted by the ESPFrame
+ * Arduino library (Arduino/libraries/ESPFrame) into rows of doubles.
+ *
+ * Each frame is COBS-encoded and terminated by a 0x00 byte. Decoded, it is
+ *
+ *   uint8  sequence, uint8 type, uint8 count, count values, uint16 crc
+ *
+ * with little-endian int16/uint16/float values and a CRC-16/CCITT-FALSE over
+ * everything before the crc. Frames that fail the CRC, are malformed, or carry
+ * the wrong number of values are dropped and counted; gaps in the sequence
+ * number are counted as lost frames.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BinaryFrameDecoder {
+  public:
+    enum ValueType { INT16 = 0, UINT16 = 1, FLOAT = 2 };
+
+    static const uint32_t kMaxValues = 32;
+
+    explicit BinaryFrameDecoder(uint32_t num_dimensions);
+
+    // Consumes `size` bytes and calls `on_frame(const double* values)` with
+    // getNumDimensions() values for every valid frame completed by them.
+    template<typename F>
+    void feed(const uint8_t* data, size_t size, F on_frame) {
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != 0) {
+                if (encoded_.size() < kMaxEncodedSize) {
+                    encoded_.push_back(data[i]);
+                } else {
+                    overflowed_ = true;
+                }
+                continue;
+            }
+            if (finishFrame()) { on_frame(values_.data()); }
+        }
+    }
+
+    uint32_t getNumDimensions() const { return num_dimensions_; }
+
+    uint64_t getNumFrames() const { return num_frames_.load(std::memory_order_relaxed); }
+    uint64_t getNumCorruptFrames() const { return num_corrupt_frames_.load(std::memory_order_relaxed); }
+    uint64_t getNumLostFrames() const { return num_lost_frames_.load(std::memory_order_relaxed); }
+
+    static uint16_t crc16(const uint8_t* data, size_t size);
+
+    // Decodes COBS `in` into `out` (which may alias `in`); returns the decoded
+    // size, or -1 if `in` is not valid COBS.
+    static int cobsDecode(const uint8_t* in, size_t size, uint8_t* out);
+
+  private:
+    // sequence + type + count + largest payload + crc, COBS overhead.
+    static const size_t kMaxRawSize = 3 + kMaxValues * 4 + 2;
+    static const size_t kMaxEncodedSize = kMaxRawSize + kMaxRawSize / 254 + 1;
+
+    // Decodes the bytes accumulated since the last delimiter into values_.
+    bool finishFrame();
+    void countCorrupt();
+
+    const uint32_t num_dimensions_;
+    std::vector<uint8_t> encoded_;
+    // The frame finishFrame() is parsing; COBS never grows, so it is sized
+    // for the largest encoded_ once.
+    std::vector<uint8_t> decoded_;
+    bool overflowed_;
+    std::vector<double> values_;
+
+    bool has_sequence_;
+    uint8_t last_sequence_;
+
+    std::atomic<uint64_t> num_frames_;
+    std::atomic<uint64_t> num_corrupt_frames_;
+    std::atomic<uint64_t> num_lost_frames_;
+};
@@ -1,7 +1,7 @@
-#include "ofApp.h"
+#include "calibrator.h"
 
-#include "Calibrator.h"
+#include "runtime.h"
 
 void useCalibrator(Calibrator &calibrator) {
-    ((ofApp *) ofGetAppPtr())->useCalibrator(calibrator);
+    getRuntime()->useCalibrator(calibrator);
 }
@@ -3,10 +3,11 @@
 #include <string>
 
 #include <GRT/GRT.h>
+#include "of_shim.h"
 
 class CalibrateProcess {
   public:
-    typedef void (*CalibratorCallback)(const MatrixDouble&);
+    typedef void (*CalibratorCallback)(const GRT::MatrixDouble&);
 
     CalibrateProcess(std::string name, std::string description, CalibratorCallback cb)
             : name_(name), description_(description), cb_(cb), is_calibrated_(false) {}
@@ -44,11 +45,13 @@ class Calibrator {
     Calibrator& setCalibrateFunction(CalibrateFunc f) {
         simple_calibrate_func_ = nullptr;
         calibrate_func_ = f;
+        return *this;
     }
 
     Calibrator& setCalibrateFunction(SimpleCalibrateFunc f) {
         simple_calibrate_func_ = f;
         calibrate_func_ = nullptr;
+        return *this;
     }
 
     Calibrator& addCalibrateProcess(CalibrateProcess cp) {
@@ -0,0 +1,184 @@
+#include "clocked_timeout_filter.h"
+
+#include <algorithm>
+
+#include "sample_clock.h"
+
+using namespace GRT;
+
+RegisterPostProcessingModule<ClockedClassLabelTimeoutFilter>
+        ClockedClassLabelTimeoutFilter::registerModule(
+                "ClockedClassLabelTimeoutFilter");
+
+ClockedClassLabelTimeoutFilter::ClockedClassLabelTimeoutFilter(
+        unsigned long timeout_ms, UINT filter_mode)
+        : timeout_ms_(timeout_ms),
+          filter_mode_(filter_mode),
+          filtered_class_label_(0) {
+    postProcessingType = "ClockedClassLabelTimeoutFilter";
+    postProcessingInputMode = INPUT_MODE_PREDICTED_CLASS_LABEL;
+    postProcessingOutputMode = OUTPUT_MODE_PREDICTED_CLASS_LABEL;
+    debugLog.setProceedingText("[DEBUG ClockedClassLabelTimeoutFilter]");
+    errorLog.setProceedingText("[ERROR ClockedClassLabelTimeoutFilter]");
+    warningLog.setProceedingText("[WARNING ClockedClassLabelTimeoutFilter]");
+    init();
+}
+
+ClockedClassLabelTimeoutFilter::ClockedClassLabelTimeoutFilter(
+        const ClockedClassLabelTimeoutFilter& rhs)
+        : ClockedClassLabelTimeoutFilter(rhs.timeout_ms_, rhs.filter_mode_) {
+    copyBaseVariables(&rhs);
+}
+
+ClockedClassLabelTimeoutFilter& ClockedClassLabelTimeoutFilter::operator=(
+        const ClockedClassLabelTimeoutFilter& rhs) {
+    if (this != &rhs) {
+        timeout_ms_ = rhs.timeout_ms_;
+        filter_mode_ = rhs.filter_mode_;
+        copyBaseVariables(&rhs);
+        init();
+    }
+    return *this;
+}
+
+bool ClockedClassLabelTimeoutFilter::deepCopyFrom(
+        const PostProcessing* post_processing) {
+    if (post_processing == nullptr) { return false; }
+    if (getPostProcessingType() != post_processing->getPostProcessingType()) {
+        errorLog << "deepCopyFrom(const PostProcessing *postProcessing) - "
+                 << "PostProcessing Types Do Not Match!" << endl;
+        return false;
+    }
+    const ClockedClassLabelTimeoutFilter* rhs =
+            static_cast<const ClockedClassLabelTimeoutFilter*>(post_processing);
+    timeout_ms_ = rhs->timeout_ms_;
+    filter_mode_ = rhs->filter_mode_;
+    copyBaseVariables(post_processing);
+    return init();
+}
+
+bool ClockedClassLabelTimeoutFilter::init() {
+    initialized = false;
+    numInputDimensions = 1;
+    numOutputDimensions = 1;
+    processedData.clear();
+    processedData.resize(1, 0);
+    filtered_class_label_ = 0;
+    timeouts_.clear();
+    initialized = true;
+    return true;
+}
+
+bool ClockedClassLabelTimeoutFilter::process(const VectorDouble& input) {
+    if (!initialized) {
+        errorLog << "process(const VectorDouble &inputVector) - Not initialized!"
+                 << endl;
+        return false;
+    }
+    if (input.size() != numInputDimensions) {
+        errorLog << "process(const VectorDouble &inputVector) - The size of the "
+                 << "inputVector (" << input.size() << ") does not match that "
+                 << "of the filter (" << numInputDimensions << ")!" << endl;
+        return false;
+    }
+    processedData[0] = filter(static_cast<UINT>(input[0]));
+    return true;
+}
+
+bool ClockedClassLabelTimeoutFilter::reset() {
+    return init();
+}
+
+UINT ClockedClassLabelTimeoutFilter::filter(UINT predicted_class_label) {
+    int64_t now_ns = getSampleTimeNs();
+
+    // Forget every label whose timeout has expired.
+    timeouts_.erase(std::remove_if(timeouts_.begin(), timeouts_.end(),
+                                   [now_ns](const Timeout& t) {
+                                       return now_ns >= t.expires_ns;
+                                   }),
+                    timeouts_.end());
+
+    filtered_class_label_ = 0;
+    if (predicted_class_label == 0) { return 0; }
+
+    bool suppressed;
+    if (filter_mode_ == ALL_CLASS_LABELS) {
+        suppressed = !timeouts_.empty();
+    } else {
+        suppressed = std::any_of(timeouts_.begin(), timeouts_.end(),
+                                 [predicted_class_label](const Timeout& t) {
+                                     return t.class_label == predicted_class_label;
+                                 });
+    }
+    if (suppressed) { return 0; }
+
+    Timeout timeout;
+    timeout.class_label = predicted_class_label;
+    timeout.expires_ns = now_ns + static_cast<int64_t>(timeout_ms_) * 1000000;
+    timeouts_.push_back(timeout);
+    filtered_class_label_ = predicted_class_label;
+    return filtered_class_label_;
+}
+
+bool ClockedClassLabelTimeoutFilter::setTimeoutDuration(unsigned long timeout_ms) {
+    timeout_ms_ = timeout_ms;
+    return init();
+}
+
+bool ClockedClassLabelTimeoutFilter::setFilterMode(UINT filter_mode) {
+    if (filter_mode != ALL_CLASS_LABELS &&
+        filter_mode != INDEPENDENT_CLASS_LABELS) {
+        return false;
+    }
+    filter_mode_ = filter_mode;
+    return init();
+}
+
+bool ClockedClassLabelTimeoutFilter::saveModelToFile(fstream& file) const {
+    if (!file.is_open()) {
+        errorLog << "saveModelToFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    file << "GRT_CLOCKED_CLASS_LABEL_TIMEOUT_FILTER_FILE_V1.0" << endl;
+    file << "NumInputDimensions: " << numInputDimensions << endl;
+    file << "NumOutputDimensions: " << numOutputDimensions << endl;
+    file << "TimeoutDuration: " << timeout_ms_ << endl;
+    file << "FilterMode: " << filter_mode_ << endl;
+    return true;
+}
+
+bool ClockedClassLabelTimeoutFilter::loadModelFromFile(fstream& file) {
+    if (!file.is_open()) {
+        errorLog << "loadModelFromFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+
+    string word;
+    file >> word;
+    if (word != "GRT_CLOCKED_CLASS_LABEL_TIMEOUT_FILTER_FILE_V1.0") {
+        errorLog << "loadModelFromFile(fstream &file) - Invalid file format!"
+                 << endl;
+        return false;
+    }
+
+    // Each setting is a "Name: value" pair.
+    const char* const kSettings[] = { "NumInputDimensions:",
+                                      "NumOutputDimensions:",
+                                      "TimeoutDuration:",
+                                      "FilterMode:" };
+    unsigned long values[4];
+    for (int i = 0; i < 4; i++) {
+        file >> word;
+        if (word != kSettings[i] || !(file >> values[i])) {
+            errorLog << "loadModelFromFile(fstream &file) - Failed to read "
+                     << kSettings[i] << endl;
+            return false;
+        }
+    }
+    timeout_ms_ = values[2];
+    filter_mode_ = static_cast<UINT>(values[3]);
+    return init();
+}
@@ -0,0 +1,63 @@
+/*
+ * ClockedClassLabelTimeoutFilter is a drop-in replacement for GRT's
+ * ClassLabelTimeoutFilter that measures the timeout on the sample clock (see
+ * sample_clock.h) instead of the wall clock. GRT's filter starts a real timer
+ * when a label is emitted, so its output depends on how fast samples are
+ * processed: replaying a session faster than real time (or running the
+ * pipeline over recorded test data) suppresses far more labels than the live
+ * run did. Measured on sample timestamps, the filter gives the same result at
+ * any playback speed.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GRT/GRT.h"
+
+class ClockedClassLabelTimeoutFilter : public GRT::PostProcessing {
+  public:
+    // ALL_CLASS_LABELS: after a label is emitted, every label is suppressed
+    // until the timeout expires. INDEPENDENT_CLASS_LABELS: only the label that
+    // was emitted is suppressed.
+    enum FilterModes { ALL_CLASS_LABELS = 0, INDEPENDENT_CLASS_LABELS };
+
+    ClockedClassLabelTimeoutFilter(unsigned long timeout_ms = 1000,
+                                   GRT::UINT filter_mode = ALL_CLASS_LABELS);
+    ClockedClassLabelTimeoutFilter(const ClockedClassLabelTimeoutFilter& rhs);
+    virtual ~ClockedClassLabelTimeoutFilter() {}
+
+    ClockedClassLabelTimeoutFilter& operator=(
+            const ClockedClassLabelTimeoutFilter& rhs);
+
+    virtual bool deepCopyFrom(const PostProcessing* post_processing);
+    virtual bool process(const GRT::VectorDouble& input);
+    virtual bool reset();
+    virtual bool saveModelToFile(std::fstream& file) const;
+    virtual bool loadModelFromFile(std::fstream& file);
+
+    // Filters one predicted class label, returning it if it may pass or 0.
+    GRT::UINT filter(GRT::UINT predicted_class_label);
+
+    bool setTimeoutDuration(unsigned long timeout_ms);
+    bool setFilterMode(GRT::UINT filter_mode);
+    GRT::UINT getFilteredClassLabel() const { return filtered_class_label_; }
+
+  private:
+    struct Timeout {
+        GRT::UINT class_label;
+        int64_t expires_ns;
+    };
+
+    bool init();
+
+    unsigned long timeout_ms_;
+    GRT::UINT filter_mode_;
+    GRT::UINT filtered_class_label_;
+    // Labels emitted and still in their timeout. Holds at most one entry in
+    // ALL_CLASS_LABELS mode.
+    std::vector<Timeout> timeouts_;
+
+    static GRT::RegisterPostProcessingModule<ClockedClassLabelTimeoutFilter>
+            registerModule;
+};
@@ -0,0 +1,323 @@
+#include "fast_anbc.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FAST_ANBC_NEON 1
+#endif
+
+using namespace GRT;
+
+RegisterClassifierModule<FastANBC> FastANBC::registerModule("FastANBC");
+
+namespace {
+
+const double kLogSqrtTwoPi = 0.5 * std::log(2 * M_PI);
+
+// out[k] = offsets[k] - sum_j precisions[j][k] * (x[j] - means[j][k])^2 for
+// every lane k; num_lanes is a multiple of FastANBC::kLaneWidth.
+void evaluate(const float* x, uint32_t num_dimensions, uint32_t num_lanes,
+              const float* means, const float* precisions,
+              const float* offsets, float* out) {
+#if defined(__AVX__)
+    for (uint32_t k = 0; k < num_lanes; k += 8) {
+        __m256 sum = _mm256_loadu_ps(offsets + k);
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            const uint32_t i = j * num_lanes + k;
+            __m256 d = _mm256_sub_ps(_mm256_set1_ps(x[j]),
+                                     _mm256_loadu_ps(means + i));
+            sum = _mm256_sub_ps(sum, _mm256_mul_ps(_mm256_mul_ps(d, d),
+                                                   _mm256_loadu_ps(precisions + i)));
+        }
+        _mm256_storeu_ps(out + k, sum);
+    }
+#elif defined(__SSE2__)
+    for (uint32_t k = 0; k < num_lanes; k += 8) {
+        __m128 sum_lo = _mm_loadu_ps(offsets + k);
+        __m128 sum_hi = _mm_loadu_ps(offsets + k + 4);
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            const uint32_t i = j * num_lanes + k;
+            __m128 xj = _mm_set1_ps(x[j]);
+            __m128 d_lo = _mm_sub_ps(xj, _mm_loadu_ps(means + i));
+            __m128 d_hi = _mm_sub_ps(xj, _mm_loadu_ps(means + i + 4));
+            sum_lo = _mm_sub_ps(sum_lo, _mm_mul_ps(_mm_mul_ps(d_lo, d_lo),
+                                                   _mm_loadu_ps(precisions + i)));
+            sum_hi = _mm_sub_ps(sum_hi, _mm_mul_ps(_mm_mul_ps(d_hi, d_hi),
+                                                   _mm_loadu_ps(precisions + i + 4)));
+        }
+        _mm_storeu_ps(out + k, sum_lo);
+        _mm_storeu_ps(out + k + 4, sum_hi);
+    }
+#elif defined(FAST_ANBC_NEON)
+    for (uint32_t k = 0; k < num_lanes; k += 8) {
+        float32x4_t sum_lo = vld1q_f32(offsets + k);
+        float32x4_t sum_hi = vld1q_f32(offsets + k + 4);
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            const uint32_t i = j * num_lanes + k;
+            float32x4_t xj = vdupq_n_f32(x[j]);
+            float32x4_t d_lo = vsubq_f32(xj, vld1q_f32(means + i));
+            float32x4_t d_hi = vsubq_f32(xj, vld1q_f32(means + i + 4));
+            sum_lo = vmlsq_f32(sum_lo, vmulq_f32(d_lo, d_lo),
+                               vld1q_f32(precisions + i));
+            sum_hi = vmlsq_f32(sum_hi, vmulq_f32(d_hi, d_hi),
+                               vld1q_f32(precisions + i + 4));
+        }
+        vst1q_f32(out + k, sum_lo);
+        vst1q_f32(out + k + 4, sum_hi);
+    }
+#else
+    for (uint32_t k = 0; k < num_lanes; k++) { out[k] = offsets[k]; }
+    for (uint32_t j = 0; j < num_dimensions; j++) {
+        const float* mean = means + j * num_lanes;
+        const float* precision = precisions + j * num_lanes;
+        for (uint32_t k = 0; k < num_lanes; k++) {
+            float d = x[j] - mean[k];
+            out[k] -= precision[k] * d * d;
+        }
+    }
+#endif
+}
+
+}  // namespace
+
+FastANBC::FastANBC(bool use_scaling, bool use_null_rejection,
+                   double null_rejection_coeff)
+        : num_lanes_(0) {
+    useScaling = use_scaling;
+    useNullRejection = use_null_rejection;
+    nullRejectionCoeff = null_rejection_coeff;
+    supportsNullRejection = true;
+    classifierType = "FastANBC";
+    classifierMode = STANDARD_CLASSIFIER_MODE;
+    debugLog.setProceedingText("[DEBUG FastANBC]");
+    errorLog.setProceedingText("[ERROR FastANBC]");
+    trainingLog.setProceedingText("[TRAINING FastANBC]");
+    warningLog.setProceedingText("[WARNING FastANBC]");
+}
+
+FastANBC::FastANBC(const FastANBC& rhs) : FastANBC() {
+    *this = rhs;
+}
+
+FastANBC& FastANBC::operator=(const FastANBC& rhs) {
+    if (this != &rhs) {
+        anbc_ = rhs.anbc_;
+        num_lanes_ = rhs.num_lanes_;
+        means_ = rhs.means_;
+        precisions_ = rhs.precisions_;
+        offsets_ = rhs.offsets_;
+        input_ = rhs.input_;
+        log_likelihoods_ = rhs.log_likelihoods_;
+        copyBaseVariables(&rhs);
+    }
+    return *this;
+}
+
+bool FastANBC::deepCopyFrom(const Classifier* classifier) {
+    if (classifier == nullptr) { return false; }
+    if (classifierType != classifier->getClassifierType()) {
+        errorLog << "deepCopyFrom(const Classifier *classifier) - "
+                 << "Classifier Types Do Not Match!" << endl;
+        return false;
+    }
+    *this = *static_cast<const FastANBC*>(classifier);
+    return true;
+}
+
+bool FastANBC::train_(ClassificationData& training_data) {
+    clear();
+    anbc_ = ANBC(useScaling, useNullRejection, nullRejectionCoeff);
+    if (!anbc_.train_(training_data)) {
+        errorLog << "train_(ClassificationData &trainingData) - Failed to "
+                 << "train the ANBC model" << endl;
+        return false;
+    }
+    return init();
+}
+
+bool FastANBC::predict_(VectorDouble& input) {
+    if (!trained) {
+        errorLog << "predict_(VectorDouble &inputVector) - The model has not "
+                 << "been trained!" << endl;
+        return false;
+    }
+    if (input.size() != numInputDimensions) {
+        errorLog << "predict_(VectorDouble &inputVector) - The size of the "
+                 << "input vector (" << input.size() << ") does not match the "
+                 << "number of input dimensions (" << numInputDimensions << ")"
+                 << endl;
+        return false;
+    }
+
+    std::copy(input.begin(), input.end(), input_.begin());
+    evaluate(input_.data(), numInputDimensions, num_lanes_, means_.data(),
+             precisions_.data(), offsets_.data(), log_likelihoods_.data());
+
+    // Ties go to the first class, as in GRT.
+    uint32_t best = 0;
+    for (uint32_t k = 1; k < numClasses; k++) {
+        if (log_likelihoods_[k] > log_likelihoods_[best]) { best = k; }
+    }
+    double max_log_likelihood = log_likelihoods_[best];
+    double sum = 0;
+    for (uint32_t k = 0; k < numClasses; k++) {
+        classDistances[k] = log_likelihoods_[k];
+        classLikelihoods[k] = std::exp(classDistances[k] - max_log_likelihood);
+        sum += classLikelihoods[k];
+    }
+    for (uint32_t k = 0; k < numClasses; k++) { classLikelihoods[k] /= sum; }
+
+    maxLikelihood = classLikelihoods[best];
+    bestDistance = max_log_likelihood;
+    predictedClassLabel = classLabels[best];
+    if (useNullRejection && max_log_likelihood < nullRejectionThresholds[best]) {
+        predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    }
+    return true;
+}
+
+bool FastANBC::clear() {
+    Classifier::clear();
+    anbc_.clear();
+    num_lanes_ = 0;
+    means_.clear();
+    precisions_.clear();
+    offsets_.clear();
+    input_.clear();
+    log_likelihoods_.clear();
+    return true;
+}
+
+bool FastANBC::recomputeNullRejectionThresholds() {
+    if (!trained) { return false; }
+    anbc_.setNullRejectionCoeff(nullRejectionCoeff);
+    if (!anbc_.recomputeNullRejectionThresholds()) { return false; }
+    nullRejectionThresholds = anbc_.getNullRejectionThresholds();
+    return true;
+}
+
+bool FastANBC::setNullRejectionCoeff(double null_rejection_coeff) {
+    if (null_rejection_coeff <= 0) { return false; }
+    nullRejectionCoeff = null_rejection_coeff;
+    if (trained) { recomputeNullRejectionThresholds(); }
+    return true;
+}
+
+bool FastANBC::saveModelToFile(fstream& file) const {
+    if (!file.is_open()) {
+        errorLog << "saveModelToFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    file << "GRT_FAST_ANBC_MODEL_FILE_V1.0" << endl;
+    if (!trained) {
+        // An untrained ANBC would not remember the settings.
+        ANBC settings(useScaling, useNullRejection, nullRejectionCoeff);
+        return settings.saveModelToFile(file);
+    }
+    return anbc_.saveModelToFile(file);
+}
+
+bool FastANBC::loadModelFromFile(fstream& file) {
+    if (!file.is_open()) {
+        errorLog << "loadModelFromFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    clear();
+
+    string word;
+    file >> word;
+    if (word != "GRT_FAST_ANBC_MODEL_FILE_V1.0") {
+        errorLog << "loadModelFromFile(fstream &file) - Invalid file format!"
+                 << endl;
+        return false;
+    }
+    if (!anbc_.loadModelFromFile(file)) {
+        errorLog << "loadModelFromFile(fstream &file) - Failed to read the "
+                 << "ANBC model" << endl;
+        return false;
+    }
+    useScaling = anbc_.getScalingEnabled();
+    useNullRejection = anbc_.getNullRejectionEnabled();
+    nullRejectionCoeff = anbc_.getNullRejectionCoeff();
+    return anbc_.getTrained() ? init() : true;
+}
+
+const char* FastANBC::getKernelName() {
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(__SSE2__)
+    return "SSE2";
+#elif defined(FAST_ANBC_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+bool FastANBC::init() {
+    numInputDimensions = anbc_.getNumInputDimensions();
+    numClasses = anbc_.getNumClasses();
+    classLabels = anbc_.getClassLabels();
+    ranges = anbc_.getRanges();
+    nullRejectionThresholds = anbc_.getNullRejectionThresholds();
+    vector<ANBC_Model> models = anbc_.getModels();
+    if (models.size() != numClasses) {
+        errorLog << "init() - The ANBC model has " << models.size()
+                 << " models for " << numClasses << " classes" << endl;
+        return false;
+    }
+
+    const uint32_t num_dimensions = numInputDimensions;
+    num_lanes_ = (numClasses + kLaneWidth - 1) / kLaneWidth * kLaneWidth;
+    // Padding lanes stay 0 and are never read back.
+    means_.assign(num_dimensions * num_lanes_, 0);
+    precisions_.assign(num_dimensions * num_lanes_, 0);
+    offsets_.assign(num_lanes_, 0);
+    for (uint32_t k = 0; k < numClasses; k++) {
+        const ANBC_Model& model = models[k];
+        double offset = 0;
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            // GRT skips the dimensions a class does not weigh in on.
+            if (model.weights[j] <= 0) { continue; }
+            double sigma = model.sigma[j];
+            double mean = model.mu[j];
+            double precision = 1 / (2 * sigma * sigma);
+            offset += std::log(model.weights[j]) - kLogSqrtTwoPi -
+                      std::log(sigma);
+            if (useScaling) {
+                // x is scaled to (x - min) / range before the Gaussian.
+                double range = ranges[j].maxValue - ranges[j].minValue;
+                if (range > 0) {
+                    mean = ranges[j].minValue + mean * range;
+                    precision /= range * range;
+                } else {
+                    // Constant in training: treat the scaled input as 0.
+                    offset -= precision * mean * mean;
+                    mean = 0;
+                    precision = 0;
+                }
+            }
+            means_[j * num_lanes_ + k] = static_cast<float>(mean);
+            precisions_[j * num_lanes_ + k] = static_cast<float>(precision);
+        }
+        offsets_[k] = static_cast<float>(offset);
+    }
+
+    input_.assign(num_dimensions, 0);
+    log_likelihoods_.assign(num_lanes_, 0);
+    classLikelihoods.assign(numClasses, 0);
+    classDistances.assign(numClasses, 0);
+    predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    maxLikelihood = 0;
+    bestDistance = 0;
+    trained = true;
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * FastANBC is GRT's ANBC (Adaptive Naive Bayes Classifier) with a faster
+ * prediction path. Training, null rejection and the model file are GRT's;
+ * only predict() differs. GRT's ANBC evaluates every class's Gaussians one
+ * by one, in double precision, with a log() and an exp() per class and
+ * dimension. FastANBC rearranges the trained model into a kernel that
+ * evaluates all classes at once:
+ *
+ *   log p(x | k) = offset[k] - sum_j precision[j][k] * (x[j] - mean[j][k])^2
+ *
+ * with offset[k] = sum_j (log(weight[j][k]) - log(sqrt(2 pi) sigma[j][k]))
+ * and precision[j][k] = 1 / (2 sigma[j][k]^2) precomputed, and scaling to the
+ * training ranges folded into mean and precision. The arrays are float,
+ * dimension-major with the classes side by side (padded to kLaneWidth), so
+ * that every dimension is one broadcast and a few SIMD multiply-adds across
+ * the classes: AVX (if compiled with -mavx), SSE2 or NEON, or scalar code
+ * elsewhere. getKernelName() says which.
+ *
+ * It is a drop-in replacement for ANBC in a user's setup():
+ *
+ * pipeline.setClassifier(FastANBC(false, true, null_rej));
+ *
+ * The log-likelihoods (getClassDistances()) match GRT's to float precision,
+ * so predictions only differ when two classes are within float rounding of
+ * each other. Unlike GRT's, the likelihoods are normalized relative to the
+ * most likely class, so they do not all underflow to 0 far from every class.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GRT/GRT.h"
+
+class FastANBC : public GRT::Classifier {
+  public:
+    // Classes are padded to a multiple of this many.
+    static const uint32_t kLaneWidth = 8;
+
+    FastANBC(bool use_scaling = false, bool use_null_rejection = false,
+             double null_rejection_coeff = 10.0);
+    FastANBC(const FastANBC& rhs);
+    virtual ~FastANBC() {}
+
+    FastANBC& operator=(const FastANBC& rhs);
+
+    virtual bool deepCopyFrom(const GRT::Classifier* classifier);
+    virtual bool train_(GRT::ClassificationData& training_data);
+    virtual bool predict_(GRT::VectorDouble& input);
+    virtual bool clear();
+    virtual bool recomputeNullRejectionThresholds();
+    virtual bool setNullRejectionCoeff(double null_rejection_coeff);
+    virtual bool saveModelToFile(std::fstream& file) const;
+    virtual bool loadModelFromFile(std::fstream& file);
+
+    using GRT::MLBase::saveModelToFile;
+    using GRT::MLBase::loadModelFromFile;
+
+    // The trained GRT model the kernel was built from.
+    const GRT::ANBC& getANBC() const { return anbc_; }
+    // "AVX", "SSE2", "NEON" or "scalar".
+    static const char* getKernelName();
+
+  private:
+    // Copies the trained model's settings and builds the kernel arrays.
+    bool init();
+
+    GRT::ANBC anbc_;
+
+    // numClasses rounded up to kLaneWidth.
+    uint32_t num_lanes_;
+    // numInputDimensions x num_lanes_.
+    std::vector<float> means_;
+    std::vector<float> precisions_;
+    // num_lanes_.
+    std::vector<float> offsets_;
+
+    // Scratch space.
+    std::vector<float> input_;
+    std::vector<float> log_likelihoods_;
+
+    static GRT::RegisterClassifierModule<FastANBC> registerModule;
+};
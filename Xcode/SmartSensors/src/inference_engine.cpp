@@ -0,0 +1,276 @@
+#include "inference_engine.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "sample_clock.h"
+#include "tracer.h"
+
+namespace {
+
+std::string getHistogramName(const std::string& engine_name,
+                             const std::string& name) {
+    return engine_name.empty() ? name : engine_name + "/" + name;
+}
+
+}  // namespace
+
+InferenceEngine::InferenceEngine(uint32_t capacity, const std::string& name)
+        : name_(name),
+          istream_(nullptr),
+          calibrator_(nullptr),
+          ostream_(nullptr),
+          input_samples_(capacity),
+          pool_(nullptr),
+          is_scheduled_(false),
+          num_tasks_(0),
+          is_running_(false),
+          discard_input_(false),
+          num_processed_(0),
+          live_pipeline_(std::make_shared<GRT::GestureRecognitionPipeline>()),
+          live_pipeline_generation_(0),
+          profile_stages_(false),
+          pipeline_(std::make_shared<GRT::GestureRecognitionPipeline>()),
+          pipeline_generation_(0),
+          label_(0) {
+    Profiler& profiler = getProfiler();
+    sample_latency_ = profiler.getHistogram(
+            getHistogramName(name, "inference/sample"));
+    calibrate_latency_ = profiler.getHistogram(
+            getHistogramName(name, "inference/calibrate"));
+    predict_latency_ = profiler.getHistogram(
+            getHistogramName(name, "inference/predict"));
+    ostream_latency_ = profiler.getHistogram(
+            getHistogramName(name, "inference/ostream"));
+    e2e_latency_ = profiler.getHistogram(
+            getHistogramName(name, "e2e/arrival to prediction"));
+}
+
+InferenceEngine::~InferenceEngine() {
+    stop();
+}
+
+void InferenceEngine::setPipeline(
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline) {
+    std::shared_ptr<GRT::GestureRecognitionPipeline> copy =
+            std::make_shared<GRT::GestureRecognitionPipeline>(*pipeline);
+    std::atomic_store(&retired_pipeline_,
+                      std::shared_ptr<GRT::GestureRecognitionPipeline>());
+    std::atomic_store(&live_pipeline_, pipeline);
+    std::atomic_store(&next_pipeline_, copy);
+    live_pipeline_generation_.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const GRT::GestureRecognitionPipeline>
+InferenceEngine::getPipeline() const {
+    return std::atomic_load(&live_pipeline_);
+}
+
+void InferenceEngine::start(IStream* stream) {
+    if (is_running_) { return; }
+    istream_ = stream;
+    istream_->onDataReadyEvent(this, &InferenceEngine::onDataIn);
+    istream_->setDownstreamCapacity([this]() {
+        return input_samples_.capacity() - input_samples_.size();
+    });
+
+    is_running_ = true;
+    if (pool_ == nullptr) {
+        inference_thread_ = std::thread(&InferenceEngine::run, this);
+    }
+    istream_->start();
+}
+
+void InferenceEngine::stop() {
+    if (!is_running_) { return; }
+    istream_->stop();
+    is_running_ = false;
+    input_ready_.notify_one();
+    if (inference_thread_.joinable()) {
+        inference_thread_.join();
+    }
+    // A task still running may schedule one more, but that one exits
+    // right away.
+    while (num_tasks_ > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void InferenceEngine::calibrate(CalibrateProcess& process,
+                                const GRT::MatrixDouble& data) {
+    std::lock_guard<std::mutex> lock(calibrator_mutex_);
+    process.setData(data);
+    process.calibrate();
+}
+
+bool InferenceEngine::pinToCpu(int cpu) {
+    if (!inference_thread_.joinable()) { return false; }
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(inference_thread_.native_handle(),
+                                  sizeof(cpus), &cpus) == 0;
+#else
+    // macOS only has affinity hints, which do not pin anything.
+    return false;
+#endif
+}
+
+void InferenceEngine::onDataIn(const GRT::MatrixDouble& input,
+                               const std::vector<int64_t>& timestamps_ns,
+                               int64_t arrival_ns) {
+    if (input_callback_ != nullptr) {
+        input_callback_(input, timestamps_ns, arrival_ns);
+    }
+
+    uint32_t num_dimensions = input.getNumCols();
+    for (uint32_t i = 0; i < input.getNumRows(); i++) {
+        const double* row = input[i];
+        int64_t time_ns = timestamps_ns[i];
+        input_samples_.pushWith([=](InputSample& slot) {
+            slot.time_ns = time_ns;
+            slot.arrival_ns = arrival_ns;
+            slot.data.assign(row, row + num_dimensions);
+        });
+    }
+    if (pool_ != nullptr) {
+        // Orders the push before the is_scheduled_ check, against runTask().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        schedule();
+        return;
+    }
+    // Not under input_ready_mutex_ so that the stream never blocks; a wake-up
+    // lost to the race is made up for by the inference thread's wait timeout.
+    input_ready_.notify_one();
+}
+
+void InferenceEngine::schedule() {
+    if (is_scheduled_.exchange(true, std::memory_order_acq_rel)) { return; }
+    num_tasks_.fetch_add(1);
+    pool_->submit([this]() { runTask(); });
+}
+
+void InferenceEngine::runTask() {
+    if (is_running_) {
+        processAvailable(kMaxSamplesPerTask);
+    }
+    // Publishes this task's consumer state to whichever task runs next. The
+    // fence makes sure that a sample pushed after the last check is either
+    // seen below or scheduled by onDataIn().
+    is_scheduled_.store(false, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Samples that arrived after the last check, or more than one task's
+    // worth, get a new task; queued behind other engines' tasks for fairness.
+    if (is_running_ && input_samples_.size() > 0) { schedule(); }
+    num_tasks_.fetch_sub(1);
+}
+
+void InferenceEngine::run() {
+    while (is_running_) {
+        if (processAvailable(kMaxSamplesPerTask) > 0) { continue; }
+        std::unique_lock<std::mutex> lock(input_ready_mutex_);
+        input_ready_.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+            return input_samples_.size() > 0 || !is_running_;
+        });
+    }
+}
+
+uint32_t InferenceEngine::processAvailable(uint32_t max_samples) {
+    if (discard_input_.exchange(false)) { input_samples_.clear(); }
+
+    // Switch to a newly published pipeline between two samples.
+    uint32_t generation =
+            live_pipeline_generation_.load(std::memory_order_acquire);
+    if (generation != pipeline_generation_) {
+        std::shared_ptr<GRT::GestureRecognitionPipeline> next =
+                std::atomic_load(&next_pipeline_);
+        if (next != pipeline_) {
+            // Only pointers change hands here; the copy was made by
+            // setPipeline() and the old one is freed by the next call.
+            pipeline_.swap(next);
+            std::atomic_store(&retired_pipeline_, next);
+            pipeline_profiler_.attach(*pipeline_);
+        }
+        pipeline_generation_ = generation;
+    }
+
+    uint32_t num_processed = 0;
+    InputSample* sample;
+    while (num_processed < max_samples &&
+           (sample = input_samples_.front()) != nullptr) {
+        process(*sample);
+        input_samples_.pop();
+        num_processed++;
+    }
+    num_processed_.fetch_add(num_processed, std::memory_order_relaxed);
+
+    // Pool threads go on to other engines' samples.
+    setSampleTimeNs(kNoSampleTime);
+    setSampleArrivalNs(0);
+    return num_processed;
+}
+
+void InferenceEngine::process(const InputSample& sample) {
+    GRT::GestureRecognitionPipeline& pipeline = *pipeline_;
+    ScopedSpan sample_span(sample_latency_);
+    int64_t start_ns = sample_span.getStartNs();
+
+    // Time-dependent pipeline modules see the time the sample was taken, not
+    // the time it happens to be processed.
+    setSampleTimeNs(sample.time_ns);
+    // An OStream fired by this sample measures its latency from here.
+    setSampleArrivalNs(sample.arrival_ns);
+
+    bool is_calibrated = true;
+    if (calibrator_ == nullptr) {
+        data_point_ = sample.data;
+    } else {
+        ScopedSpan span(calibrate_latency_);
+        std::lock_guard<std::mutex> lock(calibrator_mutex_);
+        is_calibrated = calibrator_->isCalibrated();
+        if (is_calibrated) {
+            data_point_ = calibrator_->calibrate(sample.data);
+        } else {
+            data_point_.clear();
+        }
+    }
+
+    bool is_predicted = pipeline.getTrained();
+    if (is_predicted) {
+        if (profile_stages_) {
+            ScopedSpan span(predict_latency_);
+            pipeline_profiler_.predict(pipeline, data_point_);
+            label_ = pipeline_profiler_.getPredictedClassLabel();
+            class_likelihoods_ = pipeline_profiler_.getClassLikelihoods();
+        } else {
+            ScopedSpan span(predict_latency_);
+            pipeline.predict(data_point_);
+            label_ = pipeline.getPredictedClassLabel();
+            class_likelihoods_ = pipeline.getClassLikelihoods();
+        }
+        e2e_latency_->record(getMonotonicTimeNs() - sample.arrival_ns);
+
+        if (ostream_ != nullptr && label_ != 0) {
+            ScopedSpan span(ostream_latency_);
+            ostream_->onReceive(label_);
+        }
+    }
+
+    if (result_callback_ != nullptr) {
+        Result result = { sample.time_ns, sample.arrival_ns, sample.data,
+                          data_point_, is_calibrated, is_predicted, label_,
+                          class_likelihoods_, pipeline };
+        result_callback_(result);
+    }
+
+    Tracer& tracer = getTracer();
+    if (tracer.isTracing()) {
+        tracer.span("sample", start_ns, getMonotonicTimeNs(),
+                    "queued_ns", start_ns - sample.arrival_ns);
+    }
+}
@@ -0,0 +1,202 @@
+/*
+ * InferenceEngine is the ESP runtime without any user interface: it takes the
+ * samples an IStream delivers, calibrates them, runs them through the live
+ * pipeline and hands the predicted labels to an OStream, on a thread of its
+ * own and at the rate samples arrive.
+ *
+ * InferenceEngine engine;
+ * engine.setCalibrator(&calibrator);   // optional
+ * engine.setOStream(&ostream);         // optional
+ * engine.setPipeline(std::make_shared<GRT::GestureRecognitionPipeline>(pipeline));
+ * engine.start(&stream);
+ * ...
+ * engine.stop();
+ *
+ * The app (ofApp) drives one to plot and record what it computes; the headless
+ * runner (see headless/) drives one on its own, or many through a
+ * SessionManager. With runOn(), the engine has no thread of its own: queued
+ * samples are processed by tasks on a shared ThreadPool instead, at most one
+ * at a time per engine.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "calibrator.h"
+#include "istream.h"
+#include "ostream.h"
+#include "pipeline_profiler.h"
+#include "profiler.h"
+#include "ring_buffer.h"
+#include "thread_pool.h"
+
+class InferenceEngine {
+  public:
+    // Number of samples that can be queued between the stream and the
+    // inference thread. At 44.1 kHz audio this is more than a second of data.
+    static const uint32_t kDefaultCapacity = 1 << 16;
+
+    // What the inference thread knows about a sample once it has processed
+    // it. Only valid during the ResultCallback call.
+    struct Result {
+        int64_t time_ns;
+        int64_t arrival_ns;
+        const std::vector<double>& raw;
+        // Calibrated input; empty if the calibrator has not been run yet.
+        const std::vector<double>& input;
+        bool is_calibrated;
+        // Set if the pipeline is trained. `label` is the last prediction
+        // either way.
+        bool is_predicted;
+        GRT::UINT label;
+        const std::vector<double>& class_likelihoods;
+        // The inference thread's own copy of the live pipeline.
+        GRT::GestureRecognitionPipeline& pipeline;
+    };
+    typedef std::function<void(const Result&)> ResultCallback;
+
+    // Most samples one pool task processes before it yields to other work.
+    static const uint32_t kMaxSamplesPerTask = 256;
+
+    // Latency histograms are named "<name>/inference/..." (just
+    // "inference/..." without a name).
+    explicit InferenceEngine(uint32_t capacity = kDefaultCapacity,
+                             const std::string& name = "");
+    ~InferenceEngine();
+
+    InferenceEngine(const InferenceEngine&) = delete;
+    InferenceEngine& operator=(const InferenceEngine&) = delete;
+
+    // These must be set before start().
+    void setCalibrator(Calibrator* calibrator) { calibrator_ = calibrator; }
+    void setOStream(OStream* ostream) { ostream_ = ostream; }
+    // Called on the stream's thread with every batch it delivers, before the
+    // batch is queued (e.g. to record it).
+    void onInput(IStream::onDataReadyCallback callback) {
+        input_callback_ = callback;
+    }
+    // Called on the inference thread for every processed sample.
+    void onResult(ResultCallback callback) { result_callback_ = callback; }
+    // Processes samples on `pool` instead of a thread of its own.
+    void runOn(ThreadPool* pool) { pool_ = pool; }
+
+    // Makes `pipeline` the live pipeline. The inference thread's own copy of
+    // it is made here, on the calling thread, and the inference thread
+    // switches to it between two samples without copying anything. It must
+    // not be modified afterwards, so that it can be copied from any thread.
+    // An untrained pipeline still runs pre-processing and feature extraction
+    // for the result callback.
+    void setPipeline(std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline);
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> getPipeline() const;
+
+    // Connects to `stream`, starts the inference thread (unless running on a
+    // pool) and then the stream.
+    void start(IStream* stream);
+    // Stops the stream and then the inference thread.
+    void stop();
+    bool isRunning() const { return is_running_; }
+
+    // Has the inference thread throw away everything queued so far.
+    void discardInput() { discard_input_ = true; }
+
+    // Runs `process` on `data` while the inference thread is kept off the
+    // calibrator. Can be called from any thread.
+    void calibrate(CalibrateProcess& process, const GRT::MatrixDouble& data);
+
+    // Times every pipeline module (see PipelineProfiler); slower.
+    void setProfileStages(bool profile_stages) { profile_stages_ = profile_stages; }
+
+    // Pins the inference thread to `cpu`. Only supported on Linux; returns
+    // false if the thread is not running or could not be pinned.
+    bool pinToCpu(int cpu);
+
+    const std::string& getName() const { return name_; }
+    uint64_t getNumProcessed() const { return num_processed_; }
+    size_t getNumQueued() const { return input_samples_.size(); }
+    uint64_t getNumDropped() const { return input_samples_.getNumDropped(); }
+    uint64_t getNumOverruns() const { return input_samples_.getNumOverruns(); }
+    // Time from a sample's arrival until its prediction.
+    const LatencyHistogram& getLatency() const { return *e2e_latency_; }
+
+  private:
+    struct InputSample {
+        int64_t time_ns;
+        // When the bytes holding this sample were read; see tracer.h.
+        int64_t arrival_ns;
+        std::vector<double> data;
+    };
+
+    void onDataIn(const GRT::MatrixDouble& input,
+                  const std::vector<int64_t>& timestamps_ns, int64_t arrival_ns);
+    void run();
+    // Processes up to `max_samples` queued samples; returns how many.
+    uint32_t processAvailable(uint32_t max_samples);
+    void process(const InputSample& sample);
+    // Pool mode: makes sure a task will process the queued samples.
+    void schedule();
+    void runTask();
+
+    std::string name_;
+    IStream* istream_;
+    Calibrator* calibrator_;
+    OStream* ostream_;
+    IStream::onDataReadyCallback input_callback_;
+    ResultCallback result_callback_;
+
+    // Samples are pushed by the stream's thread (onDataIn) and drained by the
+    // inference thread. Neither side blocks the other; if inference falls so
+    // far behind that the ring fills up, new samples are dropped and counted.
+    RingBuffer<InputSample> input_samples_;
+
+    std::thread inference_thread_;
+    ThreadPool* pool_;
+    // Set while a pool task for this engine is queued or running, so that
+    // samples are only ever consumed by one task at a time.
+    std::atomic<bool> is_scheduled_;
+    // Pool tasks that may still touch the engine; stop() waits for them.
+    std::atomic<uint32_t> num_tasks_;
+    std::atomic<bool> is_running_;
+    std::mutex input_ready_mutex_;
+    std::condition_variable input_ready_;
+    std::atomic<bool> discard_input_;
+    std::atomic<uint64_t> num_processed_;
+
+    // Held by the inference thread while it calibrates a sample, and by
+    // calibrate().
+    std::mutex calibrator_mutex_;
+
+    // Published pipelines are never modified; live_pipeline_generation_ is
+    // bumped after each so the inference thread notices cheaply.
+    // next_pipeline_ is the inference thread's copy of live_pipeline_, and
+    // retired_pipeline_ the copy it last switched away from, which the next
+    // setPipeline() releases so that it is not freed on the inference thread.
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> live_pipeline_;
+    std::shared_ptr<GRT::GestureRecognitionPipeline> next_pipeline_;
+    std::shared_ptr<GRT::GestureRecognitionPipeline> retired_pipeline_;
+    std::atomic<uint32_t> live_pipeline_generation_;
+
+    std::atomic<bool> profile_stages_;
+    PipelineProfiler pipeline_profiler_;
+
+    // Inference thread (or current pool task) only.
+    std::shared_ptr<GRT::GestureRecognitionPipeline> pipeline_;
+    uint32_t pipeline_generation_;
+    std::vector<double> data_point_;
+    GRT::UINT label_;
+    std::vector<double> class_likelihoods_;
+
+    LatencyHistogram* sample_latency_;
+    LatencyHistogram* calibrate_latency_;
+    LatencyHistogram* predict_latency_;
+    LatencyHistogram* ostream_latency_;
+    LatencyHistogram* e2e_latency_;
+};
@@ -1,18 +1,25 @@
 #include "istream.h"
-#include "ofApp.h"
+#include "ascii_parser.h"
+#include "runtime.h"
+#include "sample_clock.h"
+#include "tracer.h"
 
 #include <chrono>         // std::chrono::milliseconds
 #include <thread>         // std::this_thread::sleep_for
 
 void useStream(IStream &stream) {
-    ((ofApp *) ofGetAppPtr())->useStream(stream);
+    getRuntime()->useStream(stream);
 }
 
 void usePipeline(GRT::GestureRecognitionPipeline &pipeline) {
-    ((ofApp *) ofGetAppPtr())->usePipeline(pipeline);
+    getRuntime()->usePipeline(pipeline);
 }
 
-IStream::IStream() : has_started_(false), data_ready_callback_(nullptr) {}
+IStream::IStream()
+        : has_started_(false),
+          data_ready_callback_(nullptr),
+          read_latency_(getProfiler().getHistogram("stream/decode + dispatch")) {
+}
 
 vector<double> IStream::normalize(vector<double> input) {
     if (vectorNormalizer_ != nullptr) {
@@ -26,6 +33,61 @@ vector<double> IStream::normalize(vector<double> input) {
     }
 }
 
+void IStream::dispatch(const GRT::MatrixDouble& data, int64_t arrival_ns) {
+    if (data_ready_callback_ == nullptr) { return; }
+    timestamps_ns_.assign(data.getNumRows(), arrival_ns);
+    dispatch(data, timestamps_ns_, arrival_ns);
+}
+
+void IStream::dispatch(const GRT::MatrixDouble& data,
+                       const vector<int64_t>& timestamps_ns,
+                       int64_t arrival_ns) {
+    if (data_ready_callback_ == nullptr) { return; }
+    data_ready_callback_(data, timestamps_ns, arrival_ns);
+
+    // The read starts the flow that ends where an OStream emits.
+    Tracer& tracer = getTracer();
+    if (tracer.isTracing()) {
+        tracer.span("stream read", arrival_ns, getMonotonicTimeNs(), arrival_ns);
+    }
+}
+
+void IStream::dispatchRows(const double* rows, uint32_t num_rows,
+                           uint32_t num_dimensions, GRT::MatrixDouble& batch,
+                           int64_t arrival_ns, const int64_t* timestamps_ns) {
+    if (vectorNormalizer_ != nullptr) {
+        vector<double> row(num_dimensions);
+        for (uint32_t i = 0; i < num_rows; i++) {
+            const double* in = rows + i * num_dimensions;
+            row.assign(in, in + num_dimensions);
+            vector<double> output = normalize(row);
+            if (i == 0 && (batch.getNumRows() != num_rows ||
+                           batch.getNumCols() != output.size())) {
+                batch.resize(num_rows, output.size());
+            }
+            std::copy(output.begin(), output.end(), batch[i]);
+        }
+    } else {
+        if (batch.getNumRows() != num_rows || batch.getNumCols() != num_dimensions) {
+            batch.resize(num_rows, num_dimensions);
+        }
+        for (uint32_t i = 0; i < num_rows; i++) {
+            const double* in = rows + i * num_dimensions;
+            double* out = batch[i];
+            for (uint32_t j = 0; j < num_dimensions; j++) {
+                out[j] = (normalizer_ != nullptr) ? normalizer_(in[j]) : in[j];
+            }
+        }
+    }
+
+    if (timestamps_ns == nullptr) {
+        dispatch(batch, arrival_ns);
+    } else if (data_ready_callback_ != nullptr) {
+        timestamps_ns_.assign(timestamps_ns, timestamps_ns + num_rows);
+        dispatch(batch, timestamps_ns_, arrival_ns);
+    }
+}
+
 void IStream::setLabelsForAllDimensions(const vector<string> labels) {
     istream_labels_ = labels;
 }
@@ -40,6 +102,7 @@ const vector<string>& IStream::getLabels() const {
     return istream_labels_;
 }
 
+#ifndef ESP_HEADLESS
 AudioStream::AudioStream(uint32_t downsample_rate)
         : downsample_rate_(downsample_rate),
           sound_stream_(new ofSoundStream()) {
@@ -69,6 +132,8 @@ int AudioStream::getNumInputDimensions() {
 }
 
 void AudioStream::audioIn(float* input, int buffer_size, int nChannel) {
+    int64_t arrival_ns = getMonotonicTimeNs();
+    ScopedSpan span(read_latency_);
     // set nChannel as 1 to load only a single channel (left).
     nChannel = 1;
     GRT::MatrixDouble data(buffer_size / nChannel / downsample_rate_, nChannel);
@@ -77,15 +142,27 @@ void AudioStream::audioIn(float* input, int buffer_size, int nChannel) {
         for (int j = 0; j < nChannel; j++)
             data[i][j] = input[i * nChannel * downsample_rate_ + j];
 
-    if (data_ready_callback_ != nullptr) {
-        data_ready_callback_(data);
-    }
+    dispatch(data, arrival_ns);
+}
+#endif  // ESP_HEADLESS
+
+// Maps the index used by the user (as printed by ofSerial::listDevices()) to a
+// device path such as /dev/tty.usbmodem1411. Returns "" if out of range.
+static string getSerialDevicePath(uint32_t port) {
+#ifdef ESP_HEADLESS
+    vector<string> devices = listSerialDevices();
+    if (port >= devices.size()) { return ""; }
+    return devices[port];
+#else
+    ofSerial serial;
+    vector<ofSerialDeviceInfo> devices = serial.getDeviceList();
+    if (port >= devices.size()) { return ""; }
+    return devices[port].getDevicePath();
+#endif
 }
 
 SerialStream::SerialStream(uint32_t port, uint32_t baud = 115200)
-        : port_(port), baud_(baud), serial_(new ofSerial()) {
-    // Print all devices for convenience.
-    // serial_->listDevices();
+        : port_(port), baud_(baud) {
 }
 
 void SerialStream::start() {
@@ -94,17 +171,24 @@ void SerialStream::start() {
     }
 
     if (!has_started_) {
-        serial_->setup(port_, baud_);
-        reading_thread_.reset(new std::thread(&SerialStream::readSerial, this));
+        // Each callback delivers kBufferSize_ bytes, so let the driver wake us
+        // up once per buffer rather than once per byte.
+        if (!serial_.open(getSerialDevicePath(port_), baud_, kBufferSize_)) {
+            ofLog(OF_LOG_ERROR) << serial_.getLastError();
+            return;
+        }
         has_started_ = true;
+        reading_thread_.reset(new std::thread(&SerialStream::readSerial, this));
     }
 }
 
 void SerialStream::stop() {
     has_started_ = false;
+    serial_.interrupt();
     if (reading_thread_ != nullptr && reading_thread_->joinable()) {
         reading_thread_->join();
     }
+    serial_.close();
 }
 
 int SerialStream::getNumInputDimensions() {
@@ -112,55 +196,34 @@ int SerialStream::getNumInputDimensions() {
 }
 
 void SerialStream::readSerial() {
-    // TODO(benzh) This readSerial is running in a different thread
-    // and performing a busy polling (100% CPU usage). Should be
-    // optimized.
-    int sleep_time = kBufferSize_ * 1000 / (baud_ / 10);
-    ofLog() << "Serial port will be read every " << sleep_time << " ms";
+    vector<uint8_t> bytes(kBufferSize_);
+    uint32_t filled = 0;
     while (has_started_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time));
-
-        int local_buffer_size = kBufferSize_;
-        int bytesRequired = kBufferSize_;
-        unsigned char bytes[bytesRequired];
-        int bytesRemaining = bytesRequired;
-        while (bytesRemaining > 0) {
-            // check for data
-            if (serial_->available() > 0) {
-                // try to read - note offset into the bytes[] array, this is so
-                // that we don't overwrite the bytes we already have
-                int bytesArrayOffset = bytesRequired - bytesRemaining;
-                int result = serial_->readBytes(&bytes[bytesArrayOffset],
-                                                bytesRemaining);
-
-                // check for error code
-                if (result == OF_SERIAL_ERROR) {
-                    // something bad happened
-                    ofLog(OF_LOG_ERROR) << "Error reading from serial";
-                    break;
-                } else if (result == OF_SERIAL_NO_DATA) {
-                    // nothing was read, try again
-                } else {
-                    // we read some data!
-                    bytesRemaining -= result;
-                }
-            }
+        // Blocks until bytes arrive (or stop() interrupts us).
+        int result = serial_.read(&bytes[filled], kBufferSize_ - filled);
+        if (result < 0) {
+            ofLog(OF_LOG_ERROR) << "Error reading from serial: "
+                                << serial_.getLastError();
+            break;
         }
-        GRT::MatrixDouble data(local_buffer_size, 1);
-        for (int i = 0; i < local_buffer_size; i++) {
+
+        filled += result;
+        if (filled < kBufferSize_) { continue; }
+        filled = 0;
+
+        int64_t arrival_ns = getMonotonicTimeNs();
+        ScopedSpan span(read_latency_);
+        GRT::MatrixDouble data(kBufferSize_, 1);
+        for (uint32_t i = 0; i < kBufferSize_; i++) {
             int b = bytes[i];
             data[i][0] = (normalizer_ != nullptr) ? normalizer_(b) : b;
         }
-        if (data_ready_callback_ != nullptr) {
-            data_ready_callback_(data);
-        }
+        dispatch(data, arrival_ns);
     }
 }
 
 ASCIISerialStream::ASCIISerialStream(uint32_t port, uint32_t baud, uint32_t dim)
-        : serial_(new ofSerial()), port_(port), baud_(baud), numDimensions_(dim) {
-    // Print all devices for convenience.
-    //serial_->listDevices();
+        : port_(port), baud_(baud), numDimensions_(dim) {
 }
 
 void ASCIISerialStream::start() {
@@ -169,17 +232,23 @@ void ASCIISerialStream::start() {
     }
 
     if (!has_started_) {
-        serial_->setup(port_, baud_);
-        reading_thread_.reset(new std::thread(&ASCIISerialStream::readSerial, this));
+        // Lines are short and variable in length: wake up on the first byte.
+        if (!serial_.open(getSerialDevicePath(port_), baud_, 1)) {
+            ofLog(OF_LOG_ERROR) << serial_.getLastError();
+            return;
+        }
         has_started_ = true;
+        reading_thread_.reset(new std::thread(&ASCIISerialStream::readSerial, this));
     }
 }
 
 void ASCIISerialStream::stop() {
     has_started_ = false;
+    serial_.interrupt();
     if (reading_thread_ != nullptr && reading_thread_->joinable()) {
         reading_thread_->join();
     }
+    serial_.close();
 }
 
 int ASCIISerialStream::getNumInputDimensions() {
@@ -187,42 +256,230 @@ int ASCIISerialStream::getNumInputDimensions() {
 }
 
 void ASCIISerialStream::readSerial() {
-    // TODO(benzh) This readSerial is running in a different thread
-    // and performing a busy polling (100% CPU usage). Should be
-    // optimized.
-    int sleep_time = 10;
-    ofLog() << "Serial port will be read every " << sleep_time << " ms";
+    ASCIILineParser parser(numDimensions_);
+    GRT::MatrixDouble batch;
     while (has_started_) {
-        string s;
+        // Blocks until bytes arrive (or stop() interrupts us). Bytes go
+        // straight into the parser's buffer.
+        size_t capacity;
+        char* dest = parser.prepare(&capacity);
+        int result = serial_.read(reinterpret_cast<uint8_t*>(dest), capacity);
+        if (result < 0) {
+            ofLog(OF_LOG_ERROR) << "Error reading from serial: "
+                                << serial_.getLastError();
+            break;
+        }
 
-        do {
-            while (serial_->available() < 1) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time));
-            }
-            s += serial_->readByte();
-        } while(s[s.length() - 1] != '\n');
+        int64_t arrival_ns = getMonotonicTimeNs();
+        ScopedSpan span(read_latency_);
+        parser.commit(result);
 
-        //ofLog() << "read: '" << s << "'" << endl;
+        uint32_t num_rows = parser.parse();
+        if (num_rows == 0 || data_ready_callback_ == nullptr) { continue; }
 
-        if (data_ready_callback_ != nullptr) {
-            istringstream iss(s);
-            vector<double> data;
-            double d;
+        // Hand every line of this chunk off as a single batch.
+        dispatchRows(parser.getRow(0), num_rows, numDimensions_, batch,
+                     arrival_ns);
+    }
+}
 
-            while (iss >> d) data.push_back(d);
+BinarySerialStream::BinarySerialStream(uint32_t port, uint32_t baud, uint32_t dim)
+        : port_(port), baud_(baud), numDimensions_(dim), decoder_(dim) {
+}
 
-            if (data.size() > 0) {
-                data = normalize(data);
+void BinarySerialStream::start() {
+    if (port_ == -1) {
+        ofLog(OF_LOG_ERROR) << "USB Port has not been properly set";
+    }
 
-                GRT::MatrixDouble matrix;
-                matrix.push_back(data);
+    if (!has_started_) {
+        // 16-bit values: header + payload + crc, plus COBS overhead.
+        uint32_t frame_size = 3 + numDimensions_ * 2 + 2 + 2;
+        if (!serial_.open(getSerialDevicePath(port_), baud_, frame_size)) {
+            ofLog(OF_LOG_ERROR) << serial_.getLastError();
+            return;
+        }
+        has_started_ = true;
+        reading_thread_.reset(new std::thread(&BinarySerialStream::readSerial, this));
+    }
+}
+
+void BinarySerialStream::stop() {
+    has_started_ = false;
+    serial_.interrupt();
+    if (reading_thread_ != nullptr && reading_thread_->joinable()) {
+        reading_thread_->join();
+    }
+    serial_.close();
+}
+
+int BinarySerialStream::getNumInputDimensions() {
+    return numDimensions_;
+}
+
+void BinarySerialStream::readSerial() {
+    uint8_t buffer[1024];
+    vector<double> rows;
+    GRT::MatrixDouble batch;
+
+    while (has_started_) {
+        // Blocks until bytes arrive (or stop() interrupts us).
+        int result = serial_.read(buffer, sizeof(buffer));
+        if (result < 0) {
+            ofLog(OF_LOG_ERROR) << "Error reading from serial: "
+                                << serial_.getLastError();
+            break;
+        }
+
+        int64_t arrival_ns = getMonotonicTimeNs();
+        ScopedSpan span(read_latency_);
+        rows.clear();
+        decoder_.feed(buffer, result, [&rows, this](const double* values) {
+            rows.insert(rows.end(), values, values + numDimensions_);
+        });
+
+        uint32_t num_rows = rows.size() / numDimensions_;
+        if (num_rows == 0 || data_ready_callback_ == nullptr) { continue; }
+
+        // Hand every frame of this read off as a single batch.
+        dispatchRows(rows.data(), num_rows, numDimensions_, batch, arrival_ns);
+    }
+}
+
+// Samples are handed off in batches of at most this many, and a batch never
+// spans a pause in real-time playback.
+const uint32_t kReplayBatchSize = 256;
+// Longest single sleep, so that stop() is honoured promptly.
+const int64_t kReplayMaxSleepNs = 50 * 1000000LL;
+
+ReplayStream::ReplayStream(const string& path, double speed, bool loop)
+        : path_(path), speed_(speed), loop_(loop), is_finished_(false),
+          position_(0) {
+    // Opened right away: the number of dimensions is needed before start().
+    if (!reader_.open(path_)) {
+        ofLog(OF_LOG_ERROR) << reader_.getLastError();
+    } else {
+        ofLog() << "Replaying " << reader_.getNumSamples() << " samples from "
+                << path_;
+    }
+}
+
+void ReplayStream::start() {
+    if (reader_.getNumSamples() == 0) {
+        ofLog(OF_LOG_ERROR) << "Nothing to replay in " << path_;
+        return;
+    }
+
+    if (!has_started_) {
+        // The thread of a finished (non-looping) replay exits by itself.
+        if (replay_thread_ != nullptr && replay_thread_->joinable()) {
+            replay_thread_->join();
+        }
+        if (is_finished_) {
+            position_ = 0;
+            is_finished_ = false;
+        }
+        has_started_ = true;
+        replay_thread_.reset(new std::thread(&ReplayStream::replay, this));
+    }
+}
+
+void ReplayStream::stop() {
+    has_started_ = false;
+    if (replay_thread_ != nullptr && replay_thread_->joinable()) {
+        replay_thread_->join();
+    }
+}
+
+int ReplayStream::getNumInputDimensions() {
+    return reader_.getNumDimensions();
+}
+
+void ReplayStream::replay() {
+    uint32_t num_dimensions = reader_.getNumDimensions();
+    uint64_t num_samples = reader_.getNumSamples();
+    vector<double> rows;
+    vector<int64_t> timestamps;
+    rows.reserve(kReplayBatchSize * num_dimensions);
+    timestamps.reserve(kReplayBatchSize);
+    GRT::MatrixDouble batch;
+
+    // Each pass over a looped session is shifted by the session's length (plus
+    // one average sample interval) so that timestamps keep increasing.
+    int64_t first_ns = reader_.getTimestampNs(0);
+    int64_t last_ns = reader_.getTimestampNs(num_samples - 1);
+    int64_t loop_period_ns = last_ns - first_ns;
+    if (num_samples > 1) { loop_period_ns += loop_period_ns / (num_samples - 1); }
+    int64_t loop_offset_ns = 0;
+
+    // Real-time playback maps session time onto wall time through an anchor
+    // that is reset whenever the speed changes.
+    double anchor_speed = 0;
+    int64_t anchor_wall_ns = 0;
+    int64_t anchor_sample_ns = 0;
+
+    auto flush = [&]() {
+        if (timestamps.empty()) { return; }
+        // Replayed samples keep their recorded times; they "arrive" now.
+        dispatchRows(rows.data(), timestamps.size(), num_dimensions, batch,
+                     getMonotonicTimeNs(), timestamps.data());
+        rows.clear();
+        timestamps.clear();
+    };
+
+    while (has_started_) {
+        uint64_t position = position_;
+        if (position >= num_samples) {
+            flush();
+            if (!loop_) {
+                is_finished_ = true;
+                has_started_ = false;
+                ofLog() << "Finished replaying " << path_;
+                break;
+            }
+            position_ = position = 0;
+            loop_offset_ns += loop_period_ns;
+        }
+
+        // Never hand the consumer more than it has room for.
+        if (downstream_capacity_ != nullptr &&
+            downstream_capacity_() <= timestamps.size()) {
+            flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
 
-                data_ready_callback_(matrix);
+        int64_t sample_ns = reader_.getTimestampNs(position) + loop_offset_ns;
+        double speed = speed_;
+        if (speed > 0) {
+            int64_t now_ns = getMonotonicTimeNs();
+            if (speed != anchor_speed) {
+                anchor_speed = speed;
+                anchor_wall_ns = now_ns;
+                anchor_sample_ns = sample_ns;
+            }
+            int64_t due_ns = anchor_wall_ns +
+                    static_cast<int64_t>((sample_ns - anchor_sample_ns) / speed);
+            if (due_ns > now_ns) {
+                flush();
+                int64_t sleep_ns = std::min(due_ns - now_ns, kReplayMaxSleepNs);
+                std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+                continue;
             }
+        } else {
+            anchor_speed = 0;
         }
+
+        const double* sample = reader_.getSample(position);
+        rows.insert(rows.end(), sample, sample + num_dimensions);
+        timestamps.push_back(sample_ns);
+        position_ = position + 1;
+        if (timestamps.size() == kReplayBatchSize) { flush(); }
     }
+    flush();
 }
 
+#ifndef ESP_HEADLESS
 FirmataStream::FirmataStream(uint32_t port) : port_(port) {
     ofSerial serial;
     serial.listDevices();
@@ -278,7 +535,7 @@ void FirmataStream::update() {
             data = normalize(data);
             GRT::MatrixDouble matrix;
             matrix.push_back(data);
-            if (data_ready_callback_ != nullptr) data_ready_callback_(matrix);
+            dispatch(matrix, getMonotonicTimeNs());
         } else if (arduino_.isInitialized()) {
             ofLog() << "Configuring Arduino.";
             for (int i = 0; i < pins_.size(); i++)
@@ -287,3 +544,4 @@ void FirmataStream::update() {
         }
     }
 }
+#endif  // ESP_HEADLESS
@@ -5,9 +5,16 @@
 #pragma once
 
 #include "GRT/GRT.h"
-#include "ofMain.h"
+#include "of_shim.h"
+#include "binary_frame.h"
+#include "profiler.h"
+#include "serial_port.h"
+#include "session_file.h"
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <thread>
 
 // See more documentation:
 // http://openframeworks.cc/documentation/sound/ofSoundStream/#show_setup
@@ -54,16 +61,34 @@ class IStream {
 
     bool hasStarted() { return has_started_; }
 
-    typedef std::function<void(GRT::MatrixDouble)> onDataReadyCallback;
+    // Called with a batch of samples (one per row), the time each sample was
+    // taken and the time the batch arrived, in nanoseconds (see
+    // sample_clock.h). Live streams take both from the monotonic clock; a
+    // stream whose device reports its own timestamps, or a replayed session,
+    // passes those as sample times while the arrival time stays the moment
+    // the bytes were read, which end-to-end latency is measured from (see
+    // tracer.h).
+    typedef std::function<void(const GRT::MatrixDouble&,
+                               const vector<int64_t>&,
+                               int64_t)> onDataReadyCallback;
 
     void onDataReadyEvent(onDataReadyCallback callback) {
         data_ready_callback_ = callback;
     }
 
-    template<typename T1, typename arg, class T>
-    void onDataReadyEvent(T1* owner, void (T::*listenerMethod)(arg)) {
+    template<typename T1, typename arg1, typename arg2, typename arg3, class T>
+    void onDataReadyEvent(T1* owner,
+                          void (T::*listenerMethod)(arg1, arg2, arg3)) {
         using namespace std::placeholders;
-        data_ready_callback_ = std::bind(listenerMethod, owner, _1);
+        data_ready_callback_ = std::bind(listenerMethod, owner, _1, _2, _3);
+    }
+
+    // Lets streams that can produce data faster than real time (ReplayStream)
+    // wait for the consumer instead of overflowing it. `f` returns how many
+    // more samples the consumer can currently accept.
+    typedef std::function<size_t()> downstreamCapacityFunc;
+    void setDownstreamCapacity(downstreamCapacityFunc f) {
+        downstream_capacity_ = f;
     }
 
     // Set labels on all input dimension. This function takes either a vector of
@@ -75,14 +100,44 @@ class IStream {
 
   protected:
     vector<string> istream_labels_;
-    bool has_started_;
+    // Read by the reading threads, and cleared by a replay that has reached
+    // the end of its session.
+    std::atomic<bool> has_started_;
     onDataReadyCallback data_ready_callback_;
+    downstreamCapacityFunc downstream_capacity_;
     normalizeFunc normalizer_;
     vectorNormalizeFunc vectorNormalizer_;
 
+    // Time spent decoding and dispatching each read (or audio buffer).
+    LatencyHistogram* read_latency_;
+
     vector<double> normalize(vector<double>);
+
+    // Hands `data`, read at `arrival_ns` (getMonotonicTimeNs() right after the
+    // read returned), to the data-ready callback. Without `timestamps_ns`,
+    // every row is stamped with the arrival time.
+    void dispatch(const GRT::MatrixDouble& data, int64_t arrival_ns);
+    void dispatch(const GRT::MatrixDouble& data,
+                  const vector<int64_t>& timestamps_ns, int64_t arrival_ns);
+
+    // Normalizes `num_rows` rows of `num_dimensions` values stored back to back
+    // in `rows` into `batch`, re-using its storage when the shape does not
+    // change, and dispatches the batch. `timestamps_ns`, if given, holds one
+    // timestamp per row.
+    void dispatchRows(const double* rows, uint32_t num_rows,
+                      uint32_t num_dimensions, GRT::MatrixDouble& batch,
+                      int64_t arrival_ns,
+                      const int64_t* timestamps_ns = nullptr);
+
+  private:
+    // Scratch space for the timestamps handed to the callback; only used by
+    // the thread that produces the data.
+    vector<int64_t> timestamps_ns_;
 };
 
+// AudioStream and FirmataStream are built on openFrameworks and are not
+// available in headless builds.
+#ifndef ESP_HEADLESS
 class AudioStream : public ofBaseApp, public IStream {
   public:
     AudioStream(uint32_t downsample_rate = 1);
@@ -94,6 +149,7 @@ class AudioStream : public ofBaseApp, public IStream {
     uint32_t downsample_rate_;
     unique_ptr<ofSoundStream> sound_stream_;
 };
+#endif  // ESP_HEADLESS
 
 class SerialStream : public IStream {
   public:
@@ -107,7 +163,7 @@ class SerialStream : public IStream {
     // Serial buffer size
     uint32_t kBufferSize_ = 64;
 
-    unique_ptr<ofSerial> serial_;
+    SerialPort serial_;
 
     // A separate reading thread to read data from Serial.
     unique_ptr<std::thread> reading_thread_;
@@ -121,16 +177,77 @@ class ASCIISerialStream : public IStream {
     virtual void stop() final;
     virtual int getNumInputDimensions() final;
   private:
-    unique_ptr<ofSerial> serial_;
+    SerialPort serial_;
+    uint32_t port_;
+    uint32_t baud_;
+    uint32_t numDimensions_;
+
+    // A separate reading thread to read data from Serial.
+    unique_ptr<std::thread> reading_thread_;
+    void readSerial();
+};
+
+// BinarySerialStream reads frames sent by the ESPFrame Arduino library (see
+// Arduino/libraries/ESPFrame). Corrupted frames are detected by their CRC and
+// dropped; lost frames are detected from their sequence numbers.
+class BinarySerialStream : public IStream {
+  public:
+    BinarySerialStream(uint32_t port, uint32_t baud, uint32_t numDimensions);
+    virtual void start() final;
+    virtual void stop() final;
+    virtual int getNumInputDimensions() final;
+
+    uint64_t getNumFrames() const { return decoder_.getNumFrames(); }
+    uint64_t getNumCorruptFrames() const { return decoder_.getNumCorruptFrames(); }
+    uint64_t getNumLostFrames() const { return decoder_.getNumLostFrames(); }
+  private:
+    SerialPort serial_;
     uint32_t port_;
     uint32_t baud_;
     uint32_t numDimensions_;
+    BinaryFrameDecoder decoder_;
 
     // A separate reading thread to read data from Serial.
     unique_ptr<std::thread> reading_thread_;
     void readSerial();
 };
 
+// ReplayStream plays back a session recorded with SessionWriter. Samples keep
+// their recorded timestamps, so time-dependent pipeline modules behave as they
+// did when the session was recorded regardless of the playback speed.
+// Sessions hold the samples a stream delivered, i.e. after normalization, so a
+// normalizer should only be set if it is meant to be applied on top.
+class ReplayStream : public IStream {
+  public:
+    // `speed` is the playback rate relative to the recording (1.0 is real
+    // time, 10.0 is ten times faster); 0 plays back as fast as the consumer
+    // can keep up. If `loop` is set, playback restarts at the end of the
+    // session.
+    ReplayStream(const string& path, double speed = 1.0, bool loop = false);
+    virtual void start() final;
+    virtual void stop() final;
+    virtual int getNumInputDimensions() final;
+
+    void setSpeed(double speed) { speed_ = speed; }
+    double getSpeed() const { return speed_; }
+
+    // True once the whole session has been played (never set when looping).
+    bool isFinished() const { return is_finished_; }
+    uint64_t getPosition() const { return position_; }
+    uint64_t getNumSamples() const { return reader_.getNumSamples(); }
+  private:
+    string path_;
+    std::atomic<double> speed_;
+    bool loop_;
+    SessionReader reader_;
+    std::atomic<bool> is_finished_;
+    std::atomic<uint64_t> position_;
+
+    unique_ptr<std::thread> replay_thread_;
+    void replay();
+};
+
+#ifndef ESP_HEADLESS
 class FirmataStream : public IStream {
   public:
     FirmataStream(uint32_t port);
@@ -149,6 +266,7 @@ class FirmataStream : public IStream {
     unique_ptr<std::thread> update_thread_;
     void update();
 };
+#endif  // ESP_HEADLESS
 
 void useStream(IStream &stream);
 void usePipeline(GRT::GestureRecognitionPipeline &pipeline);
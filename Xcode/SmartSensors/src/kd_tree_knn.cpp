@@ -0,0 +1,549 @@
+#include "kd_tree_knn.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+using namespace GRT;
+
+RegisterClassifierModule<KDTreeKNN> KDTreeKNN::registerModule("KDTreeKNN");
+
+namespace {
+
+// Subtrees this small are searched by brute force.
+const uint32_t kLeafSize = 8;
+
+template <class T>
+bool readSetting(fstream& file, const char* name, T* value) {
+    string word;
+    file >> word;
+    return word == name && (file >> *value);
+}
+
+}  // namespace
+
+KDTreeKNN::KDTreeKNN(UINT k, bool use_scaling, bool use_null_rejection,
+                     double null_rejection_coeff)
+        : k_(k), epsilon_(0), num_distances_(0) {
+    useScaling = use_scaling;
+    useNullRejection = use_null_rejection;
+    nullRejectionCoeff = null_rejection_coeff;
+    supportsNullRejection = true;
+    classifierType = "KDTreeKNN";
+    classifierMode = STANDARD_CLASSIFIER_MODE;
+    debugLog.setProceedingText("[DEBUG KDTreeKNN]");
+    errorLog.setProceedingText("[ERROR KDTreeKNN]");
+    trainingLog.setProceedingText("[TRAINING KDTreeKNN]");
+    warningLog.setProceedingText("[WARNING KDTreeKNN]");
+}
+
+bool KDTreeKNN::deepCopyFrom(const Classifier* classifier) {
+    if (classifier == nullptr) { return false; }
+    if (classifierType != classifier->getClassifierType()) {
+        errorLog << "deepCopyFrom(const Classifier *classifier) - "
+                 << "Classifier Types Do Not Match!" << endl;
+        return false;
+    }
+    *this = *static_cast<const KDTreeKNN*>(classifier);
+    return true;
+}
+
+bool KDTreeKNN::train_(ClassificationData& training_data) {
+    clear();
+    const uint32_t num_samples = training_data.getNumSamples();
+    if (num_samples == 0) {
+        errorLog << "train_(ClassificationData &trainingData) - There is no "
+                 << "training data!" << endl;
+        return false;
+    }
+    if (k_ == 0) {
+        errorLog << "train_(ClassificationData &trainingData) - K must be "
+                 << "at least 1" << endl;
+        return false;
+    }
+    numInputDimensions = training_data.getNumDimensions();
+    ranges = training_data.getRanges();
+    std::map<UINT, uint32_t> class_index;
+    for (const ClassTracker& tracker : training_data.getClassTracker()) {
+        class_index[tracker.classLabel] = classLabels.size();
+        classLabels.push_back(tracker.classLabel);
+    }
+    numClasses = classLabels.size();
+
+    const uint32_t num_dimensions = numInputDimensions;
+    samples_.resize(num_samples * num_dimensions);
+    class_indices_.resize(num_samples);
+    for (uint32_t i = 0; i < num_samples; i++) {
+        scale(&training_data[i].getSample()[0], &samples_[i * num_dimensions]);
+        class_indices_[i] = class_index[training_data[i].getClassLabel()];
+    }
+    if (!init()) { return false; }
+
+    // Every sample's mean distance to its nearest neighbours in its class.
+    vector<vector<double>> class_distances(numClasses);
+    for (uint32_t i = 0; i < num_samples; i++) {
+        search(&samples_[i * num_dimensions], k_, i, class_indices_[i]);
+        if (neighbours_.empty()) { continue; }
+        double sum = 0;
+        for (const Neighbour& neighbour : neighbours_) {
+            sum += std::sqrt(neighbour.first);
+        }
+        class_distances[class_indices_[i]].push_back(sum / neighbours_.size());
+    }
+    training_mu_.assign(numClasses, 0);
+    training_sigma_.assign(numClasses, 0);
+    for (uint32_t c = 0; c < numClasses; c++) {
+        const vector<double>& distances = class_distances[c];
+        if (distances.empty()) {
+            warningLog << "train_(ClassificationData &trainingData) - Class "
+                       << classLabels[c] << " has only one sample, so its "
+                       << "null rejection threshold is 0" << endl;
+            continue;
+        }
+        double mu = 0;
+        for (double distance : distances) { mu += distance; }
+        mu /= distances.size();
+        double sum_squares = 0;
+        for (double distance : distances) {
+            sum_squares += (distance - mu) * (distance - mu);
+        }
+        training_mu_[c] = mu;
+        training_sigma_[c] = distances.size() > 1
+                ? std::sqrt(sum_squares / (distances.size() - 1)) : 0;
+    }
+    return recomputeNullRejectionThresholds();
+}
+
+bool KDTreeKNN::predict_(VectorDouble& input) {
+    if (!trained) {
+        errorLog << "predict_(VectorDouble &inputVector) - The model has not "
+                 << "been trained!" << endl;
+        return false;
+    }
+    if (input.size() != numInputDimensions) {
+        errorLog << "predict_(VectorDouble &inputVector) - The size of the "
+                 << "input vector (" << input.size() << ") does not match the "
+                 << "number of input dimensions (" << numInputDimensions << ")"
+                 << endl;
+        return false;
+    }
+
+    scale(&input[0], input_.data());
+    search(input_.data(), k_, -1, -1);
+
+    votes_.assign(numClasses, 0);
+    std::fill(classDistances.begin(), classDistances.end(), 0);
+    for (const Neighbour& neighbour : neighbours_) {
+        votes_[class_indices_[neighbour.second]]++;
+        classDistances[class_indices_[neighbour.second]] +=
+                std::sqrt(neighbour.first);
+    }
+    // Ties go to the first class, as in GRT.
+    uint32_t best = 0;
+    for (uint32_t c = 0; c < numClasses; c++) {
+        if (votes_[c] > votes_[best]) { best = c; }
+        classLikelihoods[c] = static_cast<double>(votes_[c]) / neighbours_.size();
+        classDistances[c] = votes_[c] > 0
+                ? classDistances[c] / votes_[c]
+                : std::numeric_limits<double>::max();
+    }
+
+    maxLikelihood = classLikelihoods[best];
+    bestDistance = classDistances[best];
+    predictedClassLabel = classLabels[best];
+    if (useNullRejection && bestDistance > nullRejectionThresholds[best]) {
+        predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    }
+    return true;
+}
+
+bool KDTreeKNN::clear() {
+    Classifier::clear();
+    samples_.clear();
+    class_indices_.clear();
+    nodes_.clear();
+    training_mu_.clear();
+    training_sigma_.clear();
+    neighbours_.clear();
+    num_distances_ = 0;
+    return true;
+}
+
+bool KDTreeKNN::recomputeNullRejectionThresholds() {
+    if (!trained) { return false; }
+    nullRejectionThresholds.resize(numClasses);
+    for (uint32_t c = 0; c < numClasses; c++) {
+        nullRejectionThresholds[c] =
+                training_mu_[c] + training_sigma_[c] * nullRejectionCoeff;
+    }
+    return true;
+}
+
+bool KDTreeKNN::setNullRejectionCoeff(double null_rejection_coeff) {
+    if (null_rejection_coeff <= 0) { return false; }
+    nullRejectionCoeff = null_rejection_coeff;
+    if (trained) { recomputeNullRejectionThresholds(); }
+    return true;
+}
+
+bool KDTreeKNN::setK(UINT k) {
+    if (k == 0) { return false; }
+    k_ = k;
+    return true;
+}
+
+bool KDTreeKNN::setEpsilon(double epsilon) {
+    if (epsilon < 0) { return false; }
+    epsilon_ = epsilon;
+    return true;
+}
+
+bool KDTreeKNN::saveModelToFile(fstream& file) const {
+    if (!file.is_open()) {
+        errorLog << "saveModelToFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    std::streamsize precision = file.precision(17);
+    file << "GRT_KD_TREE_KNN_MODEL_FILE_V1.0" << endl;
+    file << "UseScaling: " << useScaling << endl;
+    file << "UseNullRejection: " << useNullRejection << endl;
+    file << "NullRejectionCoeff: " << nullRejectionCoeff << endl;
+    file << "K: " << k_ << endl;
+    file << "Epsilon: " << epsilon_ << endl;
+    file << "NumInputDimensions: " << numInputDimensions << endl;
+    file << "Trained: " << trained << endl;
+    if (trained) {
+        file << "Ranges:";
+        for (const MinMax& range : ranges) {
+            file << " " << range.minValue << " " << range.maxValue;
+        }
+        file << endl;
+        file << "NumClasses: " << numClasses << endl;
+        for (uint32_t c = 0; c < numClasses; c++) {
+            file << "Class: " << classLabels[c] << " " << training_mu_[c]
+                 << " " << training_sigma_[c] << endl;
+        }
+        // Scaled, in tree order; the tree is rebuilt on loading.
+        const uint32_t num_samples = class_indices_.size();
+        file << "NumSamples: " << num_samples << endl;
+        for (uint32_t i = 0; i < num_samples; i++) {
+            file << class_indices_[i];
+            for (uint32_t d = 0; d < numInputDimensions; d++) {
+                file << " " << samples_[i * numInputDimensions + d];
+            }
+            file << "\n";
+        }
+    }
+    file.precision(precision);
+    return true;
+}
+
+bool KDTreeKNN::loadModelFromFile(fstream& file) {
+    if (!file.is_open()) {
+        errorLog << "loadModelFromFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    clear();
+
+    string word;
+    file >> word;
+    if (word != "GRT_KD_TREE_KNN_MODEL_FILE_V1.0") {
+        errorLog << "loadModelFromFile(fstream &file) - Invalid file format!"
+                 << endl;
+        return false;
+    }
+    bool is_trained = false;
+    if (!readSetting(file, "UseScaling:", &useScaling) ||
+        !readSetting(file, "UseNullRejection:", &useNullRejection) ||
+        !readSetting(file, "NullRejectionCoeff:", &nullRejectionCoeff) ||
+        !readSetting(file, "K:", &k_) ||
+        !readSetting(file, "Epsilon:", &epsilon_) ||
+        !readSetting(file, "NumInputDimensions:", &numInputDimensions) ||
+        !readSetting(file, "Trained:", &is_trained)) {
+        errorLog << "loadModelFromFile(fstream &file) - Failed to read the "
+                 << "settings" << endl;
+        return false;
+    }
+    if (!is_trained) { return true; }
+
+    const uint32_t num_dimensions = numInputDimensions;
+    ranges.resize(num_dimensions);
+    bool ok = (file >> word) && word == "Ranges:";
+    for (uint32_t d = 0; ok && d < num_dimensions; d++) {
+        ok = static_cast<bool>(file >> ranges[d].minValue >> ranges[d].maxValue);
+    }
+    ok = ok && readSetting(file, "NumClasses:", &numClasses);
+    if (ok) {
+        classLabels.resize(numClasses);
+        training_mu_.resize(numClasses);
+        training_sigma_.resize(numClasses);
+    }
+    for (uint32_t c = 0; ok && c < numClasses; c++) {
+        ok = (file >> word) && word == "Class:" &&
+             (file >> classLabels[c] >> training_mu_[c] >> training_sigma_[c]);
+    }
+    uint32_t num_samples = 0;
+    ok = ok && readSetting(file, "NumSamples:", &num_samples);
+    if (ok) {
+        samples_.resize(num_samples * num_dimensions);
+        class_indices_.resize(num_samples);
+    }
+    for (uint32_t i = 0; ok && i < num_samples; i++) {
+        ok = (file >> class_indices_[i]) && class_indices_[i] < numClasses;
+        for (uint32_t d = 0; ok && d < num_dimensions; d++) {
+            ok = static_cast<bool>(file >> samples_[i * num_dimensions + d]);
+        }
+    }
+    if (!ok || num_samples == 0) {
+        errorLog << "loadModelFromFile(fstream &file) - Failed to read the "
+                 << "model" << endl;
+        clear();
+        return false;
+    }
+    return init() && recomputeNullRejectionThresholds();
+}
+
+bool KDTreeKNN::saveModel(ModelFileWriter* writer) const {
+    if (!trained) { return false; }
+    const uint32_t num_samples = class_indices_.size();
+    const uint32_t shape[] = { numInputDimensions, numClasses, num_samples };
+    vector<double> ranges_array;
+    for (const MinMax& range : ranges) {
+        ranges_array.push_back(range.minValue);
+        ranges_array.push_back(range.maxValue);
+    }
+    // Per node: begin, end, dimension, left, right; -1 (no child) is stored
+    // as 0xffffffff.
+    vector<uint32_t> nodes;
+    vector<double> splits;
+    for (const Node& node : nodes_) {
+        nodes.push_back(node.begin);
+        nodes.push_back(node.end);
+        nodes.push_back(node.dimension);
+        nodes.push_back(static_cast<uint32_t>(node.left));
+        nodes.push_back(static_cast<uint32_t>(node.right));
+        splits.push_back(node.split);
+    }
+    writer->addBytes("model_type", classifierType);
+    writer->addWords("shape", shape, 3);
+    writer->addDoubles("ranges", ranges_array);
+    writer->addWords("class_labels", classLabels);
+    writer->addDoubles("training_mu", training_mu_);
+    writer->addDoubles("training_sigma", training_sigma_);
+    writer->addDoubles("samples", samples_);
+    writer->addWords("class_indices", class_indices_);
+    writer->addWords("nodes", nodes);
+    writer->addDoubles("splits", splits);
+    return true;
+}
+
+bool KDTreeKNN::loadModel(const ModelFileReader& reader) {
+    clear();
+
+    string type;
+    vector<uint32_t> shape;
+    if (!reader.getBytes("model_type", &type) || type != classifierType ||
+        !reader.getWords("shape", &shape, 3)) {
+        errorLog << "loadModel(const ModelFileReader &reader) - Not a "
+                 << classifierType << " model" << endl;
+        return false;
+    }
+    const uint32_t num_dimensions = shape[0];
+    const uint32_t num_classes = shape[1];
+    const uint32_t num_samples = shape[2];
+
+    vector<double> ranges_array;
+    vector<uint32_t> nodes;
+    vector<double> splits;
+    bool ok = num_dimensions > 0 && num_classes > 0 && num_samples > 0 &&
+              reader.getDoubles("ranges", &ranges_array, 2 * num_dimensions) &&
+              reader.getWords("class_labels", &classLabels, num_classes) &&
+              reader.getDoubles("training_mu", &training_mu_, num_classes) &&
+              reader.getDoubles("training_sigma", &training_sigma_,
+                                num_classes) &&
+              reader.getDoubles("samples", &samples_,
+                                uint64_t(num_samples) * num_dimensions) &&
+              reader.getWords("class_indices", &class_indices_,
+                              num_samples) &&
+              reader.getDoubles("splits", &splits) && !splits.empty() &&
+              reader.getWords("nodes", &nodes, 5 * splits.size());
+    for (uint32_t i = 0; ok && i < num_samples; i++) {
+        ok = class_indices_[i] < num_classes;
+    }
+    // Children come after their parent, so a search always terminates.
+    const uint32_t num_nodes = splits.size();
+    nodes_.resize(ok ? num_nodes : 0);
+    for (uint32_t i = 0; ok && i < num_nodes; i++) {
+        Node& node = nodes_[i];
+        node.begin = nodes[5 * i];
+        node.end = nodes[5 * i + 1];
+        node.dimension = nodes[5 * i + 2];
+        node.left = static_cast<int32_t>(nodes[5 * i + 3]);
+        node.right = static_cast<int32_t>(nodes[5 * i + 4]);
+        node.split = splits[i];
+        ok = node.begin <= node.end && node.end <= num_samples &&
+             node.dimension < num_dimensions &&
+             ((node.left < 0 && node.right < 0) ||
+              (node.left > int32_t(i) && node.right > int32_t(i) &&
+               uint32_t(node.left) < num_nodes &&
+               uint32_t(node.right) < num_nodes));
+    }
+    if (!ok) {
+        errorLog << "loadModel(const ModelFileReader &reader) - Invalid "
+                 << "model" << endl;
+        clear();
+        return false;
+    }
+
+    numInputDimensions = num_dimensions;
+    numClasses = num_classes;
+    ranges.resize(num_dimensions);
+    for (uint32_t d = 0; d < num_dimensions; d++) {
+        ranges[d].minValue = ranges_array[2 * d];
+        ranges[d].maxValue = ranges_array[2 * d + 1];
+    }
+    initScratch();
+    return recomputeNullRejectionThresholds();
+}
+
+void KDTreeKNN::scale(const double* input, double* output) const {
+    for (uint32_t d = 0; d < numInputDimensions; d++) {
+        if (!useScaling) {
+            output[d] = input[d];
+            continue;
+        }
+        double range = ranges[d].maxValue - ranges[d].minValue;
+        output[d] = range > 0 ? (input[d] - ranges[d].minValue) / range : 0;
+    }
+}
+
+bool KDTreeKNN::init() {
+    const uint32_t num_dimensions = numInputDimensions;
+    const uint32_t num_samples = class_indices_.size();
+
+    // build() sorts an index; the samples are then put in its order, so
+    // that every node's samples are contiguous.
+    vector<uint32_t> order(num_samples);
+    for (uint32_t i = 0; i < num_samples; i++) { order[i] = i; }
+    nodes_.clear();
+    build(order, 0, num_samples);
+    vector<double> samples(samples_.size());
+    vector<uint32_t> class_indices(num_samples);
+    for (uint32_t i = 0; i < num_samples; i++) {
+        const double* sample = &samples_[order[i] * num_dimensions];
+        std::copy(sample, sample + num_dimensions, &samples[i * num_dimensions]);
+        class_indices[i] = class_indices_[order[i]];
+    }
+    samples_.swap(samples);
+    class_indices_.swap(class_indices);
+    initScratch();
+    return true;
+}
+
+void KDTreeKNN::initScratch() {
+    input_.assign(numInputDimensions, 0);
+    votes_.assign(numClasses, 0);
+    neighbours_.reserve(k_ + 1);
+    classLikelihoods.assign(numClasses, 0);
+    classDistances.assign(numClasses, 0);
+    predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    maxLikelihood = 0;
+    bestDistance = 0;
+    trained = true;
+}
+
+int32_t KDTreeKNN::build(vector<uint32_t>& order, uint32_t begin,
+                         uint32_t end) {
+    const uint32_t num_dimensions = numInputDimensions;
+    int32_t index = nodes_.size();
+    Node node = { begin, end, 0, 0, -1, -1 };
+    nodes_.push_back(node);
+    if (end - begin <= kLeafSize) { return index; }
+
+    // Split the widest dimension at its median.
+    double widest = -1;
+    for (uint32_t d = 0; d < num_dimensions; d++) {
+        double min = std::numeric_limits<double>::max();
+        double max = -std::numeric_limits<double>::max();
+        for (uint32_t i = begin; i < end; i++) {
+            double value = samples_[order[i] * num_dimensions + d];
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+        if (max - min > widest) {
+            widest = max - min;
+            node.dimension = d;
+        }
+    }
+    // All samples identical: nothing to split.
+    if (widest <= 0) { return index; }
+
+    uint32_t middle = begin + (end - begin) / 2;
+    const uint32_t d = node.dimension;
+    std::nth_element(order.begin() + begin, order.begin() + middle,
+                     order.begin() + end, [&](uint32_t a, uint32_t b) {
+        return samples_[a * num_dimensions + d] <
+               samples_[b * num_dimensions + d];
+    });
+    node.split = samples_[order[middle] * num_dimensions + d];
+    node.left = build(order, begin, middle);
+    node.right = build(order, middle, end);
+    nodes_[index] = node;
+    return index;
+}
+
+void KDTreeKNN::search(const double* x, uint32_t k, int64_t exclude,
+                       int32_t class_index) {
+    neighbours_.clear();
+    num_distances_ = 0;
+    if (!nodes_.empty()) { searchNode(0, x, k, exclude, class_index); }
+    std::sort_heap(neighbours_.begin(), neighbours_.end());
+}
+
+void KDTreeKNN::searchNode(int32_t index, const double* x, uint32_t k,
+                           int64_t exclude, int32_t class_index) {
+    const Node& node = nodes_[index];
+    if (node.left < 0) {
+        for (uint32_t i = node.begin; i < node.end; i++) {
+            if (i == exclude ||
+                (class_index >= 0 &&
+                 class_indices_[i] != static_cast<uint32_t>(class_index))) {
+                continue;
+            }
+            double distance =
+                    getSquaredDistance(x, &samples_[i * numInputDimensions]);
+            num_distances_++;
+            if (neighbours_.size() < k) {
+                neighbours_.push_back(Neighbour(distance, i));
+                std::push_heap(neighbours_.begin(), neighbours_.end());
+            } else if (distance < neighbours_.front().first) {
+                std::pop_heap(neighbours_.begin(), neighbours_.end());
+                neighbours_.back() = Neighbour(distance, i);
+                std::push_heap(neighbours_.begin(), neighbours_.end());
+            }
+        }
+        return;
+    }
+
+    double diff = x[node.dimension] - node.split;
+    int32_t near = diff < 0 ? node.left : node.right;
+    int32_t far = diff < 0 ? node.right : node.left;
+    searchNode(near, x, k, exclude, class_index);
+    // Everything on the far side is at least |diff| away.
+    double bound = diff * diff * (1 + epsilon_) * (1 + epsilon_);
+    if (neighbours_.size() < k || bound < neighbours_.front().first) {
+        searchNode(far, x, k, exclude, class_index);
+    }
+}
+
+double KDTreeKNN::getSquaredDistance(const double* a, const double* b) const {
+    double sum = 0;
+    for (uint32_t d = 0; d < numInputDimensions; d++) {
+        double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
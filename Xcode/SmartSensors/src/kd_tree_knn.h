@@ -0,0 +1,120 @@
+/*
+ * KDTreeKNN is a K-nearest-neighbour classifier like GRT's KNN, but finds the
+ * neighbours with a KD-tree built at training time instead of measuring the
+ * distance to every training sample, so a prediction visits O(log n) samples
+ * rather than n once the training set is large (thousands of color or pose
+ * samples). It is a drop-in replacement for KNN in a user's setup():
+ *
+ * pipeline.setClassifier(KDTreeKNN(10, true, true, 10.0));
+ *
+ * Like GRT's KNN, the predicted class is the most common one among the K
+ * nearest training samples (Euclidean distance), its likelihood the share of
+ * the K it has, and its distance their mean distance. Null rejection rejects
+ * a prediction whose class distance is above mu + null_rejection_coeff *
+ * sigma, where mu and sigma are over the class's training samples' mean
+ * distance to their K nearest neighbours of the same class.
+ *
+ * The search is exact by default. With setEpsilon(e) > 0 it is approximate:
+ * branches that cannot hold a neighbour closer than 1 / (1 + e) of the
+ * current K-th distance are skipped, so every neighbour found is within
+ * (1 + e) times the distance of the true one of the same rank, and far fewer
+ * samples are visited. Samples at exactly the same distance may be picked in
+ * a different order than by GRT's KNN.
+ */
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "model_file.h"
+
+class KDTreeKNN : public GRT::Classifier, public BinaryModel {
+  public:
+    KDTreeKNN(GRT::UINT k = 10, bool use_scaling = false,
+              bool use_null_rejection = false,
+              double null_rejection_coeff = 10.0);
+    virtual ~KDTreeKNN() {}
+
+    virtual bool deepCopyFrom(const GRT::Classifier* classifier);
+    virtual bool train_(GRT::ClassificationData& training_data);
+    virtual bool predict_(GRT::VectorDouble& input);
+    virtual bool clear();
+    virtual bool recomputeNullRejectionThresholds();
+    virtual bool setNullRejectionCoeff(double null_rejection_coeff);
+    virtual bool saveModelToFile(std::fstream& file) const;
+    virtual bool loadModelFromFile(std::fstream& file);
+    // The tree is saved as it is, so loading does not rebuild it.
+    virtual bool saveModel(ModelFileWriter* writer) const;
+    virtual bool loadModel(const ModelFileReader& reader);
+
+    using GRT::MLBase::saveModelToFile;
+    using GRT::MLBase::loadModelFromFile;
+
+    // Takes effect at the next training.
+    bool setK(GRT::UINT k);
+    bool setEpsilon(double epsilon);
+    GRT::UINT getK() const { return k_; }
+    double getEpsilon() const { return epsilon_; }
+    // The scaled training samples, row-major, in tree order, and the index
+    // of each one's class in getClassLabels().
+    const std::vector<double>& getSamples() const { return samples_; }
+    const std::vector<uint32_t>& getSampleClasses() const {
+        return class_indices_;
+    }
+    // How many training samples the last prediction measured the distance
+    // to.
+    uint32_t getNumDistancesComputed() const { return num_distances_; }
+
+  private:
+    // A subtree: samples [begin, end) of the reordered training set, split
+    // on `dimension` at `split` into the children, unless it is a leaf.
+    struct Node {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t dimension;
+        double split;
+        int32_t left;
+        int32_t right;
+    };
+    // (squared distance, sample index), a max-heap on the distance.
+    typedef std::pair<double, uint32_t> Neighbour;
+
+    void scale(const double* input, double* output) const;
+    // Adds the subtree of samples order[begin, end) and returns its index;
+    // reorders `order` so that each node's samples are contiguous.
+    int32_t build(std::vector<uint32_t>& order, uint32_t begin, uint32_t end);
+    // Finds the k nearest samples to `x` (scaled), skipping `exclude` and,
+    // if `class_index` is not -1, samples of other classes. Leaves them in
+    // neighbours_, nearest first.
+    void search(const double* x, uint32_t k, int64_t exclude,
+                int32_t class_index);
+    void searchNode(int32_t node, const double* x, uint32_t k,
+                    int64_t exclude, int32_t class_index);
+    double getSquaredDistance(const double* a, const double* b) const;
+    // Builds the tree over samples_, then calls initScratch().
+    bool init();
+    // Sizes the scratch space and flags the model as trained.
+    void initScratch();
+
+    GRT::UINT k_;
+    double epsilon_;
+
+    // Scaled training samples, row-major, in tree order, and the index of
+    // each one's class in classLabels.
+    std::vector<double> samples_;
+    std::vector<uint32_t> class_indices_;
+    std::vector<Node> nodes_;
+    // Per class, over its training samples.
+    std::vector<double> training_mu_;
+    std::vector<double> training_sigma_;
+
+    // Scratch space.
+    std::vector<double> input_;
+    std::vector<Neighbour> neighbours_;
+    std::vector<uint32_t> votes_;
+    uint32_t num_distances_;
+
+    static GRT::RegisterClassifierModule<KDTreeKNN> registerModule;
+};
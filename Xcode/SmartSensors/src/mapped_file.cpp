@@ -0,0 +1,52 @@
+#include "mapped_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        last_error_ = "Failed to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        last_error_ = "Failed to stat " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        last_error_ = path + " is empty";
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        last_error_ = "Failed to map " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t*>(addr);
+    size_ = st.st_size;
+    last_error_.clear();
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
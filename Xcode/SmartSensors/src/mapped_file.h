@@ -0,0 +1,33 @@
+/*
+ * MappedFile maps a whole file read-only into memory, so that recorded
+ * sessions and models can be used in place without being parsed or copied.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+  public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false on failure; see getLastError().
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    const uint8_t* data_;
+    size_t size_;
+    std::string last_error_;
+};
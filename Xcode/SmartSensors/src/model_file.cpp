@@ -0,0 +1,249 @@
+#include "model_file.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+uint64_t getElementSize(uint32_t type) {
+    switch (type) {
+        case ModelArrayEntry::BYTES: return 1;
+        case ModelArrayEntry::UINT32: return sizeof(uint32_t);
+        case ModelArrayEntry::DOUBLE: return sizeof(double);
+        default: return 0;
+    }
+}
+
+uint64_t align(uint64_t offset) {
+    return (offset + kModelArrayAlignment - 1) / kModelArrayAlignment *
+           kModelArrayAlignment;
+}
+
+}  // namespace
+
+void ModelFileWriter::addBytes(const std::string& name,
+                               const std::string& bytes) {
+    add(name, ModelArrayEntry::BYTES, bytes.data(), bytes.size(), 1);
+}
+
+void ModelFileWriter::addWords(const std::string& name,
+                               const std::vector<uint32_t>& words) {
+    addWords(name, words.data(), words.size());
+}
+
+void ModelFileWriter::addWords(const std::string& name, const uint32_t* words,
+                               uint64_t count) {
+    add(name, ModelArrayEntry::UINT32, words, count, sizeof(uint32_t));
+}
+
+void ModelFileWriter::addDoubles(const std::string& name,
+                                 const std::vector<double>& doubles) {
+    addDoubles(name, doubles.data(), doubles.size());
+}
+
+void ModelFileWriter::addDoubles(const std::string& name,
+                                 const double* doubles, uint64_t count) {
+    add(name, ModelArrayEntry::DOUBLE, doubles, count, sizeof(double));
+}
+
+void ModelFileWriter::add(const std::string& name, uint32_t type,
+                          const void* data, uint64_t count,
+                          uint64_t element_size) {
+    Array array;
+    array.name = name;
+    array.type = type;
+    array.count = count;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    array.data.assign(bytes, bytes + count * element_size);
+    arrays_.push_back(array);
+}
+
+bool ModelFileWriter::fail(FILE* file, const std::string& path,
+                           const std::string& what) {
+    last_error_ = what + ": " + strerror(errno);
+    if (file != nullptr) { fclose(file); }
+    remove(path.c_str());
+    return false;
+}
+
+bool ModelFileWriter::write(const std::string& path) {
+    std::vector<ModelArrayEntry> entries(arrays_.size());
+    uint64_t offset = align(sizeof(ModelFileHeader) +
+                            arrays_.size() * sizeof(ModelArrayEntry));
+    for (size_t i = 0; i < arrays_.size(); i++) {
+        if (arrays_[i].name.size() >= sizeof(entries[i].name)) {
+            last_error_ = "Array name too long: " + arrays_[i].name;
+            return false;
+        }
+        ModelArrayEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, arrays_[i].name.data(), arrays_[i].name.size());
+        entry.type = arrays_[i].type;
+        entry.offset = offset;
+        entry.count = arrays_[i].count;
+        offset = align(offset + arrays_[i].data.size());
+    }
+
+    ModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kModelFileMagic, sizeof(header.magic));
+    header.version = kModelFileVersion;
+    header.num_arrays = arrays_.size();
+    header.file_size = offset;
+
+    const std::string temporary_path = path + ".tmp";
+    FILE* file = fopen(temporary_path.c_str(), "wb");
+    if (file == nullptr) {
+        last_error_ = "Failed to open " + temporary_path + ": " +
+                strerror(errno);
+        return false;
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        (!entries.empty() &&
+         fwrite(entries.data(), sizeof(ModelArrayEntry), entries.size(), file)
+                 != entries.size())) {
+        return fail(file, temporary_path, "Failed to write model header");
+    }
+    // Zero padding up to each array.
+    static const uint8_t kPadding[kModelArrayAlignment] = {};
+    uint64_t position = sizeof(header) + entries.size() * sizeof(entries[0]);
+    for (size_t i = 0; i <= arrays_.size(); i++) {
+        uint64_t next = i < arrays_.size() ? entries[i].offset : offset;
+        if (next > position &&
+            fwrite(kPadding, next - position, 1, file) != 1) {
+            return fail(file, temporary_path, "Failed to write model array");
+        }
+        position = next;
+        if (i == arrays_.size() || arrays_[i].data.empty()) { continue; }
+        if (fwrite(arrays_[i].data.data(), arrays_[i].data.size(), 1, file)
+                != 1) {
+            return fail(file, temporary_path, "Failed to write model array");
+        }
+        position += arrays_[i].data.size();
+    }
+    if (fclose(file) != 0) {
+        return fail(nullptr, temporary_path, "Failed to close model file");
+    }
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        return fail(nullptr, temporary_path, "Failed to rename model file");
+    }
+    last_error_.clear();
+    return true;
+}
+
+bool ModelFileReader::open(const std::string& path) {
+    close();
+
+    if (!file_.open(path)) {
+        last_error_ = file_.getLastError();
+        return false;
+    }
+
+    const ModelFileHeader* header =
+            reinterpret_cast<const ModelFileHeader*>(file_.data());
+    if (file_.size() < sizeof(*header) ||
+        memcmp(header->magic, kModelFileMagic, sizeof(header->magic)) != 0) {
+        last_error_ = path + " is not a model file";
+        close();
+        return false;
+    }
+    if (header->version != kModelFileVersion) {
+        last_error_ = path + " has unsupported model version " +
+                std::to_string(header->version);
+        close();
+        return false;
+    }
+    if (header->file_size != file_.size() ||
+        header->num_arrays > (file_.size() - sizeof(*header)) /
+                             sizeof(ModelArrayEntry)) {
+        last_error_ = path + " is truncated";
+        close();
+        return false;
+    }
+
+    const ModelArrayEntry* entries = reinterpret_cast<const ModelArrayEntry*>(
+            file_.data() + sizeof(*header));
+    entries_.assign(entries, entries + header->num_arrays);
+    for (ModelArrayEntry& entry : entries_) {
+        entry.name[sizeof(entry.name) - 1] = '\0';
+        uint64_t element_size = getElementSize(entry.type);
+        if (element_size == 0 || entry.offset % kModelArrayAlignment != 0 ||
+            entry.offset > file_.size() ||
+            entry.count > (file_.size() - entry.offset) / element_size) {
+            last_error_ = path + " has an invalid array " + entry.name;
+            close();
+            return false;
+        }
+    }
+    last_error_.clear();
+    return true;
+}
+
+void ModelFileReader::close() {
+    file_.close();
+    entries_.clear();
+}
+
+const void* ModelFileReader::get(const std::string& name, uint32_t type,
+                                 uint64_t* count) const {
+    *count = 0;
+    for (const ModelArrayEntry& entry : entries_) {
+        if (entry.type == type && name == entry.name) {
+            *count = entry.count;
+            return file_.data() + entry.offset;
+        }
+    }
+    return nullptr;
+}
+
+const uint8_t* ModelFileReader::getBytes(const std::string& name,
+                                         uint64_t* count) const {
+    return static_cast<const uint8_t*>(
+            get(name, ModelArrayEntry::BYTES, count));
+}
+
+const uint32_t* ModelFileReader::getWords(const std::string& name,
+                                          uint64_t* count) const {
+    return static_cast<const uint32_t*>(
+            get(name, ModelArrayEntry::UINT32, count));
+}
+
+const double* ModelFileReader::getDoubles(const std::string& name,
+                                          uint64_t* count) const {
+    return static_cast<const double*>(
+            get(name, ModelArrayEntry::DOUBLE, count));
+}
+
+bool ModelFileReader::getBytes(const std::string& name,
+                               std::string* bytes) const {
+    uint64_t count;
+    const uint8_t* data = getBytes(name, &count);
+    if (data == nullptr) { return false; }
+    bytes->assign(reinterpret_cast<const char*>(data), count);
+    return true;
+}
+
+bool ModelFileReader::getWords(const std::string& name,
+                               std::vector<uint32_t>* words,
+                               int64_t count) const {
+    uint64_t actual;
+    const uint32_t* data = getWords(name, &actual);
+    if (data == nullptr || (count >= 0 && actual != uint64_t(count))) {
+        return false;
+    }
+    words->assign(data, data + actual);
+    return true;
+}
+
+bool ModelFileReader::getDoubles(const std::string& name,
+                                 std::vector<double>* doubles,
+                                 int64_t count) const {
+    uint64_t actual;
+    const double* data = getDoubles(name, &actual);
+    if (data == nullptr || (count >= 0 && actual != uint64_t(count))) {
+        return false;
+    }
+    doubles->assign(data, data + actual);
+    return true;
+}
@@ -0,0 +1,133 @@
+/*
+ * Trained models in a compact binary file that loads without parsing: a
+ * header, a table of named arrays and the arrays themselves, which can be
+ * memory-mapped and read in place (see ModelFileReader).
+ *
+ * Layout (little-endian, every array 64-byte aligned):
+ *
+ *   ModelFileHeader
+ *   ModelArrayEntry[num_arrays]
+ *   array 0, array 1, ...
+ *
+ * An array is raw bytes (e.g. text), uint32s or doubles. What the arrays of
+ * a classifier are is up to the classifier (see BinaryModel below); readers
+ * look them up by name, so a later version can add arrays without breaking
+ * older files.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+const char kModelFileMagic[4] = { 'E', 'S', 'P', 'M' };
+const uint32_t kModelFileVersion = 1;
+const uint32_t kModelArrayAlignment = 64;
+
+struct ModelFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_arrays;
+    uint32_t reserved0;
+    uint64_t file_size;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(ModelFileHeader) == 64, "ModelFileHeader layout");
+
+struct ModelArrayEntry {
+    enum Type : uint32_t { BYTES = 1, UINT32 = 2, DOUBLE = 3 };
+
+    // Zero-padded; at most 31 characters.
+    char name[32];
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    // Elements, not bytes.
+    uint64_t count;
+    uint64_t reserved1;
+};
+static_assert(sizeof(ModelArrayEntry) == 64, "ModelArrayEntry layout");
+
+// Collects named arrays in memory and writes them out in one go.
+class ModelFileWriter {
+  public:
+    void addBytes(const std::string& name, const std::string& bytes);
+    void addWords(const std::string& name, const std::vector<uint32_t>& words);
+    void addWords(const std::string& name, const uint32_t* words,
+                  uint64_t count);
+    void addDoubles(const std::string& name,
+                    const std::vector<double>& doubles);
+    void addDoubles(const std::string& name, const double* doubles,
+                    uint64_t count);
+
+    // Returns false on failure; see getLastError(). The file is written to
+    // a temporary one first, so a failed write leaves `path` as it was.
+    bool write(const std::string& path);
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    struct Array {
+        std::string name;
+        uint32_t type;
+        uint64_t count;
+        std::vector<uint8_t> data;
+    };
+
+    void add(const std::string& name, uint32_t type, const void* data,
+             uint64_t count, uint64_t element_size);
+    bool fail(FILE* file, const std::string& path, const std::string& what);
+
+    std::vector<Array> arrays_;
+    std::string last_error_;
+};
+
+// Memory-maps a model file. The arrays are checked to lie within the file
+// when it is opened, so the getters return pointers into the mapping that
+// are valid until close().
+class ModelFileReader {
+  public:
+    bool open(const std::string& path);
+    void close();
+
+    // Null (and *count 0) if there is no array `name` of that type.
+    const uint8_t* getBytes(const std::string& name, uint64_t* count) const;
+    const uint32_t* getWords(const std::string& name, uint64_t* count) const;
+    const double* getDoubles(const std::string& name, uint64_t* count) const;
+
+    // Copies; false if missing, or if `count` is not -1 and the array does
+    // not have exactly that many elements.
+    bool getBytes(const std::string& name, std::string* bytes) const;
+    bool getWords(const std::string& name, std::vector<uint32_t>* words,
+                  int64_t count = -1) const;
+    bool getDoubles(const std::string& name, std::vector<double>* doubles,
+                    int64_t count = -1) const;
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    const void* get(const std::string& name, uint32_t type,
+                    uint64_t* count) const;
+
+    MappedFile file_;
+    std::vector<ModelArrayEntry> entries_;
+    std::string last_error_;
+};
+
+// A classifier whose trained model can be saved as arrays of a model file,
+// next to the GRT text of its settings (see pipeline_file.h). Loading copies
+// the arrays as they are, without recomputing anything derived from them.
+class BinaryModel {
+  public:
+    virtual ~BinaryModel() {}
+
+    // Adds the trained model's arrays. False if it is not trained.
+    virtual bool saveModel(ModelFileWriter* writer) const = 0;
+    // Replaces the model with the one in `reader`, keeping the settings.
+    // Returns false, and leaves the classifier untrained, if `reader` has no
+    // valid model of this classifier.
+    virtual bool loadModel(const ModelFileReader& reader) = 0;
+};
@@ -1,8 +1,18 @@
 #include "ofApp.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 #include <math.h>
-
+#include <sstream>
+
+#include "pipeline_export.h"
+#include "pipeline_file.h"
+#include "pipeline_rebuild.h"
+#include "sample_clock.h"
+#include "tracer.h"
+#include "training_browser.h"
 #include "user.h"
 
 // If the feature output dimension is larger than 32, making the visualization a
@@ -12,10 +22,15 @@ static const char* kInstruction =
         "Press capital C/P/T/A to change tabs. "
         "`p` to pause or resume, 1-9 to record samples \n"
         "`r` to record test data, `f` to show features, `s` to save data"
-        "`l` to load training data, and `t` to train a model.";
+        "`l` to load training data, `t` to train a model (`c` to cancel), \n"
+        "`o` to show latencies, `d` to dump them to a file and `x` to trace.";
 
 const double kPipelineHeightWeight = 0.3;
 
+// Number of processed samples that can be queued between the inference thread
+// and the GUI thread. At 44.1 kHz audio this is more than a second of data.
+const uint32_t kProcessedSamplesCapacity = 1 << 16;
+
 class Palette {
   public:
     vector<ofColor> generate(uint32_t n) {
@@ -75,7 +90,11 @@ ofApp::ofApp() : fragment_(TRAINING),
                  num_pipeline_stages_(0),
                  ostream_(NULL),
                  should_save_training_data_(false),
-                 calibrator_(nullptr) {
+                 calibrator_(nullptr),
+                 capture_stages_(false),
+                 needs_calibration_(false),
+                 processed_samples_(kProcessedSamplesCapacity) {
+    setRuntime(this);
 }
 
 //--------------------------------------------------------------
@@ -94,7 +113,16 @@ void ofApp::setup() {
         }
     }
 
-    istream_->onDataReadyEvent(this, &ofApp::onDataIn);
+    engine_.setCalibrator(calibrator_);
+    engine_.setOStream(ostream_);
+    engine_.onInput([this](const GRT::MatrixDouble& input,
+                           const vector<int64_t>& timestamps_ns, int64_t) {
+        session_recorder_.record(input, timestamps_ns);
+    });
+    engine_.onResult([this](const InferenceEngine::Result& result) {
+        onInferenceResult(result);
+    });
+    startSessionRecording();
 
     const vector<string>& istream_labels = istream_->getLabels();
     plot_raw_.setup(kBufferSize_, istream_->getNumOutputDimensions(), "Raw Data");
@@ -270,8 +298,9 @@ void ofApp::setup() {
 
     ofBackground(54, 54, 54);
 
-    // After everything is setup, start streaming.
-    istream_->start();
+    // After everything is setup, start inference and streaming.
+    publishPipeline();
+    engine_.start(istream_);
 }
 
 void ofApp::onPlotRangeSelected(Plotter::CallbackArgs arg) {
@@ -354,10 +383,10 @@ void ofApp::updateTestWindowPlot() {
     for (int i = start; i < end; i++) {
         plot_testdata_window_.setup(end - start, istream_->getNumInputDimensions(), "Test Data");
         for (int i = start; i < end; i++) {
-            if (pipeline_->getTrained()) {
+            if (trained_pipeline_ != nullptr) {
                 int predicted_label = test_data_predicted_class_labels_[i];
-                std::string title = training_data_.getClassNameForCorrespondingClassLabel(predicted_label);
-                if (title == "NOT_SET") title = std::string("Label") + std::to_string(predicted_label);
+                std::string title = training_data_.getClassName(predicted_label);
+                if (title.empty()) title = std::string("Label") + std::to_string(predicted_label);
 
                 plot_testdata_window_.update(test_data_.getRowVector(i), predicted_label != 0, title);
             } else {
@@ -368,40 +397,147 @@ void ofApp::updateTestWindowPlot() {
 }
 
 void ofApp::runPredictionOnTestData() {
-    test_data_predicted_class_labels_.resize(test_data_.getNumRows());
+    test_data_predicted_class_labels_.assign(test_data_.getNumRows(), 0);
+    if (trained_pipeline_ == nullptr) { return; }
+
+    // A fresh copy, so that neither the live pipeline's state nor an earlier
+    // run affects the result.
+    GRT::GestureRecognitionPipeline pipeline(*trained_pipeline_);
     for (int i = 0; i < test_data_.getNumRows(); i++) {
-        if (pipeline_->getTrained()) {
-            pipeline_->predict(test_data_.getRowVector(i));
+        // Replay the test data on the clock it was recorded with.
+        setSampleTimeNs(i < test_data_times_.size() ? test_data_times_[i]
+                                                    : kNoSampleTime);
+        pipeline.predict(test_data_.getRowVector(i));
 
-            int predicted_label = pipeline_->getPredictedClassLabel();
+        int predicted_label = pipeline.getPredictedClassLabel();
 
-            test_data_predicted_class_labels_[i] = predicted_label;
-        } else {
-            test_data_predicted_class_labels_[i] = 0;
-        }
+        test_data_predicted_class_labels_[i] = predicted_label;
     }
-
+    setSampleTimeNs(kNoSampleTime);
 }
 
 void ofApp::savePipeline() {
-    if (!pipeline_->save("pipeline.grt")) {
+    if (trained_pipeline_ == nullptr) {
+        ofLog(OF_LOG_ERROR) << "There is no trained pipeline to save";
+        return;
+    }
+    // An export still running from the last save would write
+    // model_fixed_point.h after this one.
+    if (export_job_ != nullptr) {
+        finishFixedPointExport();
+    }
+
+    GRT::GestureRecognitionPipeline pipeline(*trained_pipeline_);
+    if (!pipeline.save("pipeline.grt")) {
         ofLog(OF_LOG_ERROR) << "Failed to save the pipeline";
     }
 
-    if (!pipeline_->getClassifier()->save("classifier.grt")) {
+    if (!pipeline.getClassifier()->save("classifier.grt")) {
         ofLog(OF_LOG_ERROR) << "Failed to save the classifier";
     }
+
+    // The same pipeline as a model file, which loads much faster.
+    // loadPipeline() prefers it over pipeline.grt, so one left over from an
+    // earlier save must not outlive a failed one.
+    std::string error;
+    if (!savePipelineFile(pipeline, "pipeline.espm", &error)) {
+        ofLog(OF_LOG_ERROR) << "Failed to save pipeline.espm: " << error;
+        remove("pipeline.espm");
+    }
+
+    // The same model as code for an Arduino sketch, if it can be exported.
+    // Otherwise headers exported from an earlier pipeline are removed, so
+    // that they cannot be mistaken for this one.
+    std::ostringstream header;
+    if (!exportPipelineHeader(pipeline, "model", header, &error)) {
+        ofLog(OF_LOG_NOTICE) << "Not exporting model.h: " << error;
+        remove("model.h");
+        remove("model_fixed_point.h");
+        return;
+    }
+    std::ofstream file("model.h");
+    if (!(file << header.str())) {
+        ofLog(OF_LOG_ERROR) << "Failed to save model.h";
+    }
+
+    // And in fixed point, for boards without an FPU, with the scales
+    // calibrated on the training data.
+    startFixedPointExport();
+}
+
+void ofApp::startFixedPointExport() {
+    export_job_.reset(new ExportJob());
+    ExportJob* job = export_job_.get();
+    job->pipeline = trained_pipeline_;
+    job->data = training_data_;
+    job->is_exportable = false;
+    job->is_saved = false;
+    job->is_done = false;
+
+    // As with training, finishFixedPointExport() joins the thread before the
+    // job is released.
+    export_thread_ = std::thread([job]() {
+        std::ostringstream header;
+        job->is_exportable = exportFixedPointHeader(
+                *job->pipeline, job->data.toTimeSeriesData(), "model", header,
+                &job->error);
+        if (job->is_exportable) {
+            std::ofstream file("model_fixed_point.h");
+            job->is_saved = static_cast<bool>(file << header.str());
+        } else {
+            remove("model_fixed_point.h");
+        }
+        job->is_done = true;
+    });
+}
+
+void ofApp::finishFixedPointExport() {
+    export_thread_.join();
+    unique_ptr<ExportJob> job = std::move(export_job_);
+
+    if (!job->is_exportable) {
+        ofLog(OF_LOG_NOTICE) << "Not exporting model_fixed_point.h: "
+                             << job->error;
+    } else if (!job->is_saved) {
+        ofLog(OF_LOG_ERROR) << "Failed to save model_fixed_point.h";
+    }
 }
 
 void ofApp::loadPipeline() {
+    // pipeline.grt is only read if there is no usable model file, e.g. when
+    // the pipeline was saved by an older version.
     GRT::GestureRecognitionPipeline pipeline;
-    if (!pipeline.load("pipeline.grt")) {
-        ofLog(OF_LOG_ERROR) << "Failed to load the pipeline";
+    std::string error;
+    if (!loadPipelineFile("pipeline.espm", &pipeline, &error)) {
+        ofLog(OF_LOG_NOTICE) << "Not loading pipeline.espm: " << error;
+        pipeline = GRT::GestureRecognitionPipeline();
+        if (!pipeline.load("pipeline.grt")) {
+            ofLog(OF_LOG_ERROR) << "Failed to load the pipeline";
+        }
     }
 
     // TODO(benzh) Compare the two pipelines and warn the user if the
     // loaded one is different from his.
+    cancelTraining();
     (*pipeline_) = pipeline;
+    if (pipeline.getTrained()) {
+        trained_pipeline_ = std::make_shared<GRT::GestureRecognitionPipeline>(pipeline);
+    } else {
+        trained_pipeline_.reset();
+    }
+    trained_settings_.reset();
+    publishPipeline();
+}
+
+void ofApp::publishPipeline() {
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline =
+            trained_pipeline_;
+    if (pipeline == nullptr) {
+        // Untrained, but the inference thread still runs the pre-processing
+        // and feature extraction stages for the pipeline tab.
+        pipeline = std::make_shared<GRT::GestureRecognitionPipeline>(*pipeline_);
+    }
+    engine_.setPipeline(pipeline);
 }
 
 void ofApp::renameTrainingSample(int num) {
@@ -411,14 +547,7 @@ void ofApp::renameTrainingSample(int num) {
     }
 
     int label = num + 1;
-    rename_title_ = training_data_.getClassNameForCorrespondingClassLabel(label);
-
-    // Hide internal names
-    if (rename_title_ == "CLASS_LABEL_NOT_FOUND" ||
-        rename_title_ == "NOT_SET") {
-        rename_title_ = "";
-    }
-
+    rename_title_ = training_data_.getClassName(label);
     is_in_renaming_ = true;
     rename_target_ = label;
     display_title_ = rename_title_;
@@ -428,8 +557,7 @@ void ofApp::renameTrainingSample(int num) {
 }
 
 void ofApp::renameTrainingSampleDone() {
-    training_data_.setClassNameForCorrespondingClassLabel(rename_title_,
-                                                          rename_target_);
+    training_data_.setClassName(rename_target_, rename_title_);
     is_in_renaming_ = false;
     plot_samples_[rename_target_ - 1].setTitle(rename_title_);
     ofRemoveListener(ofEvents().update, this, &ofApp::updateEventReceived);
@@ -454,28 +582,21 @@ void ofApp::updateEventReceived(ofEventArgs& arg) {
 
 void ofApp::deleteTrainingSample(int num) {
     int label = num + 1;
-    string class_name =
-            training_data_.getClassNameForCorrespondingClassLabel(label);
-
-    // AFAICT, there's no way to delete an individual sample (except the
-    // last one. Instead, remove all samples with the corresponding label
-    // and add back all the ones except the one we want to delete.
-    TimeSeriesClassificationData data = training_data_.getClassData(label);
-    training_data_.eraseAllSamplesWithClassLabel(label);
-    for (int i = 0; i < data.getNumSamples(); i++)
-        if (i != plot_sample_indices_[num])
-            training_data_.addSample(label, data[i].getData());
-
-    if (data.getNumSamples() > 1) {
+    const vector<uint32_t>& ids = training_data_.getClassSampleIds(label);
+    if (plot_sample_indices_[num] < 0 ||
+        plot_sample_indices_[num] >= ids.size()) {
+        return;
+    }
+
+    // The samples after the deleted one move down one place in `ids`.
+    training_data_.erase(ids[plot_sample_indices_[num]]);
+    if (!ids.empty()) {
         // if we were showing the last sample, need to show previous one
-        if (plot_sample_indices_[num] + 1 == data.getNumSamples()) {
+        if (plot_sample_indices_[num] == ids.size()) {
             plot_sample_indices_[num]--;
-            plot_samples_[num].setData(data[plot_sample_indices_[num]].getData());
-        } else {
-            plot_samples_[num].setData(data[plot_sample_indices_[num] + 1].getData());
         }
-
-        training_data_.setClassNameForCorrespondingClassLabel(class_name, label);
+        plot_samples_[num].setData(
+                training_data_.getMatrix(ids[plot_sample_indices_[num]]));
     } else {
         plot_samples_[num].reset();
         plot_sample_indices_[num] = -1;
@@ -492,28 +613,20 @@ void ofApp::trimTrainingSample(int num) {
     if (selection.second - selection.first < 10) { return; }
 
     int label = num + 1;
-    string class_name =
-            training_data_.getClassNameForCorrespondingClassLabel(label);
-    TimeSeriesClassificationData data = training_data_.getClassData(label);
-    training_data_.eraseAllSamplesWithClassLabel(label);
-
-    for (int i = 0; i < data.getNumSamples(); i++) {
-        if (i == plot_sample_indices_[num]) {
-            GRT::MatrixDouble sample = data[i].getData();
-            GRT::MatrixDouble new_sample;
-
-            assert(selection.second - selection.first < sample.getNumRows());
-            for (int row = selection.first; row < selection.second; row++) {
-                new_sample.push_back(sample.getRowVector(row));
-            }
-            training_data_.addSample(label, new_sample);
-            plot_samples_[num].setData(new_sample);
-        } else {
-            training_data_.addSample(label, data[i].getData());
-        }
+    const vector<uint32_t>& ids = training_data_.getClassSampleIds(label);
+    if (plot_sample_indices_[num] < 0 ||
+        plot_sample_indices_[num] >= ids.size()) {
+        return;
+    }
+
+    // The sample keeps its values; it only uses fewer of them.
+    uint32_t id = ids[plot_sample_indices_[num]];
+    if (!training_data_.trim(id, selection.first,
+                             selection.second - selection.first)) {
+        return;
     }
+    plot_samples_[num].setData(training_data_.getMatrix(id));
 
-    training_data_.setClassNameForCorrespondingClassLabel(class_name, label);
     populateSampleFeatures(num);
     should_save_training_data_ = true;
 }
@@ -531,32 +644,25 @@ void ofApp::doRelabelTrainingSample(uint32_t source, uint32_t target) {
 
     // plot_samples_ (num) is 0-based, labels (source and target) are 1-based.
     uint32_t num = source - 1;
-    MatrixDouble target_data;
-
-    // Below is adapted from deleteTrainingSample. We delete sample first (need
-    // to store it, that's why we can't just call deleteTrainingSample) and then
-    // add it back with a different label.
-    int label = num + 1;
-
-    TimeSeriesClassificationData data = training_data_.getClassData(label);
-    training_data_.eraseAllSamplesWithClassLabel(label);
-    for (int i = 0; i < data.getNumSamples(); i++) {
-        if (i != plot_sample_indices_[num]) {
-            training_data_.addSample(label, data[i].getData());
-        } else {
-            target_data = data[i].getData();
-            training_data_.addSample(target, target_data);
-        }
+    const vector<uint32_t>& ids = training_data_.getClassSampleIds(source);
+    if (plot_sample_indices_[num] < 0 ||
+        plot_sample_indices_[num] >= ids.size()) {
+        return;
     }
 
-    if (data.getNumSamples() > 1) {
+    // The sample keeps its place in the training data; for the plots, it is
+    // as if it was deleted from one label and added to the other. The samples
+    // after it move down one place in `ids`.
+    uint32_t id = ids[plot_sample_indices_[num]];
+    training_data_.setClassLabel(id, target);
+
+    if (!ids.empty()) {
         // if we were showing the last sample, need to show previous one
-        if (plot_sample_indices_[num] + 1 == data.getNumSamples()) {
+        if (plot_sample_indices_[num] == ids.size()) {
             plot_sample_indices_[num]--;
-            plot_samples_[num].setData(data[plot_sample_indices_[num]].getData());
-        } else {
-            plot_samples_[num].setData(data[plot_sample_indices_[num] + 1].getData());
         }
+        plot_samples_[num].setData(
+                training_data_.getMatrix(ids[plot_sample_indices_[num]]));
     } else {
         plot_samples_[num].reset();
         plot_sample_indices_[num] = -1;
@@ -565,8 +671,12 @@ void ofApp::doRelabelTrainingSample(uint32_t source, uint32_t target) {
     populateSampleFeatures(num);
 
     // For the target label, update the plot.
-    plot_sample_indices_[target - 1]++;
-    plot_samples_[target - 1].setData(target_data);
+    const vector<uint32_t>& target_ids =
+            training_data_.getClassSampleIds(target);
+    plot_sample_indices_[target - 1] =
+            std::lower_bound(target_ids.begin(), target_ids.end(), id) -
+            target_ids.begin();
+    plot_samples_[target - 1].setData(training_data_.getMatrix(id));
     populateSampleFeatures(target - 1);
 
     should_save_training_data_ = true;
@@ -574,53 +684,63 @@ void ofApp::doRelabelTrainingSample(uint32_t source, uint32_t target) {
 
 //--------------------------------------------------------------
 void ofApp::update() {
-    std::lock_guard<std::mutex> guard(input_data_mutex_);
-    for (int i = 0; i < input_data_.getNumRows(); i++){
-        vector<double> raw_data = input_data_.getRowVector(i);
-        vector<double> data_point;
-        plot_raw_.update(raw_data);
-        if (calibrator_ == nullptr) {
-            data_point = raw_data;
-        } else if (calibrator_->isCalibrated()) {
-            data_point = calibrator_->calibrate(raw_data);
-        } else {
-            // Not calibrated! For now, force the tab to be CALIBRATION.
-            fragment_ = CALIBRATION;
-        }
+    if (training_job_ != nullptr && training_job_->is_done) {
+        finishTraining();
+    }
+    if (rebuild_job_ != nullptr && rebuild_job_->is_done) {
+        finishRebuild();
+    }
+    if (export_job_ != nullptr && export_job_->is_done) {
+        finishFixedPointExport();
+    }
+    if (is_reload_pending_ && rebuild_job_ == nullptr &&
+        ofGetElapsedTimeMillis() - reload_requested_ms_ >= kReloadSettleMs_) {
+        is_reload_pending_ = false;
+        rebuildPipeline();
+    }
 
-        if (pipeline_->getTrained()) {
-            pipeline_->predict(data_point);
-            predicted_label_ = pipeline_->getPredictedClassLabel();
-            predicted_class_distances_ = pipeline_->getClassDistances();
-            predicted_class_likelihoods_ = pipeline_->getClassLikelihoods();
-            predicted_class_labels_ = pipeline_->getClassifier()->getClassLabels();
+    uint64_t dropped = getNumDroppedSamples();
+    if (dropped != reported_dropped_samples_) {
+        ofLog(OF_LOG_WARNING) << "Dropped " << dropped - reported_dropped_samples_
+                              << " input samples (" << getNumSampleOverruns()
+                              << " overruns so far)";
+        reported_dropped_samples_ = dropped;
+    }
 
-            if (ostream_ != NULL && predicted_label_ != 0) {
-                ostream_->onReceive(predicted_label_);
-            }
-        }
+    if (needs_calibration_.exchange(false)) {
+        // Not calibrated! For now, force the tab to be CALIBRATION.
+        fragment_ = CALIBRATION;
+    }
+    capture_stages_ = istream_->hasStarted() && fragment_ == PIPELINE;
+
+    if (prediction_.update()) {
+        const Prediction& prediction = prediction_.front();
+        predicted_label_ = prediction.label;
+        predicted_class_distances_ = prediction.class_distances;
+        predicted_class_likelihoods_ = prediction.class_likelihoods;
+        predicted_class_labels_ = prediction.class_labels;
+    }
 
-        std::string title =
-                training_data_.getClassNameForCorrespondingClassLabel(predicted_label_);
-        if (title == "NOT_SET") {
-            title = std::string("Label") + std::to_string(predicted_label_);
-        }
+    // Plot and record every sample processed since the last frame.
+    for (ProcessedSample* sample = processed_samples_.front(); sample != nullptr;
+         processed_samples_.pop(), sample = processed_samples_.front()) {
+        plot_raw_.update(sample->raw);
 
-        plot_inputs_.update(data_point, predicted_label_ != 0, title);
+        std::string title = training_data_.getClassName(sample->label);
+        if (title.empty()) {
+            title = std::string("Label") + std::to_string(sample->label);
+        }
 
-        if (istream_->hasStarted() && fragment_ == PIPELINE) {
-            if (!pipeline_->preProcessData(data_point)) {
-                ofLog(OF_LOG_ERROR) << "ERROR: Failed to compute features!";
-            }
+        plot_inputs_.update(sample->input, sample->label != 0, title);
 
-            for (int j = 0; j < pipeline_->getNumPreProcessingModules(); j++) {
-                vector<double> data = pipeline_->getPreProcessedData(j);
-                plot_pre_processed_[j].update(data);
+        if (sample->has_stages && fragment_ == PIPELINE) {
+            for (int j = 0; j < sample->pre_processed.size(); j++) {
+                plot_pre_processed_[j].update(sample->pre_processed[j]);
             }
 
-            for (int j = 0; j < pipeline_->getNumFeatureExtractionModules(); j++) {
+            for (int j = 0; j < sample->features.size(); j++) {
                 // Working on j-th stage.
-                vector<double> feature = pipeline_->getFeatureExtractionData(j);
+                const vector<double>& feature = sample->features[j];
                 if (feature.size() < kTooManyFeaturesThreshold) {
                     for (int k = 0; k < feature.size(); k++) {
                         vector<double> v = { feature[k] };
@@ -635,14 +755,62 @@ void ofApp::update() {
 
         if (is_recording_) {
             if (fragment_ == CALIBRATION) {
-                sample_data_.push_back(raw_data);
+                sample_data_.push_back(sample->raw);
             } else {
-                sample_data_.push_back(data_point);
+                sample_data_.push_back(sample->input);
             }
+            sample_times_.push_back(sample->time_ns);
         }
     }
 }
 
+uint64_t ofApp::getNumDroppedSamples() const {
+    return engine_.getNumDropped() + processed_samples_.getNumDropped();
+}
+
+uint64_t ofApp::getNumSampleOverruns() const {
+    return engine_.getNumOverruns() + processed_samples_.getNumOverruns();
+}
+
+void ofApp::onInferenceResult(const InferenceEngine::Result& result) {
+    if (!result.is_calibrated) { needs_calibration_ = true; }
+
+    GRT::GestureRecognitionPipeline& pipeline = result.pipeline;
+    if (result.is_predicted) {
+        Prediction& prediction = prediction_.back();
+        prediction.label = result.label;
+        prediction.class_likelihoods = result.class_likelihoods;
+        prediction.class_distances = pipeline.getClassifier()->getClassDistances();
+        prediction.class_labels = pipeline.getClassifier()->getClassLabels();
+        prediction_.publish();
+    }
+
+    // predict() has already run the pre-processing and feature extraction
+    // stages; an untrained pipeline has to run them separately.
+    bool capture_stages = capture_stages_;
+    if (capture_stages && !result.is_predicted &&
+        !pipeline.preProcessData(result.input)) {
+        ofLog(OF_LOG_ERROR) << "ERROR: Failed to compute features!";
+    }
+
+    processed_samples_.pushWith([&](ProcessedSample& slot) {
+        slot.time_ns = result.time_ns;
+        slot.raw = result.raw;
+        slot.input = result.input;
+        slot.label = result.label;
+        slot.has_stages = capture_stages;
+        if (!capture_stages) { return; }
+        slot.pre_processed.resize(pipeline.getNumPreProcessingModules());
+        for (int j = 0; j < slot.pre_processed.size(); j++) {
+            slot.pre_processed[j] = pipeline.getPreProcessedData(j);
+        }
+        slot.features.resize(pipeline.getNumFeatureExtractionModules());
+        for (int j = 0; j < slot.features.size(); j++) {
+            slot.features[j] = pipeline.getFeatureExtractionData(j);
+        }
+    });
+}
+
 void ofDrawColoredBitmapString(ofColor color,
                                const string& text,
                                float x, float y) {
@@ -708,11 +876,105 @@ void ofApp::draw() {
     // Show instructions across all tabs.
     ofDrawBitmapString(kInstruction, left_margin, top_margin + margin);
 
+    if (session_recorder_.hasFailed()) {
+        ofDrawColoredBitmapString(
+            red, "Session recording stopped: " + session_recorder_.getLastError(),
+            left_margin, ofGetHeight() - margin);
+    } else if (session_recorder_.getNumDropped() > 0) {
+        ofDrawColoredBitmapString(
+            red, "Session recording dropped " +
+            std::to_string(session_recorder_.getNumDropped()) + " samples",
+            left_margin, ofGetHeight() - margin);
+    }
+
+    if (training_job_ != nullptr) {
+        uint64_t elapsed_ms = ofGetElapsedTimeMillis() - training_job_->start_time_ms;
+        string status = training_job_->is_cancelled ? "Cancelling training"
+                                                    : "Training";
+        ofDrawColoredBitmapString(
+            red, status + "... " + std::to_string(elapsed_ms / 1000) +
+            "s (press c to cancel)", ofGetWidth() - 400, top_margin + margin);
+    }
+
+    // Let the user know if input could not be processed fast enough.
+    if (getNumDroppedSamples() > 0) {
+        ofDrawColoredBitmapString(
+            red, "Dropped " + std::to_string(getNumDroppedSamples()) +
+            " samples in " + std::to_string(getNumSampleOverruns()) +
+            " overruns", ofGetWidth() - 400, top_margin);
+    }
+
+    if (is_profile_visible_) {
+        drawProfile();
+    }
+
+    if (getTracer().isTracing()) {
+        ofDrawColoredBitmapString(red, "Tracing (press x to stop)",
+                                  ofGetWidth() - 400, top_margin + margin * 2);
+    }
+
     if (!gui_hide_) {
         gui_.draw();
     }
 }
 
+void ofApp::drawProfile() {
+    const uint32_t kLineHeight = 14;
+    const uint32_t kWidth = 660;
+    vector<Profiler::Summary> summaries = getProfiler().getSummaries();
+
+    uint32_t left = 10;
+    uint32_t top = ofGetHeight() - (summaries.size() + 2) * kLineHeight - 40;
+    ofPushStyle();
+    ofSetColor(0, 0, 0, 200);
+    ofDrawRectangle(left, top, kWidth, (summaries.size() + 2) * kLineHeight);
+    ofPopStyle();
+
+    std::ostringstream table;
+    table << std::left << std::setw(48) << "Latency ('d' to dump)" << std::right
+          << std::setw(8) << "p50" << std::setw(10) << "p99"
+          << std::setw(10) << "max";
+    ofDrawBitmapString(table.str(), left + 5, top + kLineHeight);
+    for (uint32_t i = 0; i < summaries.size(); i++) {
+        const Profiler::Summary& s = summaries[i];
+        table.str("");
+        table << std::left << std::setw(48) << s.name.substr(0, 47) << std::right
+              << std::setw(8) << formatDuration(s.p50_ns)
+              << std::setw(10) << formatDuration(s.p99_ns)
+              << std::setw(10) << formatDuration(s.max_ns);
+        ofDrawBitmapString(table.str(), left + 5, top + (i + 2) * kLineHeight);
+    }
+}
+
+void ofApp::dumpProfile() {
+    string path = ofToDataPath(
+            "profile-" + ofGetTimestampString("%Y%m%d-%H%M%S") + ".txt", true);
+    std::ofstream out(path.c_str());
+    getProfiler().dump(out);
+    if (!out) {
+        ofLog(OF_LOG_ERROR) << "Failed to write the latency profile to " << path;
+        return;
+    }
+    ofLog() << "Wrote the latency profile to " << path;
+}
+
+void ofApp::toggleTrace() {
+    Tracer& tracer = getTracer();
+    if (!tracer.isTracing()) {
+        tracer.start();
+        ofLog() << "Tracing; press x again to stop.";
+        return;
+    }
+    string path = ofToDataPath(
+            "trace-" + ofGetTimestampString("%Y%m%d-%H%M%S") + ".json", true);
+    if (!tracer.stop(path)) {
+        ofLog(OF_LOG_ERROR) << tracer.getLastError();
+        return;
+    }
+    ofLog() << "Wrote the trace to " << path
+            << "; open it in chrome://tracing or ui.perfetto.dev";
+}
+
 void ofApp::drawCalibration() {
     uint32_t margin = 30;
     uint32_t stage_left = 10;
@@ -805,7 +1067,6 @@ void ofApp::drawTrainingInfo() {
     uint32_t width = stage_width / kNumMaxLabels_;
     float minY = plot_inputs_.getRanges().first;
     float maxY = plot_inputs_.getRanges().second;
-    auto class_tracker = training_data_.getClassTracker();
 
     for (int i = 0; i < kNumMaxLabels_; i++) {
         int label = i + 1;
@@ -813,19 +1074,17 @@ void ofApp::drawTrainingInfo() {
         plot_samples_[i].setRanges(minY, maxY, true);
         plot_samples_[i].draw(x, stage_top, width, stage_height);
 
-        for (int j = 0; j < class_tracker.size(); j++) {
-            if (class_tracker[j].classLabel == label) {
-                ofDrawBitmapString(
-                    std::to_string(plot_sample_indices_[i] + 1) + " / " +
-                    std::to_string(class_tracker[j].counter), x + width / 2 - 20,
-                    stage_top + stage_height + 20);
-                if (plot_sample_indices_[i] > 0)
-                    ofDrawBitmapString("<-", x, stage_top + stage_height + 20);
-                if (plot_sample_indices_[i] + 1 < class_tracker[j].counter)
-                    ofDrawBitmapString("->", x + width - 20, stage_top + stage_height + 20);
-                plot_sample_button_locations_[i].first.set(x, stage_top + stage_height, 20, 20);
-                plot_sample_button_locations_[i].second.set(x + width - 20, stage_top + stage_height, 20, 20);
-            }
+        TrainingSampleCaption caption = getTrainingSampleCaption(
+                training_data_, label, plot_sample_indices_[i]);
+        if (caption.num_samples > 0) {
+            ofDrawBitmapString(caption.text, x + width / 2 - 20,
+                               stage_top + stage_height + 20);
+            if (caption.has_previous)
+                ofDrawBitmapString("<-", x, stage_top + stage_height + 20);
+            if (caption.has_next)
+                ofDrawBitmapString("->", x + width - 20, stage_top + stage_height + 20);
+            plot_sample_button_locations_[i].first.set(x, stage_top + stage_height, 20, 20);
+            plot_sample_button_locations_[i].second.set(x + width - 20, stage_top + stage_height, 20, 20);
         }
 
         // TODO(dmellis): only update these values when the screen size changes.
@@ -866,7 +1125,7 @@ void ofApp::drawTrainingInfo() {
     for (uint32_t i = 0; i < kNumMaxLabels_; i++) {
         uint32_t x = stage_left + i * width;
         uint32_t y = stage_top;
-        vector<Plotter> feature_plots = plot_sample_features_[i];
+        vector<Plotter>& feature_plots = plot_sample_features_[i];
         uint32_t margin = 5;
         uint32_t height = stage_height / feature_plots.size() - margin;
 
@@ -907,10 +1166,18 @@ void ofApp::drawAnalysis() {
 }
 
 void ofApp::exit() {
+    cancelTraining();
     if (training_thread_.joinable()) {
         training_thread_.join();
     }
-    istream_->stop();
+    if (rebuild_thread_.joinable()) {
+        rebuild_thread_.join();
+    }
+    if (export_job_ != nullptr) {
+        finishFixedPointExport();
+    }
+    engine_.stop();
+    session_recorder_.stop();
 
     // Save training data here!
     if (should_save_training_data_) { saveTrainingData(); }
@@ -924,21 +1191,43 @@ void ofApp::saveTrainingData() {
     // Apply all the class names before save.
     for (uint32_t i = 0; i < kNumMaxLabels_; i++) {
         const string& name = plot_samples_[i].getTitle();
-        training_data_.setClassNameForCorrespondingClassLabel(name, i + 1);
+        training_data_.setClassName(i + 1, name);
     }
 
-    ofFileDialogResult result = ofSystemSaveDialog("TrainingData.grt",
+    // Saved as a training set file (see training_set.h) unless asked for
+    // GRT's text, e.g. to use the data outside the app.
+    ofFileDialogResult result = ofSystemSaveDialog("TrainingData.espt",
                                                    "Save your training data?");
     if (result.bSuccess) {
-        training_data_.save(result.getPath());
+        const string path = result.getPath();
+        if (ofFilePath::getFileExt(path) == "grt") {
+            if (!training_data_.toTimeSeriesData().save(path)) {
+                ofLog(OF_LOG_ERROR) << "Failed to save " << path;
+            }
+        } else if (!training_data_.save(path)) {
+            ofLog(OF_LOG_ERROR) << "Failed to save the training data: "
+                                << training_data_.getLastError();
+        }
     }
 
     should_save_training_data_ = false;
 }
 
-void ofApp::onDataIn(GRT::MatrixDouble input) {
-    std::lock_guard<std::mutex> guard(input_data_mutex_);
-    input_data_ = input;
+void ofApp::startSessionRecording() {
+    // A replayed session is already on disk.
+    if (dynamic_cast<ReplayStream*>(istream_) != nullptr) { return; }
+
+    string dir = ofToDataPath("sessions", true);
+    if (!ofDirectory::doesDirectoryExist(dir) &&
+        !ofDirectory::createDirectory(dir, false, true)) {
+        ofLog(OF_LOG_ERROR) << "Failed to create " << dir
+                            << "; the session will not be recorded";
+        return;
+    }
+    string path = ofFilePath::join(
+            dir, "session-" + ofGetTimestampString("%Y%m%d-%H%M%S") + ".esps");
+    session_recorder_.start(path);
+    ofLog() << "Recording session to " << path;
 }
 
 //--------------------------------------------------------------
@@ -975,6 +1264,7 @@ void ofApp::keyPressed(int key){
             is_recording_ = true;
             label_ = key - '0';
             sample_data_.clear();
+            sample_times_.clear();
         }
     }
 
@@ -984,16 +1274,29 @@ void ofApp::keyPressed(int key){
                 is_recording_ = true;
                 label_ = 255;
                 sample_data_.clear();
+                sample_times_.clear();
                 test_data_.clear();
+                test_data_times_.clear();
                 plot_testdata_window_.reset();
             }
             break;
         case 'f': toggleFeatureView(); break;
         case 'h': gui_hide_ = !gui_hide_; break;
         case 'l': loadTrainingData(); break;
-        case 'p': istream_->toggle(); input_data_.clear(); break;
+        case 'p':
+            istream_->toggle();
+            engine_.discardInput();
+            processed_samples_.clear();
+            break;
         case 's': saveTrainingData(); break;
         case 't': trainModel(); break;
+        case 'c': cancelTraining(); break;
+        case 'd': dumpProfile(); break;
+        case 'x': toggleTrace(); break;
+        case 'o':
+            is_profile_visible_ = !is_profile_visible_;
+            engine_.setProfileStages(is_profile_visible_);
+            break;
 
         // Tab related
         case 'C': fragment_ = CALIBRATION; break;
@@ -1017,63 +1320,114 @@ void ofApp::toggleFeatureView() {
 }
 
 void ofApp::trainModel() {
-   // If prior training has not finished, we wait.
-   if (training_thread_.joinable()) {
-       training_thread_.join();
-   }
-
-   auto training_func = [this]() -> bool {
-       ofLog() << "Training started";
-       if (pipeline_->train(training_data_)) {
-           ofLog() << "Training is successful";
-
-           for (Plotter& plot : plot_samples_) {
-               assert(true == plot.clearContentModifiedFlag());
-           }
-
-           return true;
-       } else {
-           ofLog(OF_LOG_ERROR) << "Failed to train the model";
-           return false;
-       }
-   };
-
-   // TODO(benzh) Fix data race issue later.
-   if (training_func()) {
-       fragment_ = TRAINING;
-       runPredictionOnTestData();
-       updateTestWindowPlot();
-       pipeline_->reset();
-   }
+    if (training_job_ != nullptr) {
+        // Train again (with the latest data) once the running job has ended.
+        training_job_->is_cancelled = true;
+        is_training_pending_ = true;
+        return;
+    }
+    startTraining();
+}
+
+void ofApp::startTraining() {
+    if (training_thread_.joinable()) {
+        training_thread_.join();
+    }
+
+    training_job_.reset(new TrainingJob());
+    TrainingJob* job = training_job_.get();
+    job->settings = std::make_shared<GRT::GestureRecognitionPipeline>(*pipeline_);
+    job->pipeline = std::make_shared<GRT::GestureRecognitionPipeline>(*pipeline_);
+    job->data = training_data_;
+    job->start_time_ms = ofGetElapsedTimeMillis();
+    job->is_cancelled = false;
+    job->is_done = false;
+    job->succeeded = false;
+
+    ofLog() << "Training started";
+    // The job owns everything the thread touches; finishTraining() joins the
+    // thread before the job is released.
+    training_thread_ = std::thread([job]() {
+        job->succeeded = job->pipeline->train(job->data.toTimeSeriesData());
+        job->is_done = true;
+    });
+}
+
+void ofApp::cancelTraining() {
+    if (training_job_ == nullptr) { return; }
+    training_job_->is_cancelled = true;
+    is_training_pending_ = false;
+    ofLog() << "Training cancelled";
+}
+
+void ofApp::finishTraining() {
+    training_thread_.join();
+    unique_ptr<TrainingJob> job = std::move(training_job_);
+
+    // The result of a cancelled job is simply dropped.
+    if (!job->is_cancelled && job->succeeded) {
+        ofLog() << "Training is successful ("
+                << ofGetElapsedTimeMillis() - job->start_time_ms << " ms)";
+
+        for (Plotter& plot : plot_samples_) {
+            assert(true == plot.clearContentModifiedFlag());
+        }
+
+        trained_pipeline_ = job->pipeline;
+        trained_settings_ = job->settings;
+        publishPipeline();
+
+        fragment_ = TRAINING;
+        runPredictionOnTestData();
+        updateTestWindowPlot();
+    } else if (!job->is_cancelled) {
+        ofLog(OF_LOG_ERROR) << "Failed to train the model";
+    }
+
+    if (is_training_pending_) {
+        is_training_pending_ = false;
+        startTraining();
+    }
 }
 
 void ofApp::loadTrainingData() {
-    GRT::TimeSeriesClassificationData training_data;
     ofFileDialogResult result = ofSystemLoadDialog("Load existing data", true);
 
     if (!result.bSuccess) return;
 
-    if (!training_data.load(result.getPath()) ){
-        ofLog(OF_LOG_ERROR) << "Failed to load the training data!"
-                            << " path: " << result.getPath();
+    // Training set files are mapped rather than parsed; anything else is
+    // taken to be GRT's text, as saved by older versions.
+    const string path = result.getPath();
+    TrainingSet training_data;
+    if (ofFilePath::getFileExt(path) == "espt") {
+        if (!training_data.load(path)) {
+            ofLog(OF_LOG_ERROR) << "Failed to load the training data: "
+                                << training_data.getLastError();
+        }
+    } else {
+        GRT::TimeSeriesClassificationData text;
+        if (!text.load(path)) {
+            ofLog(OF_LOG_ERROR) << "Failed to load the training data!"
+                                << " path: " << path;
+        }
+        training_data.assign(text);
     }
 
     training_data_ = training_data;
-    auto trackers = training_data_.getClassTracker();
-    for (auto tracker : trackers) {
-        plot_sample_indices_[tracker.classLabel - 1] = tracker.counter - 1;
-    }
-
-    for (int i = 0; i < training_data_.getNumSamples(); i++) {
-        int label = training_data_[i].getClassLabel();
-        plot_samples_[label - 1].setData(training_data_[i].getData());
+    training_data_.setNumDimensions(istream_->getNumOutputDimensions());
+    for (int i = 0; i < kNumMaxLabels_; i++) {
+        int label = i + 1;
+        const vector<uint32_t>& ids = training_data_.getClassSampleIds(label);
+        plot_sample_indices_[i] = int(ids.size()) - 1;
+        if (ids.empty()) { continue; }
+        plot_samples_[i].setData(training_data_.getMatrix(ids.back()));
 
-        string title = training_data_.getClassNameForCorrespondingClassLabel(label);
-        if (title == "NOT_SET") {
+        string title = training_data_.getClassName(label);
+        if (title.empty()) {
             title = std::string("Label") + std::to_string(label);
         }
 
-        plot_samples_[label - 1].setTitle(title);
+        plot_samples_[i].setTitle(title);
     }
 
     // After we load the training data,
@@ -1100,17 +1454,15 @@ void ofApp::keyReleased(int key) {
             vector<CalibrateProcess>& calibrators = calibrator_->getCalibrateProcesses();
             if (label_ - 1 < calibrators.size()) {
                 plot_calibrators_[label_ - 1].setData(sample_data_);
-                calibrators[label_ - 1].setData(sample_data_);
-                calibrators[label_ - 1].calibrate();
+                engine_.calibrate(calibrators[label_ - 1], sample_data_);
                 plot_inputs_.reset();
             }
         } else if (fragment_ == TRAINING) {
-            training_data_.addSample(label_, sample_data_);
+            training_data_.append(label_, sample_data_);
 
             plot_samples_[label_ - 1].setData(sample_data_);
-            plot_sample_indices_[label_ - 1] = training_data_.getClassTracker()[
-                      training_data_.getClassLabelIndexValue(label_)].
-                        counter - 1;
+            plot_sample_indices_[label_ - 1] =
+                    training_data_.getNumClassSamples(label_) - 1;
 
             should_save_training_data_ = true;
         }
@@ -1118,6 +1470,7 @@ void ofApp::keyReleased(int key) {
 
     if (key == 'r') {
         test_data_ = sample_data_;
+        test_data_times_ = sample_times_;
         plot_testdata_overview_.setData(test_data_);
         runPredictionOnTestData();
         updateTestWindowPlot();
@@ -1144,22 +1497,16 @@ void ofApp::mouseReleased(int x, int y, int button) {
     // Navigating between samples (samples themselves are not changed).
     for (int i = 0; i < kNumMaxLabels_; i++) {
         int label = i + 1;
-        TimeSeriesClassificationData data = training_data_.getClassData(label);
-        if (plot_sample_button_locations_[i].first.inside(x, y)) {
-            if (plot_sample_indices_[i] > 0) {
-                plot_sample_indices_[i]--;
-                plot_samples_[i].setData(data[plot_sample_indices_[i]].getData());
-                assert(true == plot_samples_[i].clearContentModifiedFlag());
-                populateSampleFeatures(i);
-            }
-        }
-        if (plot_sample_button_locations_[i].second.inside(x, y)) {
-            if (plot_sample_indices_[i] + 1 < data.getNumSamples()) {
-                plot_sample_indices_[i]++;
-                plot_samples_[i].setData(data[plot_sample_indices_[i]].getData());
-                assert(true == plot_samples_[i].clearContentModifiedFlag());
-                populateSampleFeatures(i);
-            }
+        int step = 0;
+        if (plot_sample_button_locations_[i].first.inside(x, y)) { step = -1; }
+        if (plot_sample_button_locations_[i].second.inside(x, y)) { step = 1; }
+        GRT::MatrixDouble sample;
+        if (step != 0 &&
+            stepTrainingSample(training_data_, label, step,
+                               &plot_sample_indices_[i], &sample)) {
+            plot_samples_[i].setData(sample);
+            assert(true == plot_samples_[i].clearContentModifiedFlag());
+            populateSampleFeatures(i);
         }
     }
 
@@ -1181,8 +1528,82 @@ void ofApp::mouseReleased(int x, int y, int button) {
 }
 
 void ofApp::reloadPipelineModules() {
+    is_reload_pending_ = true;
+    reload_requested_ms_ = ofGetElapsedTimeMillis();
+}
+
+void ofApp::rebuildPipeline() {
+    // setup() writes to the user's globals, so it runs here; it only
+    // constructs the modules, which is cheap.
     pipeline_->clearAll();
     ::setup();
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> settings =
+            std::make_shared<GRT::GestureRecognitionPipeline>(*pipeline_);
+
+    if (training_job_ != nullptr) {
+        // The running job trains with the old parameters.
+        trainModel();
+        return;
+    }
+    if (trained_pipeline_ == nullptr) {
+        publishPipeline();
+        return;
+    }
+    if (trained_settings_ == nullptr) {
+        discardTrainedPipeline();
+        return;
+    }
+
+    if (rebuild_thread_.joinable()) {
+        rebuild_thread_.join();
+    }
+    rebuild_job_.reset(new RebuildJob());
+    RebuildJob* job = rebuild_job_.get();
+    job->trained = trained_pipeline_;
+    job->trained_settings = trained_settings_;
+    job->settings = settings;
+    job->is_done = false;
+    // As with training, finishRebuild() joins the thread before the job is
+    // released.
+    rebuild_thread_ = std::thread([job]() {
+        job->result = carryOverTrainedState(*job->trained,
+                                            *job->trained_settings,
+                                            *job->settings);
+        job->is_done = true;
+    });
+}
+
+void ofApp::finishRebuild() {
+    rebuild_thread_.join();
+    unique_ptr<RebuildJob> job = std::move(rebuild_job_);
+
+    // Training may have published a newer model in the meantime, and a
+    // training job started since then already uses the new parameters.
+    if (trained_pipeline_ != job->trained || training_job_ != nullptr) {
+        return;
+    }
+    if (job->result == nullptr) {
+        discardTrainedPipeline();
+        return;
+    }
+
+    ofLog() << "Kept the trained model with the new parameters";
+    trained_pipeline_ = job->result;
+    trained_settings_ = job->settings;
+    publishPipeline();
+    runPredictionOnTestData();
+    updateTestWindowPlot();
+}
+
+void ofApp::discardTrainedPipeline() {
+    if (training_data_.getNumSamples() > 0) {
+        ofLog() << "Retraining with the new parameters";
+        trainModel();
+        return;
+    }
+    trained_pipeline_.reset();
+    trained_settings_.reset();
+    publishPipeline();
 }
 
 //--------------------------------------------------------------
@@ -4,6 +4,9 @@
 #include <stdint.h>
 
 // C++ System
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 // of System
@@ -14,12 +17,18 @@
 
 // custom
 #include "calibrator.h"
+#include "inference_engine.h"
 #include "istream.h"
 #include "plotter.h"
 #include "ostream.h"
+#include "ring_buffer.h"
+#include "runtime.h"
+#include "session_recorder.h"
+#include "training_set.h"
+#include "triple_buffer.h"
 #include "tuneable.h"
 
-class ofApp : public ofBaseApp {
+class ofApp : public ofBaseApp, public Runtime {
   public:
     ofApp();
     void setup();
@@ -39,10 +48,14 @@ class ofApp : public ofBaseApp {
     void dragEvent(ofDragInfo dragInfo);
     void gotMessage(ofMessage msg);
 
+    // Runtime
+    void useCalibrator(Calibrator &calibrator);
+    void useStream(IStream &stream);
+    void usePipeline(GRT::GestureRecognitionPipeline &pipeline);
+    void useOStream(OStream &stream);
     void registerTuneable(Tuneable* t) {
         tuneable_parameters_.push_back(t);
     }
-
     void reloadPipelineModules();
   private:
     enum Fragment { CALIBRATION, PIPELINE, TRAINING, ANALYSIS };
@@ -52,16 +65,6 @@ class ofApp : public ofBaseApp {
     void drawTrainingInfo();
     void drawAnalysis();
 
-    void useCalibrator(Calibrator &calibrator);
-    void useStream(IStream &stream);
-    void usePipeline(GRT::GestureRecognitionPipeline &pipeline);
-    void useOStream(OStream &stream);
-
-    friend void useCalibrator(Calibrator &calibrator);
-    friend void useStream(IStream &stream);
-    friend void usePipeline(GRT::GestureRecognitionPipeline &pipeline);
-    friend void useOStream(OStream &stream);
-
     uint32_t num_pipeline_stages_;
 
     // Currently, we support labels (stored in label_) from 1 to 9.
@@ -77,8 +80,6 @@ class ofApp : public ofBaseApp {
 
     // Input stream, a callback should be registered upon data arrival
     IStream *istream_;
-    // Callback used for input data stream (istream_)
-    void onDataIn(GRT::MatrixDouble in);
 
     // Input stream, a callback should be registered upon data arrival
     OStream *ostream_;
@@ -87,15 +88,79 @@ class ofApp : public ofBaseApp {
     // added to sample_data_.
     bool is_recording_;
     GRT::MatrixDouble sample_data_;
-
-    // input_data_ is written by istream_ thread and read by GUI thread.
-    std::mutex input_data_mutex_;
-    GRT::MatrixDouble input_data_;
+    // Timestamp of each row in sample_data_.
+    vector<int64_t> sample_times_;
+
+    // Calibration, prediction and OStream output run on the engine's inference
+    // thread at the rate samples arrive, independent of the frame rate. The
+    // engine hands every processed sample to onInferenceResult(), still on
+    // that thread.
+    InferenceEngine engine_;
+    void onInferenceResult(const InferenceEngine::Result& result);
+    uint64_t reported_dropped_samples_ = 0;
+
+    // Latency overlay ('o') and dump ('d'); see profiler.h. While the overlay
+    // is showing, the engine also times every pipeline module.
+    bool is_profile_visible_ = false;
+    void drawProfile();
+    void dumpProfile();
+    // Starts a Chrome trace ('x'), or stops it and writes it to data/.
+    void toggleTrace();
+
+    // pipeline_ is the user's pipeline. The GUI thread only ever uses it as a
+    // template: it is never trained in place. The engine predicts with its
+    // own copy of the live pipeline, which publishPipeline() replaces
+    // whenever a new model is trained or loaded.
+    void publishPipeline();
+    // The last successfully trained (or loaded) pipeline; null if the current
+    // configuration has not been trained. GUI thread only.
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> trained_pipeline_;
+    // The untrained pipeline trained_pipeline_ was trained from; null if it
+    // is not known (a loaded pipeline).
+    std::shared_ptr<const GRT::GestureRecognitionPipeline> trained_settings_;
+
+    // Set by the GUI while the pipeline tab is showing, so that the inference
+    // thread captures the output of every pipeline stage.
+    std::atomic<bool> capture_stages_;
+    // Set by the inference thread when the calibrator has not been run yet.
+    std::atomic<bool> needs_calibration_;
+
+    // The latest prediction, published by the inference thread and picked up
+    // by the GUI once per frame.
+    struct Prediction {
+        UINT label;
+        vector<double> class_distances;
+        vector<double> class_likelihoods;
+        vector<UINT> class_labels;
+    };
+    TripleBuffer<Prediction> prediction_;
+
+    // Every processed sample goes back to the GUI for plotting and recording.
+    struct ProcessedSample {
+        int64_t time_ns;
+        vector<double> raw;
+        vector<double> input;
+        UINT label;
+        bool has_stages;
+        vector<vector<double>> pre_processed;
+        vector<vector<double>> features;
+    };
+    RingBuffer<ProcessedSample> processed_samples_;
+
+    // Samples dropped because either ring ran full.
+    uint64_t getNumDroppedSamples() const;
+    uint64_t getNumSampleOverruns() const;
+
+    // Everything istream_ delivers is also recorded to data/sessions/ so that
+    // it can be replayed later with ReplayStream.
+    SessionRecorder session_recorder_;
+    void startSessionRecording();
 
     // Pipeline
     GRT::GestureRecognitionPipeline *pipeline_;
-    GRT::TimeSeriesClassificationData training_data_;
+    TrainingSet training_data_;
     GRT::MatrixDouble test_data_;
+    vector<int64_t> test_data_times_;
     float training_accuracy_;
     int predicted_label_;
     vector<double> predicted_class_distances_;
@@ -145,7 +210,71 @@ class ofApp : public ofBaseApp {
     void loadTrainingData();
     void saveTrainingData();
 
+    // Training runs on training_thread_ against a copy of pipeline_ and a
+    // snapshot of training_data_ (which shares its samples; the copy GRT
+    // trains on is made on the training thread). The live pipeline keeps
+    // predicting until the result is published. Only one job runs at a time:
+    // asking to train while a job is running cancels it and trains again once
+    // it has ended. GRT cannot interrupt a classifier mid-training, so
+    // cancelling only discards the result.
+    struct TrainingJob {
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> settings;
+        std::shared_ptr<GRT::GestureRecognitionPipeline> pipeline;
+        TrainingSet data;
+        uint64_t start_time_ms;
+        std::atomic<bool> is_cancelled;
+        std::atomic<bool> is_done;
+        bool succeeded;
+    };
+    unique_ptr<TrainingJob> training_job_;
+    bool is_training_pending_ = false;
     void trainModel();
+    void startTraining();
+    void cancelTraining();
+    void finishTraining();
+
+    // A Tuneable change only marks the pipeline for reloading; update()
+    // rebuilds it once no change has come in for kReloadSettleMs_, so that
+    // dragging a slider rebuilds it once rather than on every event. The
+    // rebuilt pipeline keeps the trained model if the change allows it (see
+    // pipeline_rebuild.h), which rebuild_thread_ works out; otherwise the
+    // model is retrained in the background. Either way, the live pipeline
+    // keeps predicting until its replacement is published.
+    const uint64_t kReloadSettleMs_ = 150;
+    bool is_reload_pending_ = false;
+    uint64_t reload_requested_ms_ = 0;
+    struct RebuildJob {
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> trained;
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> trained_settings;
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> settings;
+        // Null if the model has to be retrained.
+        std::shared_ptr<GRT::GestureRecognitionPipeline> result;
+        std::atomic<bool> is_done;
+    };
+    unique_ptr<RebuildJob> rebuild_job_;
+    std::thread rebuild_thread_;
+    void rebuildPipeline();
+    void finishRebuild();
+    // Retrains with the current settings if there is training data, or
+    // falls back to the untrained pipeline.
+    void discardTrainedPipeline();
+
+    // savePipeline() leaves model_fixed_point.h to export_thread_, since
+    // calibrating it runs the pipeline over a copy of every recording. The
+    // job exports the saved pipeline with a snapshot of training_data_.
+    struct ExportJob {
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline;
+        TrainingSet data;
+        // False if the pipeline cannot be exported in fixed point.
+        bool is_exportable;
+        bool is_saved;
+        std::string error;
+        std::atomic<bool> is_done;
+    };
+    unique_ptr<ExportJob> export_job_;
+    std::thread export_thread_;
+    void startFixedPointExport();
+    void finishFixedPointExport();
 
     vector<ofxPanel *> training_sample_guis_;
     void renameTrainingSample(int num);
@@ -164,7 +293,7 @@ class ofApp : public ofBaseApp {
     // Display title is rename_title_ plus a blinking underscore.
     string display_title_;
 
-    // Multithreading to avoid GUI blocked.
+    // Runs training_job_.
     std::thread training_thread_;
 
     // Prompts to ask the user to save the training data if changed.
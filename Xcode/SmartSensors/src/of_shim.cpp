@@ -0,0 +1,67 @@
+#include "of_shim.h"
+
+#ifdef ESP_HEADLESS
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+#include <limits.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const kLogLevelNames[] = {
+    "verbose", "notice", "warning", "error", "fatal", "silent"
+};
+
+ofLogLevel log_level = OF_LOG_NOTICE;
+std::string data_path_root = "data/";
+
+// Keeps lines logged by different threads from interleaving.
+std::mutex& getLogMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+const std::chrono::steady_clock::time_point start_time =
+        std::chrono::steady_clock::now();
+
+}  // namespace
+
+ofLog::~ofLog() {
+    if (level_ < log_level || level_ == OF_LOG_SILENT) { return; }
+    std::lock_guard<std::mutex> lock(getLogMutex());
+    std::cerr << "[" << kLogLevelNames[level_] << "] " << message_.str()
+              << std::endl;
+}
+
+void ofSetLogLevel(ofLogLevel level) {
+    log_level = level;
+}
+
+uint64_t ofGetElapsedTimeMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+}
+
+std::string ofToDataPath(const std::string& path, bool absolute) {
+    std::string result =
+            (!path.empty() && path[0] == '/') ? path : data_path_root + path;
+    if (absolute && result[0] != '/') {
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) != nullptr) {
+            result = std::string(cwd) + "/" + result;
+        }
+    }
+    return result;
+}
+
+void ofSetDataPathRoot(const std::string& root) {
+    data_path_root = root;
+    if (!data_path_root.empty() && data_path_root.back() != '/') {
+        data_path_root += '/';
+    }
+}
+
+#endif  // ESP_HEADLESS
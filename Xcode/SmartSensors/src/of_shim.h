@@ -0,0 +1,72 @@
+/*
+ * The few openFrameworks utilities the ESP runtime uses. Normally this is
+ * just ofMain.h; with ESP_HEADLESS defined (see headless/) it provides
+ * minimal stand-ins instead, so that the runtime builds and runs without
+ * openFrameworks, a window or a GL context.
+ */
+#pragma once
+
+#ifndef ESP_HEADLESS
+
+#include "ofMain.h"
+
+#else
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The runtime was written against ofMain.h, which does the same.
+using namespace std;
+
+enum ofLogLevel {
+    OF_LOG_VERBOSE,
+    OF_LOG_NOTICE,
+    OF_LOG_WARNING,
+    OF_LOG_ERROR,
+    OF_LOG_FATAL_ERROR,
+    OF_LOG_SILENT
+};
+
+// ofLog(OF_LOG_ERROR) << "Failed to " << what; writes one line to stderr
+// when the temporary goes away.
+class ofLog {
+  public:
+    explicit ofLog(ofLogLevel level = OF_LOG_NOTICE) : level_(level) {}
+    ~ofLog();
+
+    template<typename T>
+    ofLog& operator<<(const T& value) {
+        message_ << value;
+        return *this;
+    }
+    ofLog& operator<<(std::ostream& (*manipulator)(std::ostream&)) {
+        message_ << manipulator;
+        return *this;
+    }
+
+  private:
+    ofLogLevel level_;
+    std::ostringstream message_;
+};
+
+// Messages below `level` are dropped.
+void ofSetLogLevel(ofLogLevel level);
+
+// Milliseconds since the program started.
+uint64_t ofGetElapsedTimeMillis();
+
+// Relative paths are taken relative to the data directory ("data/" unless
+// changed with ofSetDataPathRoot()).
+std::string ofToDataPath(const std::string& path, bool absolute = false);
+void ofSetDataPathRoot(const std::string& root);
+
+#endif  // ESP_HEADLESS
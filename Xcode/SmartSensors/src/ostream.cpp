@@ -1,6 +1,25 @@
-#include "ofApp.h"
 #include "ostream.h"
+#include "profiler.h"
+#include "runtime.h"
+#include "sample_clock.h"
+#include "tracer.h"
 
 void useOStream(OStream &stream) {
-    ((ofApp *) ofGetAppPtr())->useOStream(stream);
+    getRuntime()->useOStream(stream);
+}
+
+void OStream::onEmitted() {
+    static LatencyHistogram* e2e_latency =
+            getProfiler().getHistogram("e2e/arrival to ostream");
+    int64_t arrival_ns = getSampleArrivalNs();
+    if (arrival_ns == 0) { return; }
+
+    int64_t now_ns = getMonotonicTimeNs();
+    e2e_latency->record(now_ns - arrival_ns);
+
+    Tracer& tracer = getTracer();
+    if (tracer.isTracing()) {
+        tracer.flowEnd("ostream emit", now_ns, arrival_ns,
+                       "latency_ns", now_ns - arrival_ns);
+    }
 }
@@ -10,7 +10,9 @@
  */
 #pragma once
 
+#ifdef __APPLE__
 #include <ApplicationServices/ApplicationServices.h>
+#endif
 
 #include <arpa/inet.h>
 #include <errno.h>
@@ -25,26 +27,30 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#include "ofMain.h"
-#include "ofApp.h"
+#include "of_shim.h"
 
 const uint64_t kGracePeriod = 500; // 0.5 second
 
-// Forward declaration.
-class ofApp;
-
 class OStream {
   public:
+    virtual ~OStream() = default;
+
     virtual void onReceive(uint32_t label) = 0;
 
     virtual bool start() { has_started_ = true; return true; }
     void setStreamSize(int size) { stream_size_ = size; }
     bool hasStarted() { return has_started_; }
   protected:
+    // Subclasses call this right after they actually emit something, to
+    // record how long it took from the triggering sample's arrival (see
+    // tracer.h).
+    void onEmitted();
+
     int stream_size_ = -1;
     bool has_started_ = false;
 };
 
+#ifdef __APPLE__
 // MacOSKeyboardOStream will emulate keyboard key press event upon receiving
 // classification results (via the callback `onReceive`). Users of this class
 // can supply a map<integer, char> so that the labels will be translated to
@@ -92,6 +98,7 @@ class MacOSKeyboardOStream : public OStream {
         CGEventPostToPSN(&psn, key_up);
         CFRelease(key_down);
         CFRelease(key_up);
+        onEmitted();
     }
 
     void sendString(const std::string& str) {
@@ -153,6 +160,7 @@ private:
         elapsed_time_ = ofGetElapsedTimeMillis();
 
         doubleClick(CGPointMake(mouse.first, mouse.second));
+        onEmitted();
     }
 
     void doubleClick(CGPoint point, int clickCount = 2) {
@@ -181,6 +189,8 @@ private:
     std::map<uint32_t, pair<uint32_t, uint32_t>> mouse_mapping_;
 };
 
+#endif  // __APPLE__
+
 // TcpOStream
 class TcpOStream : public OStream {
   public:
@@ -249,6 +259,7 @@ private:
         elapsed_time_ = ofGetElapsedTimeMillis();
 
         write(sockfd_, tosend.c_str(), tosend.size());
+        onEmitted();
     }
 
     string getStreamString(uint32_t label) {
@@ -0,0 +1,290 @@
+#include "parameter_sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include "of_shim.h"
+#include "profiler.h"
+#include "sample_clock.h"
+
+namespace {
+
+struct FoldResult {
+    bool is_trained;
+    uint32_t num_correct;
+    uint32_t num_samples;
+    double training_ms;
+};
+
+// The values a grid sweep tries for `tuneable`.
+std::vector<double> getGridValues(const Tuneable& tuneable, uint32_t steps) {
+    std::vector<double> values;
+    if (tuneable.getType() == Tuneable::BOOL) {
+        values.push_back(0);
+        values.push_back(1);
+        return values;
+    }
+    if (steps < 2) {
+        values.push_back(tuneable.getValue());
+        return values;
+    }
+    double min = tuneable.getMin();
+    double max = tuneable.getMax();
+    for (uint32_t i = 0; i < steps; i++) {
+        double value = min + (max - min) * i / (steps - 1);
+        if (tuneable.getType() == Tuneable::INT_RANGE) {
+            value = std::round(value);
+            // Narrow int ranges have fewer distinct values than steps.
+            if (!values.empty() && values.back() == value) { continue; }
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+// Trains a copy of `settings` on `training` and classifies every sample of
+// `test` row by row, the way the live pipeline sees it, with rows
+// `sample_period_ns` apart on the sample clock. `test` is a copy because GRT
+// only indexes samples through a non-const operator[].
+FoldResult evaluateFold(const GRT::GestureRecognitionPipeline& settings,
+                        const GRT::TimeSeriesClassificationData& training,
+                        GRT::TimeSeriesClassificationData test,
+                        int64_t sample_period_ns,
+                        LatencyHistogram* predict_latency) {
+    FoldResult result = { false, 0, 0, 0 };
+    GRT::GestureRecognitionPipeline pipeline(settings);
+    int64_t start_ns = getMonotonicTimeNs();
+    if (!pipeline.train(training)) { return result; }
+    result.training_ms = (getMonotonicTimeNs() - start_ns) / 1e6;
+    result.is_trained = true;
+
+    std::map<GRT::UINT, uint32_t> votes;
+    for (GRT::UINT i = 0; i < test.getNumSamples(); i++) {
+        const GRT::MatrixDouble& data = test[i].getData();
+        pipeline.reset();
+        votes.clear();
+        for (GRT::UINT row = 0; row < data.getNumRows(); row++) {
+            // Time-based stages (e.g. ClockedClassLabelTimeoutFilter) would
+            // otherwise run on the wall clock, and how many rows they
+            // suppress would depend on how fast this thread gets through
+            // them.
+            setSampleTimeNs(row * sample_period_ns);
+            {
+                ScopedSpan span(predict_latency);
+                pipeline.predict(data.getRowVector(row));
+            }
+            GRT::UINT label = pipeline.getPredictedClassLabel();
+            if (label != 0) { votes[label]++; }
+        }
+
+        GRT::UINT predicted_label = 0;
+        uint32_t max_votes = 0;
+        for (const auto& vote : votes) {
+            if (vote.second > max_votes) {
+                predicted_label = vote.first;
+                max_votes = vote.second;
+            }
+        }
+        if (predicted_label == test[i].getClassLabel()) {
+            result.num_correct++;
+        }
+        result.num_samples++;
+    }
+    setSampleTimeNs(kNoSampleTime);
+    return result;
+}
+
+}  // namespace
+
+ParameterSweep::ParameterSweep(const std::vector<Tuneable*>& tuneables,
+                               PipelineBuilder build)
+        : tuneables_(tuneables), build_(build) {
+}
+
+void ParameterSweep::addGrid(uint32_t steps) {
+    std::vector<std::vector<double>> points(1);
+    for (const Tuneable* tuneable : tuneables_) {
+        std::vector<double> values = getGridValues(*tuneable, steps);
+        std::vector<std::vector<double>> extended;
+        for (const std::vector<double>& point : points) {
+            for (double value : values) {
+                extended.push_back(point);
+                extended.back().push_back(value);
+            }
+        }
+        points.swap(extended);
+    }
+    points_.insert(points_.end(), points.begin(), points.end());
+}
+
+void ParameterSweep::addRandom(uint32_t num_points, uint32_t seed) {
+    std::mt19937 random(seed);
+    for (uint32_t i = 0; i < num_points; i++) {
+        std::vector<double> point;
+        for (const Tuneable* tuneable : tuneables_) {
+            switch (tuneable->getType()) {
+                case Tuneable::BOOL:
+                    point.push_back(std::bernoulli_distribution()(random));
+                    break;
+                case Tuneable::INT_RANGE:
+                    point.push_back(std::uniform_int_distribution<int>(
+                            std::round(tuneable->getMin()),
+                            std::round(tuneable->getMax()))(random));
+                    break;
+                default:
+                    point.push_back(std::uniform_real_distribution<double>(
+                            tuneable->getMin(), tuneable->getMax())(random));
+                    break;
+            }
+        }
+        points_.push_back(point);
+    }
+}
+
+std::vector<ParameterSweep::Result> ParameterSweep::run(
+        const GRT::TimeSeriesClassificationData& data, uint32_t num_folds,
+        int64_t sample_period_ns, ThreadPool& pool) {
+    std::vector<Result> results;
+    GRT::TimeSeriesClassificationData folded(data);
+    if (num_folds < 2 || !folded.spiltDataIntoKFolds(num_folds, true)) {
+        ofLog(OF_LOG_ERROR) << "Cannot split " << data.getNumSamples()
+                            << " training samples into " << num_folds
+                            << " folds";
+        return results;
+    }
+    std::vector<GRT::TimeSeriesClassificationData> training_folds;
+    std::vector<GRT::TimeSeriesClassificationData> test_folds;
+    for (uint32_t k = 0; k < num_folds; k++) {
+        training_folds.push_back(folded.getTrainingFoldData(k));
+        test_folds.push_back(folded.getTestFoldData(k));
+    }
+
+    // The builder runs the user's setup(), so this stays on this thread.
+    std::vector<double> saved_values;
+    for (const Tuneable* tuneable : tuneables_) {
+        saved_values.push_back(tuneable->getValue());
+    }
+    std::vector<GRT::GestureRecognitionPipeline> pipelines;
+    for (const std::vector<double>& point : points_) {
+        for (uint32_t i = 0; i < tuneables_.size(); i++) {
+            tuneables_[i]->setValue(point[i]);
+        }
+        pipelines.push_back(build_());
+    }
+    for (uint32_t i = 0; i < tuneables_.size(); i++) {
+        tuneables_[i]->setValue(saved_values[i]);
+    }
+    build_();
+
+    // One task per (point, fold); each writes only its own FoldResult.
+    std::vector<FoldResult> fold_results(points_.size() * num_folds);
+    std::vector<std::unique_ptr<LatencyHistogram>> predict_latencies;
+    for (uint32_t i = 0; i < points_.size(); i++) {
+        predict_latencies.emplace_back(new LatencyHistogram());
+    }
+    std::mutex mutex;
+    std::condition_variable done;
+    uint32_t num_remaining = fold_results.size();
+    for (uint32_t i = 0; i < points_.size(); i++) {
+        for (uint32_t k = 0; k < num_folds; k++) {
+            pool.submit([&, i, k]() {
+                FoldResult& result = fold_results[i * num_folds + k];
+                result = { false, 0, 0, 0 };
+                try {
+                    result = evaluateFold(pipelines[i], training_folds[k],
+                                          test_folds[k], sample_period_ns,
+                                          predict_latencies[i].get());
+                } catch (const std::exception& e) {
+                    ofLog(OF_LOG_ERROR) << "Sweep point " << i << " failed: "
+                                        << e.what();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--num_remaining == 0) { done.notify_all(); }
+            });
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return num_remaining == 0; });
+    }
+
+    for (uint32_t i = 0; i < points_.size(); i++) {
+        Result result = { points_[i], true, 0, 0, 0, 0 };
+        uint32_t num_correct = 0;
+        uint32_t num_samples = 0;
+        for (uint32_t k = 0; k < num_folds; k++) {
+            const FoldResult& fold = fold_results[i * num_folds + k];
+            result.is_trained &= fold.is_trained;
+            num_correct += fold.num_correct;
+            num_samples += fold.num_samples;
+            result.training_ms += fold.training_ms / num_folds;
+        }
+        if (result.is_trained && num_samples > 0) {
+            result.accuracy = static_cast<double>(num_correct) / num_samples;
+        }
+        result.mean_predict_ns = predict_latencies[i]->getMean();
+        result.p99_predict_ns = predict_latencies[i]->getPercentile(99);
+        results.push_back(result);
+    }
+    return results;
+}
+
+void ParameterSweep::rank(std::vector<Result>& results, double min_accuracy) {
+    std::stable_sort(results.begin(), results.end(),
+                     [min_accuracy](const Result& a, const Result& b) {
+        bool a_passes = a.is_trained && a.accuracy >= min_accuracy;
+        bool b_passes = b.is_trained && b.accuracy >= min_accuracy;
+        if (a_passes != b_passes) { return a_passes; }
+        if (a_passes && a.mean_predict_ns != b.mean_predict_ns) {
+            return a.mean_predict_ns < b.mean_predict_ns;
+        }
+        return a.accuracy > b.accuracy;
+    });
+}
+
+void ParameterSweep::printLeaderboard(const std::vector<Result>& results,
+                                      std::ostream& out,
+                                      uint32_t max_rows) const {
+    std::vector<size_t> widths;
+    out << std::setw(4) << "#";
+    for (const Tuneable* tuneable : tuneables_) {
+        widths.push_back(std::max<size_t>(10, tuneable->getTitle().size() + 2));
+        out << std::setw(widths.back()) << tuneable->getTitle();
+    }
+    out << std::setw(10) << "accuracy" << std::setw(12) << "predict"
+        << std::setw(12) << "p99" << std::setw(12) << "train" << "\n";
+
+    for (uint32_t i = 0; i < results.size() && i < max_rows; i++) {
+        const Result& result = results[i];
+        out << std::setw(4) << i + 1;
+        for (uint32_t j = 0; j < result.values.size(); j++) {
+            std::ostringstream value;
+            value << std::setprecision(4) << result.values[j];
+            out << std::setw(widths[j]) << value.str();
+        }
+        if (!result.is_trained) {
+            out << std::setw(10) << "failed" << "\n";
+            continue;
+        }
+        std::ostringstream accuracy;
+        accuracy << std::fixed << std::setprecision(1)
+                 << 100 * result.accuracy << "%";
+        out << std::setw(10) << accuracy.str()
+            << std::setw(12) << formatDuration(result.mean_predict_ns)
+            << std::setw(12) << formatDuration(result.p99_predict_ns)
+            << std::setw(12) << formatDuration(result.training_ms * 1e6)
+            << "\n";
+    }
+    if (results.size() > max_rows) {
+        out << "(" << results.size() - max_rows << " more)\n";
+    }
+    out.flush();
+}
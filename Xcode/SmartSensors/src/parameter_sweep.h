@@ -0,0 +1,90 @@
+/*
+ * ParameterSweep searches the registered Tuneables for the best pipeline
+ * settings. Every point of the sweep assigns one value to each tuneable; the
+ * pipeline built for it is trained and cross-validated on the training data,
+ * and the points are ranked by accuracy and by how long a prediction takes.
+ *
+ * ParameterSweep sweep(tuneables, [&]() {
+ *     pipeline.clearAll();
+ *     ::setup();              // builds the pipeline from the tuneables
+ *     return pipeline;
+ * });
+ * sweep.addGrid(5);           // or sweep.addRandom(100, seed)
+ * ThreadPool pool;
+ * std::vector<ParameterSweep::Result> results =
+ *         sweep.run(training_data, 5, 10000000, pool);  // 100 Hz
+ * ParameterSweep::rank(results, 0.9);
+ * sweep.printLeaderboard(results, std::cout);
+ *
+ * Pipelines are built on the calling thread, since building one usually
+ * means running the user's setup(); every (point, fold) pair is then
+ * trained and evaluated as a task of its own on the pool.
+ *
+ * Test samples are evaluated the way the live pipeline sees them: row by
+ * row, on a freshly reset copy of the trained pipeline, with the sample clock
+ * (sample_clock.h) advancing one sample period per row so that time-based
+ * stages behave the same however busy the pool is. A sample counts as
+ * correct if its most frequently predicted non-zero label is its own.
+ * Prediction times are measured per row while other tasks keep the other
+ * cores busy, so compare them between points rather than with a live run.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "thread_pool.h"
+#include "tuneable.h"
+
+class ParameterSweep {
+  public:
+    struct Result {
+        // One value per tuneable, in the order given to the constructor.
+        std::vector<double> values;
+        // False if the pipeline failed to train on any fold.
+        bool is_trained;
+        // Fraction of test samples classified correctly, over all folds.
+        double accuracy;
+        double mean_predict_ns;
+        int64_t p99_predict_ns;
+        // Mean training time of one fold.
+        double training_ms;
+    };
+
+    typedef std::function<GRT::GestureRecognitionPipeline()> PipelineBuilder;
+
+    // `build` returns an untrained pipeline for the tuneables' current values.
+    ParameterSweep(const std::vector<Tuneable*>& tuneables,
+                   PipelineBuilder build);
+
+    // Adds every combination of `steps` values spread evenly over each
+    // range, ends included. Booleans take both values.
+    void addGrid(uint32_t steps);
+    // Adds `num_points` points drawn uniformly from the ranges.
+    void addRandom(uint32_t num_points, uint32_t seed);
+    uint32_t getNumPoints() const { return points_.size(); }
+
+    // Evaluates every point with `num_folds`-fold cross-validation and blocks
+    // until all are done; `data` was recorded one row every
+    // `sample_period_ns`. The tuneables get their values back afterwards.
+    // Returns no results if `data` cannot be split into `num_folds` folds.
+    std::vector<Result> run(const GRT::TimeSeriesClassificationData& data,
+                            uint32_t num_folds, int64_t sample_period_ns,
+                            ThreadPool& pool);
+
+    // Puts the points that reach `min_accuracy` first, fastest first, and
+    // then the others, most accurate first.
+    static void rank(std::vector<Result>& results, double min_accuracy);
+
+    void printLeaderboard(const std::vector<Result>& results,
+                          std::ostream& out, uint32_t max_rows = 20) const;
+
+  private:
+    std::vector<Tuneable*> tuneables_;
+    PipelineBuilder build_;
+    std::vector<std::vector<double>> points_;
+};
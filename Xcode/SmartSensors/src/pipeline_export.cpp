@@ -0,0 +1,1380 @@
+#include "pipeline_export.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+#include "fast_anbc.h"
+#include "kd_tree_knn.h"
+
+namespace {
+
+bool fail(std::string* error, const std::string& message) {
+    *error = message;
+    return false;
+}
+
+// GRT's TimeDomainFeatures has no getters for its settings; a copy of it can
+// read them.
+class TimeDomainFeaturesSettings : public GRT::TimeDomainFeatures {
+  public:
+    explicit TimeDomainFeaturesSettings(const GRT::TimeDomainFeatures& module)
+            : GRT::TimeDomainFeatures(module) {}
+
+    void get(ExportedStage* stage) const {
+        stage->buffer_length = bufferLength;
+        stage->num_frames = numFrames;
+        stage->offset_input = offsetInput;
+        stage->use_mean = useMean;
+        stage->use_std_dev = useStdDev;
+        stage->use_euclidean_norm = useEuclideanNorm;
+        stage->use_rms = useRMS;
+    }
+};
+
+// Likewise for GRT's KNN and its training data, which it keeps scaled.
+class KNNModel : public GRT::KNN {
+  public:
+    explicit KNNModel(const GRT::KNN& knn) : GRT::KNN(knn) {}
+
+    GRT::UINT getDistanceMethod() const { return distanceMethod; }
+    GRT::ClassificationData& getTrainingData() { return trainingData; }
+};
+
+void initStage(ExportedStage* stage) {
+    stage->buffer_length = 0;
+    stage->num_frames = 1;
+    stage->offset_input = false;
+    stage->use_mean = stage->use_std_dev = false;
+    stage->use_euclidean_norm = stage->use_rms = false;
+}
+
+bool checkBufferLength(const ExportedStage& stage, const std::string& type,
+                       std::string* error) {
+    if (stage.buffer_length == 0 || stage.buffer_length > 0xffff) {
+        return fail(error, "Unsupported " + type + " buffer length");
+    }
+    return true;
+}
+
+bool readPreProcessing(GRT::PreProcessing* module, ExportedStage* stage,
+                       std::string* error) {
+    initStage(stage);
+    const std::string type = module->getPreProcessingType();
+    GRT::MovingAverageFilter* filter =
+            dynamic_cast<GRT::MovingAverageFilter*>(module);
+    if (filter == nullptr) {
+        return fail(error, "Cannot export a " + type + " module");
+    }
+    stage->type = ExportedStage::MOVING_AVERAGE_FILTER;
+    stage->num_input_dimensions = module->getNumInputDimensions();
+    stage->num_output_dimensions = module->getNumOutputDimensions();
+    stage->buffer_length = filter->getFilterSize();
+    return checkBufferLength(*stage, type, error);
+}
+
+bool readFeatureExtraction(GRT::FeatureExtraction* module,
+                           ExportedStage* stage, std::string* error) {
+    initStage(stage);
+    const std::string type = module->getFeatureExtractionType();
+    const GRT::TimeDomainFeatures* features =
+            dynamic_cast<const GRT::TimeDomainFeatures*>(module);
+    if (features == nullptr) {
+        return fail(error, "Cannot export a " + type + " module");
+    }
+    stage->type = ExportedStage::TIME_DOMAIN_FEATURES;
+    stage->num_input_dimensions = module->getNumInputDimensions();
+    stage->num_output_dimensions = module->getNumOutputDimensions();
+    TimeDomainFeaturesSettings(*features).get(stage);
+    uint32_t num_features = stage->use_mean + stage->use_std_dev +
+                            stage->use_euclidean_norm + stage->use_rms;
+    // GRT indexes past its frames if they do not divide the buffer.
+    if (stage->num_frames == 0 ||
+        stage->buffer_length % stage->num_frames != 0 ||
+        stage->num_output_dimensions !=
+                stage->num_input_dimensions * stage->num_frames *
+                num_features) {
+        return fail(error, "Unsupported TimeDomainFeatures settings");
+    }
+    return checkBufferLength(*stage, type, error);
+}
+
+// The settings every GRT classifier has. GRT's getters are not all const.
+void readClassifierSettings(GRT::Classifier& trained,
+                            ExportedClassifier* classifier) {
+    classifier->use_scaling = trained.getScalingEnabled();
+    classifier->num_input_dimensions = trained.getNumInputDimensions();
+    classifier->use_null_rejection = trained.getNullRejectionEnabled();
+    classifier->null_rejection_thresholds =
+            trained.getNullRejectionThresholds();
+    classifier->class_labels = trained.getClassLabels();
+    classifier->ranges.clear();
+    if (classifier->use_scaling) { classifier->ranges = trained.getRanges(); }
+}
+
+bool readANBC(GRT::ANBC& anbc, ExportedClassifier* classifier,
+              std::string* error) {
+    classifier->type = ExportedClassifier::ANBC;
+    readClassifierSettings(anbc, classifier);
+    const std::vector<GRT::ANBC_Model> models = anbc.getModels();
+    const uint32_t num_classes = classifier->class_labels.size();
+    if (models.size() != num_classes) {
+        return fail(error, "Failed to read the ANBC models");
+    }
+    classifier->means.resize(num_classes);
+    classifier->sigmas.resize(num_classes);
+    classifier->weights.resize(num_classes);
+    for (uint32_t k = 0; k < num_classes; k++) {
+        const GRT::ANBC_Model& model = models[k];
+        if (model.classLabel != classifier->class_labels[k] ||
+            model.mu.size() != classifier->num_input_dimensions) {
+            return fail(error, "Failed to read the ANBC models");
+        }
+        classifier->means[k] = model.mu;
+        classifier->sigmas[k] = model.sigma;
+        classifier->weights[k] = model.weights;
+    }
+    return true;
+}
+
+bool readKNN(GRT::KNN& trained, ExportedClassifier* classifier,
+             std::string* error) {
+    classifier->type = ExportedClassifier::KNN;
+    readClassifierSettings(trained, classifier);
+    KNNModel knn(trained);
+    if (knn.getDistanceMethod() != GRT::KNN::EUCLIDEAN_DISTANCE) {
+        return fail(error, "Only KNN with Euclidean distance can be exported");
+    }
+    classifier->k = knn.getK();
+    GRT::ClassificationData& training_data = knn.getTrainingData();
+    const uint32_t num_samples = training_data.getNumSamples();
+    const uint32_t num_dimensions = classifier->num_input_dimensions;
+    if (training_data.getNumDimensions() != num_dimensions) {
+        return fail(error, "Failed to read the KNN training data");
+    }
+    classifier->samples.resize(num_samples * num_dimensions);
+    classifier->sample_classes.resize(num_samples);
+    for (uint32_t i = 0; i < num_samples; i++) {
+        const uint32_t class_label = training_data[i].getClassLabel();
+        uint32_t k = 0;
+        while (k < classifier->class_labels.size() &&
+               classifier->class_labels[k] != class_label) {
+            k++;
+        }
+        if (k == classifier->class_labels.size()) {
+            return fail(error, "The KNN training data has an unknown class");
+        }
+        classifier->sample_classes[i] = k;
+        const GRT::VectorDouble& sample = training_data[i].getSample();
+        std::copy(sample.begin(), sample.end(),
+                  classifier->samples.begin() + i * num_dimensions);
+    }
+    return true;
+}
+
+// The samples of a KDTreeKNN are already scaled and in tree order.
+bool readKDTreeKNN(KDTreeKNN& knn, ExportedClassifier* classifier,
+                   std::string* error) {
+    classifier->type = ExportedClassifier::KNN;
+    readClassifierSettings(knn, classifier);
+    classifier->k = knn.getK();
+    classifier->samples = knn.getSamples();
+    classifier->sample_classes = knn.getSampleClasses();
+    const uint32_t num_classes = classifier->class_labels.size();
+    for (uint32_t class_index : classifier->sample_classes) {
+        if (class_index >= num_classes) {
+            return fail(error, "Failed to read the KDTreeKNN samples");
+        }
+    }
+    if (classifier->samples.size() != classifier->sample_classes.size() *
+                                      classifier->num_input_dimensions) {
+        return fail(error, "Failed to read the KDTreeKNN samples");
+    }
+    return true;
+}
+
+std::string formatFloat(double value) {
+    if (std::isnan(value)) { return "NAN"; }
+    if (std::isinf(value)) { return value > 0 ? "INFINITY" : "-INFINITY"; }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    std::string text = buffer;
+    if (text.find_first_of(".e") == std::string::npos) { text += ".0"; }
+    return text + "f";
+}
+
+// Writes `values` as a PROGMEM table: a two-dimensional one with rows of
+// `row_length`, or a one-dimensional one if `row_length` is 0.
+template <class T>
+void writeTable(std::ostream& out, const std::string& declaration,
+                const std::vector<T>& values, uint32_t row_length,
+                std::string (*format)(T)) {
+    const size_t line_length = row_length > 0 ? row_length : 8;
+    out << declaration << " PROGMEM = {\n";
+    for (size_t i = 0; i < values.size(); i += line_length) {
+        size_t end = std::min(i + line_length, values.size());
+        out << "    " << (row_length > 0 ? "{ " : "");
+        for (size_t j = i; j < end; j++) {
+            out << format(values[j]) << (j + 1 < end ? ", " : "");
+        }
+        out << (row_length > 0 ? " }" : "")
+            << (end < values.size() ? ",\n" : "\n");
+    }
+    out << "};\n";
+}
+
+std::string formatWord(uint32_t value) { return std::to_string(value); }
+
+std::string describeStage(const ExportedStage& stage) {
+    std::ostringstream description;
+    if (stage.type == ExportedStage::MOVING_AVERAGE_FILTER) {
+        description << "MovingAverageFilter(" << stage.buffer_length << ")";
+    } else {
+        description << "TimeDomainFeatures(" << stage.buffer_length << ", "
+                    << stage.num_frames << ")";
+    }
+    return description.str();
+}
+
+// The start of a generated header, up to the class labels. `value_size` is
+// the size of the values the stages buffer.
+void writePreamble(std::ostream& out, const ExportedPipeline& pipeline,
+                   const std::string& name, uint32_t value_size,
+                   const std::string& arithmetic) {
+    const ExportedClassifier& classifier = pipeline.classifier;
+    std::string description;
+    uint32_t state_size = 0;
+    for (const ExportedStage& stage : pipeline.stages) {
+        description += describeStage(stage) + " -> ";
+        state_size += value_size * stage.buffer_length *
+                      stage.num_input_dimensions + 4;
+    }
+    description += classifier.type == ExportedClassifier::ANBC
+            ? "ANBC"
+            : "KNN(" + std::to_string(classifier.k) + ")";
+
+    out << "// Generated from a trained GRT pipeline by the ESP exporter "
+           "(pipeline_export.h);\n"
+        << "// do not edit.\n"
+        << "//\n"
+        << "// " << description << "\n"
+        << "// " << pipeline.num_input_dimensions << " input dimensions, "
+        << classifier.class_labels.size() << " classes, " << state_size
+        << " bytes of State, " << arithmetic << " arithmetic.\n"
+        << "#pragma once\n"
+        << "\n"
+        << "#include <math.h>\n"
+        << "#include <stdint.h>\n"
+        << "\n"
+        << "#if defined(__AVR__)\n"
+        << "#include <avr/pgmspace.h>\n"
+        << "#ifndef ESP_READ_FLOAT\n"
+        << "#define ESP_READ_FLOAT(x) pgm_read_float(&(x))\n"
+        << "#define ESP_READ_BYTE(x) pgm_read_byte(&(x))\n"
+        << "#define ESP_READ_WORD(x) pgm_read_word(&(x))\n"
+        << "#define ESP_READ_DWORD(x) pgm_read_dword(&(x))\n"
+        << "#endif\n"
+        << "#else\n"
+        << "#ifndef PROGMEM\n"
+        << "#define PROGMEM\n"
+        << "#endif\n"
+        << "#ifndef ESP_READ_FLOAT\n"
+        << "#define ESP_READ_FLOAT(x) (x)\n"
+        << "#define ESP_READ_BYTE(x) (x)\n"
+        << "#define ESP_READ_WORD(x) (x)\n"
+        << "#define ESP_READ_DWORD(x) (x)\n"
+        << "#endif\n"
+        << "#endif\n"
+        << "\n"
+        << "namespace " << name << " {\n"
+        << "\n"
+        << "constexpr uint16_t kNumInputDimensions = "
+        << pipeline.num_input_dimensions << ";\n"
+        << "constexpr uint16_t kNumClasses = " << classifier.class_labels.size()
+        << ";\n"
+        << "\n";
+    writeTable(out, "const uint16_t kClassLabels[kNumClasses]",
+               classifier.class_labels, 0, formatWord);
+}
+
+// Code shared by both stages: adds the input to the stage's ring buffer.
+void writePush(std::ostream& out, const ExportedStage& stage, uint32_t s) {
+    out << "    for (uint16_t j = 0; j < " << stage.num_input_dimensions
+        << "; j++) {\n"
+        << "        state->buffer" << s << "[state->next" << s << "][j] = x"
+        << s - 1 << "[j];\n"
+        << "    }\n"
+        << "    if (++state->next" << s << " == " << stage.buffer_length
+        << ") { state->next" << s << " = 0; }\n"
+        << "    if (state->count" << s << " < " << stage.buffer_length
+        << ") { state->count" << s << "++; }\n";
+}
+
+void writeMovingAverageFilter(std::ostream& out, const ExportedStage& stage,
+                              uint32_t s) {
+    out << "    // " << describeStage(stage) << ": the mean of the last "
+        << stage.buffer_length << " inputs.\n"
+        << "    float x" << s << "[" << stage.num_output_dimensions << "];\n";
+    writePush(out, stage, s);
+    out << "    for (uint16_t j = 0; j < " << stage.num_input_dimensions
+        << "; j++) {\n"
+        << "        float sum = 0;\n"
+        << "        for (uint16_t i = 0; i < state->count" << s
+        << "; i++) { sum += state->buffer" << s << "[i][j]; }\n"
+        << "        x" << s << "[j] = sum / state->count" << s << ";\n"
+        << "    }\n";
+}
+
+
+// Emits a loop over the samples of one frame of a TimeDomainFeatures
+// buffer, with the sample in `v` (of `type`) for `body`.
+void writeFrameLoop(std::ostream& out, const ExportedStage& stage, uint32_t s,
+                    const std::string& type, const std::string& body) {
+    const uint32_t frame_size = stage.buffer_length / stage.num_frames;
+    out << "                for (uint16_t i = frame * " << frame_size
+        << "; i < (frame + 1) * " << frame_size << "; i++) {\n"
+        << "                    uint16_t slot = first + i;\n"
+        << "                    if (slot >= " << stage.buffer_length
+        << ") { slot -= " << stage.buffer_length << "; }\n"
+        << "                    const " << type << " v = state->buffer" << s
+        << "[slot][j]" << (stage.offset_input ? " - offset" : "") << ";\n"
+        << "                    " << body << "\n"
+        << "                }\n";
+}
+
+void writeTimeDomainFeatures(std::ostream& out, const ExportedStage& stage,
+                             uint32_t s) {
+    const uint32_t frame_size = stage.buffer_length / stage.num_frames;
+    out << "    // " << describeStage(stage) << ": per input and frame of "
+        << frame_size << " samples,";
+    if (stage.use_mean) { out << " mean"; }
+    if (stage.use_std_dev) { out << " std-dev"; }
+    if (stage.use_euclidean_norm) { out << " norm"; }
+    if (stage.use_rms) { out << " rms"; }
+    out << ".\n"
+        << "    float x" << s << "[" << stage.num_output_dimensions << "];\n";
+    writePush(out, stage, s);
+    // Like GRT's, the buffer is read from slot 0 (the first samples, then
+    // zeros) until it is full, and oldest first after that.
+    out << "    {\n"
+        << "        const uint16_t first = state->count" << s << " < "
+        << stage.buffer_length << " ? 0 : state->next" << s << ";\n"
+        << "        uint16_t f = 0;\n"
+        << "        for (uint16_t j = 0; j < " << stage.num_input_dimensions
+        << "; j++) {\n";
+    if (stage.offset_input) {
+        out << "            const float offset = state->buffer" << s
+            << "[first][j];\n";
+    }
+    out << "            for (uint16_t frame = 0; frame < " << stage.num_frames
+        << "; frame++) {\n"
+        << "                float sum = 0;\n"
+        << "                float sum_squares = 0;\n";
+    writeFrameLoop(out, stage, s, "float", "sum += v; sum_squares += v * v;");
+    out << "                const float mean = sum / " << frame_size << ";\n";
+    if (stage.use_mean) { out << "                x" << s << "[f++] = mean;\n"; }
+    if (stage.use_std_dev) {
+        out << "                float deviation = 0;\n";
+        writeFrameLoop(out, stage, s, "float",
+                       "deviation += (v - mean) * (v - mean);");
+        out << "                x" << s << "[f++] = sqrtf(deviation / "
+            << (frame_size > 1 ? frame_size - 1 : 1) << ");\n";
+    }
+    if (stage.use_euclidean_norm) {
+        out << "                x" << s << "[f++] = sqrtf(sum_squares);\n";
+    }
+    if (stage.use_rms) {
+        out << "                x" << s << "[f++] = sqrtf(sum_squares / "
+            << frame_size << ");\n";
+    }
+    out << "            }\n"
+        << "        }\n"
+        << "    }\n";
+}
+
+// GRT's ANBC predicts no class when every likelihood underflows a double.
+const double kMinLogLikelihood = -745.13;
+
+// log p(x | k) = offsets[k] - sum_j precisions[k][j] * (x[j] - means[k][j])^2
+// over unscaled inputs, as FastANBC computes it. The tables are row-major.
+void foldANBC(const ExportedClassifier& classifier,
+              std::vector<double>* offsets, std::vector<double>* means,
+              std::vector<double>* precisions) {
+    const uint32_t num_classes = classifier.class_labels.size();
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    offsets->assign(num_classes, 0);
+    means->assign(num_classes * num_dimensions, 0);
+    precisions->assign(num_classes * num_dimensions, 0);
+    for (uint32_t k = 0; k < num_classes; k++) {
+        double offset = 0;
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            double weight = classifier.weights[k][j];
+            if (weight <= 0) { continue; }
+            double sigma = classifier.sigmas[k][j];
+            double mean = classifier.means[k][j];
+            double precision = 1 / (2 * sigma * sigma);
+            offset += std::log(weight) - 0.5 * std::log(2 * M_PI) -
+                      std::log(sigma);
+            if (classifier.use_scaling) {
+                double range = classifier.ranges[j].maxValue -
+                               classifier.ranges[j].minValue;
+                if (range > 0) {
+                    mean = classifier.ranges[j].minValue + mean * range;
+                    precision /= range * range;
+                } else {
+                    offset -= precision * mean * mean;
+                    mean = 0;
+                    precision = 0;
+                }
+            }
+            (*means)[k * num_dimensions + j] = mean;
+            (*precisions)[k * num_dimensions + j] = precision;
+        }
+        (*offsets)[k] = offset;
+    }
+}
+
+void writeANBCTables(std::ostream& out, const ExportedClassifier& classifier) {
+    const uint32_t num_classes = classifier.class_labels.size();
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    std::vector<double> folded_offsets, folded_means, folded_precisions;
+    foldANBC(classifier, &folded_offsets, &folded_means, &folded_precisions);
+    std::vector<float> offsets(folded_offsets.begin(), folded_offsets.end());
+    std::vector<float> means(folded_means.begin(), folded_means.end());
+    std::vector<float> precisions(folded_precisions.begin(),
+                                  folded_precisions.end());
+    std::string (*format)(float) = [](float value) {
+        return formatFloat(value);
+    };
+    std::ostringstream size;
+    size << "[" << num_classes << "][" << num_dimensions << "]";
+    writeTable(out, "const float kOffsets[kNumClasses]", offsets, 0, format);
+    writeTable(out, "const float kMeans" + size.str(), means, num_dimensions,
+               format);
+    writeTable(out, "const float kPrecisions" + size.str(), precisions,
+               num_dimensions, format);
+}
+
+void writeANBC(std::ostream& out, const ExportedClassifier& classifier,
+               uint32_t s) {
+    out << "    // ANBC: the class with the highest Gaussian log-likelihood.\n"
+        << "    uint16_t best = 0;\n"
+        << "    float best_log_likelihood = -INFINITY;\n"
+        << "    for (uint16_t k = 0; k < kNumClasses; k++) {\n"
+        << "        float log_likelihood = ESP_READ_FLOAT(kOffsets[k]);\n"
+        << "        for (uint16_t j = 0; j < " << classifier.num_input_dimensions
+        << "; j++) {\n"
+        << "            const float diff = x" << s
+        << "[j] - ESP_READ_FLOAT(kMeans[k][j]);\n"
+        << "            log_likelihood -= ESP_READ_FLOAT(kPrecisions[k][j]) * "
+           "diff * diff;\n"
+        << "        }\n"
+        << "        if (log_likelihood > best_log_likelihood) {\n"
+        << "            best = k;\n"
+        << "            best_log_likelihood = log_likelihood;\n"
+        << "        }\n"
+        << "    }\n"
+        << "    if (!(best_log_likelihood >= " << formatFloat(kMinLogLikelihood)
+        << ")) { return 0; }\n";
+    if (classifier.use_null_rejection) {
+        out << "    if (best_log_likelihood < ESP_READ_FLOAT(kThresholds[best])) "
+               "{ return 0; }\n";
+    }
+    out << "    return ESP_READ_WORD(kClassLabels[best]);\n";
+}
+
+void writeKNNTables(std::ostream& out, const ExportedClassifier& classifier) {
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    const uint32_t num_samples = classifier.sample_classes.size();
+    std::string (*format)(double) = formatFloat;
+    if (classifier.use_scaling) {
+        std::vector<double> minima(num_dimensions), scales(num_dimensions);
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            double range = classifier.ranges[j].maxValue -
+                           classifier.ranges[j].minValue;
+            minima[j] = classifier.ranges[j].minValue;
+            scales[j] = range > 0 ? 1 / range : 0;
+        }
+        std::string size = "[" + std::to_string(num_dimensions) + "]";
+        writeTable(out, "const float kMinima" + size, minima, 0, format);
+        writeTable(out, "const float kScales" + size, scales, 0, format);
+    }
+    writeTable(out, "const uint16_t kSampleClasses[" +
+                            std::to_string(num_samples) + "]",
+               classifier.sample_classes, 0, formatWord);
+    writeTable(out, "const float kSamples[" + std::to_string(num_samples) +
+                            "][" + std::to_string(num_dimensions) + "]",
+               classifier.samples, num_dimensions, format);
+}
+
+void writeKNN(std::ostream& out, const ExportedClassifier& classifier,
+              uint32_t s) {
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    const uint32_t num_samples = classifier.sample_classes.size();
+    const uint32_t k = std::min<uint32_t>(classifier.k, num_samples);
+    std::string input = "x" + std::to_string(s);
+    out << "    // KNN: the " << k << " nearest training samples vote.\n";
+    if (classifier.use_scaling) {
+        out << "    float scaled[" << num_dimensions << "];\n"
+            << "    for (uint16_t j = 0; j < " << num_dimensions << "; j++) {\n"
+            << "        scaled[j] = (" << input
+            << "[j] - ESP_READ_FLOAT(kMinima[j])) * "
+               "ESP_READ_FLOAT(kScales[j]);\n"
+            << "    }\n";
+        input = "scaled";
+    }
+    out << "    float distances[" << k << "];\n"
+        << "    uint16_t classes[" << k << "];\n"
+        << "    uint16_t count = 0;\n"
+        << "    for (" << (num_samples > 0xffff ? "uint32_t" : "uint16_t")
+        << " i = 0; i < " << num_samples << "; i++) {\n"
+        << "        float distance = 0;\n"
+        << "        for (uint16_t j = 0; j < " << num_dimensions << "; j++) {\n"
+        << "            const float diff = " << input
+        << "[j] - ESP_READ_FLOAT(kSamples[i][j]);\n"
+        << "            distance += diff * diff;\n"
+        << "        }\n"
+        << "        if (count < " << k << ") {\n"
+        << "            distances[count] = distance;\n"
+        << "            classes[count++] = ESP_READ_WORD(kSampleClasses[i]);\n"
+        << "            continue;\n"
+        << "        }\n"
+        << "        // GRT replaces the first of the farthest neighbours.\n"
+        << "        uint16_t farthest = 0;\n"
+        << "        for (uint16_t n = 1; n < " << k << "; n++) {\n"
+        << "            if (distances[n] > distances[farthest]) { farthest = n; }\n"
+        << "        }\n"
+        << "        if (distance < distances[farthest]) {\n"
+        << "            distances[farthest] = distance;\n"
+        << "            classes[farthest] = ESP_READ_WORD(kSampleClasses[i]);\n"
+        << "        }\n"
+        << "    }\n"
+        << "    uint16_t votes[kNumClasses] = { 0 };\n"
+        << "    float sums[kNumClasses] = { 0 };\n"
+        << "    for (uint16_t n = 0; n < count; n++) {\n"
+        << "        votes[classes[n]]++;\n"
+        << "        sums[classes[n]] += sqrtf(distances[n]);\n"
+        << "    }\n"
+        << "    uint16_t best = 0;\n"
+        << "    for (uint16_t c = 1; c < kNumClasses; c++) {\n"
+        << "        if (votes[c] > votes[best]) { best = c; }\n"
+        << "    }\n";
+    if (classifier.use_null_rejection) {
+        out << "    if (sums[best] / votes[best] > "
+               "ESP_READ_FLOAT(kThresholds[best])) { return 0; }\n";
+    }
+    out << "    return ESP_READ_WORD(kClassLabels[best]);\n";
+}
+
+// Fixed point: every signal between modules is an int16 in units of a scale
+// per dimension. Calibrated signals use half of the range, so that inputs up
+// to twice as large as in the training data do not saturate.
+const double kMaxQ15 = 32767;
+const double kHeadroom = 2;
+// Log-likelihoods are in units of 2^-16, and saturate at -2^14.
+const double kLogLikelihoodUnit = 65536;
+const double kMaxLogLikelihoodMagnitude = 1 << 30;
+// ANBC distances from a class mean are in units of 1/256 of sqrt(2) sigma,
+// so that their square is in units of the log-likelihood.
+const double kDistanceUnit = 256;
+
+double getScale(double max_magnitude) {
+    return max_magnitude > 0 ? kHeadroom * max_magnitude / kMaxQ15 : 1;
+}
+
+// Rounds `value` and saturates it to +-max_magnitude.
+int32_t quantize(double value, double max_magnitude) {
+    if (!(value > -max_magnitude)) {
+        return static_cast<int32_t>(-max_magnitude);
+    }
+    return static_cast<int32_t>(std::min(max_magnitude, std::round(value)));
+}
+
+// A factor > 0 as multiplier * 2^-shift, with the multiplier in [2^29, 2^30)
+// if the shift allows.
+void getMultiplier(double factor, int32_t* multiplier, uint32_t* shift) {
+    *multiplier = 0;
+    *shift = 0;
+    if (!(factor > 0) || std::isinf(factor)) { return; }
+    int exponent = 0;
+    std::frexp(factor, &exponent);
+    *shift = std::max(0, std::min(62, 30 - exponent));
+    *multiplier = static_cast<int32_t>(
+            std::min(std::round(std::ldexp(factor, *shift)), 2147483647.0));
+}
+
+std::string formatInteger(int32_t value) { return std::to_string(value); }
+
+// The pipeline's stages in double precision, computed like GRT's modules
+// and the float code, to calibrate the fixed-point scales on.
+class ReferenceStages {
+  public:
+    explicit ReferenceStages(const ExportedPipeline& pipeline)
+            : pipeline_(pipeline),
+              buffers_(pipeline.stages.size()),
+              signals_(pipeline.stages.size() + 1) {
+        signals_[0].resize(pipeline.num_input_dimensions);
+        for (uint32_t s = 1; s <= pipeline.stages.size(); s++) {
+            const ExportedStage& stage = pipeline.stages[s - 1];
+            buffers_[s - 1].resize(stage.buffer_length *
+                                   stage.num_input_dimensions);
+            signals_[s].resize(stage.num_output_dimensions);
+        }
+        reset();
+    }
+
+    void reset() {
+        for (std::vector<double>& buffer : buffers_) {
+            std::fill(buffer.begin(), buffer.end(), 0);
+        }
+        next_.assign(buffers_.size(), 0);
+        count_.assign(buffers_.size(), 0);
+    }
+
+    // Afterwards, getSignal(0) is `input` and getSignal(s) the output of
+    // stage s.
+    void process(const double* input) {
+        std::copy(input, input + signals_[0].size(), signals_[0].begin());
+        for (uint32_t s = 1; s < signals_.size(); s++) {
+            processStage(s);
+        }
+    }
+
+    const std::vector<double>& getSignal(uint32_t s) const {
+        return signals_[s];
+    }
+
+  private:
+    void processStage(uint32_t s) {
+        const ExportedStage& stage = pipeline_.stages[s - 1];
+        const uint32_t num_dimensions = stage.num_input_dimensions;
+        const uint32_t length = stage.buffer_length;
+        std::vector<double>& buffer = buffers_[s - 1];
+        std::vector<double>& output = signals_[s];
+        uint32_t& next = next_[s - 1];
+        uint32_t& count = count_[s - 1];
+        std::copy(signals_[s - 1].begin(), signals_[s - 1].end(),
+                  buffer.begin() + next * num_dimensions);
+        if (++next == length) { next = 0; }
+        if (count < length) { count++; }
+
+        if (stage.type == ExportedStage::MOVING_AVERAGE_FILTER) {
+            for (uint32_t j = 0; j < num_dimensions; j++) {
+                double sum = 0;
+                for (uint32_t i = 0; i < count; i++) {
+                    sum += buffer[i * num_dimensions + j];
+                }
+                output[j] = sum / count;
+            }
+            return;
+        }
+        const uint32_t first = count < length ? 0 : next;
+        const uint32_t frame_size = length / stage.num_frames;
+        uint32_t f = 0;
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            const double offset = stage.offset_input
+                    ? buffer[first * num_dimensions + j]
+                    : 0;
+            for (uint32_t frame = 0; frame < stage.num_frames; frame++) {
+                std::vector<double> values(frame_size);
+                double sum = 0, sum_squares = 0;
+                for (uint32_t i = 0; i < frame_size; i++) {
+                    uint32_t slot = (first + frame * frame_size + i) % length;
+                    values[i] = buffer[slot * num_dimensions + j] - offset;
+                    sum += values[i];
+                    sum_squares += values[i] * values[i];
+                }
+                const double mean = sum / frame_size;
+                if (stage.use_mean) { output[f++] = mean; }
+                if (stage.use_std_dev) {
+                    double deviation = 0;
+                    for (double v : values) {
+                        deviation += (v - mean) * (v - mean);
+                    }
+                    output[f++] = std::sqrt(
+                            deviation / std::max<uint32_t>(frame_size - 1, 1));
+                }
+                if (stage.use_euclidean_norm) {
+                    output[f++] = std::sqrt(sum_squares);
+                }
+                if (stage.use_rms) {
+                    output[f++] = std::sqrt(sum_squares / frame_size);
+                }
+            }
+        }
+    }
+
+    const ExportedPipeline& pipeline_;
+    std::vector<std::vector<double>> buffers_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> count_;
+    std::vector<std::vector<double>> signals_;
+};
+
+// The arithmetic the fixed-point code shares.
+void writeFixedPointHelpers(std::ostream& out) {
+    out << "\n"
+        << "inline int16_t quantize(float x) {\n"
+        << "    if (x >= 32767.0f) { return 32767; }\n"
+        << "    if (!(x > -32767.0f)) { return -32767; }\n"
+        << "    return (int16_t)(x < 0 ? x - 0.5f : x + 0.5f);\n"
+        << "}\n"
+        << "\n"
+        << "// x * multiplier / 2^shift, rounded and saturated.\n"
+        << "inline int16_t requantize(int32_t x, int32_t multiplier, "
+           "uint8_t shift) {\n"
+        << "    int64_t product = (int64_t)x * multiplier;\n"
+        << "    if (shift > 0) { product += (int64_t)1 << (shift - 1); }\n"
+        << "    product >>= shift;\n"
+        << "    if (product > 32767) { return 32767; }\n"
+        << "    if (product < -32767) { return -32767; }\n"
+        << "    return (int16_t)product;\n"
+        << "}\n"
+        << "\n"
+        << "// floor(sqrt(x)).\n"
+        << "inline uint32_t squareRoot(uint64_t x) {\n"
+        << "    uint64_t root = 0;\n"
+        << "    uint64_t bit = (uint64_t)1 << 62;\n"
+        << "    while (bit > x) { bit >>= 2; }\n"
+        << "    while (bit != 0) {\n"
+        << "        if (x >= root + bit) {\n"
+        << "            x -= root + bit;\n"
+        << "            root = (root >> 1) + bit;\n"
+        << "        } else {\n"
+        << "            root >>= 1;\n"
+        << "        }\n"
+        << "        bit >>= 2;\n"
+        << "    }\n"
+        << "    return (uint32_t)root;\n"
+        << "}\n";
+}
+
+// The factors that take each TimeDomainFeatures output from its sums (in
+// units of the input scale) to the output scale.
+void writeRequantizationTables(std::ostream& out, const ExportedStage& stage,
+                               uint32_t s, const std::vector<double>& input,
+                               const std::vector<double>& output) {
+    const double frame_size = stage.buffer_length / stage.num_frames;
+    std::vector<double> factors;
+    for (uint32_t j = 0; j < stage.num_input_dimensions; j++) {
+        for (uint32_t frame = 0; frame < stage.num_frames; frame++) {
+            // Of the sum, sqrt(n * sum_squares - sum^2) and sqrt(sum_squares).
+            if (stage.use_mean) { factors.push_back(input[j] / frame_size); }
+            if (stage.use_std_dev) {
+                factors.push_back(
+                        input[j] / std::sqrt(frame_size *
+                                             std::max(frame_size - 1, 1.0)));
+            }
+            if (stage.use_euclidean_norm) { factors.push_back(input[j]); }
+            if (stage.use_rms) {
+                factors.push_back(input[j] / std::sqrt(frame_size));
+            }
+        }
+    }
+    std::vector<int32_t> multipliers(factors.size());
+    std::vector<uint32_t> shifts(factors.size());
+    for (uint32_t f = 0; f < factors.size(); f++) {
+        getMultiplier(factors[f] / output[f], &multipliers[f], &shifts[f]);
+    }
+    std::string size = "[" + std::to_string(factors.size()) + "]";
+    writeTable(out, "const int32_t kMultipliers" + std::to_string(s) + size,
+               multipliers, 0, formatInteger);
+    writeTable(out, "const uint8_t kShifts" + std::to_string(s) + size, shifts,
+               0, formatWord);
+}
+
+void writeFixedPointMovingAverageFilter(std::ostream& out,
+                                        const ExportedStage& stage,
+                                        uint32_t s) {
+    out << "    // " << describeStage(stage) << ": the mean of the last "
+        << stage.buffer_length << " inputs, in their scale.\n"
+        << "    int16_t x" << s << "[" << stage.num_output_dimensions << "];\n";
+    writePush(out, stage, s);
+    out << "    for (uint16_t j = 0; j < " << stage.num_input_dimensions
+        << "; j++) {\n"
+        << "        int32_t sum = 0;\n"
+        << "        for (uint16_t i = 0; i < state->count" << s
+        << "; i++) { sum += state->buffer" << s << "[i][j]; }\n"
+        << "        const int32_t count = state->count" << s << ";\n"
+        << "        x" << s << "[j] = (int16_t)((sum >= 0 ? sum + count / 2 "
+           ": sum - count / 2) / count);\n"
+        << "    }\n";
+}
+
+void writeFixedPointTimeDomainFeatures(std::ostream& out,
+                                       const ExportedStage& stage, uint32_t s) {
+    const uint32_t frame_size = stage.buffer_length / stage.num_frames;
+    auto writeFeature = [&](const std::string& value) {
+        out << "                x" << s << "[f] = requantize(" << value
+            << ", (int32_t)ESP_READ_DWORD(kMultipliers" << s << "[f]),\n"
+            << "                                   ESP_READ_BYTE(kShifts" << s
+            << "[f]));\n"
+            << "                f++;\n";
+    };
+    out << "    // " << describeStage(stage) << ": per input and frame of "
+        << frame_size << " samples:";
+    if (stage.use_mean) { out << " mean"; }
+    if (stage.use_std_dev) { out << " std-dev"; }
+    if (stage.use_euclidean_norm) { out << " norm"; }
+    if (stage.use_rms) { out << " rms"; }
+    out << ".\n"
+        << "    // They are computed from exact sums, then rescaled.\n"
+        << "    int16_t x" << s << "[" << stage.num_output_dimensions << "];\n";
+    writePush(out, stage, s);
+    out << "    {\n"
+        << "        const uint16_t first = state->count" << s << " < "
+        << stage.buffer_length << " ? 0 : state->next" << s << ";\n"
+        << "        uint16_t f = 0;\n"
+        << "        for (uint16_t j = 0; j < " << stage.num_input_dimensions
+        << "; j++) {\n";
+    if (stage.offset_input) {
+        out << "            const int32_t offset = state->buffer" << s
+            << "[first][j];\n";
+    }
+    out << "            for (uint16_t frame = 0; frame < " << stage.num_frames
+        << "; frame++) {\n"
+        << "                int32_t sum = 0;\n"
+        << "                int64_t sum_squares = 0;\n";
+    writeFrameLoop(out, stage, s, "int32_t",
+                   "sum += v; sum_squares += (int64_t)v * v;");
+    if (stage.use_mean) { writeFeature("sum"); }
+    if (stage.use_std_dev) {
+        out << "                const int32_t deviation = (int32_t)squareRoot(\n"
+            << "                        (uint64_t)(" << frame_size
+            << " * sum_squares - (int64_t)sum * sum));\n";
+        writeFeature("deviation");
+    }
+    if (stage.use_euclidean_norm || stage.use_rms) {
+        out << "                const int32_t root = "
+               "(int32_t)squareRoot((uint64_t)sum_squares);\n";
+    }
+    if (stage.use_euclidean_norm) { writeFeature("root"); }
+    if (stage.use_rms) { writeFeature("root"); }
+    out << "            }\n"
+        << "        }\n"
+        << "    }\n";
+}
+
+int32_t quantizeLogLikelihood(double log_likelihood) {
+    return quantize(log_likelihood * kLogLikelihoodUnit,
+                    kMaxLogLikelihoodMagnitude);
+}
+
+void writeFixedPointANBCTables(std::ostream& out,
+                               const ExportedClassifier& classifier,
+                               const std::vector<double>& scales) {
+    const uint32_t num_classes = classifier.class_labels.size();
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    std::vector<double> offsets, means, precisions;
+    foldANBC(classifier, &offsets, &means, &precisions);
+    std::vector<int32_t> quantized_offsets(num_classes);
+    std::vector<int32_t> quantized_means(num_classes * num_dimensions);
+    std::vector<int32_t> coefficients(num_classes * num_dimensions);
+    std::vector<uint32_t> shifts(num_classes * num_dimensions);
+    for (uint32_t k = 0; k < num_classes; k++) {
+        quantized_offsets[k] = quantizeLogLikelihood(offsets[k]);
+        for (uint32_t j = 0; j < num_dimensions; j++) {
+            const uint32_t i = k * num_dimensions + j;
+            quantized_means[i] = quantize(means[i] / scales[j], kMaxQ15);
+            // The distance from the mean per unit of the input.
+            double coefficient =
+                    std::sqrt(precisions[i]) * scales[j] * kDistanceUnit;
+            uint32_t shift = 0;
+            while (shift < 31 &&
+                   std::round(std::ldexp(coefficient, shift + 1)) <= kMaxQ15) {
+                shift++;
+            }
+            coefficients[i] = quantize(std::ldexp(coefficient, shift), kMaxQ15);
+            shifts[i] = shift;
+        }
+    }
+    std::ostringstream size;
+    size << "[" << num_classes << "][" << num_dimensions << "]";
+    writeTable(out, "const int32_t kOffsets[kNumClasses]", quantized_offsets, 0,
+               formatInteger);
+    writeTable(out, "const int16_t kMeans" + size.str(), quantized_means,
+               num_dimensions, formatInteger);
+    writeTable(out, "const int16_t kCoefficients" + size.str(), coefficients,
+               num_dimensions, formatInteger);
+    writeTable(out, "const uint8_t kCoefficientShifts" + size.str(), shifts,
+               num_dimensions, formatWord);
+}
+
+void writeFixedPointANBC(std::ostream& out,
+                         const ExportedClassifier& classifier, uint32_t s) {
+    out << "    // ANBC: the class with the highest Gaussian log-likelihood, "
+           "in units of\n"
+        << "    // 2^-16. The squared distances from the class means saturate, "
+           "so that\n"
+        << "    // they cannot overflow.\n"
+        << "    uint16_t best = 0;\n"
+        << "    int32_t best_log_likelihood = INT32_MIN;\n"
+        << "    for (uint16_t k = 0; k < kNumClasses; k++) {\n"
+        << "        uint32_t distance = 0;\n"
+        << "        for (uint16_t j = 0; j < " << classifier.num_input_dimensions
+        << "; j++) {\n"
+        << "            const int32_t diff = x" << s
+        << "[j] - (int16_t)ESP_READ_WORD(kMeans[k][j]);\n"
+        << "            int32_t z = (diff * "
+           "(int16_t)ESP_READ_WORD(kCoefficients[k][j])) >>\n"
+        << "                        ESP_READ_BYTE(kCoefficientShifts[k][j]);\n"
+        << "            if (z > 32767) { z = 32767; }\n"
+        << "            if (z < -32767) { z = -32767; }\n"
+        << "            distance += (uint32_t)(z * z);\n"
+        << "            if (distance > 0x40000000UL) {\n"
+        << "                distance = 0x40000000UL;\n"
+        << "            }\n"
+        << "        }\n"
+        << "        const int32_t log_likelihood =\n"
+        << "                (int32_t)ESP_READ_DWORD(kOffsets[k]) - "
+           "(int32_t)distance;\n"
+        << "        if (log_likelihood > best_log_likelihood) {\n"
+        << "            best = k;\n"
+        << "            best_log_likelihood = log_likelihood;\n"
+        << "        }\n"
+        << "    }\n"
+        << "    if (best_log_likelihood < "
+        << quantizeLogLikelihood(kMinLogLikelihood) << ") { return 0; }\n";
+    if (classifier.use_null_rejection) {
+        out << "    if (best_log_likelihood < "
+               "(int32_t)ESP_READ_DWORD(kThresholds[best])) {\n"
+            << "        return 0;\n"
+            << "    }\n";
+    }
+    out << "    return ESP_READ_WORD(kClassLabels[best]);\n";
+}
+
+// KNN distances are between inputs weighted by how much one unit of each
+// counts in GRT's (scaled) distance, relative to the largest: the real
+// distance is sqrt(distance) * *unit.
+void getKNNWeights(const ExportedClassifier& classifier,
+                   const std::vector<double>& scales,
+                   std::vector<double>* weights, double* unit) {
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    weights->assign(num_dimensions, 0);
+    double max_weight = 0;
+    for (uint32_t j = 0; j < num_dimensions; j++) {
+        (*weights)[j] = scales[j];
+        if (classifier.use_scaling) {
+            double range = classifier.ranges[j].maxValue -
+                           classifier.ranges[j].minValue;
+            (*weights)[j] = range > 0 ? scales[j] / range : 0;
+        }
+        max_weight = std::max(max_weight, (*weights)[j]);
+    }
+    for (double& weight : *weights) {
+        weight = max_weight > 0 ? weight / max_weight : 0;
+    }
+    // The weighted differences are scaled down by 2^16 / kMaxQ15.
+    *unit = max_weight > 0 ? max_weight * 65536 / kMaxQ15 : 1;
+}
+
+void writeFixedPointKNNTables(std::ostream& out,
+                              const ExportedClassifier& classifier,
+                              const std::vector<double>& scales) {
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    const uint32_t num_samples = classifier.sample_classes.size();
+    std::vector<double> weights;
+    double unit = 0;
+    getKNNWeights(classifier, scales, &weights, &unit);
+    std::vector<int32_t> quantized_weights(num_dimensions);
+    for (uint32_t j = 0; j < num_dimensions; j++) {
+        quantized_weights[j] = quantize(weights[j] * kMaxQ15, kMaxQ15);
+    }
+    std::vector<int32_t> samples(classifier.samples.size());
+    for (uint32_t i = 0; i < samples.size(); i++) {
+        const uint32_t j = i % num_dimensions;
+        double value = classifier.samples[i];
+        if (classifier.use_scaling) {
+            value = classifier.ranges[j].minValue +
+                    value * (classifier.ranges[j].maxValue -
+                             classifier.ranges[j].minValue);
+        }
+        samples[i] = quantize(value / scales[j], kMaxQ15);
+    }
+    if (classifier.use_null_rejection) {
+        std::vector<uint32_t> thresholds;
+        for (double threshold : classifier.null_rejection_thresholds) {
+            double quantized = std::round(threshold / unit);
+            thresholds.push_back(
+                    std::isnan(quantized) || quantized >= 4294967295.0
+                            ? 4294967295u
+                            : static_cast<uint32_t>(std::max(quantized, 0.0)));
+        }
+        writeTable(out, "const uint32_t kThresholds[kNumClasses]", thresholds,
+                   0, formatWord);
+    }
+    writeTable(out, "const int16_t kWeights[" +
+                            std::to_string(num_dimensions) + "]",
+               quantized_weights, 0, formatInteger);
+    writeTable(out, "const uint16_t kSampleClasses[" +
+                            std::to_string(num_samples) + "]",
+               classifier.sample_classes, 0, formatWord);
+    writeTable(out, "const int16_t kSamples[" + std::to_string(num_samples) +
+                            "][" + std::to_string(num_dimensions) + "]",
+               samples, num_dimensions, formatInteger);
+}
+
+void writeFixedPointKNN(std::ostream& out, const ExportedClassifier& classifier,
+                        uint32_t s) {
+    const uint32_t num_dimensions = classifier.num_input_dimensions;
+    const uint32_t num_samples = classifier.sample_classes.size();
+    const uint32_t k = std::min<uint32_t>(classifier.k, num_samples);
+    out << "    // KNN: the " << k << " nearest training samples vote. "
+           "Distances are squared\n"
+        << "    // weighted differences, saturated so that they cannot "
+           "overflow.\n"
+        << "    uint32_t distances[" << k << "];\n"
+        << "    uint16_t classes[" << k << "];\n"
+        << "    uint16_t count = 0;\n"
+        << "    for (" << (num_samples > 0xffff ? "uint32_t" : "uint16_t")
+        << " i = 0; i < " << num_samples << "; i++) {\n"
+        << "        uint32_t distance = 0;\n"
+        << "        for (uint16_t j = 0; j < " << num_dimensions << "; j++) {\n"
+        << "            const int32_t diff = x" << s
+        << "[j] - (int16_t)ESP_READ_WORD(kSamples[i][j]);\n"
+        << "            const int32_t weighted =\n"
+        << "                    (diff * (int16_t)ESP_READ_WORD(kWeights[j])) "
+           ">> 16;\n"
+        << "            distance += (uint32_t)(weighted * weighted);\n"
+        << "            if (distance > 0x80000000UL) {\n"
+        << "                distance = 0x80000000UL;\n"
+        << "            }\n"
+        << "        }\n"
+        << "        if (count < " << k << ") {\n"
+        << "            distances[count] = distance;\n"
+        << "            classes[count++] = ESP_READ_WORD(kSampleClasses[i]);\n"
+        << "            continue;\n"
+        << "        }\n"
+        << "        // GRT replaces the first of the farthest neighbours.\n"
+        << "        uint16_t farthest = 0;\n"
+        << "        for (uint16_t n = 1; n < " << k << "; n++) {\n"
+        << "            if (distances[n] > distances[farthest]) { farthest = n; }\n"
+        << "        }\n"
+        << "        if (distance < distances[farthest]) {\n"
+        << "            distances[farthest] = distance;\n"
+        << "            classes[farthest] = ESP_READ_WORD(kSampleClasses[i]);\n"
+        << "        }\n"
+        << "    }\n"
+        << "    uint16_t votes[kNumClasses] = { 0 };\n"
+        << "    uint32_t sums[kNumClasses] = { 0 };\n"
+        << "    for (uint16_t n = 0; n < count; n++) {\n"
+        << "        votes[classes[n]]++;\n"
+        << "        sums[classes[n]] += squareRoot(distances[n]);\n"
+        << "    }\n"
+        << "    uint16_t best = 0;\n"
+        << "    for (uint16_t c = 1; c < kNumClasses; c++) {\n"
+        << "        if (votes[c] > votes[best]) { best = c; }\n"
+        << "    }\n";
+    if (classifier.use_null_rejection) {
+        out << "    if (sums[best] >\n"
+            << "        (uint64_t)ESP_READ_DWORD(kThresholds[best]) * "
+               "votes[best]) {\n"
+            << "        return 0;\n"
+            << "    }\n";
+    }
+    out << "    return ESP_READ_WORD(kClassLabels[best]);\n";
+}
+
+}  // namespace
+
+bool readExportedPipeline(const GRT::GestureRecognitionPipeline& trained,
+                          ExportedPipeline* pipeline, std::string* error) {
+    // GRT only hands out its modules from a non-const pipeline.
+    GRT::GestureRecognitionPipeline copy(trained);
+    if (!copy.getTrained()) { return fail(error, "The pipeline is not trained"); }
+    if (copy.getNumPostProcessingModules() > 0) {
+        return fail(error, "Cannot export post-processing modules");
+    }
+    if (!copy.getIsClassifierSet()) {
+        return fail(error, "The pipeline has no classifier");
+    }
+
+    const uint32_t num_pre_processing = copy.getNumPreProcessingModules();
+    const uint32_t num_feature_extraction =
+            copy.getNumFeatureExtractionModules();
+    pipeline->stages.resize(num_pre_processing + num_feature_extraction);
+    for (uint32_t i = 0; i < num_pre_processing; i++) {
+        if (!readPreProcessing(copy.getPreProcessingModule(i),
+                               &pipeline->stages[i], error)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < num_feature_extraction; i++) {
+        if (!readFeatureExtraction(
+                    copy.getFeatureExtractionModule(i),
+                    &pipeline->stages[num_pre_processing + i], error)) {
+            return false;
+        }
+    }
+
+    GRT::Classifier* trained_classifier = copy.getClassifier();
+    GRT::ANBC* anbc = dynamic_cast<GRT::ANBC*>(trained_classifier);
+    FastANBC* fast_anbc = dynamic_cast<FastANBC*>(trained_classifier);
+    GRT::KNN* knn = dynamic_cast<GRT::KNN*>(trained_classifier);
+    KDTreeKNN* kd_tree_knn = dynamic_cast<KDTreeKNN*>(trained_classifier);
+    ExportedClassifier& classifier = pipeline->classifier;
+    classifier.k = 0;
+    bool ok;
+    if (anbc != nullptr) {
+        ok = readANBC(*anbc, &classifier, error);
+    } else if (fast_anbc != nullptr) {
+        GRT::ANBC model = fast_anbc->getANBC();
+        ok = readANBC(model, &classifier, error);
+    } else if (knn != nullptr) {
+        ok = readKNN(*knn, &classifier, error);
+    } else if (kd_tree_knn != nullptr) {
+        ok = readKDTreeKNN(*kd_tree_knn, &classifier, error);
+    } else {
+        return fail(error, "Cannot export a " +
+                           trained_classifier->getClassifierType() +
+                           " classifier");
+    }
+    if (!ok) { return false; }
+    if (classifier.class_labels.empty()) {
+        return fail(error, "The classifier has no classes");
+    }
+    for (uint32_t label : classifier.class_labels) {
+        if (label > 0xffff) { return fail(error, "Class labels must be < 65536"); }
+    }
+    if (classifier.type == ExportedClassifier::KNN &&
+        (classifier.k == 0 || classifier.sample_classes.empty())) {
+        return fail(error, "The KNN classifier has no neighbours");
+    }
+
+    // Every module must take what the one before it gives.
+    uint32_t num_dimensions = pipeline->stages.empty()
+            ? classifier.num_input_dimensions
+            : pipeline->stages[0].num_input_dimensions;
+    pipeline->num_input_dimensions = num_dimensions;
+    for (const ExportedStage& stage : pipeline->stages) {
+        if (stage.num_input_dimensions != num_dimensions) {
+            return fail(error, "The module dimensions do not match");
+        }
+        num_dimensions = stage.num_output_dimensions;
+    }
+    if (classifier.num_input_dimensions != num_dimensions) {
+        return fail(error, "The classifier dimensions do not match");
+    }
+    return true;
+}
+
+void writePipelineHeader(const ExportedPipeline& pipeline,
+                         const std::string& name, std::ostream& out) {
+    const ExportedClassifier& classifier = pipeline.classifier;
+    const uint32_t num_stages = pipeline.stages.size();
+
+    writePreamble(out, pipeline, name, sizeof(float), "float");
+    if (classifier.use_null_rejection) {
+        std::string (*format)(double) = formatFloat;
+        writeTable(out, "const float kThresholds[kNumClasses]",
+                   classifier.null_rejection_thresholds, 0, format);
+    }
+    if (classifier.type == ExportedClassifier::ANBC) {
+        writeANBCTables(out, classifier);
+    } else {
+        writeKNNTables(out, classifier);
+    }
+
+    out << "\n"
+        << "// The filters' sample history; zero-initialize it to start "
+           "empty.\n"
+        << "struct State {\n";
+    for (uint32_t s = 1; s <= num_stages; s++) {
+        const ExportedStage& stage = pipeline.stages[s - 1];
+        out << "    float buffer" << s << "[" << stage.buffer_length << "]["
+            << stage.num_input_dimensions << "];\n"
+            << "    uint16_t next" << s << ";\n"
+            << "    uint16_t count" << s << ";\n";
+    }
+    out << "};\n"
+        << "\n"
+        << "// `input` holds kNumInputDimensions values. Returns the predicted "
+           "class\n"
+        << "// label, or 0 for none.\n"
+        << "inline uint16_t predict(State* state, const float* input) {\n"
+        << "    const float* x0 = input;\n";
+    for (uint32_t s = 1; s <= num_stages; s++) {
+        const ExportedStage& stage = pipeline.stages[s - 1];
+        if (stage.type == ExportedStage::MOVING_AVERAGE_FILTER) {
+            writeMovingAverageFilter(out, stage, s);
+        } else {
+            writeTimeDomainFeatures(out, stage, s);
+        }
+        out << "\n";
+    }
+    if (classifier.type == ExportedClassifier::ANBC) {
+        writeANBC(out, classifier, num_stages);
+    } else {
+        writeKNN(out, classifier, num_stages);
+    }
+    out << "}\n"
+        << "\n"
+        << "}  // namespace " << name << "\n";
+}
+
+bool exportPipelineHeader(const GRT::GestureRecognitionPipeline& trained,
+                          const std::string& name, std::ostream& out,
+                          std::string* error) {
+    ExportedPipeline pipeline;
+    if (!readExportedPipeline(trained, &pipeline, error)) { return false; }
+    writePipelineHeader(pipeline, name, out);
+    return true;
+}
+
+bool calibrateFixedPoint(const ExportedPipeline& pipeline,
+                         GRT::TimeSeriesClassificationData training_data,
+                         FixedPointScales* scales, std::string* error) {
+    if (training_data.getNumSamples() == 0) {
+        return fail(error, "There is no training data to calibrate on");
+    }
+    if (training_data.getNumDimensions() != pipeline.num_input_dimensions) {
+        return fail(error, "The training data dimensions do not match the "
+                           "pipeline");
+    }
+    for (const ExportedStage& stage : pipeline.stages) {
+        // The fixed-point sums of a frame would overflow.
+        if (stage.type == ExportedStage::TIME_DOMAIN_FEATURES &&
+            stage.buffer_length / stage.num_frames > 0x7fff) {
+            return fail(error, "TimeDomainFeatures frames are too long for "
+                               "fixed point");
+        }
+    }
+
+    // Like the live pipeline, each training sample is replayed row by row
+    // from empty buffers.
+    const uint32_t num_signals = pipeline.stages.size() + 1;
+    ReferenceStages stages(pipeline);
+    std::vector<std::vector<double>> max_magnitudes(num_signals);
+    for (uint32_t s = 0; s < num_signals; s++) {
+        max_magnitudes[s].assign(stages.getSignal(s).size(), 0);
+    }
+    for (GRT::UINT i = 0; i < training_data.getNumSamples(); i++) {
+        const GRT::MatrixDouble& data = training_data[i].getData();
+        stages.reset();
+        for (GRT::UINT row = 0; row < data.getNumRows(); row++) {
+            GRT::VectorDouble input = data.getRowVector(row);
+            stages.process(&input[0]);
+            for (uint32_t s = 0; s < num_signals; s++) {
+                const std::vector<double>& signal = stages.getSignal(s);
+                for (uint32_t j = 0; j < signal.size(); j++) {
+                    max_magnitudes[s][j] = std::max(max_magnitudes[s][j],
+                                                    std::fabs(signal[j]));
+                }
+            }
+        }
+    }
+
+    scales->signals.resize(num_signals);
+    for (uint32_t s = 0; s < num_signals; s++) {
+        // A moving average stays in the range of its input, so it keeps its
+        // scale and needs no rescaling.
+        if (s > 0 && pipeline.stages[s - 1].type ==
+                             ExportedStage::MOVING_AVERAGE_FILTER) {
+            scales->signals[s] = scales->signals[s - 1];
+            continue;
+        }
+        scales->signals[s].resize(max_magnitudes[s].size());
+        for (uint32_t j = 0; j < max_magnitudes[s].size(); j++) {
+            scales->signals[s][j] = getScale(max_magnitudes[s][j]);
+        }
+    }
+    return true;
+}
+
+void writeFixedPointHeader(const ExportedPipeline& pipeline,
+                           const FixedPointScales& scales,
+                           const std::string& name, std::ostream& out) {
+    const ExportedClassifier& classifier = pipeline.classifier;
+    const uint32_t num_stages = pipeline.stages.size();
+
+    writePreamble(out, pipeline, name, sizeof(int16_t), "fixed-point");
+    std::vector<float> inverse_scales;
+    for (double scale : scales.signals[0]) {
+        inverse_scales.push_back(1 / scale);
+    }
+    std::string (*format)(float) = [](float value) {
+        return formatFloat(value);
+    };
+    writeTable(out, "const float kInputInverseScales[kNumInputDimensions]",
+               inverse_scales, 0, format);
+    for (uint32_t s = 1; s <= num_stages; s++) {
+        const ExportedStage& stage = pipeline.stages[s - 1];
+        if (stage.type == ExportedStage::TIME_DOMAIN_FEATURES) {
+            writeRequantizationTables(out, stage, s, scales.signals[s - 1],
+                                      scales.signals[s]);
+        }
+    }
+    if (classifier.type == ExportedClassifier::ANBC) {
+        if (classifier.use_null_rejection) {
+            std::vector<int32_t> thresholds;
+            for (double threshold : classifier.null_rejection_thresholds) {
+                thresholds.push_back(quantizeLogLikelihood(threshold));
+            }
+            writeTable(out, "const int32_t kThresholds[kNumClasses]",
+                       thresholds, 0, formatInteger);
+        }
+        writeFixedPointANBCTables(out, classifier, scales.signals[num_stages]);
+    } else {
+        writeFixedPointKNNTables(out, classifier, scales.signals[num_stages]);
+    }
+    writeFixedPointHelpers(out);
+
+    out << "\n"
+        << "// The filters' sample history; zero-initialize it to start "
+           "empty.\n"
+        << "struct State {\n";
+    for (uint32_t s = 1; s <= num_stages; s++) {
+        const ExportedStage& stage = pipeline.stages[s - 1];
+        out << "    int16_t buffer" << s << "[" << stage.buffer_length << "]["
+            << stage.num_input_dimensions << "];\n"
+            << "    uint16_t next" << s << ";\n"
+            << "    uint16_t count" << s << ";\n";
+    }
+    out << "};\n"
+        << "\n"
+        << "// `input` holds kNumInputDimensions values. Returns the predicted "
+           "class\n"
+        << "// label, or 0 for none. Only the input is converted from float; "
+           "the rest is\n"
+        << "// integer arithmetic.\n"
+        << "inline uint16_t predict(State* state, const float* input) {\n"
+        << "    int16_t x0[kNumInputDimensions];\n"
+        << "    for (uint16_t j = 0; j < kNumInputDimensions; j++) {\n"
+        << "        x0[j] = quantize(input[j] * "
+           "ESP_READ_FLOAT(kInputInverseScales[j]));\n"
+        << "    }\n"
+        << "\n";
+    for (uint32_t s = 1; s <= num_stages; s++) {
+        const ExportedStage& stage = pipeline.stages[s - 1];
+        if (stage.type == ExportedStage::MOVING_AVERAGE_FILTER) {
+            writeFixedPointMovingAverageFilter(out, stage, s);
+        } else {
+            writeFixedPointTimeDomainFeatures(out, stage, s);
+        }
+        out << "\n";
+    }
+    if (classifier.type == ExportedClassifier::ANBC) {
+        writeFixedPointANBC(out, classifier, num_stages);
+    } else {
+        writeFixedPointKNN(out, classifier, num_stages);
+    }
+    out << "}\n"
+        << "\n"
+        << "}  // namespace " << name << "\n";
+}
+
+bool exportFixedPointHeader(
+        const GRT::GestureRecognitionPipeline& trained,
+        const GRT::TimeSeriesClassificationData& training_data,
+        const std::string& name, std::ostream& out, std::string* error) {
+    ExportedPipeline pipeline;
+    FixedPointScales scales;
+    if (!readExportedPipeline(trained, &pipeline, error) ||
+        !calibrateFixedPoint(pipeline, training_data, &scales, error)) {
+        return false;
+    }
+    writeFixedPointHeader(pipeline, scales, name, out);
+    return true;
+}
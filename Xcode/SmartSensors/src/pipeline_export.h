@@ -0,0 +1,136 @@
+/*
+ * Exporting a trained pipeline as C++ code for microcontrollers.
+ *
+ * The Arduino sketches used to embed the GRT pipeline file as a string and
+ * load it at boot, which parses thousands of characters through an
+ * istringstream and keeps both the text and the loaded model in SRAM. The
+ * exporter instead turns the trained pipeline into a self-contained header:
+ * the model is a set of const tables (PROGMEM on AVR, so they stay in flash)
+ * and predict() is specialized to the pipeline's modules and sizes, with no
+ * parsing, no GRT and no heap allocation:
+ *
+ * #include "model.h"
+ *
+ * model::State state;  // zero-initialized: empty filter buffers
+ * ...
+ * float sample[model::kNumInputDimensions] = { red, green, blue };
+ * uint16_t label = model::predict(&state, sample);  // 0: no class
+ *
+ * Supported modules: MovingAverageFilter and TimeDomainFeatures, then an
+ * ANBC, FastANBC, KNN (Euclidean distance) or KDTreeKNN classifier, and no
+ * post-processing. The generated code computes in float, so predictions only
+ * differ from GRT's double precision when two classes are within rounding
+ * of each other; `make export-check` in headless/ compares them on recorded
+ * sessions.
+ *
+ * On boards without an FPU (most Arduinos), every float operation is a
+ * library call. The fixed-point variant converts the input to int16 once and
+ * does the rest in integer arithmetic: the signals between modules are int16
+ * in units of a scale per dimension, calibrated on the training data; the
+ * features are computed from exact integer sums and rescaled by a multiplier
+ * and shift; ANBC compares log-likelihoods in units of 2^-16, with each
+ * class mean and Q15 coefficient quantized to the input's scale; KNN stores
+ * its samples as int16. Inputs beyond twice the training data's range
+ * saturate. `make fixed-point-report` in headless/ compares its accuracy with
+ * GRT's and the float code's on the training data.
+ *
+ * The model is read from the trained modules (GRT's getters, and for the
+ * settings GRT keeps to itself, a subclass of the module that reads them)
+ * into an ExportedPipeline, which is what the code is generated from.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+
+// A pre-processing or feature extraction module.
+struct ExportedStage {
+    enum Type { MOVING_AVERAGE_FILTER, TIME_DOMAIN_FEATURES };
+
+    Type type;
+    uint32_t num_input_dimensions;
+    uint32_t num_output_dimensions;
+    // The filter size of a MovingAverageFilter.
+    uint32_t buffer_length;
+    // TimeDomainFeatures only.
+    uint32_t num_frames;
+    bool offset_input;
+    bool use_mean;
+    bool use_std_dev;
+    bool use_euclidean_norm;
+    bool use_rms;
+};
+
+struct ExportedClassifier {
+    enum Type { ANBC, KNN };
+
+    Type type;
+    uint32_t num_input_dimensions;
+    std::vector<uint32_t> class_labels;
+    // Inputs are scaled to (x - min) / (max - min), or 0 if max == min.
+    bool use_scaling;
+    std::vector<GRT::MinMax> ranges;
+    bool use_null_rejection;
+    std::vector<double> null_rejection_thresholds;
+
+    // ANBC: per class, per dimension, over scaled inputs. A dimension with
+    // weight 0 is ignored.
+    std::vector<std::vector<double>> means;
+    std::vector<std::vector<double>> sigmas;
+    std::vector<std::vector<double>> weights;
+
+    // KNN: the scaled training samples, row-major, and the index of each
+    // one's class in class_labels.
+    uint32_t k;
+    std::vector<double> samples;
+    std::vector<uint32_t> sample_classes;
+};
+
+struct ExportedPipeline {
+    uint32_t num_input_dimensions;
+    std::vector<ExportedStage> stages;
+    ExportedClassifier classifier;
+};
+
+// Reads a trained pipeline. Returns false with a message in `error` if it
+// has modules the exporter does not support.
+bool readExportedPipeline(const GRT::GestureRecognitionPipeline& trained,
+                          ExportedPipeline* pipeline, std::string* error);
+
+// Writes the header described above, with everything in namespace `name`.
+void writePipelineHeader(const ExportedPipeline& pipeline,
+                         const std::string& name, std::ostream& out);
+
+// Both of the above.
+bool exportPipelineHeader(const GRT::GestureRecognitionPipeline& trained,
+                          const std::string& name, std::ostream& out,
+                          std::string* error);
+
+// The scale of each int16 signal of the fixed-point code: the real value of
+// one unit per dimension of the pipeline's input (signals[0]) and of each
+// stage's output.
+struct FixedPointScales {
+    std::vector<std::vector<double>> signals;
+};
+
+// Replays the training data through the pipeline's stages to find the range
+// of each signal. `training_data` is a copy because GRT only indexes samples
+// through a non-const operator[].
+bool calibrateFixedPoint(const ExportedPipeline& pipeline,
+                         GRT::TimeSeriesClassificationData training_data,
+                         FixedPointScales* scales, std::string* error);
+
+// Writes the fixed-point variant of the header, with the same interface.
+void writeFixedPointHeader(const ExportedPipeline& pipeline,
+                           const FixedPointScales& scales,
+                           const std::string& name, std::ostream& out);
+
+// All of the above.
+bool exportFixedPointHeader(
+        const GRT::GestureRecognitionPipeline& trained,
+        const GRT::TimeSeriesClassificationData& training_data,
+        const std::string& name, std::ostream& out, std::string* error);
@@ -0,0 +1,79 @@
+#include "pipeline_file.h"
+
+#include "model_file.h"
+#include "temporary_file.h"
+
+namespace {
+
+bool fail(std::string* error, const std::string& message) {
+    *error = message;
+    return false;
+}
+
+// GRT only saves a pipeline to a file and loads it from one, so the text
+// goes through a temporary file.
+bool getPipelineText(GRT::GestureRecognitionPipeline& pipeline,
+                     std::string* text) {
+    TemporaryFile file("esp-pipeline");
+    return file.isCreated() && pipeline.save(file.getPath()) &&
+           file.read(text);
+}
+
+bool setPipelineText(const std::string& text,
+                     GRT::GestureRecognitionPipeline* pipeline) {
+    TemporaryFile file("esp-pipeline");
+    return file.write(text) && pipeline->load(file.getPath());
+}
+
+}  // namespace
+
+bool savePipelineFile(const GRT::GestureRecognitionPipeline& pipeline,
+                      const std::string& path, std::string* error) {
+    GRT::GestureRecognitionPipeline copy(pipeline);
+    ModelFileWriter writer;
+    GRT::Classifier* classifier = copy.getClassifier();
+    BinaryModel* model = dynamic_cast<BinaryModel*>(classifier);
+    if (model != nullptr && classifier->getTrained()) {
+        if (!model->saveModel(&writer)) {
+            return fail(error, "Failed to save the classifier's model");
+        }
+        // The text then only has the classifier's settings; the pipeline
+        // itself is still flagged as trained.
+        classifier->clear();
+    }
+
+    std::string text;
+    if (!getPipelineText(copy, &text)) {
+        return fail(error, "Failed to save the pipeline");
+    }
+    writer.addBytes("pipeline", text);
+    if (!writer.write(path)) { return fail(error, writer.getLastError()); }
+    return true;
+}
+
+bool loadPipelineFile(const std::string& path,
+                      GRT::GestureRecognitionPipeline* pipeline,
+                      std::string* error) {
+    ModelFileReader reader;
+    if (!reader.open(path)) { return fail(error, reader.getLastError()); }
+
+    std::string text;
+    if (!reader.getBytes("pipeline", &text)) {
+        return fail(error, path + " has no pipeline");
+    }
+    if (!setPipelineText(text, pipeline)) {
+        return fail(error, "Failed to load the pipeline of " + path);
+    }
+
+    // Only there if the classifier's model was saved apart from the text.
+    uint64_t count;
+    if (reader.getBytes("model_type", &count) != nullptr) {
+        BinaryModel* model =
+                dynamic_cast<BinaryModel*>(pipeline->getClassifier());
+        if (model == nullptr || !model->loadModel(reader)) {
+            return fail(error, "Failed to load the classifier's model from " +
+                               path);
+        }
+    }
+    return true;
+}
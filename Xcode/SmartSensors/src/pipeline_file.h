@@ -0,0 +1,35 @@
+/*
+ * Saving a trained pipeline as a model file (model_file.h), which loads much
+ * faster than GRT's text when the model is large.
+ *
+ * GRT saves the whole pipeline as text, and loading a DTW template set or
+ * tens of thousands of KNN samples parses every number through an
+ * istream. Here the settings of every module stay GRT text, stored as the
+ * "pipeline" array of the file, since they are short and only GRT knows how
+ * to read them; but if the classifier is a BinaryModel (PrunedDTW,
+ * KDTreeKNN), its trained model, which is nearly all of the size, is stored
+ * as arrays instead and copied straight out of the mapped file:
+ *
+ * std::string error;
+ * if (!loadPipelineFile("pipeline.espm", &pipeline, &error)) { ... }
+ *
+ * Other classifiers (GRT's, and FastANBC, whose model is a GRT ANBC) stay in
+ * the text, so any pipeline can be saved this way, it just loads no faster.
+ * That includes SVM, whose support vectors can be as large as a KNN's
+ * training set: it has no binary path, since its model is libsvm's, which
+ * GRT only reads and writes as text.
+ * `make model-bench` in headless/ checks the round trip against the text
+ * format and compares load times.
+ */
+#pragma once
+
+#include <string>
+
+#include "GRT/GRT.h"
+
+// Returns false with a message in `error` on failure.
+bool savePipelineFile(const GRT::GestureRecognitionPipeline& pipeline,
+                      const std::string& path, std::string* error);
+bool loadPipelineFile(const std::string& path,
+                      GRT::GestureRecognitionPipeline* pipeline,
+                      std::string* error);
@@ -0,0 +1,93 @@
+#include "pipeline_profiler.h"
+
+using namespace GRT;
+
+namespace {
+
+std::string getStageName(const std::string& stage, uint32_t index,
+                         const std::string& type) {
+    return "predict/" + stage + " " + std::to_string(index) + ": " + type;
+}
+
+}  // namespace
+
+void PipelineProfiler::attach(GestureRecognitionPipeline& pipeline) {
+    Profiler& profiler = getProfiler();
+
+    pre_processing_.clear();
+    for (UINT i = 0; i < pipeline.getNumPreProcessingModules(); i++) {
+        PreProcessing* module = pipeline.getPreProcessingModule(i);
+        pre_processing_.push_back(profiler.getHistogram(getStageName(
+                "1 pre-processing", i, module->getPreProcessingType())));
+    }
+
+    feature_extraction_.clear();
+    for (UINT i = 0; i < pipeline.getNumFeatureExtractionModules(); i++) {
+        FeatureExtraction* module = pipeline.getFeatureExtractionModule(i);
+        feature_extraction_.push_back(profiler.getHistogram(getStageName(
+                "2 feature extraction", i, module->getFeatureExtractionType())));
+    }
+
+    classifier_ = nullptr;
+    if (pipeline.getIsClassifierSet()) {
+        classifier_ = profiler.getHistogram(getStageName(
+                "3 classifier", 0, pipeline.getClassifier()->getClassifierType()));
+    }
+
+    post_processing_.clear();
+    for (UINT i = 0; i < pipeline.getNumPostProcessingModules(); i++) {
+        PostProcessing* module = pipeline.getPostProcessingModule(i);
+        post_processing_.push_back(profiler.getHistogram(getStageName(
+                "4 post-processing", i, module->getPostProcessingType())));
+    }
+}
+
+bool PipelineProfiler::predict(GestureRecognitionPipeline& pipeline,
+                               const VectorDouble& input) {
+    data_ = input;
+
+    for (UINT i = 0; i < pre_processing_.size(); i++) {
+        ScopedSpan span(pre_processing_[i]);
+        PreProcessing* module = pipeline.getPreProcessingModule(i);
+        if (!module->process(data_)) { return false; }
+        data_ = module->getProcessedData();
+    }
+
+    for (UINT i = 0; i < feature_extraction_.size(); i++) {
+        ScopedSpan span(feature_extraction_[i]);
+        FeatureExtraction* module = pipeline.getFeatureExtractionModule(i);
+        if (!module->computeFeatures(data_)) { return false; }
+        data_ = module->getFeatureVector();
+    }
+
+    if (classifier_ == nullptr) { return false; }
+    {
+        ScopedSpan span(classifier_);
+        Classifier* classifier = pipeline.getClassifier();
+        if (!classifier->predict(data_)) { return false; }
+        predicted_class_label_ = classifier->getPredictedClassLabel();
+        class_likelihoods_ = classifier->getClassLikelihoods();
+    }
+
+    for (UINT i = 0; i < post_processing_.size(); i++) {
+        ScopedSpan span(post_processing_[i]);
+        PostProcessing* module = pipeline.getPostProcessingModule(i);
+        if (module->getIsPostProcessingInputModePredictedClassLabel()) {
+            data_.assign(1, predicted_class_label_);
+        } else if (module->getIsPostProcessingInputModeClassLikelihoods()) {
+            data_ = class_likelihoods_;
+        } else {
+            return false;
+        }
+
+        if (!module->process(data_)) { return false; }
+        data_ = module->getProcessedData();
+
+        if (module->getIsPostProcessingOutputModePredictedClassLabel()) {
+            predicted_class_label_ = static_cast<UINT>(data_[0]);
+        } else if (module->getIsPostProcessingOutputModeClassLikelihoods()) {
+            class_likelihoods_ = data_;
+        }
+    }
+    return true;
+}
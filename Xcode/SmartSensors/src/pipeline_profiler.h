@@ -0,0 +1,43 @@
+/*
+ * PipelineProfiler times every module of a GestureRecognitionPipeline.
+ *
+ * GRT's predict() runs all modules in one call, so predict() here runs them
+ * one at a time instead, the same way GestureRecognitionPipeline does for
+ * classification, and records each module's time in its own histogram (e.g.
+ * "predict 2/feature 0: TimeDomainFeatures"). Results are identical to
+ * pipeline.predict(), but the pipeline's own getPredictedClassLabel() and
+ * friends are not updated: use the getters below instead.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "profiler.h"
+
+class PipelineProfiler {
+  public:
+    // Registers histograms for the modules of `pipeline`; must be called again
+    // whenever its structure changes.
+    void attach(GRT::GestureRecognitionPipeline& pipeline);
+
+    // Runs `input` through the attached pipeline. Returns false on failure.
+    bool predict(GRT::GestureRecognitionPipeline& pipeline,
+                 const GRT::VectorDouble& input);
+
+    GRT::UINT getPredictedClassLabel() const { return predicted_class_label_; }
+    const GRT::VectorDouble& getClassLikelihoods() const {
+        return class_likelihoods_;
+    }
+
+  private:
+    std::vector<LatencyHistogram*> pre_processing_;
+    std::vector<LatencyHistogram*> feature_extraction_;
+    LatencyHistogram* classifier_ = nullptr;
+    std::vector<LatencyHistogram*> post_processing_;
+
+    GRT::VectorDouble data_;
+    GRT::UINT predicted_class_label_ = 0;
+    GRT::VectorDouble class_likelihoods_;
+};
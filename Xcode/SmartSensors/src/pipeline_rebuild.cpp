@@ -0,0 +1,94 @@
+#include "pipeline_rebuild.h"
+
+#include <fstream>
+#include <string>
+
+#include "temporary_file.h"
+
+namespace {
+
+// GRT modules only save their settings to an fstream, so this goes through a
+// temporary file. Returns false if the module could not be saved.
+template <class Module>
+bool getSettings(const Module* module, std::string* settings) {
+    if (module == nullptr) { return false; }
+    TemporaryFile temporary("esp-settings");
+    if (!temporary.isCreated()) { return false; }
+    bool ok;
+    {
+        std::fstream file(temporary.getPath().c_str(),
+                          std::ios::out | std::ios::trunc);
+        ok = file && module->saveModelToFile(file);
+    }
+    return ok && temporary.read(settings);
+}
+
+template <class Module>
+bool haveSameSettings(const Module* a, const Module* b) {
+    std::string a_settings, b_settings;
+    return getSettings(a, &a_settings) && getSettings(b, &b_settings) &&
+           a_settings == b_settings;
+}
+
+bool haveSameTrainingSettings(const GRT::GestureRecognitionPipeline& a,
+                              const GRT::GestureRecognitionPipeline& b) {
+    if (a.getNumPreProcessingModules() != b.getNumPreProcessingModules() ||
+        a.getNumFeatureExtractionModules() !=
+                b.getNumFeatureExtractionModules() ||
+        !a.getIsClassifierSet() || !b.getIsClassifierSet()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a.getNumPreProcessingModules(); i++) {
+        if (!haveSameSettings(a.getPreProcessingModule(i),
+                              b.getPreProcessingModule(i))) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < a.getNumFeatureExtractionModules(); i++) {
+        if (!haveSameSettings(a.getFeatureExtractionModule(i),
+                              b.getFeatureExtractionModule(i))) {
+            return false;
+        }
+    }
+
+    // Compared with b's null rejection coefficient, which can be changed on
+    // a trained classifier.
+    GRT::GestureRecognitionPipeline normalized(a);
+    normalized.getClassifier()->setNullRejectionCoeff(
+            b.getClassifier()->getNullRejectionCoeff());
+    return haveSameSettings(normalized.getClassifier(), b.getClassifier());
+}
+
+}  // namespace
+
+std::shared_ptr<GRT::GestureRecognitionPipeline> carryOverTrainedState(
+        const GRT::GestureRecognitionPipeline& trained,
+        const GRT::GestureRecognitionPipeline& trained_settings,
+        const GRT::GestureRecognitionPipeline& rebuilt) {
+    if (!trained.getTrained() ||
+        !haveSameTrainingSettings(rebuilt, trained_settings)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<GRT::GestureRecognitionPipeline> pipeline =
+            std::make_shared<GRT::GestureRecognitionPipeline>(trained);
+    GRT::Classifier* classifier = pipeline->getClassifier();
+    double coeff = rebuilt.getClassifier()->getNullRejectionCoeff();
+    if (coeff != classifier->getNullRejectionCoeff()) {
+        if (!classifier->setNullRejectionCoeff(coeff) ||
+            !classifier->recomputeNullRejectionThresholds()) {
+            return nullptr;
+        }
+    }
+
+    // Post-processing modules hold no trained state; replacing them leaves
+    // the pipeline trained.
+    pipeline->removeAllPostProcessingModules();
+    for (uint32_t i = 0; i < rebuilt.getNumPostProcessingModules(); i++) {
+        if (!pipeline->addPostProcessingModule(
+                    *rebuilt.getPostProcessingModule(i))) {
+            return nullptr;
+        }
+    }
+    return pipeline;
+}
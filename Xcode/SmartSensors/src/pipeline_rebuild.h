@@ -0,0 +1,32 @@
+/*
+ * Moving a trained pipeline over to new settings without retraining.
+ *
+ * A Tuneable change re-runs the user's setup(), which builds an untrained
+ * pipeline with the new values. Some settings only affect what happens after
+ * the classifier has been trained: the classifier's null rejection
+ * coefficient (the thresholds are recomputed from the training distances)
+ * and every post-processing module (e.g. a class label timeout). If nothing
+ * else changed, the trained model can be kept:
+ *
+ * std::shared_ptr<GRT::GestureRecognitionPipeline> pipeline =
+ *         carryOverTrainedState(*trained, *trained_settings, rebuilt);
+ * if (pipeline == nullptr) { ... retrain ... }
+ *
+ * Copying a trained pipeline can take a while (DTW keeps every template), so
+ * the app calls this on a thread of its own.
+ */
+#pragma once
+
+#include <memory>
+
+#include "GRT/GRT.h"
+
+// `trained` is a pipeline trained from the untrained `trained_settings`.
+// Returns a copy of `trained` with the null rejection coefficient and the
+// post-processing modules of `rebuilt`, or null if `rebuilt` differs from
+// `trained_settings` in anything else (pre-processing, feature extraction or
+// other classifier settings), which needs retraining.
+std::shared_ptr<GRT::GestureRecognitionPipeline> carryOverTrainedState(
+        const GRT::GestureRecognitionPipeline& trained,
+        const GRT::GestureRecognitionPipeline& trained_settings,
+        const GRT::GestureRecognitionPipeline& rebuilt);
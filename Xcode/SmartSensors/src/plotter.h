@@ -41,8 +41,14 @@ class Plotter {
     bool setData(const GRT::MatrixDouble& data) {
         x_start_ = 0;
         x_end_ = 0;
-        data_.clear();
-        for (int i = 0; i < data.getNumRows(); i++) push_back(data.getRowVector(i));
+        // Copied whole rather than row by row, which allocates every row.
+        data_ = data;
+        for (uint32_t i = 0; i < data_.getNumRows(); i++) {
+            for (uint32_t j = 0; j < data_.getNumCols(); j++) {
+                if (data_[i][j] > maxY_) { maxY_ = data_[i][j]; }
+                if (data_[i][j] < minY_) { minY_ = data_[i][j]; }
+            }
+        }
         is_content_modified_ = true;
         return true;
     }
@@ -0,0 +1,136 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+uint32_t LatencyHistogram::getBucket(uint64_t value) {
+    if (value < kLinearBuckets) { return value; }
+    // Position of the highest set bit; at least kSubBucketBits + 1 here.
+    uint32_t exponent = 63 - __builtin_clzll(value);
+    uint32_t sub_bucket = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return kLinearBuckets + (exponent - kSubBucketBits - 1) * kSubBuckets +
+            sub_bucket;
+}
+
+int64_t LatencyHistogram::getBucketValue(uint32_t bucket) {
+    if (bucket < kLinearBuckets) { return bucket; }
+    uint32_t exponent = (bucket - kLinearBuckets) / kSubBuckets + kSubBucketBits + 1;
+    uint64_t sub_bucket = (bucket - kLinearBuckets) % kSubBuckets;
+    uint64_t width = 1ULL << (exponent - kSubBucketBits);
+    uint64_t low = (1ULL << exponent) + sub_bucket * width;
+    return low + width / 2;
+}
+
+void LatencyHistogram::record(int64_t duration_ns) {
+    if (duration_ns < 0) { duration_ns = 0; }
+    buckets_[getBucket(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(duration_ns, std::memory_order_relaxed);
+    int64_t max = max_.load(std::memory_order_relaxed);
+    while (duration_ns > max &&
+           !max_.compare_exchange_weak(max, duration_ns,
+                                       std::memory_order_relaxed)) {
+    }
+}
+
+double LatencyHistogram::getMean() const {
+    uint64_t count = getCount();
+    return count == 0 ? 0 :
+            static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+}
+
+int64_t LatencyHistogram::getPercentile(double p) const {
+    uint64_t count = getCount();
+    if (count == 0) { return 0; }
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count + 0.5);
+    if (rank < 1) { rank = 1; }
+    if (rank > count) { rank = count; }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kNumBuckets; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // The bucket midpoint can overshoot the largest value recorded.
+            return std::min(getBucketValue(i), getMax());
+        }
+    }
+    return getMax();
+}
+
+void LatencyHistogram::reset() {
+    for (uint32_t i = 0; i < kNumBuckets; i++) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram* Profiler::getHistogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<LatencyHistogram>& histogram = histograms_[name];
+    if (histogram == nullptr) { histogram.reset(new LatencyHistogram()); }
+    return histogram.get();
+}
+
+std::vector<Profiler::Summary> Profiler::getSummaries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Summary> summaries;
+    for (const auto& entry : histograms_) {
+        const LatencyHistogram& h = *entry.second;
+        if (h.getCount() == 0) { continue; }
+        Summary summary;
+        summary.name = entry.first;
+        summary.count = h.getCount();
+        summary.mean_ns = h.getMean();
+        summary.p50_ns = h.getPercentile(50);
+        summary.p99_ns = h.getPercentile(99);
+        summary.max_ns = h.getMax();
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+void Profiler::dump(std::ostream& out) const {
+    out << std::left << std::setw(48) << "name" << std::right
+        << std::setw(12) << "count" << std::setw(12) << "mean"
+        << std::setw(12) << "p50" << std::setw(12) << "p99"
+        << std::setw(12) << "max" << "\n";
+    for (const Summary& s : getSummaries()) {
+        out << std::left << std::setw(48) << s.name << std::right
+            << std::setw(12) << s.count
+            << std::setw(12) << formatDuration(s.mean_ns)
+            << std::setw(12) << formatDuration(s.p50_ns)
+            << std::setw(12) << formatDuration(s.p99_ns)
+            << std::setw(12) << formatDuration(s.max_ns) << "\n";
+    }
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : histograms_) { entry.second->reset(); }
+}
+
+Profiler& getProfiler() {
+    static Profiler profiler;
+    return profiler;
+}
+
+std::string formatDuration(double ns) {
+    char buffer[32];
+    if (ns < 1000) {
+        snprintf(buffer, sizeof(buffer), "%.0fns", ns);
+    } else if (ns < 1000 * 1000) {
+        snprintf(buffer, sizeof(buffer), "%.1fus", ns / 1000);
+    } else if (ns < 1000 * 1000 * 1000) {
+        snprintf(buffer, sizeof(buffer), "%.2fms", ns / (1000 * 1000));
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2fs", ns / (1000 * 1000 * 1000));
+    }
+    return buffer;
+}
@@ -0,0 +1,914 @@
+#include "pruned_dtw.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "sample_clock.h"
+
+using namespace GRT;
+
+RegisterClassifierModule<PrunedDTW> PrunedDTW::registerModule("PrunedDTW");
+
+namespace {
+
+const double kInfinity = std::numeric_limits<double>::infinity();
+
+// A template is only abandoned once it is this much (relatively) farther
+// than the closest one, so that rounding never abandons an exact tie.
+const double kTieTolerance = 1e-9;
+
+template <class T>
+bool readSetting(fstream& file, const char* name, T* value) {
+    string word;
+    file >> word;
+    return word == name && (file >> *value);
+}
+
+}  // namespace
+
+PrunedDTW::PrunedDTW(bool use_scaling, bool use_null_rejection,
+                     double null_rejection_coeff, double radius)
+        : radius_(radius),
+          use_pruning_(true),
+          window_length_(0),
+          num_window_rows_(0),
+          stats_(),
+          pool_(nullptr),
+          use_spotting_(false),
+          num_samples_(0),
+          last_match_() {
+    useScaling = use_scaling;
+    useNullRejection = use_null_rejection;
+    nullRejectionCoeff = null_rejection_coeff;
+    supportsNullRejection = true;
+    classifierType = "PrunedDTW";
+    classifierMode = TIMESERIES_CLASSIFIER_MODE;
+    debugLog.setProceedingText("[DEBUG PrunedDTW]");
+    errorLog.setProceedingText("[ERROR PrunedDTW]");
+    trainingLog.setProceedingText("[TRAINING PrunedDTW]");
+    warningLog.setProceedingText("[WARNING PrunedDTW]");
+}
+
+PrunedDTW::PrunedDTW(const PrunedDTW& rhs) : PrunedDTW() {
+    *this = rhs;
+}
+
+PrunedDTW& PrunedDTW::operator=(const PrunedDTW& rhs) {
+    if (this != &rhs) {
+        radius_ = rhs.radius_;
+        use_pruning_ = rhs.use_pruning_;
+        window_length_ = rhs.window_length_;
+        templates_ = rhs.templates_;
+        window_ = rhs.window_;
+        num_window_rows_ = rhs.num_window_rows_;
+        scratch_ = rhs.scratch_;
+        outcomes_ = rhs.outcomes_;
+        stats_ = rhs.stats_;
+        pool_ = rhs.pool_;
+        use_spotting_ = rhs.use_spotting_;
+        spotters_ = rhs.spotters_;
+        num_samples_ = rhs.num_samples_;
+        last_match_ = rhs.last_match_;
+        copyBaseVariables(&rhs);
+    }
+    return *this;
+}
+
+bool PrunedDTW::deepCopyFrom(const Classifier* classifier) {
+    if (classifier == nullptr) { return false; }
+    if (classifierType != classifier->getClassifierType()) {
+        errorLog << "deepCopyFrom(const Classifier *classifier) - "
+                 << "Classifier Types Do Not Match!" << endl;
+        return false;
+    }
+    *this = *static_cast<const PrunedDTW*>(classifier);
+    return true;
+}
+
+bool PrunedDTW::train_(TimeSeriesClassificationData& training_data) {
+    clear();
+    if (training_data.getNumSamples() == 0) {
+        errorLog << "train_(TimeSeriesClassificationData &trainingData) - "
+                 << "There is no training data!" << endl;
+        return false;
+    }
+    numInputDimensions = training_data.getNumDimensions();
+    ranges = training_data.getRanges();
+    const uint32_t num_dimensions = numInputDimensions;
+
+    // Scaled copies of every class's samples.
+    vector<ClassTracker> class_tracker = training_data.getClassTracker();
+    vector<vector<vector<double>>> class_samples(class_tracker.size());
+    for (UINT i = 0; i < training_data.getNumSamples(); i++) {
+        const MatrixDouble& data = training_data[i].getData();
+        if (data.getNumRows() == 0) { continue; }
+        for (uint32_t c = 0; c < class_tracker.size(); c++) {
+            if (training_data[i].getClassLabel() != class_tracker[c].classLabel) {
+                continue;
+            }
+            vector<vector<double>>& samples = class_samples[c];
+            samples.push_back(vector<double>(data.getNumRows() * num_dimensions));
+            for (UINT row = 0; row < data.getNumRows(); row++) {
+                scale(data[row], &samples.back()[row * num_dimensions]);
+            }
+        }
+    }
+
+    // Every class's pairwise distances. One loop index per (class, sample),
+    // which fills in that sample's row and column right of the diagonal, so
+    // no two indices write the same entry.
+    vector<vector<double>> class_distances(class_tracker.size());
+    vector<std::pair<uint32_t, uint32_t>> rows;
+    for (uint32_t c = 0; c < class_tracker.size(); c++) {
+        uint32_t n = class_samples[c].size();
+        class_distances[c].assign(n * n, 0);
+        for (uint32_t i = 0; i < n; i++) { rows.push_back(std::make_pair(c, i)); }
+    }
+    auto alignRow = [&](uint32_t r) {
+        const vector<vector<double>>& samples = class_samples[rows[r].first];
+        vector<double>& distances = class_distances[rows[r].first];
+        const uint32_t n = samples.size();
+        const uint32_t i = rows[r].second;
+        uint32_t length_i = samples[i].size() / num_dimensions;
+        Scratch scratch;
+        for (uint32_t j = i + 1; j < n; j++) {
+            uint32_t length_j = samples[j].size() / num_dimensions;
+            double distance =
+                    align(samples[i].data(), length_i, samples[j].data(),
+                          length_j, kInfinity, scratch) / (length_i + length_j);
+            distances[i * n + j] = distance;
+            distances[j * n + i] = distance;
+        }
+    };
+    if (pool_ != nullptr) {
+        pool_->parallelFor(rows.size(), alignRow);
+    } else {
+        for (uint32_t r = 0; r < rows.size(); r++) { alignRow(r); }
+    }
+
+    for (uint32_t c = 0; c < class_tracker.size(); c++) {
+        const vector<vector<double>>& samples = class_samples[c];
+        const vector<double>& distances = class_distances[c];
+        if (samples.empty()) { continue; }
+
+        // The template is the sample with the smallest total distance to the
+        // others of its class.
+        const uint32_t n = samples.size();
+        uint32_t best = 0;
+        double best_sum = kInfinity;
+        for (uint32_t i = 0; i < n; i++) {
+            double sum = 0;
+            for (uint32_t j = 0; j < n; j++) { sum += distances[i * n + j]; }
+            if (sum < best_sum) {
+                best = i;
+                best_sum = sum;
+            }
+        }
+
+        Template t;
+        t.class_label = class_tracker[c].classLabel;
+        t.length = samples[best].size() / num_dimensions;
+        t.data = samples[best];
+        t.training_mu = 0;
+        t.training_sigma = 0;
+        t.envelope_length = 0;
+        if (n == 1) {
+            warningLog << "train_(TimeSeriesClassificationData &trainingData) - "
+                       << "Class " << t.class_label << " has only one sample, "
+                       << "so its null rejection threshold is 0" << endl;
+        } else {
+            t.training_mu = best_sum / (n - 1);
+            double sum_squares = 0;
+            for (uint32_t j = 0; j < n; j++) {
+                if (j == best) { continue; }
+                double d = distances[best * n + j] - t.training_mu;
+                sum_squares += d * d;
+            }
+            t.training_sigma = n > 2 ? std::sqrt(sum_squares / (n - 2)) : 0;
+        }
+        templates_.push_back(t);
+        classLabels.push_back(t.class_label);
+    }
+    numClasses = templates_.size();
+
+    double total_length = 0;
+    for (const Template& t : templates_) { total_length += t.length; }
+    window_length_ = static_cast<uint32_t>(
+            std::max(1.0, std::round(total_length / templates_.size())));
+    for (Template& t : templates_) { computeEnvelope(t, window_length_); }
+
+    trained = true;
+    return init() && recomputeNullRejectionThresholds();
+}
+
+bool PrunedDTW::predict_(VectorDouble& input) {
+    if (!trained) {
+        errorLog << "predict_(VectorDouble &inputVector) - The model has not "
+                 << "been trained!" << endl;
+        return false;
+    }
+    if (input.size() != numInputDimensions) {
+        errorLog << "predict_(VectorDouble &inputVector) - The size of the "
+                 << "input vector (" << input.size() << ") does not match the "
+                 << "number of input dimensions (" << numInputDimensions << ")"
+                 << endl;
+        return false;
+    }
+
+    const uint32_t num_dimensions = numInputDimensions;
+    if (use_spotting_) {
+        scaled_.resize(num_dimensions);
+        scale(&input[0], scaled_.data());
+        return spot(scaled_.data());
+    }
+    if (num_window_rows_ == window_length_) {
+        std::copy(window_.begin() + num_dimensions, window_.end(),
+                  window_.begin());
+        num_window_rows_--;
+    }
+    scale(&input[0], &window_[num_window_rows_ * num_dimensions]);
+    num_window_rows_++;
+
+    if (num_window_rows_ < window_length_) {
+        predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+        maxLikelihood = 0;
+        std::fill(classLikelihoods.begin(), classLikelihoods.end(), 0);
+        std::fill(classDistances.begin(), classDistances.end(), 0);
+        return true;
+    }
+    return classify(window_.data(), window_length_);
+}
+
+bool PrunedDTW::predict_(MatrixDouble& input) {
+    if (!trained) {
+        errorLog << "predict_(MatrixDouble &inputMatrix) - The model has not "
+                 << "been trained!" << endl;
+        return false;
+    }
+    if (input.getNumCols() != numInputDimensions || input.getNumRows() == 0) {
+        errorLog << "predict_(MatrixDouble &inputMatrix) - The input has "
+                 << input.getNumCols() << " dimensions and " << input.getNumRows()
+                 << " rows" << endl;
+        return false;
+    }
+
+    const uint32_t num_dimensions = numInputDimensions;
+    scaled_.resize(input.getNumRows() * num_dimensions);
+    for (UINT row = 0; row < input.getNumRows(); row++) {
+        scale(input[row], &scaled_[row * num_dimensions]);
+    }
+    return classify(scaled_.data(), input.getNumRows());
+}
+
+bool PrunedDTW::reset() {
+    num_window_rows_ = 0;
+    resetSpotters();
+    return Classifier::reset();
+}
+
+bool PrunedDTW::clear() {
+    Classifier::clear();
+    templates_.clear();
+    window_length_ = 0;
+    window_.clear();
+    num_window_rows_ = 0;
+    stats_ = PruningStats();
+    spotters_.clear();
+    num_samples_ = 0;
+    last_match_ = Match();
+    return true;
+}
+
+bool PrunedDTW::recomputeNullRejectionThresholds() {
+    if (!trained) { return false; }
+    nullRejectionThresholds.resize(templates_.size());
+    for (uint32_t k = 0; k < templates_.size(); k++) {
+        nullRejectionThresholds[k] = templates_[k].training_mu +
+                templates_[k].training_sigma * nullRejectionCoeff;
+    }
+    return true;
+}
+
+bool PrunedDTW::setNullRejectionCoeff(double null_rejection_coeff) {
+    if (null_rejection_coeff <= 0) { return false; }
+    nullRejectionCoeff = null_rejection_coeff;
+    if (trained) { recomputeNullRejectionThresholds(); }
+    return true;
+}
+
+bool PrunedDTW::setRadius(double radius) {
+    if (radius <= 0) { return false; }
+    // The templates were picked with the old band.
+    clear();
+    radius_ = radius;
+    return true;
+}
+
+void PrunedDTW::setUseSpotting(bool use_spotting) {
+    use_spotting_ = use_spotting;
+    if (trained) { init(); }
+}
+
+bool PrunedDTW::saveModelToFile(fstream& file) const {
+    if (!file.is_open()) {
+        errorLog << "saveModelToFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    std::streamsize precision = file.precision(17);
+    file << "GRT_PRUNED_DTW_MODEL_FILE_V1.0" << endl;
+    file << "UseScaling: " << useScaling << endl;
+    file << "UseNullRejection: " << useNullRejection << endl;
+    file << "NullRejectionCoeff: " << nullRejectionCoeff << endl;
+    file << "Radius: " << radius_ << endl;
+    file << "UsePruning: " << use_pruning_ << endl;
+    file << "UseSpotting: " << use_spotting_ << endl;
+    file << "NumInputDimensions: " << numInputDimensions << endl;
+    file << "Trained: " << trained << endl;
+    if (trained) {
+        file << "WindowLength: " << window_length_ << endl;
+        file << "Ranges:";
+        for (const MinMax& range : ranges) {
+            file << " " << range.minValue << " " << range.maxValue;
+        }
+        file << endl;
+        file << "NumTemplates: " << templates_.size() << endl;
+        for (const Template& t : templates_) {
+            file << "Template: " << t.class_label << " " << t.length << " "
+                 << t.training_mu << " " << t.training_sigma << endl;
+            for (uint32_t row = 0; row < t.length; row++) {
+                for (uint32_t d = 0; d < numInputDimensions; d++) {
+                    file << t.data[row * numInputDimensions + d]
+                         << (d + 1 < numInputDimensions ? " " : "\n");
+                }
+            }
+        }
+    }
+    file.precision(precision);
+    return true;
+}
+
+bool PrunedDTW::loadModelFromFile(fstream& file) {
+    if (!file.is_open()) {
+        errorLog << "loadModelFromFile(fstream &file) - The file is not open!"
+                 << endl;
+        return false;
+    }
+    clear();
+
+    string word;
+    file >> word;
+    if (word != "GRT_PRUNED_DTW_MODEL_FILE_V1.0") {
+        errorLog << "loadModelFromFile(fstream &file) - Invalid file format!"
+                 << endl;
+        return false;
+    }
+    bool is_trained = false;
+    if (!readSetting(file, "UseScaling:", &useScaling) ||
+        !readSetting(file, "UseNullRejection:", &useNullRejection) ||
+        !readSetting(file, "NullRejectionCoeff:", &nullRejectionCoeff) ||
+        !readSetting(file, "Radius:", &radius_) ||
+        !readSetting(file, "UsePruning:", &use_pruning_) ||
+        !readSetting(file, "UseSpotting:", &use_spotting_) ||
+        !readSetting(file, "NumInputDimensions:", &numInputDimensions) ||
+        !readSetting(file, "Trained:", &is_trained)) {
+        errorLog << "loadModelFromFile(fstream &file) - Failed to read the "
+                 << "settings" << endl;
+        return false;
+    }
+    if (!is_trained) { return true; }
+
+    uint32_t num_templates = 0;
+    ranges.resize(numInputDimensions);
+    bool ok = readSetting(file, "WindowLength:", &window_length_) &&
+              (file >> word) && word == "Ranges:";
+    for (uint32_t d = 0; ok && d < numInputDimensions; d++) {
+        ok = static_cast<bool>(file >> ranges[d].minValue >> ranges[d].maxValue);
+    }
+    ok = ok && readSetting(file, "NumTemplates:", &num_templates);
+    for (uint32_t k = 0; ok && k < num_templates; k++) {
+        Template t;
+        ok = (file >> word) && word == "Template:" &&
+             (file >> t.class_label >> t.length >> t.training_mu >>
+              t.training_sigma);
+        t.data.resize(t.length * numInputDimensions);
+        for (uint32_t i = 0; ok && i < t.data.size(); i++) {
+            ok = static_cast<bool>(file >> t.data[i]);
+        }
+        t.envelope_length = 0;
+        templates_.push_back(t);
+        classLabels.push_back(t.class_label);
+    }
+    if (!ok || window_length_ == 0 || templates_.empty()) {
+        errorLog << "loadModelFromFile(fstream &file) - Failed to read the "
+                 << "model" << endl;
+        clear();
+        return false;
+    }
+
+    numClasses = templates_.size();
+    for (Template& t : templates_) { computeEnvelope(t, window_length_); }
+    trained = true;
+    return init() && recomputeNullRejectionThresholds();
+}
+
+bool PrunedDTW::saveModel(ModelFileWriter* writer) const {
+    if (!trained) { return false; }
+    const uint32_t shape[] = { numInputDimensions,
+                               static_cast<uint32_t>(templates_.size()),
+                               window_length_ };
+    vector<double> ranges_array;
+    for (const MinMax& range : ranges) {
+        ranges_array.push_back(range.minValue);
+        ranges_array.push_back(range.maxValue);
+    }
+    // Per template: class label and length; mu and sigma. The rows of all
+    // templates, and of all envelopes, are concatenated.
+    vector<uint32_t> headers;
+    vector<double> statistics, data, lower, upper;
+    for (const Template& t : templates_) {
+        headers.push_back(t.class_label);
+        headers.push_back(t.length);
+        statistics.push_back(t.training_mu);
+        statistics.push_back(t.training_sigma);
+        data.insert(data.end(), t.data.begin(), t.data.end());
+        lower.insert(lower.end(), t.lower.begin(), t.lower.end());
+        upper.insert(upper.end(), t.upper.begin(), t.upper.end());
+    }
+    writer->addBytes("model_type", classifierType);
+    writer->addWords("shape", shape, 3);
+    writer->addDoubles("ranges", ranges_array);
+    writer->addWords("templates", headers);
+    writer->addDoubles("template_statistics", statistics);
+    writer->addDoubles("template_data", data);
+    writer->addDoubles("envelope_lower", lower);
+    writer->addDoubles("envelope_upper", upper);
+    return true;
+}
+
+bool PrunedDTW::loadModel(const ModelFileReader& reader) {
+    clear();
+
+    string type;
+    vector<uint32_t> shape;
+    if (!reader.getBytes("model_type", &type) || type != classifierType ||
+        !reader.getWords("shape", &shape, 3)) {
+        errorLog << "loadModel(const ModelFileReader &reader) - Not a "
+                 << classifierType << " model" << endl;
+        return false;
+    }
+    const uint32_t num_dimensions = shape[0];
+    const uint32_t num_templates = shape[1];
+    const uint32_t window_length = shape[2];
+    const uint64_t envelope_size = uint64_t(window_length) * num_dimensions;
+
+    vector<double> ranges_array;
+    vector<uint32_t> headers;
+    vector<double> statistics;
+    uint64_t num_data, num_lower, num_upper;
+    const double* data = reader.getDoubles("template_data", &num_data);
+    const double* lower = reader.getDoubles("envelope_lower", &num_lower);
+    const double* upper = reader.getDoubles("envelope_upper", &num_upper);
+    bool ok = num_dimensions > 0 && num_templates > 0 && window_length > 0 &&
+              reader.getDoubles("ranges", &ranges_array, 2 * num_dimensions) &&
+              reader.getWords("templates", &headers, 2 * num_templates) &&
+              reader.getDoubles("template_statistics", &statistics,
+                                2 * num_templates) &&
+              data != nullptr && lower != nullptr && upper != nullptr &&
+              num_lower == num_templates * envelope_size &&
+              num_upper == num_lower;
+    uint64_t offset = 0;
+    for (uint32_t k = 0; ok && k < num_templates; k++) {
+        Template t;
+        t.class_label = headers[2 * k];
+        t.length = headers[2 * k + 1];
+        t.training_mu = statistics[2 * k];
+        t.training_sigma = statistics[2 * k + 1];
+        uint64_t size = uint64_t(t.length) * num_dimensions;
+        ok = t.length > 0 && size <= num_data - offset;
+        if (!ok) { break; }
+        t.data.assign(data + offset, data + offset + size);
+        offset += size;
+        t.envelope_length = window_length;
+        t.lower.assign(lower + k * envelope_size,
+                       lower + (k + 1) * envelope_size);
+        t.upper.assign(upper + k * envelope_size,
+                       upper + (k + 1) * envelope_size);
+        templates_.push_back(t);
+        classLabels.push_back(t.class_label);
+    }
+    if (!ok || offset != num_data) {
+        errorLog << "loadModel(const ModelFileReader &reader) - Invalid "
+                 << "model" << endl;
+        clear();
+        return false;
+    }
+
+    numInputDimensions = num_dimensions;
+    numClasses = num_templates;
+    window_length_ = window_length;
+    ranges.resize(num_dimensions);
+    for (uint32_t d = 0; d < num_dimensions; d++) {
+        ranges[d].minValue = ranges_array[2 * d];
+        ranges[d].maxValue = ranges_array[2 * d + 1];
+    }
+    trained = true;
+    return init() && recomputeNullRejectionThresholds();
+}
+
+bool PrunedDTW::init() {
+    window_.assign(window_length_ * numInputDimensions, 0);
+    num_window_rows_ = 0;
+    predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    maxLikelihood = 0;
+    bestDistance = 0;
+    classLikelihoods.assign(numClasses, 0);
+    classDistances.assign(numClasses, 0);
+    scratch_.resize(templates_.size());
+    outcomes_.resize(templates_.size());
+    spotters_.resize(templates_.size());
+    for (uint32_t k = 0; k < templates_.size(); k++) {
+        Spotter& spotter = spotters_[k];
+        spotter.costs.resize(templates_[k].length);
+        spotter.starts.resize(templates_[k].length);
+        spotter.start_times_ns.resize(templates_[k].length);
+    }
+    resetSpotters();
+    return true;
+}
+
+void PrunedDTW::resetSpotters() {
+    for (Spotter& spotter : spotters_) {
+        std::fill(spotter.costs.begin(), spotter.costs.end(), kInfinity);
+        spotter.candidate_cost = kInfinity;
+        spotter.candidate = Match();
+        spotter.is_reported = false;
+    }
+    num_samples_ = 0;
+    last_match_ = Match();
+}
+
+void PrunedDTW::scale(const double* input, double* output) const {
+    for (uint32_t d = 0; d < numInputDimensions; d++) {
+        if (!useScaling) {
+            output[d] = input[d];
+            continue;
+        }
+        double range = ranges[d].maxValue - ranges[d].minValue;
+        output[d] = range > 0 ? (input[d] - ranges[d].minValue) / range : 0;
+    }
+}
+
+void PrunedDTW::getBand(uint32_t i, uint32_t m, uint32_t n, uint32_t* lo,
+                        uint32_t* hi) const {
+    double slope = m > 1 ? static_cast<double>(n - 1) / (m - 1) : n;
+    double center = m > 1 ? i * slope : 0;
+    // At least as wide as the slope, so that consecutive rows' bands touch
+    // and a warping path always exists.
+    double radius = std::max(1.0, std::max(slope, radius_ * std::max(m, n)));
+    *lo = static_cast<uint32_t>(std::max(0.0, std::ceil(center - radius)));
+    *hi = static_cast<uint32_t>(
+            std::min(n - 1.0, std::floor(center + radius)));
+}
+
+void PrunedDTW::computeEnvelope(Template& t, uint32_t m) const {
+    const uint32_t num_dimensions = numInputDimensions;
+    t.envelope_length = m;
+    t.lower.assign(m * num_dimensions, kInfinity);
+    t.upper.assign(m * num_dimensions, -kInfinity);
+    for (uint32_t i = 0; i < m; i++) {
+        uint32_t lo, hi;
+        getBand(i, m, t.length, &lo, &hi);
+        double* lower = &t.lower[i * num_dimensions];
+        double* upper = &t.upper[i * num_dimensions];
+        for (uint32_t j = lo; j <= hi; j++) {
+            const double* row = &t.data[j * num_dimensions];
+            for (uint32_t d = 0; d < num_dimensions; d++) {
+                lower[d] = std::min(lower[d], row[d]);
+                upper[d] = std::max(upper[d], row[d]);
+            }
+        }
+    }
+}
+
+double PrunedDTW::getCellDistance(const double* a, const double* b) const {
+    double sum = 0;
+    for (uint32_t d = 0; d < numInputDimensions; d++) {
+        double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return std::sqrt(sum);
+}
+
+double PrunedDTW::getKeoghBound(const double* input, uint32_t m,
+                                const Template& t, double abandon_at,
+                                Scratch& scratch) const {
+    const uint32_t num_dimensions = numInputDimensions;
+    vector<double>& row_bounds = scratch.row_bounds;
+    row_bounds.resize(m + 1);
+    double total = 0;
+    for (uint32_t i = 0; i < m; i++) {
+        const double* x = input + i * num_dimensions;
+        const double* lower = &t.lower[i * num_dimensions];
+        const double* upper = &t.upper[i * num_dimensions];
+        double sum = 0;
+        for (uint32_t d = 0; d < num_dimensions; d++) {
+            double diff = x[d] > upper[d] ? x[d] - upper[d]
+                        : x[d] < lower[d] ? lower[d] - x[d] : 0;
+            sum += diff * diff;
+        }
+        row_bounds[i] = std::sqrt(sum);
+        total += row_bounds[i];
+        if (total > abandon_at) { return total; }
+    }
+    // Suffix sums: row_bounds[i] bounds the cost of rows i..m-1.
+    row_bounds[m] = 0;
+    for (uint32_t i = m; i-- > 0;) { row_bounds[i] += row_bounds[i + 1]; }
+    return total;
+}
+
+double PrunedDTW::align(const double* a, uint32_t m, const double* b,
+                        uint32_t n, double abandon_at, Scratch& scratch) const {
+    const uint32_t num_dimensions = numInputDimensions;
+    // Two rows of the cost matrix, infinite outside the band.
+    vector<double>& previous_row = scratch.previous_row;
+    vector<double>& current_row = scratch.current_row;
+    previous_row.assign(n, kInfinity);
+    current_row.assign(n, kInfinity);
+    uint32_t previous_lo = 1, previous_hi = 0;
+    uint32_t stale_lo = 1, stale_hi = 0;
+    for (uint32_t i = 0; i < m; i++) {
+        // current_row still holds row i - 2.
+        for (uint32_t j = stale_lo; j <= stale_hi; j++) {
+            current_row[j] = kInfinity;
+        }
+        uint32_t lo, hi;
+        getBand(i, m, n, &lo, &hi);
+        const double* x = a + i * num_dimensions;
+        double row_min = kInfinity;
+        for (uint32_t j = lo; j <= hi; j++) {
+            double best;
+            if (i == 0 && j == 0) {
+                best = 0;
+            } else {
+                best = previous_row[j];
+                if (j > 0) {
+                    best = std::min(best, std::min(previous_row[j - 1],
+                                                   current_row[j - 1]));
+                }
+            }
+            current_row[j] = getCellDistance(x, b + j * num_dimensions) + best;
+            row_min = std::min(row_min, current_row[j]);
+        }
+        if (abandon_at < kInfinity &&
+            row_min + scratch.row_bounds[i + 1] > abandon_at) {
+            return kInfinity;
+        }
+        previous_row.swap(current_row);
+        stale_lo = previous_lo;
+        stale_hi = previous_hi;
+        previous_lo = lo;
+        previous_hi = hi;
+    }
+    return previous_row[n - 1];
+}
+
+bool PrunedDTW::classify(const double* input, uint32_t m) {
+    const uint32_t num_dimensions = numInputDimensions;
+    const uint32_t num_templates = templates_.size();
+
+    // LB_Kim: every path starts at the first and ends at the last cell.
+    kim_bounds_.resize(num_templates);
+    order_.resize(num_templates);
+    for (uint32_t k = 0; k < num_templates; k++) {
+        const Template& t = templates_[k];
+        double bound = getCellDistance(input, &t.data[0]);
+        if (m > 1 || t.length > 1) {
+            bound += getCellDistance(input + (m - 1) * num_dimensions,
+                                     &t.data[(t.length - 1) * num_dimensions]);
+        }
+        kim_bounds_[k] = bound / (m + t.length);
+        order_[k] = k;
+    }
+    if (use_pruning_) {
+        std::stable_sort(order_.begin(), order_.end(),
+                         [this](uint32_t a, uint32_t b) {
+            return kim_bounds_[a] < kim_bounds_[b];
+        });
+    }
+
+    // Shared by all templates; only ever decreases, so a template abandoned
+    // against it is never the closest one, whichever order they run in.
+    std::atomic<double> best_distance(kInfinity);
+    auto score = [&](uint32_t i) {
+        scoreTemplate(order_[i], input, m, best_distance);
+    };
+    if (pool_ != nullptr && num_templates > 1) {
+        pool_->parallelFor(num_templates, score);
+    } else {
+        for (uint32_t i = 0; i < num_templates; i++) { score(i); }
+    }
+
+    // Ties go to the first template, as without pruning.
+    uint32_t best = num_templates;
+    for (uint32_t k = 0; k < num_templates; k++) {
+        switch (outcomes_[k]) {
+            case KIM_PRUNED: stats_.num_kim_pruned++; break;
+            case KEOGH_PRUNED: stats_.num_keogh_pruned++; break;
+            case ABANDONED: stats_.num_abandoned++; break;
+            case ALIGNED:
+                stats_.num_aligned++;
+                if (best == num_templates ||
+                    classDistances[k] < classDistances[best]) {
+                    best = k;
+                }
+                break;
+        }
+    }
+    if (best == num_templates) { return false; }
+
+    double sum = 0;
+    for (double likelihood : classLikelihoods) { sum += likelihood; }
+    for (double& likelihood : classLikelihoods) { likelihood /= sum; }
+    maxLikelihood = classLikelihoods[best];
+    bestDistance = classDistances[best];
+    predictedClassLabel = templates_[best].class_label;
+    if (useNullRejection && bestDistance > nullRejectionThresholds[best]) {
+        predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    }
+    return true;
+}
+
+void PrunedDTW::scoreTemplate(uint32_t k, const double* input, uint32_t m,
+                              std::atomic<double>& best_distance) {
+    Template& t = templates_[k];
+    Scratch& scratch = scratch_[k];
+    const double normalizer = m + t.length;
+    double distance;
+    Outcome outcome = ALIGNED;
+    if (!use_pruning_) {
+        distance = align(input, m, t.data.data(), t.length, kInfinity,
+                         scratch) / normalizer;
+    } else {
+        double abandon_at =
+                best_distance.load() * (1 + kTieTolerance) * normalizer;
+        if (kim_bounds_[k] * normalizer > abandon_at) {
+            distance = kim_bounds_[k];
+            outcome = KIM_PRUNED;
+        } else {
+            if (t.envelope_length != m) { computeEnvelope(t, m); }
+            double keogh = getKeoghBound(input, m, t, abandon_at, scratch);
+            // Another template may have lowered the bar meanwhile.
+            abandon_at = std::min(
+                    abandon_at,
+                    best_distance.load() * (1 + kTieTolerance) * normalizer);
+            if (keogh > abandon_at) {
+                distance = keogh / normalizer;
+                outcome = KEOGH_PRUNED;
+            } else {
+                double cost = align(input, m, t.data.data(), t.length,
+                                    abandon_at, scratch);
+                if (cost == kInfinity) {
+                    distance = keogh / normalizer;
+                    outcome = ABANDONED;
+                } else {
+                    distance = cost / normalizer;
+                }
+            }
+        }
+    }
+    if (outcome == ALIGNED) {
+        double current = best_distance.load();
+        while (distance < current &&
+               !best_distance.compare_exchange_weak(current, distance)) {
+        }
+    }
+
+    // A pruned template's distance is only a lower bound.
+    classDistances[k] = distance;
+    classLikelihoods[k] =
+            outcome == ALIGNED ? 1 / std::max(distance, 1e-12) : 0;
+    outcomes_[k] = outcome;
+}
+
+bool PrunedDTW::spot(const double* input) {
+    const uint64_t t = num_samples_++;
+    const int64_t time_ns = getSampleTimeNs();
+    auto step = [&](uint32_t k) { spotTemplate(k, input, t, time_ns); };
+    if (pool_ != nullptr && templates_.size() > 1) {
+        pool_->parallelFor(templates_.size(), step);
+    } else {
+        for (uint32_t k = 0; k < templates_.size(); k++) { step(k); }
+    }
+
+    predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+    maxLikelihood = 0;
+    bestDistance = 0;
+    uint32_t best = templates_.size();
+    for (uint32_t k = 0; k < templates_.size(); k++) {
+        const Spotter& spotter = spotters_[k];
+        classLikelihoods[k] = spotter.is_reported
+                ? 1 / std::max(spotter.reported.distance, 1e-12) : 0;
+        if (spotter.is_reported &&
+            (best == templates_.size() ||
+             spotter.reported.distance < spotters_[best].reported.distance)) {
+            best = k;
+        }
+    }
+    if (best < templates_.size()) {
+        last_match_ = spotters_[best].reported;
+        predictedClassLabel = last_match_.class_label;
+        bestDistance = last_match_.distance;
+        double sum = 0;
+        for (double likelihood : classLikelihoods) { sum += likelihood; }
+        for (double& likelihood : classLikelihoods) { likelihood /= sum; }
+        maxLikelihood = classLikelihoods[best];
+    }
+    return true;
+}
+
+void PrunedDTW::spotTemplate(uint32_t k, const double* input, uint64_t t,
+                             int64_t time_ns) {
+    const uint32_t num_dimensions = numInputDimensions;
+    const Template& t_k = templates_[k];
+    Spotter& spotter = spotters_[k];
+    const uint32_t n = t_k.length;
+    double* costs = spotter.costs.data();
+    uint64_t* starts = spotter.starts.data();
+    int64_t* start_times_ns = spotter.start_times_ns.data();
+
+    // Column t of the SPRING matrix, in place over column t - 1. A path may
+    // start at any sample, so row "-1" costs 0 and starts now.
+    double diagonal = 0, left = 0;
+    uint64_t diagonal_start = t, left_start = t;
+    int64_t diagonal_time_ns = time_ns, left_time_ns = time_ns;
+    for (uint32_t j = 0; j < n; j++) {
+        double up = costs[j];
+        uint64_t up_start = starts[j];
+        int64_t up_time_ns = start_times_ns[j];
+
+        double best_cost = diagonal;
+        uint64_t best_start = diagonal_start;
+        int64_t best_time_ns = diagonal_time_ns;
+        if (left < best_cost) {
+            best_cost = left;
+            best_start = left_start;
+            best_time_ns = left_time_ns;
+        }
+        if (up < best_cost) {
+            best_cost = up;
+            best_start = up_start;
+            best_time_ns = up_time_ns;
+        }
+        costs[j] = getCellDistance(input, &t_k.data[j * num_dimensions]) +
+                   best_cost;
+        starts[j] = best_start;
+        start_times_ns[j] = best_time_ns;
+
+        // Row j - 1 of the next column is this row of the previous one.
+        diagonal = up;
+        diagonal_start = up_start;
+        diagonal_time_ns = up_time_ns;
+        left = costs[j];
+        left_start = starts[j];
+        left_time_ns = start_times_ns[j];
+    }
+
+    // Matching costs grow with the match, so the candidate is final once no
+    // path that overlaps it is cheaper.
+    spotter.is_reported = false;
+    const double threshold = nullRejectionThresholds[k] * 2 * n;
+    if (spotter.candidate_cost <= threshold) {
+        bool is_final = true;
+        for (uint32_t j = 0; j < n && is_final; j++) {
+            is_final = costs[j] >= spotter.candidate_cost ||
+                       starts[j] > spotter.candidate.end_sample;
+        }
+        if (is_final) {
+            spotter.is_reported = true;
+            spotter.reported = spotter.candidate;
+            // Paths overlapping the match are never reported.
+            for (uint32_t j = 0; j < n; j++) {
+                if (starts[j] <= spotter.candidate.end_sample) {
+                    costs[j] = kInfinity;
+                }
+            }
+            spotter.candidate_cost = kInfinity;
+        }
+    }
+    if (costs[n - 1] <= threshold && costs[n - 1] < spotter.candidate_cost) {
+        spotter.candidate_cost = costs[n - 1];
+        Match& candidate = spotter.candidate;
+        candidate.class_label = t_k.class_label;
+        candidate.start_sample = starts[n - 1];
+        candidate.end_sample = t;
+        candidate.start_time_ns = start_times_ns[n - 1];
+        candidate.end_time_ns = time_ns;
+        candidate.distance = costs[n - 1] / (n + t - starts[n - 1] + 1);
+    }
+    // The cost of the best match ending at this sample.
+    classDistances[k] = costs[n - 1] / (2.0 * n);
+}
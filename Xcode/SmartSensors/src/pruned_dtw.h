@@ -0,0 +1,225 @@
+/*
+ * PrunedDTW is a nearest-template DTW classifier, like GRT's DTW, that skips
+ * most of the alignment work when classifying a stream. GRT's DTW aligns the
+ * last window of input against every template in full on every sample;
+ * PrunedDTW runs a cascade of cheaper tests first and stops as soon as a
+ * template provably cannot be the closest one:
+ *
+ * 1. LB_Kim: the first and the last cells of every warping path.
+ * 2. LB_Keogh: the distance of every input row to the envelope of the
+ *    template rows it may be aligned with, precomputed at training time.
+ * 3. DTW restricted to a Sakoe-Chiba band, abandoned as soon as the cost so
+ *    far plus the LB_Keogh bound of the remaining rows exceeds the distance
+ *    of the closest template found so far.
+ *
+ * Templates are tried in order of their LB_Kim bound, so that a close one is
+ * usually found first. The predicted label is the same as without pruning
+ * (setUsePruning(false)); only the distances and likelihoods reported for
+ * pruned templates differ (see getClassDistances()).
+ *
+ * It is a drop-in replacement for DTW in a user's setup():
+ *
+ * pipeline.setClassifier(PrunedDTW(false, true, threshold));
+ *
+ * Training picks one template per class (the training sample closest to the
+ * others of its class) and a null rejection threshold of
+ * mu + null_rejection_coeff * sigma of the class's distances to it. The
+ * stream is classified over a window as long as the average template.
+ *
+ * In spotting mode (setUseSpotting(true)), the stream is not windowed at all:
+ * every template runs the SPRING subsequence-DTW recurrence (Sakurai et al.,
+ * 2007), which finds the best-matching stretch of the stream ending at each
+ * sample in O(template length) work per sample. A match is reported on the
+ * sample where it becomes certain that no later sample can improve it, i.e.
+ * as soon as the gesture is over rather than once a window has slid past it,
+ * and only once: overlapping stretches are not reported again, so no
+ * timeout filter is needed. A template matches when its DTW cost is below its
+ * null rejection threshold times twice its length (spotting always rejects,
+ * whatever getUseNullRejection() says). On every other sample the predicted
+ * label is 0; getLastMatch() has the extent of the last match.
+ *
+ * Given a ThreadPool (setThreadPool()), training aligns the pairs of
+ * training samples in parallel, and prediction scores the templates in
+ * parallel. The templates, thresholds and predicted labels are the same as
+ * on one thread; with pruning, which templates get pruned (and so their
+ * reported distances) depends on the order they happen to finish in.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "model_file.h"
+#include "thread_pool.h"
+
+class PrunedDTW : public GRT::Classifier, public BinaryModel {
+  public:
+    // `radius` is the half-width of the Sakoe-Chiba band, as a fraction of
+    // the longer of the two series.
+    PrunedDTW(bool use_scaling = false, bool use_null_rejection = false,
+              double null_rejection_coeff = 3.0, double radius = 0.2);
+    PrunedDTW(const PrunedDTW& rhs);
+    virtual ~PrunedDTW() {}
+
+    PrunedDTW& operator=(const PrunedDTW& rhs);
+
+    virtual bool deepCopyFrom(const GRT::Classifier* classifier);
+    virtual bool train_(GRT::TimeSeriesClassificationData& training_data);
+    // Appends a sample to the window and classifies the window, or in
+    // spotting mode, reports the match that ends a gesture.
+    virtual bool predict_(GRT::VectorDouble& input);
+    // Classifies a whole time series.
+    virtual bool predict_(GRT::MatrixDouble& input);
+    // Empties the window, or forgets the spotting state.
+    virtual bool reset();
+    virtual bool clear();
+    virtual bool recomputeNullRejectionThresholds();
+    virtual bool setNullRejectionCoeff(double null_rejection_coeff);
+    virtual bool saveModelToFile(std::fstream& file) const;
+    virtual bool loadModelFromFile(std::fstream& file);
+    // The envelopes are saved too, so loading does not recompute them.
+    virtual bool saveModel(ModelFileWriter* writer) const;
+    virtual bool loadModel(const ModelFileReader& reader);
+
+    using GRT::MLBase::saveModelToFile;
+    using GRT::MLBase::loadModelFromFile;
+
+    bool setRadius(double radius);
+    // Only for comparison: without pruning, every template is aligned in
+    // full.
+    void setUsePruning(bool use_pruning) { use_pruning_ = use_pruning; }
+    void setUseSpotting(bool use_spotting);
+    // Splits training and prediction over `pool`, which may be shared and
+    // must outlive the classifier and its copies; nullptr (the default) runs
+    // everything on the calling thread. Handing a few short templates to the
+    // pool can cost more than it saves: dtw-bench --threads measures it.
+    void setThreadPool(ThreadPool* pool) { pool_ = pool; }
+    ThreadPool* getThreadPool() const { return pool_; }
+    double getRadius() const { return radius_; }
+    bool getUsePruning() const { return use_pruning_; }
+    bool getUseSpotting() const { return use_spotting_; }
+    uint32_t getWindowLength() const { return window_length_; }
+
+    // A stretch of the stream spotted as a gesture. Samples are counted from
+    // the last reset(); times are sample times (see sample_clock.h).
+    struct Match {
+        GRT::UINT class_label;
+        uint64_t start_sample;
+        uint64_t end_sample;
+        int64_t start_time_ns;
+        int64_t end_time_ns;
+        // Normalized like the distances of windowed classification.
+        double distance;
+    };
+    // The last match spotted since reset(); its class_label is 0 if none.
+    const Match& getLastMatch() const { return last_match_; }
+
+    // Since the last clear(), how the templates considered were settled.
+    struct PruningStats {
+        uint64_t num_kim_pruned;
+        uint64_t num_keogh_pruned;
+        uint64_t num_abandoned;
+        uint64_t num_aligned;
+    };
+    const PruningStats& getPruningStats() const { return stats_; }
+
+  private:
+    struct Template {
+        GRT::UINT class_label;
+        uint32_t length;
+        // length x numInputDimensions, row-major, scaled.
+        std::vector<double> data;
+        double training_mu;
+        double training_sigma;
+        // Per input row, the bounds of the template rows in its band; for an
+        // input of envelope_length rows.
+        uint32_t envelope_length;
+        std::vector<double> lower;
+        std::vector<double> upper;
+    };
+
+    // Per-template scratch space, so that templates can be aligned in
+    // parallel.
+    struct Scratch {
+        std::vector<double> row_bounds;
+        std::vector<double> previous_row;
+        std::vector<double> current_row;
+    };
+
+    // How scoring a template ended.
+    enum Outcome { ALIGNED, KIM_PRUNED, KEOGH_PRUNED, ABANDONED };
+
+    // The SPRING state of one template: for every template row, the cost
+    // of the best warping path ending at that row and the current sample,
+    // and the sample that path started at; plus the best match so far that
+    // has not been reported yet.
+    struct Spotter {
+        std::vector<double> costs;
+        std::vector<uint64_t> starts;
+        std::vector<int64_t> start_times_ns;
+        double candidate_cost;
+        Match candidate;
+        // Whether the last sample completed a match, and which.
+        bool is_reported;
+        Match reported;
+    };
+
+    bool init();
+    void resetSpotters();
+    // Feeds one scaled sample to every spotter.
+    bool spot(const double* input);
+    // Advances template k's spotter to sample `t`.
+    void spotTemplate(uint32_t k, const double* input, uint64_t t,
+                      int64_t time_ns);
+    void scale(const double* input, double* output) const;
+    // The band of template rows input row `i` may be aligned with.
+    void getBand(uint32_t i, uint32_t m, uint32_t n, uint32_t* lo,
+                 uint32_t* hi) const;
+    void computeEnvelope(Template& t, uint32_t m) const;
+    double getCellDistance(const double* a, const double* b) const;
+    // LB_Keogh of `m` input rows against `t`'s envelope. Fills
+    // scratch.row_bounds with the bound of rows i.. (m + 1 entries), for
+    // align() to abandon early; stops adding up once the bound exceeds
+    // `abandon_at`.
+    double getKeoghBound(const double* input, uint32_t m, const Template& t,
+                         double abandon_at, Scratch& scratch) const;
+    // The DTW cost of aligning `a` (m rows) with `b` (n rows) within the
+    // band, or infinity as soon as it must exceed `abandon_at`; needs
+    // scratch.row_bounds unless `abandon_at` is infinite.
+    double align(const double* a, uint32_t m, const double* b, uint32_t n,
+                 double abandon_at, Scratch& scratch) const;
+    // Classifies `m` scaled input rows.
+    bool classify(const double* input, uint32_t m);
+    // Sets template k's distance, likelihood and outcome, and lowers
+    // `best_distance` if it is closer.
+    void scoreTemplate(uint32_t k, const double* input, uint32_t m,
+                       std::atomic<double>& best_distance);
+
+    double radius_;
+    bool use_pruning_;
+    uint32_t window_length_;
+    std::vector<Template> templates_;
+
+    // The last window_length_ scaled samples, oldest first.
+    std::vector<double> window_;
+    uint32_t num_window_rows_;
+
+    // Scratch space.
+    std::vector<Scratch> scratch_;
+    std::vector<double> scaled_;
+    std::vector<uint32_t> order_;
+    std::vector<double> kim_bounds_;
+    std::vector<Outcome> outcomes_;
+
+    PruningStats stats_;
+    ThreadPool* pool_;
+
+    bool use_spotting_;
+    std::vector<Spotter> spotters_;
+    uint64_t num_samples_;
+    Match last_match_;
+
+    static GRT::RegisterClassifierModule<PrunedDTW> registerModule;
+};
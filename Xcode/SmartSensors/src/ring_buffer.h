@@ -0,0 +1,174 @@
+/*
+ * RingBuffer is a bounded, lock-free queue for exactly one producer thread and
+ * one consumer thread, e.g. an IStream reading thread handing samples to the
+ * GUI thread.
+ *
+ * RingBuffer<vector<double>> samples(1 << 16);
+ *
+ * // producer
+ * samples.pushWith([&](vector<double>& slot) { slot.assign(row, row + n); });
+ *
+ * // consumer
+ * samples.drain([](const vector<double>& sample) { ... });
+ *
+ * Slots are allocated once up front and re-used, so once every slot has been
+ * written a steady stream of equally sized samples never touches the heap.
+ * When the ring is full new samples are dropped (never blocking the producer)
+ * and accounted for in getNumDropped()/getNumOverruns().
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Producer-owned and consumer-owned state are kept at least this far apart so
+// that they never share a cache line.
+const size_t kCacheLineSize = 64;
+
+template<typename T>
+class RingBuffer {
+  public:
+    // `capacity` is rounded up to the next power of two. Every slot starts out
+    // as a copy of `prototype`.
+    explicit RingBuffer(size_t capacity, const T& prototype = T())
+            : mask_(roundUpToPowerOfTwo(capacity) - 1),
+              slots_(mask_ + 1, prototype),
+              head_(0), cached_tail_(0), num_pushed_(0), num_dropped_(0),
+              num_overruns_(0), last_push_dropped_(false),
+              tail_(0), cached_head_(0) {}
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    //---------------------------------------------------------------------
+    // Producer side.
+
+    // Copies `value` into the next free slot. Returns false if the ring is full
+    // and the value was dropped.
+    bool push(const T& value) {
+        return pushWith([&value](T& slot) { slot = value; });
+    }
+
+    // Calls `fill(T& slot)` on the next free slot so that the producer can
+    // write in place (e.g. assign() into a pre-sized vector). Returns false if
+    // the ring is full, in which case `fill` is not called.
+    template<typename F>
+    bool pushWith(F fill) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ > mask_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ > mask_) {
+                num_dropped_.fetch_add(1, std::memory_order_relaxed);
+                if (!last_push_dropped_) {
+                    num_overruns_.fetch_add(1, std::memory_order_relaxed);
+                    last_push_dropped_ = true;
+                }
+                return false;
+            }
+        }
+        fill(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        num_pushed_.fetch_add(1, std::memory_order_relaxed);
+        last_push_dropped_ = false;
+        return true;
+    }
+
+    //---------------------------------------------------------------------
+    // Consumer side.
+
+    // The oldest queued element, or nullptr if the ring is empty. The element
+    // stays valid (and is not overwritten) until pop() is called.
+    T* front() {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == cached_head_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail == cached_head_) { return nullptr; }
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // Releases the element returned by front() back to the producer.
+    void pop() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    // Calls `consume(T&)` on every queued element, oldest first, and returns
+    // how many were consumed. Elements pushed while draining are consumed too.
+    template<typename F>
+    size_t drain(F consume) {
+        size_t n = 0;
+        for (T* element = front(); element != nullptr; element = front()) {
+            consume(*element);
+            pop();
+            n++;
+        }
+        return n;
+    }
+
+    // Discards everything currently queued. Consumer side only, like pop().
+    void clear() {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        // front() trusts cached_head_ while tail_ differs from it, so it has
+        // to move along with tail_.
+        cached_head_ = head;
+        tail_.store(head, std::memory_order_release);
+    }
+
+    //---------------------------------------------------------------------
+    // Either side; values are a snapshot and may be stale by the time they
+    // are used.
+
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) -
+                tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Number of elements accepted by push()/pushWith().
+    uint64_t getNumPushed() const {
+        return num_pushed_.load(std::memory_order_relaxed);
+    }
+
+    // Number of elements rejected because the ring was full.
+    uint64_t getNumDropped() const {
+        return num_dropped_.load(std::memory_order_relaxed);
+    }
+
+    // Number of distinct episodes in which the ring ran full, i.e. how often
+    // the consumer fell behind (each episode may drop many elements).
+    uint64_t getNumOverruns() const {
+        return num_overruns_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t p = 1;
+        while (p < n) { p <<= 1; }
+        return p;
+    }
+
+    const uint64_t mask_;
+    std::vector<T> slots_;
+
+    char pad0_[kCacheLineSize];
+
+    // Written by the producer only.
+    std::atomic<uint64_t> head_;
+    uint64_t cached_tail_;
+    std::atomic<uint64_t> num_pushed_;
+    std::atomic<uint64_t> num_dropped_;
+    std::atomic<uint64_t> num_overruns_;
+    bool last_push_dropped_;
+
+    char pad1_[kCacheLineSize];
+
+    // Written by the consumer only.
+    std::atomic<uint64_t> tail_;
+    uint64_t cached_head_;
+
+    char pad2_[kCacheLineSize];
+};
@@ -0,0 +1,14 @@
+#include "runtime.h"
+
+#include <cassert>
+
+static Runtime* runtime = nullptr;
+
+void setRuntime(Runtime* r) {
+    runtime = r;
+}
+
+Runtime* getRuntime() {
+    assert(runtime != nullptr);
+    return runtime;
+}
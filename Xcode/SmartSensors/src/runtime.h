@@ -0,0 +1,32 @@
+/*
+ * A user's setup() (see user.h) describes a sensor application by handing its
+ * stream, calibrator, pipeline, output and tuneable parameters to useStream()
+ * and friends. Those calls go to whichever Runtime is installed: the app
+ * (ofApp), or the headless runner (see headless/).
+ */
+#pragma once
+
+#include "GRT/GRT.h"
+
+class Calibrator;
+class IStream;
+class OStream;
+class Tuneable;
+
+class Runtime {
+  public:
+    virtual ~Runtime() = default;
+
+    virtual void useStream(IStream& stream) = 0;
+    virtual void useCalibrator(Calibrator& calibrator) = 0;
+    virtual void usePipeline(GRT::GestureRecognitionPipeline& pipeline) = 0;
+    virtual void useOStream(OStream& stream) = 0;
+    virtual void registerTuneable(Tuneable* tuneable) = 0;
+
+    // Called after the user changed a tuneable parameter.
+    virtual void reloadPipelineModules() = 0;
+};
+
+// Installs the runtime that setup() talks to. Must be called before setup().
+void setRuntime(Runtime* runtime);
+Runtime* getRuntime();
@@ -0,0 +1,45 @@
+/*
+ * Time as seen by the pipeline.
+ *
+ * Every sample is stamped when it enters the system (live streams use the
+ * arrival time, ReplayStream uses the time recorded with the sample). Before a
+ * sample is pushed through the pipeline, its timestamp is made the current
+ * "sample time" of the processing thread. Time-dependent modules such as
+ * ClockedClassLabelTimeoutFilter read the sample time instead of the system
+ * clock, so a recorded session produces the same results whether it is
+ * replayed at 1x, 100x or as fast as possible.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Monotonic time in nanoseconds.
+inline int64_t getMonotonicTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const int64_t kNoSampleTime = -1;
+
+inline int64_t& currentSampleTimeNs() {
+    static thread_local int64_t time_ns = kNoSampleTime;
+    return time_ns;
+}
+
+// Sets the timestamp of the sample about to be processed on this thread. Pass
+// kNoSampleTime to fall back to the monotonic clock.
+inline void setSampleTimeNs(int64_t time_ns) {
+    currentSampleTimeNs() = time_ns;
+}
+
+// The timestamp of the sample being processed on this thread, or the
+// monotonic clock if none has been set.
+inline int64_t getSampleTimeNs() {
+    int64_t time_ns = currentSampleTimeNs();
+    return time_ns == kNoSampleTime ? getMonotonicTimeNs() : time_ns;
+}
+
+inline uint64_t getSampleTimeMillis() {
+    return getSampleTimeNs() / 1000000;
+}
@@ -0,0 +1,167 @@
+#include "serial_port.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+// Inter-byte timeout, in tenths of a second, once a frame has started.
+const cc_t kInterByteTimeout = 1;
+
+bool toSpeed(uint32_t baud, speed_t* speed) {
+    switch (baud) {
+        case 300: *speed = B300; return true;
+        case 1200: *speed = B1200; return true;
+        case 2400: *speed = B2400; return true;
+        case 4800: *speed = B4800; return true;
+        case 9600: *speed = B9600; return true;
+        case 19200: *speed = B19200; return true;
+        case 38400: *speed = B38400; return true;
+        case 57600: *speed = B57600; return true;
+        case 115200: *speed = B115200; return true;
+        case 230400: *speed = B230400; return true;
+        default: return false;
+    }
+}
+
+}  // namespace
+
+SerialPort::SerialPort() : fd_(-1) {
+    wakeup_fds_[0] = wakeup_fds_[1] = -1;
+}
+
+SerialPort::~SerialPort() {
+    close();
+}
+
+bool SerialPort::fail(const std::string& what) {
+    last_error_ = what + ": " + strerror(errno);
+    close();
+    return false;
+}
+
+bool SerialPort::open(const std::string& device, uint32_t baud,
+                      uint32_t frame_size) {
+    close();
+
+    speed_t speed;
+    if (!toSpeed(baud, &speed)) {
+        last_error_ = "Unsupported baud rate " + std::to_string(baud);
+        return false;
+    }
+
+    // O_NONBLOCK only so that open() does not wait for carrier detect; it is
+    // cleared below so that read() honours VMIN/VTIME.
+    fd_ = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0) { return fail("Failed to open " + device); }
+    if (fcntl(fd_, F_SETFL, 0) < 0) { return fail("fcntl"); }
+
+    struct termios options;
+    if (tcgetattr(fd_, &options) < 0) { return fail("tcgetattr"); }
+    cfmakeraw(&options);
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    options.c_cflag |= (CLOCAL | CREAD);
+    options.c_cflag &= ~(CSTOPB | CRTSCTS);
+    options.c_cc[VMIN] = std::max<uint32_t>(1, std::min<uint32_t>(frame_size, 255));
+    options.c_cc[VTIME] = kInterByteTimeout;
+    if (tcsetattr(fd_, TCSANOW, &options) < 0) { return fail("tcsetattr"); }
+    tcflush(fd_, TCIFLUSH);
+
+    if (pipe(wakeup_fds_) < 0) { return fail("pipe"); }
+    fcntl(wakeup_fds_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeup_fds_[1], F_SETFL, O_NONBLOCK);
+
+    last_error_.clear();
+    return true;
+}
+
+void SerialPort::close() {
+    if (fd_ >= 0) { ::close(fd_); }
+    for (int& fd : wakeup_fds_) {
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+    }
+    fd_ = -1;
+}
+
+int SerialPort::read(uint8_t* buffer, size_t size, int timeout_ms) {
+    if (fd_ < 0) {
+        last_error_ = "Serial port is not open";
+        return -1;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeup_fds_[0];
+    fds[1].events = POLLIN;
+
+    int ready = poll(fds, 2, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) { return 0; }
+        last_error_ = std::string("poll: ") + strerror(errno);
+        return -1;
+    }
+
+    if (fds[1].revents & POLLIN) {
+        // Drain the wake-up pipe; the caller re-checks whether to keep going.
+        uint8_t drain[16];
+        while (::read(wakeup_fds_[0], drain, sizeof(drain)) > 0) {}
+        return 0;
+    }
+
+    if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        last_error_ = "Serial device disconnected";
+        return -1;
+    }
+
+    if (!(fds[0].revents & POLLIN)) { return 0; }
+
+    ssize_t n = ::read(fd_, buffer, size);
+    if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN) { return 0; }
+        last_error_ = std::string("read: ") + strerror(errno);
+        return -1;
+    }
+    return static_cast<int>(n);
+}
+
+void SerialPort::interrupt() {
+    if (wakeup_fds_[1] >= 0) {
+        uint8_t b = 0;
+        // A full pipe already guarantees a pending wake-up.
+        (void) ::write(wakeup_fds_[1], &b, 1);
+    }
+}
+
+std::vector<std::string> listSerialDevices() {
+#ifdef __APPLE__
+    const char* const kPrefixes[] = { "tty.", "cu." };
+#else
+    const char* const kPrefixes[] = { "ttyS", "ttyUSB", "ttyACM", "ttyAMA",
+                                      "rfcomm" };
+#endif
+    std::vector<std::string> devices;
+    DIR* dir = opendir("/dev");
+    if (dir == nullptr) { return devices; }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        for (const char* prefix : kPrefixes) {
+            if (name.compare(0, strlen(prefix), prefix) == 0) {
+                devices.push_back("/dev/" + name);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
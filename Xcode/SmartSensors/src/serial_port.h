@@ -0,0 +1,63 @@
+/*
+ * SerialPort is a small POSIX serial port wrapper that lets a reading thread
+ * sleep in poll() until bytes arrive, instead of spinning on
+ * ofSerial::available() and sleeping for fixed intervals.
+ *
+ * SerialPort port;
+ * port.open("/dev/tty.usbmodem1411", 115200, 64);
+ * uint8_t buffer[64];
+ * int n = port.read(buffer, sizeof(buffer));  // blocks until data arrives
+ *
+ * The port is configured raw (8N1, no flow control, no echo) with VMIN set to
+ * the expected frame size and a short VTIME, so that a single read() returns a
+ * whole frame when the line is busy but never waits more than VTIME after the
+ * last byte received.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SerialPort {
+  public:
+    SerialPort();
+    ~SerialPort();
+
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    // Opens `device` at `baud`. `frame_size` is the number of bytes the reader
+    // would like per read() (clamped to [1, 255], the range of VMIN). Returns
+    // false on failure; see getLastError().
+    bool open(const std::string& device, uint32_t baud, uint32_t frame_size = 1);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    // Waits until data is available, `timeout_ms` elapses (a negative value
+    // waits forever) or interrupt() is called, then reads up to `size` bytes.
+    // Returns the number of bytes read, 0 on timeout or interrupt, and -1 on
+    // error.
+    int read(uint8_t* buffer, size_t size, int timeout_ms = -1);
+
+    // Wakes up a thread blocked in read(). Safe to call from any thread; used
+    // by IStream::stop() so that reading threads can be joined promptly.
+    void interrupt();
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    bool fail(const std::string& what);
+
+    int fd_;
+    // Self-pipe used by interrupt(): [0] is polled along with fd_, [1] is
+    // written to.
+    int wakeup_fds_[2];
+    std::string last_error_;
+};
+
+// The serial devices ofSerial::getDeviceList() would report (USB serial
+// adapters and the like under /dev), sorted by path. Used to look up ports by
+// index where openFrameworks is not available.
+std::vector<std::string> listSerialDevices();
@@ -0,0 +1,282 @@
+#include "session_file.h"
+
+#include <errno.h>
+#include <string.h>
+#include <ctime>
+
+namespace {
+
+const uint64_t kChunkHeaderSize = sizeof(SessionChunkHeader);
+
+uint64_t getRecordSize(uint32_t num_dimensions) {
+    return sizeof(int64_t) + num_dimensions * sizeof(double);
+}
+
+}  // namespace
+
+SessionWriter::SessionWriter()
+        : file_(nullptr),
+          num_dimensions_(0),
+          samples_per_chunk_(0),
+          num_samples_(0),
+          chunk_samples_(0),
+          chunk_last_timestamp_ns_(0),
+          chunk_offset_(0) {
+}
+
+SessionWriter::~SessionWriter() {
+    close();
+}
+
+bool SessionWriter::fail(const std::string& what) {
+    last_error_ = what + ": " + strerror(errno);
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+}
+
+bool SessionWriter::open(const std::string& path, uint32_t num_dimensions,
+                         uint32_t samples_per_chunk) {
+    close();
+
+    if (num_dimensions == 0 || samples_per_chunk == 0) {
+        last_error_ = "Invalid session dimensions";
+        return false;
+    }
+
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        last_error_ = "Failed to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    num_dimensions_ = num_dimensions;
+    samples_per_chunk_ = samples_per_chunk;
+    num_samples_ = 0;
+    chunk_samples_ = 0;
+    index_.clear();
+    chunk_.assign(kChunkHeaderSize +
+                  samples_per_chunk * getRecordSize(num_dimensions), 0);
+
+    SessionFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSessionFileMagic, sizeof(header.magic));
+    header.version = kSessionFileVersion;
+    header.num_dimensions = num_dimensions;
+    header.samples_per_chunk = samples_per_chunk;
+    header.created_at = time(nullptr);
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        return fail("Failed to write session header");
+    }
+    chunk_offset_ = sizeof(header);
+    last_error_.clear();
+    return true;
+}
+
+bool SessionWriter::append(int64_t timestamp_ns, const double* sample) {
+    if (file_ == nullptr) { return false; }
+
+    uint64_t record_size = getRecordSize(num_dimensions_);
+    uint8_t* record = chunk_.data() + kChunkHeaderSize +
+            chunk_samples_ * record_size;
+    memcpy(record, &timestamp_ns, sizeof(timestamp_ns));
+    memcpy(record + sizeof(timestamp_ns), sample,
+           num_dimensions_ * sizeof(double));
+
+    if (chunk_samples_ == 0) {
+        SessionChunkHeader* header =
+                reinterpret_cast<SessionChunkHeader*>(chunk_.data());
+        header->first_timestamp_ns = timestamp_ns;
+    }
+    chunk_last_timestamp_ns_ = timestamp_ns;
+    chunk_samples_++;
+    num_samples_++;
+
+    if (chunk_samples_ == samples_per_chunk_) {
+        return flushChunk();
+    }
+    return true;
+}
+
+bool SessionWriter::flushChunk() {
+    if (chunk_samples_ == 0) { return true; }
+
+    SessionChunkHeader* header =
+            reinterpret_cast<SessionChunkHeader*>(chunk_.data());
+    header->num_samples = chunk_samples_;
+    header->reserved = 0;
+
+    // Unused records of a partial chunk are zeroed so the file is reproducible.
+    uint64_t used = kChunkHeaderSize +
+            chunk_samples_ * getRecordSize(num_dimensions_);
+    memset(chunk_.data() + used, 0, chunk_.size() - used);
+
+    // Flushed right away so that a crash loses at most the chunk being filled.
+    if (fwrite(chunk_.data(), chunk_.size(), 1, file_) != 1 ||
+        fflush(file_) != 0) {
+        return fail("Failed to write session chunk");
+    }
+
+    SessionIndexEntry entry;
+    entry.offset = chunk_offset_;
+    entry.num_samples = chunk_samples_;
+    entry.first_timestamp_ns = header->first_timestamp_ns;
+    entry.last_timestamp_ns = chunk_last_timestamp_ns_;
+    index_.push_back(entry);
+
+    chunk_offset_ += chunk_.size();
+    chunk_samples_ = 0;
+    return true;
+}
+
+bool SessionWriter::close() {
+    if (file_ == nullptr) { return true; }
+    if (!flushChunk()) { return false; }
+
+    SessionIndexFooter footer;
+    footer.index_offset = chunk_offset_;
+    footer.num_chunks = index_.size();
+    footer.num_samples = num_samples_;
+    memcpy(footer.magic, kSessionIndexMagic, sizeof(footer.magic));
+
+    if ((!index_.empty() &&
+         fwrite(index_.data(), sizeof(SessionIndexEntry), index_.size(), file_)
+                 != index_.size()) ||
+        fwrite(&footer, sizeof(footer), 1, file_) != 1) {
+        return fail("Failed to write session index");
+    }
+
+    bool ok = fclose(file_) == 0;
+    if (!ok) {
+        last_error_ = std::string("Failed to close session: ") + strerror(errno);
+    }
+    file_ = nullptr;
+    return ok;
+}
+
+bool SessionReader::open(const std::string& path) {
+    close();
+
+    if (!file_.open(path)) {
+        last_error_ = file_.getLastError();
+        return false;
+    }
+
+    const SessionFileHeader* header =
+            reinterpret_cast<const SessionFileHeader*>(file_.data());
+    if (file_.size() < sizeof(*header) ||
+        memcmp(header->magic, kSessionFileMagic, sizeof(header->magic)) != 0) {
+        last_error_ = path + " is not a session file";
+        close();
+        return false;
+    }
+    if (header->version != kSessionFileVersion) {
+        last_error_ = path + " has unsupported session version " +
+                std::to_string(header->version);
+        close();
+        return false;
+    }
+    if (header->num_dimensions == 0 || header->samples_per_chunk == 0) {
+        last_error_ = path + " has an invalid session header";
+        close();
+        return false;
+    }
+
+    num_dimensions_ = header->num_dimensions;
+    samples_per_chunk_ = header->samples_per_chunk;
+    record_size_ = getRecordSize(num_dimensions_);
+    uint64_t chunk_size = kChunkHeaderSize + samples_per_chunk_ * record_size_;
+
+    // Trust the index only if it is consistent with the file size.
+    bool has_index = false;
+    if (file_.size() >= sizeof(*header) + sizeof(SessionIndexFooter)) {
+        const SessionIndexFooter* footer =
+                reinterpret_cast<const SessionIndexFooter*>(
+                        file_.data() + file_.size() - sizeof(SessionIndexFooter));
+        has_index =
+                memcmp(footer->magic, kSessionIndexMagic, sizeof(footer->magic)) == 0 &&
+                footer->index_offset ==
+                        sizeof(*header) + footer->num_chunks * chunk_size &&
+                footer->index_offset +
+                        footer->num_chunks * sizeof(SessionIndexEntry) +
+                        sizeof(SessionIndexFooter) == file_.size();
+        if (has_index) {
+            const SessionIndexEntry* entries =
+                    reinterpret_cast<const SessionIndexEntry*>(
+                            file_.data() + footer->index_offset);
+            index_.assign(entries, entries + footer->num_chunks);
+            num_samples_ = footer->num_samples;
+        }
+    }
+
+    if (!has_index && !rebuildIndex(chunk_size)) {
+        last_error_ = path + " is corrupt";
+        close();
+        return false;
+    }
+
+    // Every chunk but the last is full, so getRecord() can use a fixed stride.
+    for (size_t i = 0; i + 1 < index_.size(); i++) {
+        if (index_[i].num_samples != samples_per_chunk_) {
+            last_error_ = path + " has a partial chunk in the middle";
+            close();
+            return false;
+        }
+    }
+    last_error_.clear();
+    return true;
+}
+
+bool SessionReader::rebuildIndex(uint64_t chunk_size) {
+    index_.clear();
+    num_samples_ = 0;
+    uint64_t offset = sizeof(SessionFileHeader);
+    while (offset + chunk_size <= file_.size()) {
+        const SessionChunkHeader* chunk =
+                reinterpret_cast<const SessionChunkHeader*>(file_.data() + offset);
+        if (chunk->num_samples == 0 || chunk->num_samples > samples_per_chunk_) {
+            break;
+        }
+        SessionIndexEntry entry;
+        entry.offset = offset;
+        entry.num_samples = chunk->num_samples;
+        entry.first_timestamp_ns = chunk->first_timestamp_ns;
+        entry.last_timestamp_ns = 0;
+        memcpy(&entry.last_timestamp_ns,
+               file_.data() + offset + kChunkHeaderSize +
+                       (chunk->num_samples - 1) * record_size_,
+               sizeof(entry.last_timestamp_ns));
+        index_.push_back(entry);
+        num_samples_ += chunk->num_samples;
+        offset += chunk_size;
+        if (chunk->num_samples < samples_per_chunk_) { break; }
+    }
+    return true;
+}
+
+void SessionReader::close() {
+    file_.close();
+    index_.clear();
+    num_dimensions_ = 0;
+    samples_per_chunk_ = 0;
+    num_samples_ = 0;
+    record_size_ = 0;
+}
+
+const uint8_t* SessionReader::getRecord(uint64_t i) const {
+    const SessionIndexEntry& chunk = index_[i / samples_per_chunk_];
+    return file_.data() + chunk.offset + kChunkHeaderSize +
+            (i % samples_per_chunk_) * record_size_;
+}
+
+int64_t SessionReader::getTimestampNs(uint64_t i) const {
+    int64_t timestamp_ns;
+    memcpy(&timestamp_ns, getRecord(i), sizeof(timestamp_ns));
+    return timestamp_ns;
+}
+
+const double* SessionReader::getSample(uint64_t i) const {
+    // Records are 8-byte aligned: header, chunk header and record sizes are all
+    // multiples of 8 and mmap returns page-aligned memory.
+    return reinterpret_cast<const double*>(getRecord(i) + sizeof(int64_t));
+}
@@ -0,0 +1,129 @@
+/*
+ * Recorded sessions: a stream of timestamped samples stored in a compact binary
+ * file that can be memory-mapped and replayed (see ReplayStream).
+ *
+ * Layout (little-endian, every section 8-byte aligned):
+ *
+ *   SessionFileHeader
+ *   chunk 0, chunk 1, ...    each kChunkHeaderSize + samples_per_chunk records,
+ *                            written in full even if only partially used
+ *   SessionIndexEntry[n]     one per chunk
+ *   SessionIndexFooter       last bytes of the file
+ *
+ * A record is an int64 timestamp (ns) followed by num_dimensions doubles.
+ * Because chunks have a fixed size, a file whose index was never written (the
+ * recorder crashed) can still be read by walking the chunks.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+const char kSessionFileMagic[4] = { 'E', 'S', 'P', 'S' };
+const char kSessionIndexMagic[8] = { 'E', 'S', 'P', 'S', 'I', 'D', 'X', '1' };
+const uint32_t kSessionFileVersion = 1;
+const uint32_t kDefaultSamplesPerChunk = 4096;
+
+struct SessionFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_dimensions;
+    uint32_t samples_per_chunk;
+    // Wall-clock time (seconds since epoch) the recording started; informative.
+    int64_t created_at;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(SessionFileHeader) == 64, "SessionFileHeader layout");
+
+struct SessionChunkHeader {
+    uint32_t num_samples;
+    uint32_t reserved;
+    int64_t first_timestamp_ns;
+};
+static_assert(sizeof(SessionChunkHeader) == 16, "SessionChunkHeader layout");
+
+struct SessionIndexEntry {
+    uint64_t offset;
+    uint64_t num_samples;
+    int64_t first_timestamp_ns;
+    int64_t last_timestamp_ns;
+};
+static_assert(sizeof(SessionIndexEntry) == 32, "SessionIndexEntry layout");
+
+struct SessionIndexFooter {
+    uint64_t index_offset;
+    uint64_t num_chunks;
+    uint64_t num_samples;
+    char magic[8];
+};
+static_assert(sizeof(SessionIndexFooter) == 32, "SessionIndexFooter layout");
+
+// Writes a session file synchronously. Not thread-safe.
+class SessionWriter {
+  public:
+    SessionWriter();
+    ~SessionWriter();
+
+    bool open(const std::string& path, uint32_t num_dimensions,
+              uint32_t samples_per_chunk = kDefaultSamplesPerChunk);
+    bool append(int64_t timestamp_ns, const double* sample);
+    // Flushes the last chunk and writes the index. Also called by the
+    // destructor.
+    bool close();
+
+    bool isOpen() const { return file_ != nullptr; }
+    uint32_t getNumDimensions() const { return num_dimensions_; }
+    uint64_t getNumSamples() const { return num_samples_; }
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    bool flushChunk();
+    bool fail(const std::string& what);
+
+    FILE* file_;
+    uint32_t num_dimensions_;
+    uint32_t samples_per_chunk_;
+    uint64_t num_samples_;
+
+    // The chunk being filled: header followed by records.
+    std::vector<uint8_t> chunk_;
+    uint32_t chunk_samples_;
+    int64_t chunk_last_timestamp_ns_;
+    uint64_t chunk_offset_;
+    std::vector<SessionIndexEntry> index_;
+
+    std::string last_error_;
+};
+
+// Memory-maps a session file for random access to its samples.
+class SessionReader {
+  public:
+    bool open(const std::string& path);
+    void close();
+
+    uint32_t getNumDimensions() const { return num_dimensions_; }
+    uint64_t getNumSamples() const { return num_samples_; }
+
+    int64_t getTimestampNs(uint64_t i) const;
+    // Points into the mapping; valid until close().
+    const double* getSample(uint64_t i) const;
+
+    const std::vector<SessionIndexEntry>& getIndex() const { return index_; }
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    const uint8_t* getRecord(uint64_t i) const;
+    bool rebuildIndex(uint64_t chunk_size);
+
+    MappedFile file_;
+    uint32_t num_dimensions_ = 0;
+    uint32_t samples_per_chunk_ = 0;
+    uint64_t num_samples_ = 0;
+    uint64_t record_size_ = 0;
+    std::vector<SessionIndexEntry> index_;
+    std::string last_error_;
+};
@@ -0,0 +1,89 @@
+#include "session_manager.h"
+
+#include <algorithm>
+#include <iomanip>
+
+SessionManager::SessionManager(uint32_t num_threads)
+        : pool_(num_threads), is_running_(false) {
+}
+
+SessionManager::~SessionManager() {
+    stopAll();
+}
+
+InferenceEngine& SessionManager::addSession(
+        const std::string& name, std::unique_ptr<IStream> stream,
+        std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline,
+        std::unique_ptr<OStream> ostream, uint32_t capacity) {
+    std::unique_ptr<Session> session(new Session());
+    session->name = name;
+    session->stream = std::move(stream);
+    session->ostream = std::move(ostream);
+    session->engine.reset(new InferenceEngine(capacity, name));
+    session->engine->runOn(&pool_);
+    session->engine->setOStream(session->ostream.get());
+    session->engine->setPipeline(pipeline);
+    sessions_.push_back(std::move(session));
+    return *sessions_.back()->engine;
+}
+
+void SessionManager::startAll() {
+    if (is_running_) { return; }
+    for (auto& session : sessions_) {
+        if (session->ostream != nullptr && !session->ostream->start()) {
+            ofLog(OF_LOG_ERROR) << session->name
+                                << ": failed to connect to ostream";
+        }
+        session->engine->start(session->stream.get());
+    }
+    is_running_ = true;
+}
+
+void SessionManager::stopAll() {
+    if (!is_running_) { return; }
+    for (auto& session : sessions_) {
+        session->stream->stop();
+    }
+    for (auto& session : sessions_) {
+        session->engine->stop();
+    }
+    is_running_ = false;
+}
+
+std::vector<SessionManager::Stats> SessionManager::getStats() const {
+    std::vector<Stats> stats;
+    for (const auto& session : sessions_) {
+        const InferenceEngine& engine = *session->engine;
+        const LatencyHistogram& latency = engine.getLatency();
+        Stats s = { session->name, engine.getNumProcessed(),
+                    engine.getNumQueued(), engine.getNumDropped(),
+                    latency.getPercentile(50), latency.getPercentile(99),
+                    latency.getMax() };
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+void SessionManager::dumpStats(std::ostream& out) const {
+    std::vector<Stats> stats = getStats();
+    size_t name_width = 7;
+    for (const Stats& s : stats) {
+        name_width = std::max(name_width, s.name.size());
+    }
+
+    out << std::left << std::setw(name_width) << "session" << std::right
+        << std::setw(12) << "processed" << std::setw(10) << "queued"
+        << std::setw(10) << "dropped" << std::setw(12) << "p50"
+        << std::setw(12) << "p99" << std::setw(12) << "max" << "\n";
+    for (const Stats& s : stats) {
+        out << std::left << std::setw(name_width) << s.name << std::right
+            << std::setw(12) << s.num_processed << std::setw(10)
+            << s.num_queued << std::setw(10) << s.num_dropped
+            << std::setw(12) << formatDuration(s.p50_ns)
+            << std::setw(12) << formatDuration(s.p99_ns)
+            << std::setw(12) << formatDuration(s.max_ns) << "\n";
+    }
+    out << pool_.getNumThreads() << " threads, "
+        << pool_.getNumExecuted() << " tasks (" << pool_.getNumStolen()
+        << " stolen)" << std::endl;
+}
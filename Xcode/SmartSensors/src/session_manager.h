@@ -0,0 +1,91 @@
+/*
+ * SessionManager hosts many independent sensor sessions in one process. Each
+ * session is a stream, an optional OStream and its own InferenceEngine (with
+ * its own input ring, copy of the pipeline and latency histograms, named
+ * after the session), so a slow or failing session never stalls another.
+ * Instead of a thread per session, every engine runs on one shared
+ * work-stealing ThreadPool, sized to the number of cores by default.
+ *
+ * SessionManager sessions;
+ * sessions.addSession("left", std::move(left_stream), pipeline);
+ * sessions.addSession("right", std::move(right_stream), pipeline,
+ *                     std::move(ostream));
+ * sessions.startAll();
+ * ...
+ * sessions.dumpStats(std::cout);
+ * sessions.stopAll();
+ *
+ * Sessions can share one published pipeline: each engine copies it.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "inference_engine.h"
+#include "istream.h"
+#include "ostream.h"
+#include "thread_pool.h"
+
+class SessionManager {
+  public:
+    struct Stats {
+        std::string name;
+        uint64_t num_processed;
+        uint64_t num_queued;
+        uint64_t num_dropped;
+        // Arrival to prediction.
+        int64_t p50_ns;
+        int64_t p99_ns;
+        int64_t max_ns;
+    };
+
+    // 0 uses one pool thread per core.
+    explicit SessionManager(uint32_t num_threads = 0);
+    // Stops every session.
+    ~SessionManager();
+
+    SessionManager(const SessionManager&) = delete;
+    SessionManager& operator=(const SessionManager&) = delete;
+
+    // Adds a session reading from `stream`; the manager owns the stream and
+    // the ostream. The returned engine can be configured further (e.g. with
+    // a calibrator) until startAll().
+    InferenceEngine& addSession(
+            const std::string& name, std::unique_ptr<IStream> stream,
+            std::shared_ptr<const GRT::GestureRecognitionPipeline> pipeline,
+            std::unique_ptr<OStream> ostream = nullptr,
+            uint32_t capacity = InferenceEngine::kDefaultCapacity);
+
+    // Starts every session's ostream (logging the ones that fail), engine
+    // and stream.
+    void startAll();
+    // Stops the streams first, so that no session is fed while the others
+    // wind down.
+    void stopAll();
+
+    uint32_t getNumSessions() const { return sessions_.size(); }
+    InferenceEngine& getEngine(uint32_t i) { return *sessions_[i]->engine; }
+    IStream& getStream(uint32_t i) { return *sessions_[i]->stream; }
+    ThreadPool& getThreadPool() { return pool_; }
+
+    std::vector<Stats> getStats() const;
+    // One line per session, plus the pool's totals.
+    void dumpStats(std::ostream& out) const;
+
+  private:
+    struct Session {
+        std::string name;
+        std::unique_ptr<IStream> stream;
+        std::unique_ptr<OStream> ostream;
+        std::unique_ptr<InferenceEngine> engine;
+    };
+
+    // Declared first so that it outlives the engines whose tasks it runs.
+    ThreadPool pool_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+    bool is_running_;
+};
@@ -0,0 +1,97 @@
+#include "session_recorder.h"
+
+#include <chrono>
+
+// How long the writer thread sleeps when there is nothing to write. Samples
+// accumulate in the ring meanwhile, so this trades wake-ups for nothing more
+// than a little latency on disk.
+const uint32_t kWriterIdleMs = 20;
+
+SessionRecorder::SessionRecorder(size_t capacity)
+        : samples_(capacity),
+          is_recording_(false),
+          has_failed_(false),
+          num_written_(0) {
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const std::string& path) {
+    stop();
+    path_ = path;
+    samples_.clear();
+    num_written_ = 0;
+    has_failed_ = false;
+    last_error_.clear();
+    is_recording_ = true;
+    writing_thread_.reset(new std::thread(&SessionRecorder::write, this));
+    return true;
+}
+
+void SessionRecorder::stop() {
+    is_recording_ = false;
+    if (writing_thread_ != nullptr && writing_thread_->joinable()) {
+        writing_thread_->join();
+    }
+    writing_thread_.reset();
+}
+
+void SessionRecorder::record(const GRT::MatrixDouble& data,
+                             const std::vector<int64_t>& timestamps_ns) {
+    if (!is_recording_) { return; }
+    uint32_t num_dimensions = data.getNumCols();
+    for (uint32_t i = 0; i < data.getNumRows(); i++) {
+        const double* row = data[i];
+        int64_t time_ns = timestamps_ns[i];
+        samples_.pushWith([row, num_dimensions, time_ns](Sample& slot) {
+            slot.time_ns = time_ns;
+            slot.data.assign(row, row + num_dimensions);
+        });
+    }
+}
+
+void SessionRecorder::fail(const std::string& error) {
+    last_error_ = error;
+    has_failed_ = true;
+    is_recording_ = false;
+}
+
+int64_t SessionRecorder::writeBuffered() {
+    int64_t n = 0;
+    for (Sample* sample = samples_.front(); sample != nullptr;
+         samples_.pop(), sample = samples_.front()) {
+        if (!writer_.isOpen() &&
+            !writer_.open(path_, sample->data.size())) {
+            fail(writer_.getLastError());
+            return -1;
+        }
+        if (sample->data.size() != writer_.getNumDimensions()) {
+            // A stream never changes its dimensions; skip anything malformed.
+            continue;
+        }
+        if (!writer_.append(sample->time_ns, sample->data.data())) {
+            fail(writer_.getLastError());
+            return -1;
+        }
+        n++;
+    }
+    num_written_.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+void SessionRecorder::write() {
+    while (is_recording_) {
+        int64_t n = writeBuffered();
+        if (n < 0) { break; }
+        if (n == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kWriterIdleMs));
+        }
+    }
+    // Whatever arrived before stop() still belongs to the session.
+    if (!has_failed_) { writeBuffered(); }
+    if (writer_.isOpen() && !writer_.close() && !has_failed_) {
+        fail(writer_.getLastError());
+    }
+}
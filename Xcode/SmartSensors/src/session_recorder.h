@@ -0,0 +1,72 @@
+/*
+ * SessionRecorder continuously records every sample an IStream delivers to a
+ * session file (see session_file.h), which ReplayStream can play back later.
+ *
+ * record() is called on the stream's thread and only copies the samples into
+ * a lock-free ring; a background thread drains the ring and does all file I/O,
+ * so neither the stream nor the GUI ever waits on the disk and memory use does
+ * not grow with the length of the session. If the disk cannot keep up for
+ * longer than the ring can absorb, samples are dropped and counted.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "ring_buffer.h"
+#include "session_file.h"
+
+class SessionRecorder {
+  public:
+    // `capacity` is the number of samples that can be buffered while the
+    // writer thread is busy.
+    explicit SessionRecorder(size_t capacity = 1 << 18);
+    ~SessionRecorder();
+
+    // Starts recording to `path`. The file is created once the first samples
+    // arrive, with as many dimensions as they have.
+    bool start(const std::string& path);
+    // Writes out everything buffered and finalizes the file.
+    void stop();
+    bool isRecording() const { return is_recording_; }
+
+    // Producer side: called from the stream's data-ready callback.
+    void record(const GRT::MatrixDouble& data,
+                const std::vector<int64_t>& timestamps_ns);
+
+    const std::string& getPath() const { return path_; }
+    uint64_t getNumSamples() const { return num_written_; }
+    uint64_t getNumDropped() const { return samples_.getNumDropped(); }
+
+    // True if writing failed; recording stops and the reason is available from
+    // getLastError() (only read it once this returns true).
+    bool hasFailed() const { return has_failed_; }
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    struct Sample {
+        int64_t time_ns;
+        std::vector<double> data;
+    };
+
+    void write();
+    // Drains the ring into writer_. Returns the number of samples written, or
+    // -1 if writing failed.
+    int64_t writeBuffered();
+    void fail(const std::string& error);
+
+    RingBuffer<Sample> samples_;
+    SessionWriter writer_;
+    std::string path_;
+    std::atomic<bool> is_recording_;
+    std::atomic<bool> has_failed_;
+    std::atomic<uint64_t> num_written_;
+    std::string last_error_;
+
+    std::unique_ptr<std::thread> writing_thread_;
+};
@@ -0,0 +1,43 @@
+#include "temporary_file.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+TemporaryFile::TemporaryFile(const std::string& prefix) {
+    const char* directory = getenv("TMPDIR");
+    std::string pattern = directory != nullptr && directory[0] != '\0'
+                                  ? directory
+                                  : "/tmp";
+    if (pattern[pattern.size() - 1] != '/') { pattern += '/'; }
+    pattern += prefix + "-XXXXXX";
+
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    int fd = mkstemp(path.data());
+    if (fd < 0) { return; }
+    close(fd);
+    path_ = path.data();
+}
+
+TemporaryFile::~TemporaryFile() {
+    if (isCreated()) { unlink(path_.c_str()); }
+}
+
+bool TemporaryFile::read(std::string* contents) const {
+    if (!isCreated()) { return false; }
+    std::ifstream file(path_.c_str());
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *contents = stream.str();
+    return static_cast<bool>(file);
+}
+
+bool TemporaryFile::write(const std::string& contents) const {
+    if (!isCreated()) { return false; }
+    std::ofstream file(path_.c_str(), std::ios::out | std::ios::trunc);
+    return static_cast<bool>(file << contents);
+}
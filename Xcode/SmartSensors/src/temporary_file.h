@@ -0,0 +1,36 @@
+/*
+ * TemporaryFile is an empty file created in $TMPDIR (or /tmp if it is not
+ * set) and removed again when the TemporaryFile goes out of scope, on every
+ * path. GRT only saves and loads its objects through files, so this is how
+ * their text is round-tripped:
+ *
+ * TemporaryFile file("esp-pipeline");
+ * std::string text;
+ * bool ok = file.isCreated() && pipeline.save(file.getPath()) &&
+ *           file.read(&text);
+ */
+#pragma once
+
+#include <string>
+
+class TemporaryFile {
+  public:
+    // The file is named "<prefix>-XXXXXX", with a unique suffix.
+    explicit TemporaryFile(const std::string& prefix);
+    ~TemporaryFile();
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    // False if the file could not be created; getPath() is empty then.
+    bool isCreated() const { return !path_.empty(); }
+    const std::string& getPath() const { return path_; }
+
+    // Reads the whole file into `contents`.
+    bool read(std::string* contents) const;
+    // Replaces the file's contents with `contents`.
+    bool write(const std::string& contents) const;
+
+  private:
+    std::string path_;
+};
@@ -0,0 +1,183 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// The pool and index of the worker running on this thread, if any.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t num_threads)
+        : next_worker_(0),
+          num_queued_(0),
+          num_sleeping_(0),
+          is_stopping_(false),
+          num_executed_(0),
+          num_stolen_(0) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t i = 0; i < num_threads; i++) {
+        workers_.emplace_back(new Worker());
+    }
+    // Only started once every queue exists, since workers steal from all.
+    for (uint32_t i = 0; i < num_threads; i++) {
+        workers_[i]->thread = std::thread(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    uint32_t index = (current_pool == this)
+            ? current_worker
+            : next_worker_.fetch_add(1, std::memory_order_relaxed) %
+                      workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    // Pairs with run(): either a sleeping worker is seen here, or the worker
+    // sees the new task before it goes to sleep.
+    num_queued_.fetch_add(1);
+    if (num_sleeping_.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wakeup_.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t n, LoopBody fn) {
+    if (n == 0) { return; }
+    // Shared with the helper tasks, which may only start after the loop is
+    // done and this call has returned.
+    struct Loop {
+        LoopBody fn;
+        uint32_t n;
+        std::atomic<uint32_t> next;
+        std::atomic<uint32_t> num_done;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+    loop->fn = std::move(fn);
+    loop->n = n;
+    loop->next = 0;
+    loop->num_done = 0;
+
+    auto work = [loop]() {
+        uint32_t i;
+        while ((i = loop->next.fetch_add(1)) < loop->n) {
+            try {
+                loop->fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                if (loop->error == nullptr) {
+                    loop->error = std::current_exception();
+                }
+            }
+            if (loop->num_done.fetch_add(1) + 1 == loop->n) {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                loop->done.notify_all();
+            }
+        }
+    };
+    uint32_t num_helpers = std::min<uint32_t>(n, workers_.size()) - 1;
+    for (uint32_t i = 0; i < num_helpers; i++) {
+        submit(work);
+    }
+    work();
+
+    // Only indices already taken by running helpers are left.
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->done.wait(lock, [&loop]() { return loop->num_done == loop->n; });
+    if (loop->error != nullptr) { std::rethrow_exception(loop->error); }
+}
+
+bool ThreadPool::pop(uint32_t index, Task& task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) { return false; }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(uint32_t index, Task& task) {
+    for (uint32_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) { continue; }
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        num_stolen_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(uint32_t index) {
+    current_pool = this;
+    current_worker = index;
+    Task task;
+    while (true) {
+        if (pop(index, task) || steal(index, task)) {
+            num_queued_.fetch_sub(1);
+            // One failing task must not take the other users of the pool down.
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "ThreadPool task failed: " << e.what() << std::endl;
+            }
+            task = nullptr;
+            num_executed_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        num_sleeping_.fetch_add(1);
+        wakeup_.wait(lock, [this]() {
+            return num_queued_.load() > 0 || is_stopping_;
+        });
+        num_sleeping_.fetch_sub(1);
+        if (is_stopping_ && num_queued_.load() == 0) { break; }
+    }
+    current_pool = nullptr;
+    current_worker = -1;
+}
+
+bool ThreadPool::pinWorkers() {
+#ifdef __linux__
+    uint32_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+    bool ok = true;
+    for (uint32_t i = 0; i < workers_.size(); i++) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % num_cores, &cpus);
+        ok &= pthread_setaffinity_np(workers_[i]->thread.native_handle(),
+                                     sizeof(cpus), &cpus) == 0;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
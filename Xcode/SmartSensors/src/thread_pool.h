@@ -0,0 +1,86 @@
+/*
+ * ThreadPool runs short tasks on a fixed set of worker threads (by default one
+ * per core). Every worker has its own queue: tasks submitted from a worker go
+ * to the back of its own queue and it runs them newest first, which keeps
+ * related work on one core; tasks submitted from other threads are spread
+ * round-robin. A worker whose queue is empty steals the oldest task of
+ * another worker before going to sleep.
+ *
+ * ThreadPool pool;
+ * pool.submit([&]() { process(batch); });
+ *
+ * Tasks must not block for long: a blocked task holds up its worker. The
+ * destructor runs the tasks still queued and then joins the workers.
+ *
+ * parallelFor() splits a loop over the pool and waits for it, which is safe
+ * from a task too: the caller works through the loop itself rather than
+ * waiting for workers that may all be busy.
+ *
+ * pool.parallelFor(templates.size(), [&](uint32_t i) { score(templates[i]); });
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+  public:
+    typedef std::function<void()> Task;
+
+    // 0 uses std::thread::hardware_concurrency() threads.
+    explicit ThreadPool(uint32_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Can be called from any thread, including from a task.
+    void submit(Task task);
+
+    // Runs fn(0) .. fn(n - 1) on up to getNumThreads() threads, the calling
+    // one included, and returns once all have returned. Rethrows the first
+    // exception thrown by fn, after the others have finished.
+    typedef std::function<void(uint32_t)> LoopBody;
+    void parallelFor(uint32_t n, LoopBody fn);
+
+    // Pins worker i to core i (modulo the number of cores). Linux only;
+    // returns false if any worker could not be pinned.
+    bool pinWorkers();
+
+    uint32_t getNumThreads() const { return workers_.size(); }
+    uint64_t getNumExecuted() const { return num_executed_; }
+    uint64_t getNumStolen() const { return num_stolen_; }
+
+  private:
+    // Each queue's mutex is only contended when a task is stolen from it.
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void run(uint32_t index);
+    bool pop(uint32_t index, Task& task);
+    bool steal(uint32_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<uint32_t> next_worker_;
+
+    // Tasks queued but not yet taken by a worker.
+    std::atomic<uint64_t> num_queued_;
+    // Idle workers sleep on wakeup_ once they find nothing to steal.
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<uint32_t> num_sleeping_;
+    std::atomic<bool> is_stopping_;
+
+    std::atomic<uint64_t> num_executed_;
+    std::atomic<uint64_t> num_stolen_;
+};
@@ -0,0 +1,133 @@
+#include "tracer.h"
+
+#include <fstream>
+
+namespace {
+
+int64_t& currentArrivalNs() {
+    static thread_local int64_t arrival_ns = 0;
+    return arrival_ns;
+}
+
+}  // namespace
+
+void setSampleArrivalNs(int64_t arrival_ns) {
+    currentArrivalNs() = arrival_ns;
+}
+
+int64_t getSampleArrivalNs() {
+    return currentArrivalNs();
+}
+
+Tracer::Tracer() : is_tracing_(false), num_events_(0), max_events_(0) {
+}
+
+Tracer& getTracer() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::ThreadBuffer* Tracer::getThreadBuffer() {
+    // Buffers belong to the (process-wide) tracer and are never freed, so a
+    // thread may keep its pointer for its whole life.
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.emplace_back(new ThreadBuffer());
+        buffer = buffers_.back().get();
+        buffer->thread_id = buffers_.size();
+    }
+    return buffer;
+}
+
+void Tracer::start(size_t max_events) {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->events.clear();
+    }
+    max_events_ = max_events;
+    num_events_ = 0;
+    is_tracing_ = true;
+}
+
+void Tracer::add(const Event& event) {
+    if (!isTracing()) { return; }
+    if (num_events_.fetch_add(1, std::memory_order_relaxed) >= max_events_) {
+        return;
+    }
+    ThreadBuffer* buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->events.push_back(event);
+}
+
+void Tracer::span(const char* name, int64_t start_ns, int64_t end_ns,
+                  int64_t flow_id) {
+    Event event = { name, 'X', start_ns, end_ns - start_ns, 0, nullptr, 0 };
+    add(event);
+    if (flow_id != 0) {
+        Event flow = { "sample", 's', start_ns, 0, flow_id, nullptr, 0 };
+        add(flow);
+    }
+}
+
+void Tracer::span(const char* name, int64_t start_ns, int64_t end_ns,
+                  const char* arg_name, int64_t arg_value) {
+    Event event = { name, 'X', start_ns, end_ns - start_ns, 0,
+                    arg_name, arg_value };
+    add(event);
+}
+
+void Tracer::flowEnd(const char* name, int64_t time_ns, int64_t flow_id,
+                     const char* arg_name, int64_t arg_value) {
+    Event instant = { name, 'i', time_ns, 0, 0, arg_name, arg_value };
+    add(instant);
+    Event flow = { "sample", 'f', time_ns, 0, flow_id, nullptr, 0 };
+    add(flow);
+}
+
+bool Tracer::stop(const std::string& path) {
+    is_tracing_ = false;
+
+    std::ofstream out(path.c_str());
+    if (!out) {
+        last_error_ = "Failed to open " + path;
+        return false;
+    }
+
+    // Chrome trace timestamps are in microseconds.
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        for (const Event& e : buffer->events) {
+            out << (first ? "" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << e.name << "\",\"cat\":\"esp\",\"ph\":\""
+                << e.phase << "\",\"pid\":1,\"tid\":" << buffer->thread_id
+                << ",\"ts\":" << e.time_ns / 1000 << "." << (e.time_ns % 1000) / 100;
+            if (e.phase == 'X') {
+                out << ",\"dur\":" << e.duration_ns / 1000 << "."
+                    << (e.duration_ns % 1000) / 100;
+            } else if (e.phase == 'i') {
+                out << ",\"s\":\"t\"";
+            } else {
+                // Flows bind to the enclosing span on each end.
+                out << ",\"id\":" << e.flow_id << ",\"bp\":\"e\"";
+            }
+            if (e.arg_name != nullptr) {
+                out << ",\"args\":{\"" << e.arg_name << "\":" << e.arg_value << "}";
+            }
+            out << "}";
+        }
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        last_error_ = "Failed to write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * End-to-end latency tracing, from the moment sensor bytes are read to the
+ * moment an OStream emits a keystroke, click or TCP message.
+ *
+ * Every batch a stream reads is stamped with its arrival time (monotonic
+ * clock, see sample_clock.h), which travels with each of its samples through
+ * calibration and prediction. The inference thread makes it the current
+ * "arrival time" of the sample it is processing, so an OStream that fires can
+ * tell how long ago the bytes that caused it arrived. Those latencies always
+ * go into the "e2e/..." histograms of the Profiler.
+ *
+ * While a trace is running, the stream and inference threads additionally log
+ * events that Tracer::stop() writes in the Chrome trace event format; open the
+ * file in chrome://tracing or https://ui.perfetto.dev. A flow arrow links each
+ * emitted event back to the read it came from.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Arrival time of the sample being processed on this thread (0 if none).
+void setSampleArrivalNs(int64_t arrival_ns);
+int64_t getSampleArrivalNs();
+
+class Tracer {
+  public:
+    Tracer();
+
+    // Starts a new trace holding at most `max_events` events; later events
+    // are dropped.
+    void start(size_t max_events = 1 << 20);
+    // Stops tracing and writes the trace to `path`. Returns false on failure.
+    bool stop(const std::string& path);
+    bool isTracing() const { return is_tracing_.load(std::memory_order_relaxed); }
+
+    // All names must be string literals (or otherwise outlive the Tracer).
+
+    // A span of work on the calling thread. If `flow_id` is non-zero, starts
+    // a flow (arrow) that a later flowEnd() with the same id finishes.
+    void span(const char* name, int64_t start_ns, int64_t end_ns,
+              int64_t flow_id = 0);
+    // A span with one numeric argument, e.g. a queueing delay.
+    void span(const char* name, int64_t start_ns, int64_t end_ns,
+              const char* arg_name, int64_t arg_value);
+    // A point in time on the calling thread that ends the flow `flow_id`.
+    void flowEnd(const char* name, int64_t time_ns, int64_t flow_id,
+                 const char* arg_name, int64_t arg_value);
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    struct Event {
+        const char* name;
+        char phase;
+        int64_t time_ns;
+        int64_t duration_ns;
+        int64_t flow_id;
+        const char* arg_name;
+        int64_t arg_value;
+    };
+
+    // Events are buffered per thread; each buffer's mutex is only contended
+    // while stop() collects it.
+    struct ThreadBuffer {
+        std::mutex mutex;
+        uint32_t thread_id;
+        std::vector<Event> events;
+    };
+
+    ThreadBuffer* getThreadBuffer();
+    void add(const Event& event);
+
+    std::atomic<bool> is_tracing_;
+    std::atomic<size_t> num_events_;
+    size_t max_events_;
+
+    std::mutex buffers_mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    std::string last_error_;
+};
+
+// The process-wide tracer.
+Tracer& getTracer();
@@ -0,0 +1,29 @@
+#include "training_browser.h"
+
+#include <vector>
+
+TrainingSampleCaption getTrainingSampleCaption(const TrainingSet& set,
+                                               uint32_t class_label,
+                                               int index) {
+    TrainingSampleCaption caption;
+    caption.num_samples = set.getNumClassSamples(class_label);
+    caption.has_previous = caption.num_samples > 0 && index > 0;
+    caption.has_next = index + 1 < static_cast<int64_t>(caption.num_samples);
+    if (caption.num_samples > 0) {
+        caption.text = std::to_string(index + 1) + " / " +
+                       std::to_string(caption.num_samples);
+    }
+    return caption;
+}
+
+bool stepTrainingSample(const TrainingSet& set, uint32_t class_label,
+                        int step, int* index, GRT::MatrixDouble* sample) {
+    const std::vector<uint32_t>& ids = set.getClassSampleIds(class_label);
+    const int64_t next = static_cast<int64_t>(*index) + step;
+    if (next < 0 || next >= static_cast<int64_t>(ids.size())) {
+        return false;
+    }
+    *index = next;
+    *sample = set.getMatrix(ids[next]);
+    return true;
+}
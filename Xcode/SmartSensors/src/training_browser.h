@@ -0,0 +1,38 @@
+/*
+ * The training tab plots one sample of each class at a time, with "<-" and
+ * "->" under the plot to move between them. These functions are that
+ * navigation over a TrainingSet, apart from the drawing, so that
+ * headless/frame_bench.cpp times the same code the tab runs on every frame
+ * and on every click:
+ *
+ * TrainingSampleCaption caption =
+ *         getTrainingSampleCaption(training_data_, label, index);
+ * if (caption.num_samples > 0) { ofDrawBitmapString(caption.text, x, y); }
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "GRT/GRT.h"
+#include "training_set.h"
+
+// What is drawn under a class's plot.
+struct TrainingSampleCaption {
+    uint32_t num_samples;
+    // "3 / 10" for the third of ten samples; empty if the class has none.
+    std::string text;
+    // Whether to draw "<-" and "->".
+    bool has_previous;
+    bool has_next;
+};
+
+// `index` is the position of the plotted sample among the class's samples.
+TrainingSampleCaption getTrainingSampleCaption(const TrainingSet& set,
+                                               uint32_t class_label,
+                                               int index);
+
+// Moves `*index` by `step` (-1 or 1) and sets `*sample` to the sample there.
+// Returns false, changing nothing, if there is no sample there.
+bool stepTrainingSample(const TrainingSet& set, uint32_t class_label,
+                        int step, int* index, GRT::MatrixDouble* sample);
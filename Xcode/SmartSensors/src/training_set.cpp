@@ -0,0 +1,535 @@
+#include "training_set.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+uint64_t getBlockSize(uint32_t num_rows, uint32_t num_dimensions) {
+    return sizeof(TrainingSampleHeader) +
+           uint64_t(num_rows) * num_dimensions * sizeof(double);
+}
+
+}  // namespace
+
+TrainingSet::TrainingSet()
+        : num_dimensions_(0), num_samples_(0), index_offset_(0) {}
+
+void TrainingSet::clear() {
+    samples_.clear();
+    num_samples_ = 0;
+    class_ids_.clear();
+    class_names_.clear();
+    path_.clear();
+    file_.reset();
+    index_offset_ = 0;
+}
+
+bool TrainingSet::setNumDimensions(uint32_t num_dimensions) {
+    if (num_samples_ > 0 && num_dimensions != num_dimensions_) {
+        return false;
+    }
+    num_dimensions_ = num_dimensions;
+    return true;
+}
+
+std::vector<uint32_t> TrainingSet::getSampleIds() const {
+    std::vector<uint32_t> ids;
+    ids.reserve(num_samples_);
+    for (uint32_t id = 0; id < samples_.size(); id++) {
+        if (!samples_[id].is_erased) { ids.push_back(id); }
+    }
+    return ids;
+}
+
+const std::vector<uint32_t>& TrainingSet::getClassSampleIds(
+        uint32_t class_label) const {
+    static const std::vector<uint32_t> kNoIds;
+    std::map<uint32_t, std::vector<uint32_t>>::const_iterator it =
+            class_ids_.find(class_label);
+    return it != class_ids_.end() ? it->second : kNoIds;
+}
+
+GRT::MatrixDouble TrainingSet::getMatrix(uint32_t id) const {
+    const Sample& sample = samples_[id];
+    GRT::MatrixDouble matrix(sample.num_rows, num_dimensions_);
+    for (uint32_t d = 0; d < num_dimensions_; d++) {
+        const double* column = getColumn(id, d);
+        for (uint32_t row = 0; row < sample.num_rows; row++) {
+            matrix[row][d] = column[row];
+        }
+    }
+    return matrix;
+}
+
+TrainingSet::Sample TrainingSet::makeSample(
+        uint32_t class_label, const GRT::MatrixDouble& matrix) const {
+    const uint32_t num_rows = matrix.getNumRows();
+    std::shared_ptr<std::vector<double>> columns =
+            std::make_shared<std::vector<double>>(num_rows * num_dimensions_);
+    for (uint32_t row = 0; row < num_rows; row++) {
+        for (uint32_t d = 0; d < num_dimensions_; d++) {
+            (*columns)[d * num_rows + row] = matrix[row][d];
+        }
+    }
+    Sample sample;
+    sample.is_erased = false;
+    sample.class_label = class_label;
+    sample.num_rows = num_rows;
+    sample.stride = num_rows;
+    sample.first_row = 0;
+    sample.columns = columns->data();
+    sample.offset = 0;
+    sample.memory = columns;
+    return sample;
+}
+
+void TrainingSet::push(const Sample& sample) {
+    samples_.push_back(sample);
+    num_samples_++;
+    addToClass(samples_.size() - 1, sample.class_label);
+}
+
+void TrainingSet::addToClass(uint32_t id, uint32_t class_label) {
+    // Usually the last sample of the class; otherwise a binary search.
+    std::vector<uint32_t>& ids = class_ids_[class_label];
+    if (ids.empty() || ids.back() < id) {
+        ids.push_back(id);
+    } else {
+        ids.insert(std::lower_bound(ids.begin(), ids.end(), id), id);
+    }
+}
+
+void TrainingSet::removeFromClass(uint32_t id, uint32_t class_label) {
+    std::vector<uint32_t>& ids = class_ids_[class_label];
+    ids.erase(std::lower_bound(ids.begin(), ids.end(), id));
+}
+
+bool TrainingSet::append(uint32_t class_label,
+                         const GRT::MatrixDouble& sample, uint32_t* id) {
+    if (sample.getNumRows() == 0 || sample.getNumCols() != num_dimensions_) {
+        return false;
+    }
+    push(makeSample(class_label, sample));
+    if (id != nullptr) { *id = samples_.size() - 1; }
+    return true;
+}
+
+void TrainingSet::erase(uint32_t id) {
+    Sample& sample = samples_[id];
+    removeFromClass(id, sample.class_label);
+    // Its values (in memory, or in the file until it is compacted) are no
+    // longer used.
+    sample.is_erased = true;
+    sample.columns = nullptr;
+    sample.offset = 0;
+    sample.memory.reset();
+    num_samples_--;
+}
+
+bool TrainingSet::trim(uint32_t id, uint32_t first_row, uint32_t num_rows) {
+    Sample& sample = samples_[id];
+    if (num_rows == 0 || first_row >= sample.num_rows ||
+        num_rows > sample.num_rows - first_row) {
+        return false;
+    }
+    sample.first_row += first_row;
+    sample.num_rows = num_rows;
+    return true;
+}
+
+void TrainingSet::setClassLabel(uint32_t id, uint32_t class_label) {
+    Sample& sample = samples_[id];
+    if (sample.class_label == class_label) { return; }
+    removeFromClass(id, sample.class_label);
+    addToClass(id, class_label);
+    sample.class_label = class_label;
+}
+
+const std::string& TrainingSet::getClassName(uint32_t class_label) const {
+    static const std::string kNoName;
+    std::map<uint32_t, std::string>::const_iterator it =
+            class_names_.find(class_label);
+    return it != class_names_.end() ? it->second : kNoName;
+}
+
+void TrainingSet::setClassName(uint32_t class_label,
+                               const std::string& name) {
+    if (name.empty()) {
+        class_names_.erase(class_label);
+    } else {
+        class_names_[class_label] = name;
+    }
+}
+
+GRT::TimeSeriesClassificationData TrainingSet::toTimeSeriesData() const {
+    GRT::TimeSeriesClassificationData data;
+    data.setNumDimensions(num_dimensions_);
+    for (uint32_t id = 0; id < samples_.size(); id++) {
+        if (samples_[id].is_erased) { continue; }
+        data.addSample(samples_[id].class_label, getMatrix(id));
+    }
+    // GRT only names classes that have samples.
+    for (const std::pair<const uint32_t, std::string>& name : class_names_) {
+        data.setClassNameForCorrespondingClassLabel(name.second, name.first);
+    }
+    return data;
+}
+
+void TrainingSet::assign(GRT::TimeSeriesClassificationData& data) {
+    clear();
+    num_dimensions_ = data.getNumDimensions();
+    samples_.reserve(data.getNumSamples());
+    for (uint32_t i = 0; i < data.getNumSamples(); i++) {
+        append(data[i].getClassLabel(), data[i].getData());
+    }
+    for (const GRT::ClassTracker& tracker : data.getClassTracker()) {
+        if (tracker.className != "NOT_SET") {
+            setClassName(tracker.classLabel, tracker.className);
+        }
+    }
+}
+
+bool TrainingSet::load(const std::string& path) {
+    clear();
+
+    file_ = std::make_shared<MappedFile>();
+    if (!file_->open(path)) {
+        last_error_ = file_->getLastError();
+        clear();
+        return false;
+    }
+
+    const TrainingFileHeader* header =
+            reinterpret_cast<const TrainingFileHeader*>(file_->data());
+    if (file_->size() < sizeof(*header) ||
+        memcmp(header->magic, kTrainingFileMagic, sizeof(header->magic)) != 0) {
+        last_error_ = path + " is not a training set file";
+        clear();
+        return false;
+    }
+    if (header->version == 0 || header->version > kTrainingFileVersion) {
+        last_error_ = path + " has unsupported training set version " +
+                std::to_string(header->version);
+        clear();
+        return false;
+    }
+    if (header->num_dimensions == 0) {
+        last_error_ = path + " has an invalid training set header";
+        clear();
+        return false;
+    }
+
+    num_dimensions_ = header->num_dimensions;
+    path_ = path;
+    if (!readIndex() && !rebuildIndex()) {
+        last_error_ = path + " is corrupt";
+        clear();
+        return false;
+    }
+    last_error_.clear();
+    return true;
+}
+
+bool TrainingSet::readIndex() {
+    const uint8_t* data = file_->data();
+    const uint64_t size = file_->size();
+    if (size < sizeof(TrainingFileHeader) + sizeof(TrainingIndexFooter)) {
+        return false;
+    }
+    const TrainingIndexFooter* footer =
+            reinterpret_cast<const TrainingIndexFooter*>(
+                    data + size - sizeof(TrainingIndexFooter));
+    // Trust the index only if it is consistent with the file size.
+    if (memcmp(footer->magic, kTrainingIndexMagic,
+               sizeof(footer->magic)) != 0 ||
+        footer->index_offset < sizeof(TrainingFileHeader) ||
+        footer->index_offset % sizeof(double) != 0 ||
+        footer->num_samples > size / sizeof(TrainingIndexEntry) ||
+        footer->num_classes > size / sizeof(TrainingClassEntry) ||
+        footer->index_offset +
+                footer->num_samples * sizeof(TrainingIndexEntry) +
+                footer->num_classes * sizeof(TrainingClassEntry) +
+                sizeof(TrainingIndexFooter) != size) {
+        return false;
+    }
+
+    const TrainingIndexEntry* entries =
+            reinterpret_cast<const TrainingIndexEntry*>(
+                    data + footer->index_offset);
+    samples_.reserve(footer->num_samples);
+    for (uint64_t i = 0; i < footer->num_samples; i++) {
+        const TrainingIndexEntry& entry = entries[i];
+        if (entry.offset < sizeof(TrainingFileHeader) ||
+            entry.offset % sizeof(double) != 0 ||
+            entry.offset > footer->index_offset ||
+            footer->index_offset - entry.offset <
+                    sizeof(TrainingSampleHeader)) {
+            return false;
+        }
+        const TrainingSampleHeader* block =
+                reinterpret_cast<const TrainingSampleHeader*>(
+                        data + entry.offset);
+        if (getBlockSize(block->num_rows, num_dimensions_) >
+                    footer->index_offset - entry.offset ||
+            entry.num_rows == 0 || entry.first_row >= block->num_rows ||
+            entry.num_rows > block->num_rows - entry.first_row) {
+            return false;
+        }
+        Sample sample;
+        sample.is_erased = false;
+        sample.class_label = entry.class_label;
+        sample.num_rows = entry.num_rows;
+        sample.stride = block->num_rows;
+        sample.first_row = entry.first_row;
+        sample.offset = entry.offset;
+        sample.columns = reinterpret_cast<const double*>(
+                data + entry.offset + sizeof(TrainingSampleHeader));
+        push(sample);
+    }
+
+    const TrainingClassEntry* classes =
+            reinterpret_cast<const TrainingClassEntry*>(
+                    entries + footer->num_samples);
+    for (uint64_t i = 0; i < footer->num_classes; i++) {
+        uint32_t length = std::min<uint32_t>(classes[i].name_length,
+                                             sizeof(classes[i].name));
+        class_names_[classes[i].class_label] =
+                std::string(classes[i].name, length);
+    }
+    index_offset_ = footer->index_offset;
+    return true;
+}
+
+bool TrainingSet::rebuildIndex() {
+    // Whatever readIndex() read before it gave up.
+    samples_.clear();
+    num_samples_ = 0;
+    class_ids_.clear();
+    const uint8_t* data = file_->data();
+    uint64_t offset = sizeof(TrainingFileHeader);
+    while (offset + sizeof(TrainingSampleHeader) <= file_->size()) {
+        const TrainingSampleHeader* header =
+                reinterpret_cast<const TrainingSampleHeader*>(data + offset);
+        if (memcmp(header->magic, kTrainingSampleMagic,
+                   sizeof(header->magic)) != 0 ||
+            header->num_rows == 0 ||
+            getBlockSize(header->num_rows, num_dimensions_) >
+                    file_->size() - offset) {
+            break;
+        }
+        Sample sample;
+        sample.is_erased = false;
+        sample.class_label = header->class_label;
+        sample.num_rows = header->num_rows;
+        sample.stride = header->num_rows;
+        sample.first_row = 0;
+        sample.offset = offset;
+        sample.columns = reinterpret_cast<const double*>(
+                data + offset + sizeof(TrainingSampleHeader));
+        push(sample);
+        offset += getBlockSize(header->num_rows, num_dimensions_);
+    }
+    index_offset_ = offset;
+    return true;
+}
+
+bool TrainingSet::save(const std::string& path) {
+    if (num_dimensions_ == 0) {
+        last_error_ = "The training set has no dimensions";
+        return false;
+    }
+    bool ok = path == path_ && file_ != nullptr && !isMostlyUnused()
+            ? appendToFile() : rewrite(path);
+    if (ok) { last_error_.clear(); }
+    return ok;
+}
+
+bool TrainingSet::isMostlyUnused() const {
+    uint64_t used = 0;
+    for (const Sample& sample : samples_) {
+        // Trimmed rows count as unused.
+        if (sample.offset != 0) {
+            used += getBlockSize(sample.num_rows, num_dimensions_);
+        }
+    }
+    return used * 2 < index_offset_ - sizeof(TrainingFileHeader);
+}
+
+bool TrainingSet::fail(FILE* file, const std::string& what) {
+    last_error_ = what + ": " + strerror(errno);
+    if (file != nullptr) { fclose(file); }
+    return false;
+}
+
+bool TrainingSet::rewrite(const std::string& path) {
+    // Written next to `path` and renamed over it, so that a failed save
+    // leaves the old file (which may be the one mapped) as it was.
+    const std::string temporary_path = path + ".tmp";
+    FILE* file = fopen(temporary_path.c_str(), "wb");
+    if (file == nullptr) {
+        last_error_ = "Failed to open " + temporary_path + ": " +
+                strerror(errno);
+        return false;
+    }
+
+    TrainingFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTrainingFileMagic, sizeof(header.magic));
+    header.version = kTrainingFileVersion;
+    header.num_dimensions = num_dimensions_;
+    std::vector<Block> blocks;
+    uint64_t index_offset;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fail(file, "Failed to write the training set header");
+        remove(temporary_path.c_str());
+        return false;
+    }
+    if (!writeSamples(file, sizeof(header), true, &blocks, &index_offset)) {
+        remove(temporary_path.c_str());
+        return false;
+    }
+    if (fclose(file) != 0) {
+        fail(nullptr, "Failed to close " + temporary_path);
+        remove(temporary_path.c_str());
+        return false;
+    }
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        fail(nullptr, "Failed to rename " + temporary_path);
+        remove(temporary_path.c_str());
+        return false;
+    }
+    path_ = path;
+    return remap(blocks, index_offset);
+}
+
+bool TrainingSet::appendToFile() {
+    FILE* file = fopen(path_.c_str(), "r+b");
+    if (file == nullptr) {
+        last_error_ = "Failed to open " + path_ + ": " + strerror(errno);
+        return false;
+    }
+    // The new samples go over the old index, which is written again after
+    // them.
+    std::vector<Block> blocks;
+    uint64_t index_offset;
+    if (fseeko(file, index_offset_, SEEK_SET) != 0) {
+        return fail(file, "Failed to seek in " + path_);
+    }
+    if (!writeSamples(file, index_offset_, false, &blocks, &index_offset)) {
+        return false;
+    }
+    // The file shrinks if samples were erased.
+    off_t end = ftello(file);
+    if (fflush(file) != 0 || end < 0 || ftruncate(fileno(file), end) != 0) {
+        return fail(file, "Failed to write " + path_);
+    }
+    if (fclose(file) != 0) {
+        return fail(nullptr, "Failed to close " + path_);
+    }
+    return remap(blocks, index_offset);
+}
+
+bool TrainingSet::writeSamples(FILE* file, uint64_t offset, bool write_all,
+                               std::vector<Block>* blocks,
+                               uint64_t* index_offset) {
+    blocks->resize(samples_.size());
+    std::vector<TrainingIndexEntry> entries;
+    entries.reserve(num_samples_);
+    for (uint32_t id = 0; id < samples_.size(); id++) {
+        const Sample& sample = samples_[id];
+        if (sample.is_erased) { continue; }
+        Block& block = (*blocks)[id];
+        if (!write_all && sample.offset != 0) {
+            block.offset = sample.offset;
+            block.stride = sample.stride;
+            block.first_row = sample.first_row;
+        } else {
+            // Only the rows the sample uses.
+            TrainingSampleHeader header;
+            memcpy(header.magic, kTrainingSampleMagic, sizeof(header.magic));
+            header.class_label = sample.class_label;
+            header.num_rows = sample.num_rows;
+            header.reserved = 0;
+            if (fwrite(&header, sizeof(header), 1, file) != 1) {
+                return fail(file, "Failed to write a training sample");
+            }
+            for (uint32_t d = 0; d < num_dimensions_; d++) {
+                if (fwrite(getColumn(id, d), sizeof(double), sample.num_rows,
+                           file) != sample.num_rows) {
+                    return fail(file, "Failed to write a training sample");
+                }
+            }
+            block.offset = offset;
+            block.stride = sample.num_rows;
+            block.first_row = 0;
+            offset += getBlockSize(sample.num_rows, num_dimensions_);
+        }
+
+        TrainingIndexEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = block.offset;
+        entry.class_label = sample.class_label;
+        entry.num_rows = sample.num_rows;
+        entry.first_row = block.first_row;
+        entries.push_back(entry);
+    }
+    *index_offset = offset;
+
+    std::vector<TrainingClassEntry> classes;
+    for (const std::pair<const uint32_t, std::string>& name : class_names_) {
+        TrainingClassEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.class_label = name.first;
+        entry.name_length = std::min(name.second.size(), sizeof(entry.name));
+        memcpy(entry.name, name.second.data(), entry.name_length);
+        classes.push_back(entry);
+    }
+    TrainingIndexFooter footer;
+    footer.index_offset = offset;
+    footer.num_samples = entries.size();
+    footer.num_classes = classes.size();
+    memcpy(footer.magic, kTrainingIndexMagic, sizeof(footer.magic));
+
+    if ((!entries.empty() &&
+         fwrite(entries.data(), sizeof(TrainingIndexEntry), entries.size(),
+                file) != entries.size()) ||
+        (!classes.empty() &&
+         fwrite(classes.data(), sizeof(TrainingClassEntry), classes.size(),
+                file) != classes.size()) ||
+        fwrite(&footer, sizeof(footer), 1, file) != 1) {
+        return fail(file, "Failed to write the training set index");
+    }
+    return true;
+}
+
+bool TrainingSet::remap(const std::vector<Block>& blocks,
+                        uint64_t index_offset) {
+    // Copies of the set (e.g. a training snapshot) keep the old mapping.
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path_)) {
+        // The samples still point at the old mapping or at memory, so the
+        // set stays usable; it is rewritten in full next time.
+        last_error_ = file->getLastError();
+        path_.clear();
+        return false;
+    }
+    file_ = file;
+    index_offset_ = index_offset;
+    for (uint32_t id = 0; id < samples_.size(); id++) {
+        Sample& sample = samples_[id];
+        if (sample.is_erased) { continue; }
+        const Block& block = blocks[id];
+        sample.offset = block.offset;
+        sample.stride = block.stride;
+        sample.first_row = block.first_row;
+        sample.columns = reinterpret_cast<const double*>(
+                file_->data() + block.offset + sizeof(TrainingSampleHeader));
+        sample.memory.reset();
+    }
+    return true;
+}
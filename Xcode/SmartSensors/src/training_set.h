@@ -0,0 +1,230 @@
+/*
+ * TrainingSet holds the app's training recordings (time series with a class
+ * label) in a compact binary file that is memory-mapped rather than parsed,
+ * so that loading tens of thousands of recordings takes as long as reading
+ * the index, and they are not held in memory twice.
+ *
+ * Samples are named by an ID that stays the same while the set is edited
+ * (until it is loaded again), so that deleting, trimming or relabelling one
+ * never moves or copies the others: a deleted sample leaves an unused ID, a
+ * trimmed one keeps its values and only narrows the rows it uses, and a
+ * relabelled one keeps its place. Each class keeps the IDs of its samples,
+ * in order.
+ *
+ * Layout (little-endian, every section 8-byte aligned):
+ *
+ *   TrainingFileHeader
+ *   sample 0, sample 1, ...    each a TrainingSampleHeader followed by its
+ *                              values, dimension by dimension: num_rows
+ *                              doubles of dimension 0, then of dimension 1...
+ *   TrainingIndexEntry[n]      one per sample, in order, with the rows of
+ *                              its block it uses
+ *   TrainingClassEntry[m]      the name of each named class
+ *   TrainingIndexFooter        last bytes of the file
+ *
+ * Samples recorded since the set was loaded are kept in memory until it is
+ * saved. Saving to the file it was loaded from only appends them and
+ * rewrites the index, unless most of the file is taken by samples (or rows
+ * of trimmed samples) that were erased since, in which case the file is
+ * rewritten without them. As with session files, a file whose index was
+ * never written (the app crashed while saving) can still be read by walking
+ * the samples, though class names are then lost, and samples erased or
+ * trimmed before the crash come back whole.
+ *
+ * Copies are cheap: the values are shared, not copied, so a copy is a
+ * snapshot a training thread can read while the app keeps editing the set.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GRT/GRT.h"
+#include "mapped_file.h"
+
+const char kTrainingFileMagic[4] = { 'E', 'S', 'P', 'T' };
+const char kTrainingSampleMagic[4] = { 'S', 'M', 'P', 'L' };
+const char kTrainingIndexMagic[8] = { 'E', 'S', 'P', 'T', 'I', 'D', 'X', '1' };
+// Version 1 had no first_row in TrainingIndexEntry (it was always 0).
+const uint32_t kTrainingFileVersion = 2;
+
+struct TrainingFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_dimensions;
+    uint32_t reserved0;
+    uint8_t reserved[48];
+};
+static_assert(sizeof(TrainingFileHeader) == 64, "TrainingFileHeader layout");
+
+struct TrainingSampleHeader {
+    char magic[4];
+    uint32_t class_label;
+    // Of the block; the index says which of them the sample uses.
+    uint32_t num_rows;
+    uint32_t reserved;
+};
+static_assert(sizeof(TrainingSampleHeader) == 16,
+              "TrainingSampleHeader layout");
+
+struct TrainingIndexEntry {
+    // Of the sample's TrainingSampleHeader.
+    uint64_t offset;
+    uint32_t class_label;
+    // The sample is rows first_row to first_row + num_rows of its block.
+    uint32_t num_rows;
+    uint32_t first_row;
+    uint8_t reserved[12];
+};
+static_assert(sizeof(TrainingIndexEntry) == 32, "TrainingIndexEntry layout");
+
+struct TrainingClassEntry {
+    uint32_t class_label;
+    uint32_t name_length;
+    // Not null-terminated; longer names are cut.
+    char name[56];
+};
+static_assert(sizeof(TrainingClassEntry) == 64, "TrainingClassEntry layout");
+
+struct TrainingIndexFooter {
+    uint64_t index_offset;
+    uint64_t num_samples;
+    uint64_t num_classes;
+    char magic[8];
+};
+static_assert(sizeof(TrainingIndexFooter) == 32, "TrainingIndexFooter layout");
+
+class TrainingSet {
+  public:
+    TrainingSet();
+
+    // Forgets every sample and class name, and the file.
+    void clear();
+    // Only while there are no samples.
+    bool setNumDimensions(uint32_t num_dimensions);
+    uint32_t getNumDimensions() const { return num_dimensions_; }
+
+    uint32_t getNumSamples() const { return num_samples_; }
+    // The IDs of every sample, in order.
+    std::vector<uint32_t> getSampleIds() const;
+    // The IDs of the samples of a class, in order. Once the class has had
+    // samples, the vector follows edits until the set is cleared, loaded or
+    // replaced.
+    const std::vector<uint32_t>& getClassSampleIds(uint32_t class_label) const;
+    uint32_t getNumClassSamples(uint32_t class_label) const {
+        return getClassSampleIds(class_label).size();
+    }
+
+    // Of a sample that was not erased.
+    uint32_t getClassLabel(uint32_t id) const {
+        return samples_[id].class_label;
+    }
+    uint32_t getNumRows(uint32_t id) const { return samples_[id].num_rows; }
+    // The num_rows values of dimension `d` of sample `id`. Valid until the
+    // sample is erased, or the set is saved, loaded or cleared.
+    const double* getColumn(uint32_t id, uint32_t d) const {
+        const Sample& sample = samples_[id];
+        return sample.columns + d * sample.stride + sample.first_row;
+    }
+    // Sample `id` as GRT has it, one row per time step.
+    GRT::MatrixDouble getMatrix(uint32_t id) const;
+
+    // Adds a sample after the others, and sets `id` to its ID if not null.
+    // False if it is empty or does not have getNumDimensions() columns.
+    bool append(uint32_t class_label, const GRT::MatrixDouble& sample,
+                uint32_t* id = nullptr);
+    void erase(uint32_t id);
+    // Keeps rows first_row to first_row + num_rows of the sample (as
+    // getMatrix() has them) and drops the others. False if they are not
+    // rows of the sample, or none.
+    bool trim(uint32_t id, uint32_t first_row, uint32_t num_rows);
+    void setClassLabel(uint32_t id, uint32_t class_label);
+
+    // Empty if the class has no name.
+    const std::string& getClassName(uint32_t class_label) const;
+    void setClassName(uint32_t class_label, const std::string& name);
+
+    // Copies the samples and class names into GRT's training data, e.g. to
+    // train a pipeline on them.
+    GRT::TimeSeriesClassificationData toTimeSeriesData() const;
+    // Replaces the contents with GRT's training data. `data` is not changed;
+    // it is not const because GRT only indexes samples through a non-const
+    // operator[].
+    void assign(GRT::TimeSeriesClassificationData& data);
+
+    // Return false on failure; see getLastError(). A set that failed to load
+    // is empty. Loading numbers the samples from 0 in order; saving keeps
+    // their IDs.
+    bool load(const std::string& path);
+    bool save(const std::string& path);
+
+    const std::string& getLastError() const { return last_error_; }
+
+  private:
+    struct Sample {
+        bool is_erased;
+        uint32_t class_label;
+        uint32_t num_rows;
+        // Rows stored per dimension at `columns`, of which the sample uses
+        // num_rows from first_row.
+        uint32_t stride;
+        uint32_t first_row;
+        const double* columns;
+        // Of the sample's block in file_, or 0 if it is only in memory.
+        uint64_t offset;
+        // Holds `columns` if they are only in memory.
+        std::shared_ptr<const std::vector<double>> memory;
+    };
+    // Where saving put a sample.
+    struct Block {
+        uint64_t offset;
+        uint32_t stride;
+        uint32_t first_row;
+    };
+
+    Sample makeSample(uint32_t class_label,
+                      const GRT::MatrixDouble& sample) const;
+    // Adds a sample after the others, as ID samples_.size().
+    void push(const Sample& sample);
+    void addToClass(uint32_t id, uint32_t class_label);
+    void removeFromClass(uint32_t id, uint32_t class_label);
+    // Reads the index of the mapped file_, or walks its samples if it has
+    // none.
+    bool readIndex();
+    bool rebuildIndex();
+    // Whether more than half of the samples in path_ are no longer used.
+    bool isMostlyUnused() const;
+    // Writes every sample to a new file at `path`.
+    bool rewrite(const std::string& path);
+    // Appends the samples that are only in memory to path_, then the index.
+    bool appendToFile();
+    // Writes the samples (all of them, or only those only in memory) to
+    // `file` at `offset`, followed by the index; fills in the block of every
+    // sample, and where the index starts.
+    bool writeSamples(FILE* file, uint64_t offset, bool write_all,
+                      std::vector<Block>* blocks, uint64_t* index_offset);
+    // Maps path_ again and points the samples at it.
+    bool remap(const std::vector<Block>& blocks, uint64_t index_offset);
+    bool fail(FILE* file, const std::string& what);
+
+    uint32_t num_dimensions_;
+    // Indexed by ID, including erased samples.
+    std::vector<Sample> samples_;
+    uint32_t num_samples_;
+    // Classes are not removed when their last sample is, so that references
+    // to their IDs stay valid.
+    std::map<uint32_t, std::vector<uint32_t>> class_ids_;
+    std::map<uint32_t, std::string> class_names_;
+
+    // The file the set was loaded from or last saved to, and where its
+    // index starts (the end of its last sample).
+    std::string path_;
+    std::shared_ptr<MappedFile> file_;
+    uint64_t index_offset_;
+
+    std::string last_error_;
+};
@@ -0,0 +1,63 @@
+/*
+ * TripleBuffer hands the latest version of a value from one writer thread to
+ * one reader thread without locks and without either side ever waiting. The
+ * writer fills back() and publish()es it; the reader calls update() to pick up
+ * the most recently published value (intermediate ones are skipped) and reads
+ * it from front().
+ *
+ * TripleBuffer<Prediction> prediction;
+ *
+ * // writer
+ * prediction.back().label = label;
+ * prediction.publish();
+ *
+ * // reader
+ * if (prediction.update()) { draw(prediction.front()); }
+ *
+ * The three buffers are re-used, so values holding vectors of a steady size
+ * stop allocating after the first few rounds.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template<typename T>
+class TripleBuffer {
+  public:
+    explicit TripleBuffer(const T& prototype = T())
+            : buffers_{ prototype, prototype, prototype },
+              back_(0), middle_(1), front_(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side.
+    T& back() { return buffers_[back_]; }
+
+    void publish() {
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+                kIndexMask;
+    }
+
+    // Reader side. Returns true if a value was published since the last call.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return buffers_[front_]; }
+
+  private:
+    static const uint8_t kIndexMask = 0x3;
+    // Set in middle_ when it holds a value the reader has not seen yet.
+    static const uint8_t kFresh = 0x4;
+
+    T buffers_[3];
+    uint8_t back_;                  // writer only
+    std::atomic<uint8_t> middle_;   // shared
+    uint8_t front_;                 // reader only
+};
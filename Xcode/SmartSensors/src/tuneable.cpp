@@ -1,11 +1,31 @@
 #include "tuneable.h"
 
 #include <cmath>
+#include <map>
 
-#include "ofApp.h"
+#include "runtime.h"
 
 static std::map<void*, Tuneable*> allTuneables;
 
+double Tuneable::getValue() const {
+    switch (type_) {
+        case INT_RANGE: return *static_cast<int*>(value_ptr_);
+        case DOUBLE_RANGE: return *static_cast<double*>(value_ptr_);
+        case BOOL: return *static_cast<bool*>(value_ptr_) ? 1 : 0;
+        default: return 0;
+    }
+}
+
+void Tuneable::setValue(double value) {
+    switch (type_) {
+        case INT_RANGE: *static_cast<int*>(value_ptr_) = std::round(value); break;
+        case DOUBLE_RANGE: *static_cast<double*>(value_ptr_) = value; break;
+        case BOOL: *static_cast<bool*>(value_ptr_) = value != 0; break;
+        default: break;
+    }
+}
+
+#ifndef ESP_HEADLESS
 void Tuneable::onSliderEvent(ofxDatGuiSliderEvent e) {
     for (const auto& t : allTuneables) {
         void* data_ptr = t.second->getDataAddress();
@@ -24,7 +44,7 @@ void Tuneable::onSliderEvent(ofxDatGuiSliderEvent e) {
                 *value = e.value;
             }
 
-            ((ofApp *) ofGetAppPtr())->reloadPipelineModules();
+            getRuntime()->reloadPipelineModules();
         }
     }
 }
@@ -36,10 +56,11 @@ void Tuneable::onToggleEvent(ofxDatGuiButtonEvent e) {
         if (e.target == ui_ptr) {
             bool* value = static_cast<bool*>(data_ptr);
             *value = e.enabled;
-            ((ofApp *) ofGetAppPtr())->reloadPipelineModules();
+            getRuntime()->reloadPipelineModules();
         }
     }
 }
+#endif
 
 void registerTuneable(int& value, int min, int max,
                       const string& title,
@@ -51,7 +72,7 @@ void registerTuneable(int& value, int min, int max,
 
     Tuneable* t = new Tuneable(&value, min, max, title, description);
     allTuneables[address] = t;
-    ((ofApp *) ofGetAppPtr())->registerTuneable(t);
+    getRuntime()->registerTuneable(t);
 }
 
 void registerTuneable(double& value, double min, double max,
@@ -64,7 +85,7 @@ void registerTuneable(double& value, double min, double max,
 
     Tuneable* t = new Tuneable(&value, min, max, title, description);
     allTuneables[address] = t;
-    ((ofApp *) ofGetAppPtr())->registerTuneable(t);
+    getRuntime()->registerTuneable(t);
 }
 
 void registerTuneable(bool& value,
@@ -77,5 +98,5 @@ void registerTuneable(bool& value,
 
     Tuneable* t = new Tuneable(&value, title, description);
     allTuneables[address] = t;
-    ((ofApp *) ofGetAppPtr())->registerTuneable(t);
+    getRuntime()->registerTuneable(t);
 }
@@ -2,7 +2,9 @@
 
 #include <string>
 
+#ifndef ESP_HEADLESS
 #include "ofxDatGui.h"
+#endif
 
 using std::string;
 
@@ -26,8 +28,10 @@ class Tuneable {
     // Boolean tuneable
     Tuneable(bool* value, const string& title, const string& description)
             : value_ptr_(value), ui_ptr_(NULL),
-              type_(BOOL), title_(title), description_(description) {}
+              type_(BOOL), title_(title), description_(description),
+              min_(0), max_(1) {}
 
+#ifndef ESP_HEADLESS
     void addToGUI(ofxDatGui& gui) {
         switch (type_) {
           case INT_RANGE: {
@@ -62,6 +66,7 @@ class Tuneable {
           default: break;
         }
     }
+#endif
 
     void* getUIAddress() const {
         return ui_ptr_;
@@ -74,9 +79,22 @@ class Tuneable {
     Type getType() const {
         return type_;
     }
+
+    const string& getTitle() const { return title_; }
+    // The range of INT_RANGE and DOUBLE_RANGE tuneables; 0 to 1 for BOOL.
+    double getMin() const { return min_; }
+    double getMax() const { return max_; }
+
+    // The current value, with booleans as 0 or 1.
+    double getValue() const;
+    // Sets the value without notifying anyone (ints are rounded and booleans
+    // are true unless 0). Does not update the GUI.
+    void setValue(double value);
   private:
+#ifndef ESP_HEADLESS
     void onSliderEvent(ofxDatGuiSliderEvent e);
     void onToggleEvent(ofxDatGuiButtonEvent e);
+#endif
 
     void* value_ptr_;
     void* ui_ptr_;
@@ -32,8 +32,8 @@ void setup()
         "Rest accelerometer on flat surface.", restingDataCollected);
     useCalibrator(calibrator);
 
-    pipeline.setClassifier(DTW(false, true, threshold));
-    pipeline.addPostProcessingModule(ClassLabelTimeoutFilter(timeout));
+    pipeline.setClassifier(PrunedDTW(false, true, threshold));
+    pipeline.addPostProcessingModule(ClockedClassLabelTimeoutFilter(timeout));
     usePipeline(pipeline);
 
     registerTuneable(threshold, 0.1, 3.0,
@@ -1,6 +1,10 @@
 #include <ESP.h>
 
 ASCIISerialStream stream(0, 9600, 3);
+// To run the pipeline over a recorded session instead (as fast as possible),
+// use the line below and drop the useNormalizer() call in setup(): sessions
+// already hold normalized samples. Every run records one to data/sessions/.
+// ReplayStream stream(ofToDataPath("sessions/session-20161016-120000.esps"), 0);
 GestureRecognitionPipeline pipeline;
 TcpOStream oStream("localhost", 5204, 3, "l", "r", " ");
 
@@ -28,16 +32,23 @@ void setup()
     stream.setLabelsForAllDimensions({"x", "y", "z"});
     useStream(stream);
     
-    pipeline.setClassifier(DTW(false, true, threshold)); // don't use scaling, use null rejection, null rejection parameter
+    // PrunedDTW takes the place of GRT's DTW(false, true, threshold) but
+    // skips most of the alignment work (see pruned_dtw.h; make dtw-bench
+    // compares the two on your recordings). To fire each
+    // gesture once, as soon as it ends, call dtw.setUseSpotting(true) and
+    // drop the timeout filter below. With many templates, dtw.setThreadPool()
+    // can score them in parallel; run dtw-bench with --threads first to see
+    // whether that is any faster on your recordings.
+    PrunedDTW dtw(false, true, threshold); // don't use scaling, use null rejection, null rejection parameter
+    pipeline.setClassifier(dtw);
     // null rejection parameter is multiplied by the standard deviation to determine
     // the rejection threshold. the higher the number, the looser the filter; the
     // lower the number, the tighter the filter.
     
-    // We don't use a ClassLabelTimeoutFilter because it doesn't work
-    // properly when replaying saved sensor data (which is stored without
-    // timestamps). Instead, filter by number of samples using a
-    // ClassLabelFilter.
-    pipeline.addPostProcessingModule(ClassLabelTimeoutFilter(timeout));
+    // The timeout is measured on sample timestamps rather than the wall
+    // clock, so the filter behaves the same on recorded test data and on
+    // sessions replayed with ReplayStream as it does live.
+    pipeline.addPostProcessingModule(ClockedClassLabelTimeoutFilter(timeout));
     //pipeline.addPostProcessingModule(ClassLabelFilter(1, 25));
     usePipeline(pipeline);
     
@@ -70,12 +70,12 @@ void setup()
     useCalibrator(calibrator);
     
     pipeline.addFeatureExtractionModule(TimeDomainFeatures(10, 1, 3, false, true, true, false, false));
-    pipeline.setClassifier(ANBC(false, true, null_rej)); // use scaling, use null rejection, null rejection parameter
+    pipeline.setClassifier(FastANBC(false, true, null_rej)); // use scaling, use null rejection, null rejection parameter
     // null rejection parameter is multiplied by the standard deviation to determine
     // the rejection threshold. the higher the number, the looser the filter; the
     // lower the number, the tighter the filter.
 
-    pipeline.addPostProcessingModule(ClassLabelTimeoutFilter(timeout));
+    pipeline.addPostProcessingModule(ClockedClassLabelTimeoutFilter(timeout));
     usePipeline(pipeline);
     
     registerTuneable(timeout, 10, 1000, "Timeout",
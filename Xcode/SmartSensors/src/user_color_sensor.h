@@ -26,7 +26,7 @@ void setup() {
 
     pipeline.addPreProcessingModule(MovingAverageFilter(5, 3));
     // use scaling, use null rejection, null rejection parameter
-    pipeline.setClassifier(ANBC(scaling, true, null_rej));
+    pipeline.setClassifier(FastANBC(scaling, true, null_rej));
 
     // null rejection parameter is multiplied by the standard deviation to determine
     // the rejection threshold. the higher the number, the looser the filter; the